@@ -110,6 +110,9 @@ static int setup_transfer(int mode, __dev_t dev, __blk_t block, char *buffer, in
 	struct ide *ide;
 	struct ata_drv *drive;
 	struct partition *part;
+#ifdef CONFIG_PCI
+	struct blk_request *br;
+#endif /* CONFIG_PCI */
 
 	if(!(ide = get_ide_controller(dev))) {
 		return -EINVAL;
@@ -140,6 +143,24 @@ static int setup_transfer(int mode, __dev_t dev, __blk_t block, char *buffer, in
 	drive->xd.buffer = buffer;
 	drive->xd.blksize = blksize;
 	drive->xd.count = 0;
+	drive->xd.br = NULL;
+
+#ifdef CONFIG_PCI
+	if(drive->flags & DRIVE_HAS_DMA) {
+		/*
+		 * Merge the consecutive requests that follow the current one
+		 * (at the head of the queue) to transfer them all with a single
+		 * DMA command using a scatter-gather PRD table.
+		 */
+		br = (struct blk_request *)ide->device->requests_queue;
+		if(br && br->status == BR_PROCESSING && br->buffer->data == buffer) {
+			drive->xd.br = br;
+			drive->xd.sectors_to_io = merge_blk_request(br, ATA_MAX_SECTORS * ATA_HD_SECTSIZE) / ATA_HD_SECTSIZE;
+		}
+		drive->xd.nrsectors = drive->xd.sectors_to_io;
+		drive->xd.datalen = ATA_HD_SECTSIZE * drive->xd.nrsectors;
+	}
+#endif /* CONFIG_PCI */
 
 	if(mode == BLK_READ) {
 #ifdef CONFIG_PCI
@@ -265,7 +286,7 @@ static int dma_transfer(struct ide *ide, struct ata_drv *drive, struct xfer_data
 		return -EIO;
 	}
 
-	ata_setup_dma(ide, drive, xd->buffer, xd->datalen);
+	ata_setup_dma(ide, drive, xd);
 	ata_start_dma(ide, drive, xd->bm_cmd);
 	ata_set_timeout(ide, WAIT_FOR_DISK, 0);
 	outport_b(ide->base + ATA_COMMAND, xd->cmd);
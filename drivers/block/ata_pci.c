@@ -7,6 +7,7 @@
 
 #include <fiwix/asm.h>
 #include <fiwix/ata.h>
+#include <fiwix/buffer.h>
 #include <fiwix/pci.h>
 #include <fiwix/mm.h>
 #include <fiwix/stdio.h>
@@ -18,13 +19,31 @@ static struct pci_supported_devices supported[] = {
 	{ 0, 0 }
 };
 
-void ata_setup_dma(struct ide *ide, struct ata_drv *drive, char *buffer, int datalen)
+/*
+ * Builds the PRD table with one entry per buffer: the one in 'xd' and then
+ * the buffers of the requests merged with it (scatter-gather).
+ */
+void ata_setup_dma(struct ide *ide, struct ata_drv *drive, struct xfer_data *xd)
 {
-	struct prd *prd_table = &drive->xfer.prd_table;
-
-	prd_table->addr = (unsigned int)V2P(buffer);
-	prd_table->size = datalen;
-	prd_table->eot = PRDT_MARK_END;
+	struct prd *prd_table, *prd;
+	struct blk_request *br;
+	int n;
+
+	prd_table = prd = drive->xfer.prd_table;
+	prd->addr = (unsigned int)V2P(xd->buffer);
+	prd->size = xd->datalen;
+	prd->eot = 0;
+	if((br = xd->br)) {
+		prd->size = br->size;
+		for(n = 0; n < br->merged; n++) {
+			br = br->next;
+			prd++;
+			prd->addr = (unsigned int)V2P(br->buffer->data);
+			prd->size = br->size;
+			prd->eot = 0;
+		}
+	}
+	prd->eot = PRDT_MARK_END;
 	outport_l(ide->bm + drive->xfer.bm_prd_addr, V2P((unsigned int)prd_table));
 
 	/* clear Error and Interrupt bits */
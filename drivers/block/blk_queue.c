@@ -6,34 +6,122 @@
  */
 
 #include <fiwix/asm.h>
+#include <fiwix/kernel.h>
 #include <fiwix/irq.h>
 #include <fiwix/blk_queue.h>
 #include <fiwix/buffer.h>
 #include <fiwix/devices.h>
 #include <fiwix/sleep.h>
 #include <fiwix/sched.h>
+#include <fiwix/timer.h>
 #include <fiwix/errno.h>
 #include <fiwix/mm.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
+static void noop_add(struct device *, struct blk_request *);
+static void deadline_add(struct device *, struct blk_request *);
+
+static struct elevator elevator_table[NR_ELEVATORS + 1] = {
+	{ NULL, NULL },
+	{ "noop", noop_add },
+	{ "deadline", deadline_add }
+};
+
+int default_elevator = ELEVATOR_DEADLINE;
+struct kmem_cache *blk_request_cache;
+
+/* returns true if 'a' must be serviced before 'b' in an ascending sweep */
+static int blk_before(struct blk_request *a, struct blk_request *b)
+{
+	if(a->dev != b->dev) {
+		return a->dev < b->dev;
+	}
+	return a->block < b->block;
+}
+
+/* returns true if 'br' fits between 'prev' and 'next' in a circular sweep */
+static int blk_in_order(struct blk_request *prev, struct blk_request *br, struct blk_request *next)
+{
+	if(!blk_before(next, prev)) {
+		return !blk_before(br, prev) && blk_before(br, next);
+	}
+	/* the sweep wraps around between 'prev' and 'next' */
+	return !blk_before(br, prev) || blk_before(br, next);
+}
+
+static void insert_blk_request(struct device *d, struct blk_request *prev, struct blk_request *br)
+{
+	if(prev) {
+		br->next = prev->next;
+		prev->next = br;
+	} else {
+		br->next = (struct blk_request *)d->requests_queue;
+		d->requests_queue = (void *)br;
+	}
+	if(!br->next) {
+		d->requests_tail = (void *)br;
+	}
+}
+
 /* append the request into the queue */
+static void noop_add(struct device *d, struct blk_request *br)
+{
+	insert_blk_request(d, (struct blk_request *)d->requests_tail, br);
+}
+
+/*
+ * Sorts the request by device and block number (C-SCAN), but never ahead of
+ * the requests being processed or already past their deadline, so they can't
+ * starve. Requests for consecutive blocks end up together in the queue,
+ * ready to be merged by the driver.
+ */
+static void deadline_add(struct device *d, struct blk_request *br)
+{
+	struct blk_request *h, *prev;
+
+	br->expires = CURRENT_TICKS;
+	br->expires += br->fn == d->fsop->read_block ? READ_EXPIRE : WRITE_EXPIRE;
+
+	prev = NULL;
+	for(h = (struct blk_request *)d->requests_queue; h; h = h->next) {
+		if(h->status || (int)(CURRENT_TICKS - h->expires) >= 0) {
+			prev = h;
+		}
+	}
+	if(!prev && !(prev = (struct blk_request *)d->requests_queue)) {
+		insert_blk_request(d, NULL, br);
+		return;
+	}
+	while((h = prev->next)) {
+		if(blk_in_order(prev, br, h)) {
+			break;
+		}
+		prev = h;
+	}
+	insert_blk_request(d, prev, br);
+}
+
+/* sets the I/O scheduler of the device (0 = the default one) */
+int set_elevator(struct device *d, int elevator)
+{
+	if(elevator < 0 || elevator > NR_ELEVATORS) {
+		return -EINVAL;
+	}
+	d->elevator = elevator;
+	return 0;
+}
+
+/* place the request into the queue */
 void add_blk_request(struct blk_request *br)
 {
 	unsigned long int flags;
-	struct blk_request *h;
 	struct device *d;
 
 	d = br->device;
+	br->next = NULL;
 	SAVE_FLAGS(flags); CLI();
-	if((h = (struct blk_request *)d->requests_queue)) {
-		while(h->next) {
-			h = h->next;
-		}
-		h->next = br;
-	} else {
-		d->requests_queue = (void *)br;
-	}
+	elevator_table[d->elevator ? d->elevator : default_elevator].add(d, br);
 	RESTORE_FLAGS(flags);
 }
 
@@ -42,7 +130,7 @@ int do_blk_request(struct device *d, void *fn, struct buffer *buf)
 	struct blk_request *br;
 	int errno;
 
-	if(!(br = (struct blk_request *)kmalloc(sizeof(struct blk_request)))) {
+	if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
 		printk("WARNING: %s(): no more free memory for block requests.\n", __FUNCTION__);
 		return -ENOMEM;
 	}
@@ -62,7 +150,7 @@ int do_blk_request(struct device *d, void *fn, struct buffer *buf)
 	}
 	errno = br->errno;
 	if(!br->head_group) {
-		kfree((unsigned int)br);
+		kmem_cache_free(blk_request_cache, br);
 	}
 	return errno;
 }
@@ -70,7 +158,7 @@ int do_blk_request(struct device *d, void *fn, struct buffer *buf)
 void run_blk_request(struct device *d)
 {
 	unsigned long int flags;
-	struct blk_request *br, *brh;
+	struct blk_request *br;
 	int errno;
 
 	SAVE_FLAGS(flags); CLI();
@@ -80,29 +168,102 @@ void run_blk_request(struct device *d)
 			if(br->status == BR_COMPLETED) {
 				printk("%s(): status marked as BR_COMPLETED, picking the next one ...\n", __FUNCTION__);
 				d->requests_queue = (void *)br->next;
+				if(!br->next) {
+					d->requests_tail = NULL;
+				}
 				br = br->next;
 				continue;
 			}
 			return;
 		}
 		br->status = BR_PROCESSING;
+		br->merged = 0;
 		if(!(errno = br->fn(br->buffer->dev, br->buffer->block, br->buffer->data, br->buffer->size))) {
 			return;
 		}
-		br->errno = errno;
-		d->requests_queue = (void *)br->next;
+		br = end_blk_request(br, errno);
+	}
+	RESTORE_FLAGS(flags);
+}
+
+/*
+ * Merges into the request 'br' (the one being processed at the head of the
+ * queue) the requests that follow it while they are for the next consecutive
+ * blocks of the same device and direction, up to 'max_size' bytes in total.
+ * The driver can then transfer all the buffers with a single command, and it
+ * must complete them all at once with end_blk_request().
+ * Returns the total size of the merged request.
+ */
+int merge_blk_request(struct blk_request *br, int max_size)
+{
+	struct blk_request *next, *last;
+	int size;
+
+	size = br->size;
+	last = br;
+	br->merged = 0;
+	while((next = last->next)) {
+		if(next->status || next->dev != br->dev || next->fn != br->fn) {
+			break;
+		}
+		if(next->size != br->size || next->block != last->block + 1) {
+			break;
+		}
+		if(size + next->size > max_size) {
+			break;
+		}
+		next->status = BR_PROCESSING;
+		size += next->size;
+		br->merged++;
+		last = next;
+	}
+	return size;
+}
+
+/*
+ * Completes the request 'br' (and the ones merged with it), waking up the
+ * waiting processes. Returns the next request in the queue.
+ * This must be called with interrupts disabled.
+ */
+struct blk_request *end_blk_request(struct blk_request *br, int errno)
+{
+	struct blk_request *brh, *next;
+	struct device *d;
+	int n, merged;
+
+	d = br->device;
+	merged = br->merged;
+	for(n = 0; n <= merged; n++) {
+		next = br->next;
+		/* each merged request gets the size of its own buffer */
+		br->errno = (errno < 0 || !merged) ? errno : br->size;
+		d->requests_queue = (void *)next;
+		if(!next) {
+			d->requests_tail = NULL;
+		}
 		br->status = BR_COMPLETED;
-		if(br->head_group) {
+		if(br->flags & BRF_ASYNC) {
+			if(br->errno > 0) {
+				br->buffer->flags |= BUFFER_VALID;
+				if(br->fn == d->fsop->write_block) {
+					br->buffer->flags &= ~BUFFER_DIRTY;
+				}
+			}
+			brelse(br->buffer);
+			kmem_cache_free(blk_request_cache, br);
+		} else if(br->head_group) {
 			brh = br->head_group;
 			brh->left--;
-			brh->errno = errno;
+			if(errno < 0) {
+				brh->errno = errno;
+			}
 			if(!brh->left) {
 				wakeup(brh);
 			}
 		} else {
 			wakeup(br);
 		}
-		br = br->next;
+		br = next;
 	}
-	RESTORE_FLAGS(flags);
+	return br;
 }
@@ -37,6 +37,9 @@ static int fdc_wait_interrupt = 0;
 static int fdc_timeout = 0;
 static unsigned char fdc_results[MAX_FDC_RESULTS];
 static struct resource floppy_resource = { 0, 0 };
+static struct callout_req fdc_creq;		/* timeout of the commands */
+static struct callout_req motor_on_creq;
+static struct callout_req motor_off_creq;
 
 static struct fddt fdd_type[] = {
 /*
@@ -188,7 +191,6 @@ static void fdc_get_results(void)
 
 static int fdc_motor_on(void)
 {
-	struct callout_req creq;
 	int errno;
 
 	if(fdd_status[current_fdd].motor) {
@@ -201,9 +203,9 @@ static int fdc_motor_on(void)
 	fdd_status[!current_fdd].motor = 0;
 
 	/* fixed spin-up time of 500ms for 3.5" and 5.25" */
-	creq.fn = fdc_timer;
-	creq.arg = FDC_TR_MOTOR;
-	add_callout(&creq, HZ / 2);
+	motor_on_creq.fn = fdc_timer;
+	motor_on_creq.arg = FDC_TR_MOTOR;
+	add_callout(&motor_on_creq, HZ / 2);
 	sleep(&fdc_motor_on, PROC_UNINTERRUPTIBLE);
 
 	errno = 0;
@@ -225,17 +227,15 @@ static void do_motor_off(unsigned int fdd)
 
 static void fdc_motor_off(void)
 {
-	struct callout_req creq;
 
-	creq.fn = do_motor_off;
-	creq.arg = current_fdd;
-	add_callout(&creq, WAIT_FDC);
+	motor_off_creq.fn = do_motor_off;
+	motor_off_creq.arg = current_fdd;
+	add_callout(&motor_off_creq, WAIT_FDC);
 }
 
 static void fdc_reset(void)
 {
 	int n;
-	struct callout_req creq;
 
 	need_reset = 0;
 
@@ -247,9 +247,9 @@ static void fdc_reset(void)
 	}
 	outport_b(FDC_DOR, FDC_DMA_ENABLE | FDC_ENABLE);
 
-	creq.fn = fdc_timer;
-	creq.arg = FDC_TR_DEFAULT;
-	add_callout(&creq, WAIT_FDC);
+	fdc_creq.fn = fdc_timer;
+	fdc_creq.arg = FDC_TR_DEFAULT;
+	add_callout(&fdc_creq, WAIT_FDC);
 	/* avoid sleep if interrupt already happened */
 	if(fdc_wait_interrupt) {
 		sleep(&irq_floppy, PROC_UNINTERRUPTIBLE);
@@ -258,7 +258,7 @@ static void fdc_reset(void)
 		need_reset = 1;
 		printk("WARNING: %s(): fd%d: timeout on %s.\n", __FUNCTION__, current_fdd, floppy_device.name);
 	}
-	del_callout(&creq);
+	del_callout(&fdc_creq);
 
 	fdd_status[0].motor = fdd_status[1].motor = 0;
 	fdd_status[current_fdd].recalibrated = 0;
@@ -280,7 +280,6 @@ static void fdc_reset(void)
 
 static int fdc_recalibrate(void)
 {
-	struct callout_req creq;
 
 	if(need_reset) {
 		return 1;
@@ -295,9 +294,9 @@ static int fdc_recalibrate(void)
 		return 1;
 	}
 
-	creq.fn = fdc_timer;
-	creq.arg = FDC_TR_DEFAULT;
-	add_callout(&creq, WAIT_FDC);
+	fdc_creq.fn = fdc_timer;
+	fdc_creq.arg = FDC_TR_DEFAULT;
+	add_callout(&fdc_creq, WAIT_FDC);
 	/* avoid sleep if interrupt already happened */
 	if(fdc_wait_interrupt) {
 		sleep(&irq_floppy, PROC_UNINTERRUPTIBLE);
@@ -308,7 +307,7 @@ static int fdc_recalibrate(void)
 		return 1;
 	}
 
-	del_callout(&creq);
+	del_callout(&fdc_creq);
 	fdc_out(FDC_SENSEI);
 	fdc_get_results();
 
@@ -327,7 +326,6 @@ static int fdc_recalibrate(void)
 
 static int fdc_seek(int track, int head)
 {
-	struct callout_req creq;
 
 	if(need_reset) {
 		return 1;
@@ -353,9 +351,9 @@ static int fdc_seek(int track, int head)
 		return 1;
 	}
 
-	creq.fn = fdc_timer;
-	creq.arg = FDC_TR_DEFAULT;
-	add_callout(&creq, WAIT_FDC);
+	fdc_creq.fn = fdc_timer;
+	fdc_creq.arg = FDC_TR_DEFAULT;
+	add_callout(&fdc_creq, WAIT_FDC);
 	/* avoid sleep if interrupt already happened */
 	if(fdc_wait_interrupt) {
 		sleep(&irq_floppy, PROC_UNINTERRUPTIBLE);
@@ -366,7 +364,7 @@ static int fdc_seek(int track, int head)
 		return 1;
 	}
 
-	del_callout(&creq);
+	del_callout(&fdc_creq);
 	fdc_out(FDC_SENSEI);
 	fdc_get_results();
 
@@ -532,7 +530,6 @@ int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 	unsigned int sectors_read;
 	int cyl, head, sector;
 	int retries;
-	struct callout_req creq;
 	struct device *d;
 
 	minor = MINOR(dev);
@@ -590,9 +587,9 @@ int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			printk("WARNING: %s(): fd%d: needs reset on %s device %d,%d during read operation.\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
 			continue;
 		}
-		creq.fn = fdc_timer;
-		creq.arg = FDC_TR_DEFAULT;
-		add_callout(&creq, WAIT_FDC);
+		fdc_creq.fn = fdc_timer;
+		fdc_creq.arg = FDC_TR_DEFAULT;
+		add_callout(&fdc_creq, WAIT_FDC);
 		/* avoid sleep if interrupt already happened */
 		if(fdc_wait_interrupt) {
 			sleep(&irq_floppy, PROC_UNINTERRUPTIBLE);
@@ -602,7 +599,7 @@ int fdc_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			printk("WARNING: %s(): fd%d: timeout on %s device %d,%d.\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
 			continue;
 		}
-		del_callout(&creq);
+		del_callout(&fdc_creq);
 		fdc_get_results();
 		if(fdc_results[ST0] & (ST0_IC | ST0_UC | ST0_NR)) {
 			need_reset = 1;
@@ -643,7 +640,6 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 	unsigned int sectors_written;
 	int cyl, head, sector;
 	int retries;
-	struct callout_req creq;
 	struct device *d;
 
 	minor = MINOR(dev);
@@ -702,9 +698,9 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			printk("WARNING: %s(): fd%d: needs reset on %s device %d,%d during write operation.\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
 			continue;
 		}
-		creq.fn = fdc_timer;
-		creq.arg = FDC_TR_DEFAULT;
-		add_callout(&creq, WAIT_FDC);
+		fdc_creq.fn = fdc_timer;
+		fdc_creq.arg = FDC_TR_DEFAULT;
+		add_callout(&fdc_creq, WAIT_FDC);
 		/* avoid sleep if interrupt already happened */
 		if(fdc_wait_interrupt) {
 			sleep(&irq_floppy, PROC_UNINTERRUPTIBLE);
@@ -714,7 +710,7 @@ int fdc_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
 			printk("WARNING: %s(): fd%d: timeout on %s device %d,%d.\n", __FUNCTION__, current_fdd, floppy_device.name, MAJOR(dev), MINOR(dev));
 			continue;
 		}
-		del_callout(&creq);
+		del_callout(&fdc_creq);
 		fdc_get_results();
 		if(fdc_results[ST1] & ST1_NW) {
 			unlock_resource(&floppy_resource);
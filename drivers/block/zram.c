@@ -0,0 +1,421 @@
+/*
+ * fiwix/drivers/block/zram.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * A RAMdisk that keeps every page of its data compressed with LZ4. Its
+ * memory is not reserved at boot time like in the ramdisk driver, it's taken
+ * from the kernel as the pages are written, so it's mainly intended to be
+ * used as a swap area that stays in memory.
+ *
+ * The compressed pages are stored in caches of objects of the next multiple
+ * of ZRAM_CLASS_SIZE bytes. The zero-filled pages take no memory at all, and
+ * the pages that don't compress below ZRAM_MAX_ZSIZE are stored as they are
+ * in a whole page.
+ */
+
+#include <fiwix/config.h>
+#include <fiwix/kernel.h>
+#include <fiwix/zram.h>
+#include <fiwix/lz4.h>
+#include <fiwix/ioctl.h>
+#include <fiwix/devices.h>
+#include <fiwix/part.h>
+#include <fiwix/fs.h>
+#include <fiwix/buffer.h>
+#include <fiwix/errno.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+#ifdef CONFIG_ZRAM
+
+#define ZRAM_CLASS(size)	(((size) - 1) / ZRAM_CLASS_SIZE)
+#define ZRAM_OBJSIZE(size)	((ZRAM_CLASS(size) + 1) * ZRAM_CLASS_SIZE)
+
+struct zram zram_table[ZRAM_DRIVES];
+
+static struct kmem_cache *zram_pool[ZRAM_NR_CLASSES];
+static char zram_pool_names[ZRAM_NR_CLASSES][10];
+
+/*
+ * The requests are served with the interrupts disabled (see run_blk_request),
+ * so these buffers are never used by two of them at once.
+ */
+static unsigned short int zram_wrkmem[LZ4_HASH_SIZE];
+static unsigned char zram_zbuf[ZRAM_MAX_ZSIZE];
+static char zram_page[PAGE_SIZE];
+
+static struct fs_operations zram_driver_fsop = {
+	0,
+	0,
+
+	zram_open,
+	zram_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	zram_ioctl,
+	zram_llseek,
+	NULL,			/* readdir */
+	NULL,			/* readdir64 */
+	NULL,			/* mmap */
+	NULL,			/* select */
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lockup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	zram_read,
+	zram_write,
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	NULL,			/* ialloc */
+	NULL,			/* ifree */
+	NULL,			/* statfs */
+	NULL,			/* read_superblock */
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+static struct device zram_device = {
+	"zram",
+	ZRAM_MAJOR,
+	{ 0, 0, 0, 0, 0, 0, 0, 0 },
+	0,
+	0,
+	&zram_driver_fsop,
+	NULL,
+	NULL,
+	NULL
+};
+
+static struct zram *get_zram(int minor)
+{
+	if(TEST_MINOR(zram_device.minors, minor)) {
+		return &zram_table[minor];
+	}
+	return NULL;
+}
+
+static int is_zero_page(const char *data)
+{
+	const unsigned int *p;
+	int n;
+
+	p = (const unsigned int *)data;
+	for(n = 0; n < PAGE_SIZE / sizeof(unsigned int); n++) {
+		if(p[n]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void free_slot(struct zram *zram, unsigned int page)
+{
+	struct zram_slot *slot;
+
+	slot = &zram->table[page];
+	if(slot->flags & ZRAM_ZERO) {
+		zram->stats.zero_pages--;
+	} else if(slot->data) {
+		if(slot->flags & ZRAM_RAW) {
+			kfree((unsigned int)slot->data);
+			zram->stats.mem_used -= PAGE_SIZE;
+			zram->stats.raw_pages--;
+		} else {
+			kmem_cache_free(zram_pool[ZRAM_CLASS(slot->size)], slot->data);
+			zram->stats.mem_used -= ZRAM_OBJSIZE(slot->size);
+		}
+		zram->stats.orig_data_size -= PAGE_SIZE;
+		zram->stats.compr_data_size -= slot->size;
+		zram->stats.pages_stored--;
+	}
+	slot->data = NULL;
+	slot->size = 0;
+	slot->flags = 0;
+}
+
+static int load_page(struct zram *zram, unsigned int page, char *buffer)
+{
+	struct zram_slot *slot;
+
+	slot = &zram->table[page];
+	if(!slot->data) {
+		memset_b(buffer, 0, PAGE_SIZE);
+		return 0;
+	}
+	if(slot->flags & ZRAM_RAW) {
+		memcpy_b(buffer, slot->data, PAGE_SIZE);
+		return 0;
+	}
+	if(lz4_decompress((unsigned char *)slot->data, slot->size, (unsigned char *)buffer, PAGE_SIZE) != PAGE_SIZE) {
+		printk("WARNING: %s(): page %d of zram%d is corrupted.\n", __FUNCTION__, page, zram - zram_table);
+		return -EIO;
+	}
+	return 0;
+}
+
+static int store_page(struct zram *zram, unsigned int page, char *buffer)
+{
+	struct zram_slot *slot;
+	char *data;
+	int size, flags;
+
+	slot = &zram->table[page];
+	if(is_zero_page(buffer)) {
+		free_slot(zram, page);
+		slot->flags = ZRAM_ZERO;
+		zram->stats.zero_pages++;
+		return 0;
+	}
+
+	/* this could be kswapd, and it can't wait for the memory it reclaims */
+	if(!kstat.free_pages) {
+		zram->stats.failed_writes++;
+		return -ENOMEM;
+	}
+
+	flags = 0;
+	if((size = lz4_compress((unsigned char *)buffer, PAGE_SIZE, zram_zbuf, ZRAM_MAX_ZSIZE, zram_wrkmem))) {
+		data = (char *)kmem_cache_alloc(zram_pool[ZRAM_CLASS(size)]);
+	} else {
+		data = (char *)kmalloc(PAGE_SIZE);
+		size = PAGE_SIZE;
+		flags = ZRAM_RAW;
+	}
+	if(!data) {
+		zram->stats.failed_writes++;
+		return -ENOMEM;
+	}
+	memcpy_b(data, flags & ZRAM_RAW ? buffer : (char *)zram_zbuf, size);
+
+	free_slot(zram, page);
+	slot->data = data;
+	slot->size = size;
+	slot->flags = flags;
+	if(flags & ZRAM_RAW) {
+		zram->stats.mem_used += PAGE_SIZE;
+		zram->stats.raw_pages++;
+	} else {
+		zram->stats.mem_used += ZRAM_OBJSIZE(size);
+	}
+	zram->stats.orig_data_size += PAGE_SIZE;
+	zram->stats.compr_data_size += size;
+	zram->stats.pages_stored++;
+	return 0;
+}
+
+int zram_open(struct inode *i, struct fd *f)
+{
+	if(!get_zram(MINOR(i->rdev))) {
+		return -ENXIO;
+	}
+	return 0;
+}
+
+int zram_close(struct inode *i, struct fd *f)
+{
+	if(!get_zram(MINOR(i->rdev))) {
+		return -ENXIO;
+	}
+	sync_buffers(i->rdev);
+	return 0;
+}
+
+int zram_read(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	struct zram *zram;
+	unsigned int page;
+	__off_t offset;
+	int errno;
+
+	if(!(zram = get_zram(MINOR(dev)))) {
+		return -ENXIO;
+	}
+
+	offset = block * blksize;
+	if(offset >= zram->size * 1024) {
+		printk("%s(): block %d is beyond the size of the zram.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+	page = offset / PAGE_SIZE;
+	offset %= PAGE_SIZE;
+	blksize = MIN(blksize, PAGE_SIZE - offset);
+	zram->stats.num_reads++;
+
+	if(blksize == PAGE_SIZE) {
+		errno = load_page(zram, page, buffer);
+		return errno ? errno : blksize;
+	}
+	if((errno = load_page(zram, page, zram_page))) {
+		return errno;
+	}
+	memcpy_b(buffer, zram_page + offset, blksize);
+	return blksize;
+}
+
+int zram_write(__dev_t dev, __blk_t block, char *buffer, int blksize)
+{
+	struct zram *zram;
+	unsigned int page;
+	__off_t offset;
+	int errno;
+
+	if(!(zram = get_zram(MINOR(dev)))) {
+		return -ENXIO;
+	}
+
+	offset = block * blksize;
+	if(offset >= zram->size * 1024) {
+		printk("%s(): block %d is beyond the size of the zram.\n", __FUNCTION__, block);
+		return -EIO;
+	}
+	page = offset / PAGE_SIZE;
+	offset %= PAGE_SIZE;
+	blksize = MIN(blksize, PAGE_SIZE - offset);
+	zram->stats.num_writes++;
+
+	if(blksize == PAGE_SIZE) {
+		errno = store_page(zram, page, buffer);
+		return errno ? errno : blksize;
+	}
+
+	/* smaller blocks need to update the rest of their page */
+	if((errno = load_page(zram, page, zram_page))) {
+		return errno;
+	}
+	memcpy_b(zram_page + offset, buffer, blksize);
+	if((errno = store_page(zram, page, zram_page))) {
+		return errno;
+	}
+	return blksize;
+}
+
+int zram_ioctl(struct inode *i, struct fd *f, int cmd, unsigned int arg)
+{
+	struct hd_geometry *geom;
+	struct zram *zram;
+	int errno;
+
+	if(!(zram = get_zram(MINOR(i->rdev)))) {
+		return -ENXIO;
+	}
+
+	switch(cmd) {
+		case HDIO_GETGEO:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct hd_geometry)))) {
+				return errno;
+			}
+			geom = (struct hd_geometry *)arg;
+			geom->heads = 63;
+			geom->sectors = 16;
+			geom->cylinders = zram->size * 1024 / BPS;
+			geom->cylinders /= (geom->heads * geom->sectors);
+			geom->start = 0;
+			break;
+		case BLKRRPART:
+			break;
+		case BLKGETSIZE:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(unsigned int)))) {
+				return errno;
+			}
+			*(int *)arg = zram->size * 2;
+			break;
+		case ZRAM_GETSTATS:
+			if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(struct zram_stats)))) {
+				return errno;
+			}
+			zram->stats.disksize = zram->size * 1024;
+			memcpy_b((void *)arg, &zram->stats, sizeof(struct zram_stats));
+			break;
+		default:
+			return -EINVAL;
+	}
+	return 0;
+}
+
+__loff_t zram_llseek(struct inode *i, __loff_t offset)
+{
+	return offset;
+}
+
+/* the swap no longer needs this page, so its memory can be freed */
+void zram_free_page(__dev_t dev, unsigned int page)
+{
+	struct zram *zram;
+
+	if((zram = get_zram(MINOR(dev)))) {
+		if(page < zram->size / (PAGE_SIZE / 1024)) {
+			free_slot(zram, page);
+		}
+	}
+}
+
+/* returns the number of pages taken by the caches of all the devices */
+int zram_pool_pages(void)
+{
+	int n, pages;
+
+	pages = 0;
+	for(n = 0; n < ZRAM_NR_CLASSES; n++) {
+		if(zram_pool[n]) {
+			pages += zram_pool[n]->num_slabs;
+		}
+	}
+	return pages;
+}
+
+void zram_init(void)
+{
+	int n, pages;
+	struct zram *zram;
+
+	if(kparm_zramsize <= 0) {
+		return;
+	}
+
+	for(n = 0; n < ZRAM_NR_CLASSES; n++) {
+		sprintk(zram_pool_names[n], "zram-%d", (n + 1) * ZRAM_CLASS_SIZE);
+		if(!(zram_pool[n] = kmem_cache_create(zram_pool_names[n], (n + 1) * ZRAM_CLASS_SIZE, NULL))) {
+			return;
+		}
+	}
+
+	zram_device.blksize = (unsigned int *)kmalloc(1024);
+	zram_device.device_data = (unsigned int *)kmalloc(1024);
+	memset_b(zram_device.blksize, 0, 1024);
+	memset_b(zram_device.device_data, 0, 1024);
+	pages = kparm_zramsize / (PAGE_SIZE / 1024);
+	for(n = 0; n < ZRAM_DRIVES; n++) {
+		zram = &zram_table[n];
+		if(!(zram->table = (struct zram_slot *)kmalloc(pages * sizeof(struct zram_slot)))) {
+			printk("WARNING: %s(): not enough memory for zram%d.\n", __FUNCTION__, n);
+			continue;
+		}
+		memset_b(zram->table, 0, pages * sizeof(struct zram_slot));
+		zram->size = pages * (PAGE_SIZE / 1024);
+		SET_MINOR(zram_device.minors, n);
+		((unsigned int *)zram_device.blksize)[n] = PAGE_SIZE;
+		((unsigned int *)zram_device.device_data)[n] = zram->size;
+		printk("zram%d     compressed RAMdisk of %dKB size, %dKB blocksize (lz4)\n", n, zram->size, PAGE_SIZE / 1024);
+	}
+	register_device(BLK_DEV, &zram_device);
+}
+
+#endif /* CONFIG_ZRAM */
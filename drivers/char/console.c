@@ -928,11 +928,9 @@ void vconsole_stop(struct tty *tty)
 
 void vconsole_beep(void)
 {
-	struct callout_req creq;
+	static struct callout_req creq = { pit_beep_off, 0 };
 
 	pit_beep_on();
-	creq.fn = pit_beep_off;
-	creq.arg = 0;
 	add_callout(&creq, HZ / 8);
 }
 
@@ -17,6 +17,7 @@
 #include <fiwix/fcntl.h>
 #include <fiwix/sched.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -137,7 +138,7 @@ void irq_psaux(int num, struct sigcontext *sc)
 	}
 	charq_putchar(&psaux_table.read_q, ch);
 	wakeup(&psaux_read);
-	wakeup(&do_select);
+	wakeup_queue(&psaux_table.wq);
 }
 
 int psaux_open(struct inode *i, struct fd *f)
@@ -231,6 +232,7 @@ int psaux_select(struct inode *i, struct fd *f, int flag)
 		return -ENXIO;
 	}
 
+	select_wait(&psaux_table.wq);
 	switch(flag) {
 		case SEL_R:
 			if(psaux_table.read_q.count) {
@@ -14,6 +14,7 @@
 #include <fiwix/stat.h>
 #include <fiwix/ioctl.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
 #include <fiwix/sched.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
@@ -134,7 +135,7 @@ static struct device pty_slave_device = {
 void pty_wakeup_read(struct tty *tty)
 {
 	wakeup(&pty_read);
-	wakeup(&do_select);
+	wakeup_queue(&tty->wq);
 }
 
 int pty_open(struct tty *tty)
@@ -158,7 +159,7 @@ int pty_open(struct tty *tty)
 		printk("WARNING: %s(): devpts filesystem is not registered!\n", __FUNCTION__);
 		return -EINVAL;
 	}
-	if(!(i = ialloc(&fs->mp->sb, S_IFCHR))) {
+	if(!(i = ialloc(&fs->mp->sb, NULL, S_IFCHR))) {
 		return -EINVAL;
 	}
 	for(n = 0; n < NR_PTYS; n++) {
@@ -192,7 +193,7 @@ int pty_close(struct tty *tty)
 	tty->flags |= TTY_OTHER_CLOSED;
 	wakeup(&tty->read_q);
 	wakeup(&pty_read);
-	wakeup(&do_select);
+	wakeup_queue(&tty->wq);
 	if(MAJOR(tty->dev) == PTY_SLAVE_MAJOR) {
 		minor = MINOR(tty->dev);
 		CLEAR_MINOR(pty_slave_device.minors, minor);
@@ -239,7 +240,7 @@ int pty_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 		}
 	}
 	wakeup(&tty->write_q);
-	wakeup(&do_select);
+	wakeup_queue(&tty->wq);
 	return n;
 }
 
@@ -261,7 +262,7 @@ int pty_write(struct inode *i, struct fd *f, const char *buffer, __size_t count)
 		}
 	}
 	tty->input(tty);
-	wakeup(&do_select);
+	wakeup_queue(&tty->wq);
 	return n;
 }
 
@@ -295,6 +296,7 @@ int pty_select(struct inode *i, struct fd *f, int flag)
 	struct tty *tty;
 
 	tty = f->private_data;
+	select_wait(&tty->wq);
 
 	switch(flag) {
 		case SEL_R:
@@ -310,6 +312,11 @@ int pty_select(struct inode *i, struct fd *f, int flag)
 				return 1;
 			}
 			break;
+		case SEL_HUP:
+			if(tty->flags & TTY_OTHER_CLOSED) {
+				return 1;
+			}
+			break;
 	}
 	return 0;
 }
@@ -34,6 +34,9 @@ static void memory(void)
 	data_proc_buddyinfo(buf, 0);
 	printk("%s", buf);
 	printk("\n");
+	data_proc_slabinfo(buf, 0);
+	printk("%s", buf);
+	printk("\n");
 	kfree((unsigned int)buf);
 }
 
@@ -17,6 +17,7 @@
 #include <fiwix/sched.h>
 #include <fiwix/timer.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
 #include <fiwix/process.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/kd.h>
@@ -481,7 +482,7 @@ void do_cook(struct tty *tty)
 		tty->output(tty);
 	}
 	if(!(tty->termios.c_lflag & ICANON) || ((tty->termios.c_lflag & ICANON) && tty->canon_data)) {
-		wakeup(&do_select);
+		wakeup_queue(&tty->wq);
 	}
 	wakeup(&tty->read_q);
 }
@@ -600,6 +601,8 @@ int tty_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 		return -ERESTART;
 	}
 
+	/* each reader has its own VTIME timeout, deleted before returning */
+	memset_b(&creq, 0, sizeof(struct callout_req));
 	n = min = 0;
 	while(count > 0) {
 		if(tty->kbd.mode == K_RAW || tty->kbd.mode == K_MEDIUMRAW) {
@@ -654,9 +657,11 @@ int tty_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 						creq.arg = (unsigned int)&tty->cooked_q;
 						add_callout(&creq, timeout);
 						if(f->flags & O_NONBLOCK) {
+							del_callout(&creq);
 							return -EAGAIN;
 						}
 						if(sleep(&tty->read_q, PROC_INTERRUPTIBLE)) {
+							del_callout(&creq);
 							return -EINTR;
 						}
 					}
@@ -675,7 +680,6 @@ int tty_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 							buffer[n++] = ch;
 						}
 						if(n >= MIN(tty->termios.c_cc[VMIN], count)) {
-							del_callout(&creq);
 							break;
 						}
 						timeout = tty->termios.c_cc[VTIME] * (HZ / 10);
@@ -723,6 +727,7 @@ int tty_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 			break;
 		}
 	}
+	del_callout(&creq);
 
 	if(n) {
 		i->i_atime = CURRENT_TIME;
@@ -1102,6 +1107,7 @@ int tty_select(struct inode *i, struct fd *f, int flag)
 	struct tty *tty;
 
 	tty = f->private_data;
+	select_wait(&tty->wq);
 
 	switch(flag) {
 		case SEL_R:
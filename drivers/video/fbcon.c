@@ -443,7 +443,7 @@ void fbcon_restore_screen(struct vconsole *vc)
 void fbcon_screen_on(struct vconsole *vc)
 {
 	unsigned int flags;
-	struct callout_req creq;
+	static struct callout_req creq = { fbcon_screen_off, 0 };
 
 	if(screen_is_off) {
 		screen_is_off = 0;
@@ -455,7 +455,6 @@ void fbcon_screen_on(struct vconsole *vc)
 	}
 
 	if(BLANK_INTERVAL) {
-		creq.fn = fbcon_screen_off;
 		creq.arg = (unsigned int)vc;
 		add_callout(&creq, BLANK_INTERVAL);
 	}
@@ -549,7 +548,7 @@ void fbcon_buf_scroll(struct vconsole *vc, int mode)
 void fbcon_cursor_blink(unsigned int arg)
 {
 	struct vconsole *vc;
-	struct callout_req creq;
+	static struct callout_req creq = { fbcon_cursor_blink, 0 };
 	static int blink_on = 0;
 
 	vc = (struct vconsole *)arg;
@@ -565,7 +564,6 @@ void fbcon_cursor_blink(unsigned int arg)
 		}
 	}
 	blink_on = !blink_on;
-	creq.fn = fbcon_cursor_blink;
 	creq.arg = arg;
 	add_callout(&creq, 25);		/* 250ms */
 }
@@ -227,7 +227,7 @@ void vgacon_restore_screen(struct vconsole *vc)
 void vgacon_screen_on(struct vconsole *vc)
 {
 	unsigned int flags;
-	struct callout_req creq;
+	static struct callout_req creq = { vgacon_screen_off, 0 };
 
 	if(screen_is_off) {
 		SAVE_FLAGS(flags); CLI();
@@ -238,8 +238,6 @@ void vgacon_screen_on(struct vconsole *vc)
 	}
 
 	if(BLANK_INTERVAL) {
-		creq.fn = vgacon_screen_off;
-		creq.arg = 0;
 		add_callout(&creq, BLANK_INTERVAL);
 	}
 }
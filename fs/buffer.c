@@ -28,9 +28,24 @@
 
 struct buffer *buffer_table;		/* buffer pool */
 
+/*
+ * The buffers not in use are kept in two LRU lists for each size. A buffer
+ * enters in the inactive list, and it's promoted to the active list only if
+ * it's requested again while it's still cached. New buffers are taken from
+ * the head of the inactive list, so a large sequential read only recycles
+ * its own blocks and doesn't evict the hot ones (superblocks, bitmaps, inode
+ * tables, ...). The active list is limited to ACTIVE_RATIO times the size of
+ * the inactive list, and its oldest buffers are moved back to the inactive
+ * list to get another chance.
+ */
+#define ACTIVE_RATIO	2
+
 /* [0] = 1KB, [1] = 2KB, [2] = unused, [3] = 4KB */
-struct buffer *buffer_head[4];		/* heads of free list */
+struct buffer *buffer_head[4];		/* heads of free (inactive) list */
+struct buffer *buffer_active_head[4];	/* heads of active list */
 struct buffer *buffer_dirty_head[4];	/* heads of dirty list */
+static int nr_inactive[4];
+static int nr_active[4];
 
 /*
  * hash table
@@ -48,12 +63,16 @@ struct buffer *buffer_dirty_head[4];	/* heads of dirty list */
 struct buffer **buffer_hash_table;
 
 static struct resource sync_resource = { 0, 0 };
+static struct kmem_cache *buffer_cache;
+
+/* dirty buffers being written (protected by sync_resource) */
+static struct buffer *writeback_list[WRITEBACK_BATCH];
 
 static struct buffer *add_buffer_to_pool(void)
 {
 	struct buffer *buf;
 
-	if(!(buf = (struct buffer *)kmalloc(sizeof(struct buffer)))) {
+	if(!(buf = (struct buffer *)kmem_cache_alloc(buffer_cache))) {
 		return NULL;
 	}
 	memset_b(buf, 0, sizeof(struct buffer));
@@ -95,7 +114,7 @@ static void del_buffer_from_pool(struct buffer *buf)
 		buffer_table = buf->next;
 	}
 
-	kfree((unsigned int)tmp);
+	kmem_cache_free(buffer_cache, tmp);
 	kstat.nr_buffers--;
 }
 
@@ -143,6 +162,45 @@ static void remove_from_hash(struct buffer *buf)
 	}
 }
 
+/*
+ * A dirty buffer that belongs to a file (data, indirect blocks or the block
+ * of its inode) is also linked in the list of its inode, so fsync() only
+ * writes the blocks of that file.
+ */
+static void remove_from_inode_list(struct buffer *buf)
+{
+	if(!buf->inode) {
+		return;
+	}
+
+	if(buf->next_idirty) {
+		buf->next_idirty->prev_idirty = buf->prev_idirty;
+	}
+	if(buf->prev_idirty) {
+		buf->prev_idirty->next_idirty = buf->next_idirty;
+	} else {
+		buf->inode->dirty_buffers = buf->next_idirty;
+	}
+	buf->inode = NULL;
+	buf->prev_idirty = buf->next_idirty = NULL;
+}
+
+static void insert_on_inode_list(struct buffer *buf, struct inode *i)
+{
+	if(buf->inode == i) {
+		return;
+	}
+
+	/* a block shared by several inodes belongs to the last writer */
+	remove_from_inode_list(buf);
+	buf->inode = i;
+	buf->prev_idirty = NULL;
+	if((buf->next_idirty = i->dirty_buffers)) {
+		i->dirty_buffers->prev_idirty = buf;
+	}
+	i->dirty_buffers = buf;
+}
+
 static void insert_on_dirty_list(struct buffer *buf)
 {
 	struct buffer *h;
@@ -154,6 +212,7 @@ static void insert_on_dirty_list(struct buffer *buf)
 	if(buf->prev_dirty || buf->next_dirty) {
 		return;
 	}
+	buf->dirty_time = CURRENT_TICKS;
 	if(!h) {
 		buffer_dirty_head[index] = buf;
 		h = buffer_dirty_head[index];
@@ -175,10 +234,12 @@ static void remove_from_dirty_list(struct buffer *buf)
 	struct buffer *h;
 	int index;
 
+	remove_from_inode_list(buf);
 	index = BUFHEAD_INDEX(buf->size);
 	h = buffer_dirty_head[index];
 
-	if(!h) {
+	/* not in the list */
+	if(!h || !buf->prev_dirty) {
 		return;
 	}
 
@@ -202,81 +263,119 @@ static void remove_from_dirty_list(struct buffer *buf)
 	kstat.nr_dirty_buffers--;
 }
 
-static void insert_on_free_list(struct buffer *buf)
+static void lru_insert(struct buffer **head, struct buffer *buf, int at_head)
 {
 	struct buffer *h;
-	int index;
-
-	index = BUFHEAD_INDEX(buf->size);
-	h = buffer_head[index];
 
+	h = *head;
 	if(!h) {
-		buffer_head[index] = buf;
-		h = buffer_head[index];
+		*head = buf;
+		h = buf;
 	} else {
 		buf->prev_free = h->prev_free;
-
-		/*
-		 * If is not marked as valid then this buffer
-		 * is placed at the beginning of the free list.
-		 */
-		if(!(buf->flags & BUFFER_VALID)) {
+		if(at_head) {
 			buf->next_free = h;
 			h->prev_free = buf;
-			buffer_head[index] = buf;
+			*head = buf;
 			return;
-		} else {
-			h->prev_free->next_free = buf;
 		}
+		h->prev_free->next_free = buf;
 	}
 	h->prev_free = buf;
 }
 
-static void append_on_free_list(struct buffer *buf)
+/* returns 0 if the buffer was not in the list */
+static int lru_remove(struct buffer **head, struct buffer *buf)
 {
 	struct buffer *h;
-	int index;
 
-	index = BUFHEAD_INDEX(buf->size);
-	h = buffer_head[index];
+	h = *head;
+	if(!h || !buf->prev_free) {
+		return 0;
+	}
 
-	if(!h) {
-		buffer_head[index] = buf;
-		h = buffer_head[index];
-	} else {
-		buf->prev_free = h->prev_free;
-		h->prev_free->next_free = buf;
+	if(buf->next_free) {
+		buf->next_free->prev_free = buf->prev_free;
 	}
-	h->prev_free = buf;
+	if(buf != h) {
+		buf->prev_free->next_free = buf->next_free;
+	}
+	if(!buf->next_free) {
+		h->prev_free = buf->prev_free;
+	}
+	if(buf == h) {
+		*head = buf->next_free;
+	}
+	buf->prev_free = buf->next_free = NULL;
+	return 1;
 }
 
-static void remove_from_free_list(struct buffer *buf)
+/* moves the oldest active buffers to the tail of the inactive list */
+static void balance_lists(int index)
+{
+	struct buffer *buf;
+
+	while(nr_active[index] > nr_inactive[index] * ACTIVE_RATIO) {
+		buf = buffer_active_head[index];
+		lru_remove(&buffer_active_head[index], buf);
+		nr_active[index]--;
+		kstat.active_buffers -= buf->size / 1024;
+		buf->flags &= ~BUFFER_ACTIVE;
+		lru_insert(&buffer_head[index], buf, 0);
+		nr_inactive[index]++;
+		kstat.inactive_buffers += buf->size / 1024;
+	}
+}
+
+static void insert_on_free_list(struct buffer *buf)
 {
-	struct buffer *h;
 	int index;
 
 	index = BUFHEAD_INDEX(buf->size);
-	h = buffer_head[index];
 
-	if(!h) {
+	if(buf->flags & BUFFER_ACTIVE) {
+		lru_insert(&buffer_active_head[index], buf, 0);
+		nr_active[index]++;
+		kstat.active_buffers += buf->size / 1024;
+		balance_lists(index);
 		return;
 	}
 
-	if(buf->next_free) {
-		buf->next_free->prev_free = buf->prev_free;
-	}
-	if(buf->prev_free) {
-		if(buf != h) {
-			buf->prev_free->next_free = buf->next_free;
+	/*
+	 * If is not marked as valid then this buffer
+	 * is placed at the beginning of the free list.
+	 */
+	lru_insert(&buffer_head[index], buf, !(buf->flags & BUFFER_VALID));
+	nr_inactive[index]++;
+	kstat.inactive_buffers += buf->size / 1024;
+}
+
+static void append_on_free_list(struct buffer *buf)
+{
+	int index;
+
+	index = BUFHEAD_INDEX(buf->size);
+	lru_insert(&buffer_head[index], buf, 0);
+	nr_inactive[index]++;
+	kstat.inactive_buffers += buf->size / 1024;
+}
+
+static void remove_from_free_list(struct buffer *buf)
+{
+	int index;
+
+	index = BUFHEAD_INDEX(buf->size);
+	if(buf->flags & BUFFER_ACTIVE) {
+		if(lru_remove(&buffer_active_head[index], buf)) {
+			nr_active[index]--;
+			kstat.active_buffers -= buf->size / 1024;
+		}
+	} else {
+		if(lru_remove(&buffer_head[index], buf)) {
+			nr_inactive[index]--;
+			kstat.inactive_buffers -= buf->size / 1024;
 		}
 	}
-	if(!buf->next_free) {
-		h->prev_free = buf->prev_free;
-	}
-	if(buf == h) {
-		buffer_head[index] = buf->next_free;
-	}
-	buf->prev_free = buf->next_free = NULL;
 }
 
 static void buffer_wait(struct buffer *buf)
@@ -343,7 +442,9 @@ static struct buffer *get_free_buffer(int mode, int size)
 	int index;
 
 	index = BUFHEAD_INDEX(size);
-	buf = buffer_head[index];
+	if(!(buf = buffer_head[index])) {
+		buf = buffer_active_head[index];
+	}
 
 	/*
 	 * We check buf->dev to see if this buffer has been already used
@@ -358,7 +459,9 @@ static struct buffer *get_free_buffer(int mode, int size)
 					return buf;
 				}
 			}
-			buf = buffer_head[index];
+			if(!(buf = buffer_head[index])) {
+				buf = buffer_active_head[index];
+			}
 		}
 	}
 	if(!buf) {
@@ -368,36 +471,12 @@ static struct buffer *get_free_buffer(int mode, int size)
 
 	for(;;) {
 		SAVE_FLAGS(flags); CLI();
-		buf = buffer_head[index];
-		if(buf->flags & BUFFER_LOCKED) {
-			sleep(&buffer_wait, PROC_UNINTERRUPTIBLE);
-		} else {
-			break;
-		}
-		RESTORE_FLAGS(flags);
-	}
-
-	remove_from_free_list(buf);
-	buf->flags |= BUFFER_LOCKED;
-
-	RESTORE_FLAGS(flags);
-	return buf;
-}
-
-static struct buffer *get_dirty_buffer(int size)
-{
-	unsigned int flags;
-	struct buffer *buf;
-	int index;
-
-	index = BUFHEAD_INDEX(size);
-
-	for(;;) {
-		SAVE_FLAGS(flags); CLI();
-		if(!(buf = buffer_dirty_head[index])) {
-			/* no buffers in this dirty list */
-			RESTORE_FLAGS(flags);
-			return NULL;
+		if(!(buf = buffer_head[index])) {
+			/* the active list is used only if the inactive is empty */
+			if(!(buf = buffer_active_head[index])) {
+				RESTORE_FLAGS(flags);
+				return NULL;
+			}
 		}
 		if(buf->flags & BUFFER_LOCKED) {
 			sleep(&buffer_wait, PROC_UNINTERRUPTIBLE);
@@ -407,7 +486,8 @@ static struct buffer *get_dirty_buffer(int size)
 		RESTORE_FLAGS(flags);
 	}
 
-	remove_from_dirty_list(buf);
+	remove_from_free_list(buf);
+	buf->flags &= ~BUFFER_ACTIVE;
 	buf->flags |= BUFFER_LOCKED;
 
 	RESTORE_FLAGS(flags);
@@ -469,6 +549,12 @@ static struct buffer *getblk(__dev_t dev, __blk_t block, int size)
 			}
 			buf->flags |= BUFFER_LOCKED;
 			remove_from_free_list(buf);
+
+			/* requested again while cached, it's promoted */
+			if(buf->flags & BUFFER_VALID) {
+				buf->flags |= BUFFER_ACTIVE;
+				kstat.buffer_hits++;
+			}
 			RESTORE_FLAGS(flags);
 			return buf;
 		}
@@ -488,6 +574,10 @@ static struct buffer *getblk(__dev_t dev, __blk_t block, int size)
 		}
 
 		SAVE_FLAGS(flags); CLI();
+		if(buf->flags & BUFFER_VALID) {
+			kstat.buffer_evictions++;
+		}
+		kstat.buffer_misses++;
 		remove_from_hash(buf);	/* remove it from its old hash */
 		buf->dev = dev;
 		buf->block = block;
@@ -498,12 +588,56 @@ static struct buffer *getblk(__dev_t dev, __blk_t block, int size)
 	}
 }
 
+/*
+ * Queues a group of blocks without waiting for them. The requests are
+ * detached from the group and freed on completion, and the blocks that
+ * are already cached (or being read) are skipped.
+ */
+static void gbread_async(struct device *d, struct blk_request *brh)
+{
+	struct blk_request *br, *next;
+	struct buffer *buf;
+
+	br = brh->next_group;
+	brh->next_group = NULL;
+	while(br) {
+		next = br->next_group;
+		if(br->flags & BRF_NOBLOCK || search_buffer_hash(br->dev, br->block, br->size)) {
+			kmem_cache_free(blk_request_cache, br);
+			br = next;
+			continue;
+		}
+		if(!(buf = getblk(br->dev, br->block, br->size))) {
+			kmem_cache_free(blk_request_cache, br);
+			br = next;
+			continue;
+		}
+		if(buf->flags & BUFFER_VALID) {
+			brelse(buf);
+			kmem_cache_free(blk_request_cache, br);
+			br = next;
+			continue;
+		}
+		br->buffer = buf;
+		br->flags |= BRF_ASYNC;
+		br->head_group = br->next_group = NULL;
+		add_blk_request(br);
+		br = next;
+	}
+	run_blk_request(d);
+}
+
 /* read a group of blocks */
 int gbread(struct device *d, struct blk_request *brh)
 {
 	struct blk_request *br;
 	struct buffer *buf;
 
+	if(brh->flags & BRF_ASYNC) {
+		gbread_async(d, brh);
+		return 0;
+	}
+
 	br = brh->next_group;
 	while(br) {
 		if(!(br->flags & BRF_NOBLOCK)) {
@@ -569,6 +703,23 @@ void bwrite(struct buffer *buf)
 	brelse(buf);
 }
 
+/* marks the buffer as dirty and links it to the inode 'i' */
+void mark_buffer_dirty(struct buffer *buf, struct inode *i)
+{
+	unsigned int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	buf->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+	insert_on_inode_list(buf, i);
+	RESTORE_FLAGS(flags);
+}
+
+void bwrite_inode(struct buffer *buf, struct inode *i)
+{
+	mark_buffer_dirty(buf, i);
+	brelse(buf);
+}
+
 void brelse(struct buffer *buf)
 {
 	unsigned int flags;
@@ -577,6 +728,8 @@ void brelse(struct buffer *buf)
 
 	if(buf->flags & BUFFER_DIRTY) {
 		insert_on_dirty_list(buf);
+	} else {
+		remove_from_dirty_list(buf);
 	}
 
 	insert_on_free_list(buf);
@@ -588,45 +741,235 @@ void brelse(struct buffer *buf)
 	wakeup(&buffer_wait);
 }
 
+/* sorts the buffers by device and block number (shell sort) */
+static void sort_buffers(struct buffer **list, int nr)
+{
+	struct buffer *buf;
+	int gap, n, i;
+
+	for(gap = nr / 2; gap > 0; gap /= 2) {
+		for(n = gap; n < nr; n++) {
+			buf = list[n];
+			for(i = n; i >= gap; i -= gap) {
+				if(list[i - gap]->dev < buf->dev) {
+					break;
+				}
+				if(list[i - gap]->dev == buf->dev && list[i - gap]->block < buf->block) {
+					break;
+				}
+				list[i] = list[i - gap];
+			}
+			list[i] = buf;
+		}
+	}
+}
+
+/*
+ * Locks and puts in 'list' up to 'max' dirty buffers of 'size' that belong to
+ * the device 'dev' (0 = all devices). If 'expire' is set, only the buffers
+ * that have been dirty for longer than DIRTY_EXPIRE are taken, and if 'wait'
+ * is set, it waits for the locked buffers instead of skipping them.
+ * The buffers stay in the dirty list until they have been written.
+ */
+static int collect_dirty_buffers(struct buffer **list, int max, int size, __dev_t dev, int expire, int wait)
+{
+	unsigned int flags;
+	struct buffer *buf;
+	int nr;
+
+	nr = 0;
+	SAVE_FLAGS(flags); CLI();
+	buf = buffer_dirty_head[BUFHEAD_INDEX(size)];
+	while(buf && nr < max) {
+		/* the list is kept in the order the buffers were dirtied */
+		if(expire && (int)(CURRENT_TICKS - buf->dirty_time) < DIRTY_EXPIRE) {
+			break;
+		}
+		if(dev && buf->dev != dev) {
+			buf = buf->next_dirty;
+			continue;
+		}
+		if(buf->flags & BUFFER_LOCKED) {
+			if(wait && !nr) {
+				sleep(&buffer_wait, PROC_UNINTERRUPTIBLE);
+				buf = buffer_dirty_head[BUFHEAD_INDEX(size)];
+				continue;
+			}
+			buf = buf->next_dirty;
+			continue;
+		}
+		buf->flags |= BUFFER_LOCKED;
+		list[nr++] = buf;
+		buf = buf->next_dirty;
+	}
+	RESTORE_FLAGS(flags);
+	return nr;
+}
+
+/*
+ * Writes the (locked) buffers in ascending order of device and block number,
+ * so the drivers can merge the consecutive blocks in a single transfer. If
+ * 'brh' is NULL the requests are asynchronous and each buffer is released on
+ * completion, otherwise they are linked in the group 'brh' to be waited for.
+ * It returns the number of buffers queued or already written.
+ */
+static int write_buffers(struct buffer **list, int nr, struct blk_request *brh)
+{
+	struct blk_request *br, *last;
+	struct buffer *buf;
+	struct device *d, *prev_d;
+	int n, written;
+
+	sort_buffers(list, nr);
+	prev_d = NULL;
+	last = brh;
+	written = 0;
+	for(n = 0; n < nr; n++) {
+		buf = list[n];
+		if(!(d = get_device(BLK_DEV, buf->dev))) {
+			printk("WARNING: %s(): block device %d,%d not registered!\n", __FUNCTION__, MAJOR(buf->dev), MINOR(buf->dev));
+			brelse(buf);
+			continue;
+		}
+		if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
+			if(!sync_one_buffer(buf)) {
+				written++;
+			}
+			brelse(buf);
+			continue;
+		}
+		memset_b(br, 0, sizeof(struct blk_request));
+		br->dev = buf->dev;
+		br->block = buf->block;
+		br->size = buf->size;
+		br->buffer = buf;
+		br->device = d;
+		br->fn = d->fsop->write_block;
+		if(brh) {
+			br->head_group = brh;
+			last->next_group = br;
+			last = br;
+			brh->left++;
+		} else {
+			br->flags |= BRF_ASYNC;
+		}
+		if(prev_d && prev_d != d) {
+			run_blk_request(prev_d);
+		}
+		add_blk_request(br);
+		prev_d = d;
+		written++;
+	}
+	if(prev_d) {
+		run_blk_request(prev_d);
+	}
+	return written;
+}
+
+/* writes the buffers in 'list' and waits for them, returns the written ones */
+static int write_buffers_wait(struct buffer **list, int nr)
+{
+	unsigned int flags;
+	struct blk_request brh, *br, *next;
+	int written;
+
+	memset_b(&brh, 0, sizeof(struct blk_request));
+	written = write_buffers(list, nr, &brh);
+
+	SAVE_FLAGS(flags); CLI();
+	if(brh.left) {
+		sleep(&brh, PROC_UNINTERRUPTIBLE);
+	}
+	RESTORE_FLAGS(flags);
+
+	br = brh.next_group;
+	while(br) {
+		next = br->next_group;
+		if(br->errno > 0) {
+			br->buffer->flags &= ~BUFFER_DIRTY;
+		} else {
+			printk("WARNING: %s(): unable to write block %d on device %d,%d.\n", __FUNCTION__, br->block, MAJOR(br->dev), MINOR(br->dev));
+			written--;
+		}
+		brelse(br->buffer);
+		kmem_cache_free(blk_request_cache, br);
+		br = next;
+	}
+	return written;
+}
+
+/* writes synchronously all the dirty buffers of 'dev' (0 = all devices) */
 void sync_buffers(__dev_t dev)
 {
-	struct buffer *buf, *first;
-	int flushed, size;
+	int nr, size;
 
 	lock_resource(&sync_resource);
-	flushed = 0;
 	for(size = BLKSIZE_1K; size <= PAGE_SIZE; size <<= 1) {
-		first = NULL;
 		for(;;) {
-			if(!(buf = get_dirty_buffer(size))) {
+			if(!(nr = collect_dirty_buffers(writeback_list, WRITEBACK_BATCH, size, dev, 0, 1))) {
 				break;
 			}
-			if(first == buf) {
-				insert_on_dirty_list(buf);
-				buf->flags &= ~BUFFER_LOCKED;
-				wakeup(&buffer_wait);
+
+			/* don't insist on a device that fails */
+			if(!write_buffers_wait(writeback_list, nr)) {
 				break;
 			}
-			if(!dev || buf->dev == dev) {
-				if(sync_one_buffer(buf)) {
-					insert_on_dirty_list(buf);
-					buf->flags &= ~BUFFER_LOCKED;
+		}
+	}
+	unlock_resource(&sync_resource);
+}
+
+/* writes synchronously only the dirty buffers of the inode 'i' */
+int sync_inode_buffers(struct inode *i)
+{
+	unsigned int flags;
+	struct buffer *buf;
+	int nr, errno;
+
+	errno = 0;
+	lock_resource(&sync_resource);
+	for(;;) {
+		nr = 0;
+		SAVE_FLAGS(flags); CLI();
+		buf = i->dirty_buffers;
+		while(buf && nr < WRITEBACK_BATCH) {
+			if(buf->flags & BUFFER_LOCKED) {
+				if(!nr) {
+					sleep(&buffer_wait, PROC_UNINTERRUPTIBLE);
+					buf = i->dirty_buffers;
 					continue;
 				}
-				flushed++;
-			} else {
-				if(!first) {
-					first = buf;
-				}
-				insert_on_dirty_list(buf);
+				buf = buf->next_idirty;
+				continue;
 			}
-			buf->flags &= ~BUFFER_LOCKED;
+			buf->flags |= BUFFER_LOCKED;
+			writeback_list[nr++] = buf;
+			buf = buf->next_idirty;
+		}
+		RESTORE_FLAGS(flags);
+
+		if(!nr) {
+			break;
+		}
+		if(write_buffers_wait(writeback_list, nr) < nr) {
+			errno = -EIO;
+			break;
 		}
-	}
-	if(flushed) {
-		wakeup(&buffer_wait);
 	}
 	unlock_resource(&sync_resource);
+	return errno;
+}
+
+/* the inode is about to be reused, its buffers stay only in the dirty list */
+void detach_inode_buffers(struct inode *i)
+{
+	unsigned int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	while(i->dirty_buffers) {
+		remove_from_inode_list(i->dirty_buffers);
+	}
+	RESTORE_FLAGS(flags);
 }
 
 void invalidate_buffers(__dev_t dev)
@@ -641,7 +984,11 @@ void invalidate_buffers(__dev_t dev)
 		if(!(buf->flags & BUFFER_LOCKED) && buf->dev == dev) {
 			buffer_wait(buf);
 			remove_from_hash(buf);
-			buf->flags &= ~(BUFFER_VALID | BUFFER_LOCKED);
+
+			/* it goes to the head of the inactive list */
+			remove_from_free_list(buf);
+			buf->flags &= ~(BUFFER_VALID | BUFFER_LOCKED | BUFFER_ACTIVE);
+			insert_on_free_list(buf);
 			wakeup(&buffer_wait);
 		}
 		buf = buf->next;
@@ -651,6 +998,34 @@ void invalidate_buffers(__dev_t dev)
 	/* FIXME: invalidate_pages(dev); */
 }
 
+/* drops the cached copy of a block that has been written without the cache */
+void invalidate_buffer(__dev_t dev, __blk_t block, int size)
+{
+	unsigned int flags;
+	struct buffer *buf;
+
+	SAVE_FLAGS(flags); CLI();
+	while((buf = search_buffer_hash(dev, block, size))) {
+		buffer_wait(buf);
+
+		/* it could have been reused while waiting for it */
+		if(buf->dev == dev && buf->block == block && buf->size == size) {
+			if(buf->flags & BUFFER_DIRTY) {
+				remove_from_dirty_list(buf);
+			}
+			remove_from_hash(buf);
+			remove_from_free_list(buf);
+			buf->flags &= ~(BUFFER_VALID | BUFFER_DIRTY | BUFFER_LOCKED | BUFFER_ACTIVE);
+			insert_on_free_list(buf);
+			wakeup(&buffer_wait);
+			break;
+		}
+		buf->flags &= ~BUFFER_LOCKED;
+		wakeup(&buffer_wait);
+	}
+	RESTORE_FLAGS(flags);
+}
+
 static int reclaim_siblings(struct buffer *buf)
 {
 	struct buffer *orig, *tmp;
@@ -726,6 +1101,9 @@ int reclaim_buffers(void)
 				RESTORE_FLAGS(flags);
 				continue;
 			}
+			if(buf->flags & BUFFER_VALID) {
+				kstat.buffer_evictions++;
+			}
 			kfree((unsigned int)(buf->data) & PAGE_MASK);
 			remove_from_hash(buf);
 			kstat.buffers_size -= buf->size / 1024;
@@ -760,57 +1138,38 @@ int reclaim_buffers(void)
 	return reclaimed;
 }
 
+/*
+ * The dirty buffers are written periodically (every DIRTY_WRITEBACK ticks)
+ * once they are older than DIRTY_EXPIRE, or all of them as soon as they go
+ * over the BUFFER_DIRTY_RATIO threshold. They are written in batches, sorted
+ * and asynchronously, so the drivers can transfer them in large requests.
+ */
 int kbdflushd(void)
 {
-	struct buffer *buf, *first;
-	int flushed, size;
+	unsigned int flags;
+	int nr, size, expire;
 
 	for(;;) {
+		SAVE_FLAGS(flags); CLI();
+		current->timeout = DIRTY_WRITEBACK;
 		sleep(&kbdflushd, PROC_INTERRUPTIBLE);
-		flushed = 0;
+		current->timeout = 0;
+		RESTORE_FLAGS(flags);
 
 		lock_resource(&sync_resource);
-		for(size = BLKSIZE_1K; size <= PAGE_SIZE; size <<= 1) {
-			first = NULL;
-			for(;;) {
-				if(!(buf = get_dirty_buffer(size))) {
-					break;
-				}
-
-				if(!(buf->flags & BUFFER_DIRTY)) {
-					printk("WARNING: %s(): a dirty buffer (dev %x, block %d, flags = %x) is not marked as dirty!\n", __FUNCTION__, buf->dev, buf->block, buf->flags);
-					continue;
-				}
-
-				if(first) {
-					if(first == buf) {
-						insert_on_dirty_list(buf);
-						buf->flags &= ~BUFFER_LOCKED;
-						wakeup(&buffer_wait);
-						break;
-					}
-				} else {
-					first = buf;
-				}
-
-				if(sync_one_buffer(buf)) {
-					insert_on_dirty_list(buf);
-					buf->flags &= ~BUFFER_LOCKED;
-					wakeup(&buffer_wait);
-					continue;
-				}
-				buf->flags &= ~BUFFER_LOCKED;
-				wakeup(&buffer_wait);
-				flushed++;
-
-				if(flushed == NR_BUF_RECLAIM) {
-					if(kstat.nr_dirty_buffers < kstat.max_dirty_buffers) {
-						break;
-					}
-					flushed = 0;
-					do_sched();
-				}
+		for(;;) {
+			expire = kstat.nr_dirty_buffers <= kstat.max_dirty_buffers;
+			nr = 0;
+			for(size = BLKSIZE_1K; size <= PAGE_SIZE; size <<= 1) {
+				nr += collect_dirty_buffers(writeback_list + nr, WRITEBACK_BATCH - nr, size, 0, expire, 0);
+			}
+			if(!nr) {
+				break;
+			}
+			if(!write_buffers(writeback_list, nr, NULL) || nr < WRITEBACK_BATCH) {
+				break;
 			}
+			do_sched();
 		}
 		unlock_resource(&sync_resource);
 	}
@@ -820,7 +1179,12 @@ void buffer_init(void)
 {
 	buffer_table = NULL;
 	memset_b(buffer_head, 0, sizeof(buffer_head));
+	memset_b(buffer_active_head, 0, sizeof(buffer_active_head));
+	memset_b(nr_inactive, 0, sizeof(nr_inactive));
+	memset_b(nr_active, 0, sizeof(nr_active));
 	memset_b(buffer_dirty_head, 0, sizeof(buffer_dirty_head));
 	kstat.max_dirty_buffers = (kstat.max_buffers_size * BUFFER_DIRTY_RATIO) / 100;
 	memset_b(buffer_hash_table, 0, buffer_hash_table_size);
+	buffer_cache = kmem_cache_create("buffer", sizeof(struct buffer), NULL);
+	blk_request_cache = kmem_cache_create("blk_request", sizeof(struct blk_request), NULL);
 }
@@ -0,0 +1,271 @@
+/*
+ * fiwix/fs/dcache.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * The dentry cache keeps the result of the recent directory lookups as
+ * (device, directory inode, name) -> inode, so do_namei() doesn't need to
+ * scan the directory blocks every time a path is resolved. A name that
+ * doesn't exist is also cached (negative entry) with the inode 0.
+ *
+ * Only the filesystems with the FSOP_DCACHE flag are cached. The syscalls
+ * that change a directory invalidate the names they touch, and every
+ * invalidation increments 'dcache_seq' so that a lookup that slept while
+ * reading the disk won't insert a result that might be already stale.
+ *
+ *   dentry_hash
+ *   +--------+
+ *   |        |
+ *   +--------+   +--------+   +--------+
+ *   | index  |-->| dentry |-->| dentry |--> NULL
+ *   +--------+   +--------+   +--------+
+ *   |        |
+ *   +--------+
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/dcache.h>
+#include <fiwix/mm.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+static struct dentry *dentry_hash[NR_DENTRY_HASH];
+static struct dentry *lru_head;		/* most recently used */
+static struct dentry *lru_tail;		/* least recently used */
+static struct kmem_cache *dentry_cache;
+static unsigned int dcache_seq;
+
+/* the name ends at the end of the path component */
+static int get_name_len(const char *name)
+{
+	int len;
+
+	for(len = 0; name[len] && name[len] != '/'; len++);
+	return len;
+}
+
+static int dentry_hashfn(__dev_t dev, __ino_t dir, const char *name, int len)
+{
+	unsigned int h;
+
+	h = dev ^ dir;
+	while(len--) {
+		h = (h << 5) + h + *(name++);
+	}
+	return h % NR_DENTRY_HASH;
+}
+
+static void insert_on_lru(struct dentry *d)
+{
+	d->prev_lru = NULL;
+	d->next_lru = lru_head;
+	if(lru_head) {
+		lru_head->prev_lru = d;
+	} else {
+		lru_tail = d;
+	}
+	lru_head = d;
+}
+
+static void remove_from_lru(struct dentry *d)
+{
+	if(d->next_lru) {
+		d->next_lru->prev_lru = d->prev_lru;
+	} else {
+		lru_tail = d->prev_lru;
+	}
+	if(d->prev_lru) {
+		d->prev_lru->next_lru = d->next_lru;
+	} else {
+		lru_head = d->next_lru;
+	}
+}
+
+static struct dentry *search_dentry(__dev_t dev, __ino_t dir, const char *name, int len)
+{
+	struct dentry *d;
+
+	d = dentry_hash[dentry_hashfn(dev, dir, name, len)];
+	while(d) {
+		if(d->dev == dev && d->dir == dir && d->name_len == len) {
+			if(!strncmp(d->name, name, len)) {
+				return d;
+			}
+		}
+		d = d->next_hash;
+	}
+	return NULL;
+}
+
+static void del_dentry(struct dentry *d)
+{
+	struct dentry **h;
+
+	h = &dentry_hash[dentry_hashfn(d->dev, d->dir, d->name, d->name_len)];
+	if(d->next_hash) {
+		d->next_hash->prev_hash = d->prev_hash;
+	}
+	if(d->prev_hash) {
+		d->prev_hash->next_hash = d->next_hash;
+	}
+	if(d == *h) {
+		*h = d->next_hash;
+	}
+	remove_from_lru(d);
+	if(!d->inode) {
+		kstat.nr_negative_dentries--;
+	}
+	kstat.nr_dentries--;
+	kmem_cache_free(dentry_cache, d);
+}
+
+static void add_dentry(__dev_t dev, __ino_t dir, const char *name, int len, __ino_t inode, unsigned int seq)
+{
+	struct dentry **h, *d;
+
+	if(kstat.nr_dentries >= NR_DENTRIES) {
+		del_dentry(lru_tail);
+	}
+	if(!(d = (struct dentry *)kmem_cache_alloc(dentry_cache))) {
+		return;
+	}
+
+	/* the directory might have changed while allocating the entry */
+	if(seq != dcache_seq || search_dentry(dev, dir, name, len)) {
+		kmem_cache_free(dentry_cache, d);
+		return;
+	}
+
+	d->dev = dev;
+	d->dir = dir;
+	d->inode = inode;
+	d->name_len = len;
+	memcpy_b(d->name, (void *)name, len);
+	d->name[len] = 0;
+
+	h = &dentry_hash[dentry_hashfn(dev, dir, name, len)];
+	d->prev_hash = NULL;
+	d->next_hash = *h;
+	if(*h) {
+		(*h)->prev_hash = d;
+	}
+	*h = d;
+	insert_on_lru(d);
+	if(!inode) {
+		kstat.nr_negative_dentries++;
+	}
+	kstat.nr_dentries++;
+}
+
+/*
+ * Same as the lookup() method of the filesystem (it consumes the reference
+ * of 'dir'), but it looks first into the dentry cache.
+ */
+int dcache_lookup(const char *name, struct inode *dir, struct inode **i_res)
+{
+	struct dentry *d;
+	__dev_t dev;
+	__ino_t ino;
+	unsigned int seq;
+	int len, errno;
+
+	len = get_name_len(name);
+	if(!(dir->fsop->flags & FSOP_DCACHE) || len > DNAME_LEN) {
+		return dir->fsop->lookup(name, dir, i_res);
+	}
+
+	dev = dir->dev;
+	ino = dir->inode;
+	if((d = search_dentry(dev, ino, name, len))) {
+		kstat.dcache_hits++;
+		remove_from_lru(d);
+		insert_on_lru(d);
+		if(!d->inode) {
+			iput(dir);
+			return -ENOENT;
+		}
+		if(d->inode == ino) {
+			*i_res = dir;
+			return 0;
+		}
+		if(!(*i_res = iget(dir->sb, d->inode))) {
+			iput(dir);
+			return -EACCES;
+		}
+		iput(dir);
+		return 0;
+	}
+
+	kstat.dcache_misses++;
+	seq = dcache_seq;
+	errno = dir->fsop->lookup(name, dir, i_res);
+	if(!errno) {
+		/* names that cross a mount point are not cached */
+		if((*i_res)->dev == dev) {
+			add_dentry(dev, ino, name, len, (*i_res)->inode, seq);
+		}
+	} else if(errno == -ENOENT) {
+		add_dentry(dev, ino, name, len, 0, seq);
+	}
+	return errno;
+}
+
+/* invalidates a single name of the directory */
+void dcache_remove(struct inode *dir, const char *name)
+{
+	struct dentry *d;
+	int len;
+
+	dcache_seq++;
+	if(!name) {
+		return;
+	}
+	len = get_name_len(name);
+	if(len <= DNAME_LEN) {
+		if((d = search_dentry(dir->dev, dir->inode, name, len))) {
+			del_dentry(d);
+		}
+	}
+}
+
+/* invalidates all the names pointing to or contained in the inode */
+void dcache_purge(__dev_t dev, __ino_t inode)
+{
+	struct dentry *d, *next;
+
+	dcache_seq++;
+	for(d = lru_head; d; d = next) {
+		next = d->next_lru;
+		if(d->dev == dev && (d->dir == inode || d->inode == inode)) {
+			del_dentry(d);
+		}
+	}
+}
+
+/* invalidates all the names of the device */
+void dcache_flush(__dev_t dev)
+{
+	struct dentry *d, *next;
+
+	dcache_seq++;
+	for(d = lru_head; d; d = next) {
+		next = d->next_lru;
+		if(d->dev == dev) {
+			del_dentry(d);
+		}
+	}
+}
+
+void dcache_init(void)
+{
+	memset_b(dentry_hash, 0, sizeof(dentry_hash));
+	lru_head = lru_tail = NULL;
+	dcache_seq = 0;
+	dentry_cache = kmem_cache_create("dentry", sizeof(struct dentry), NULL);
+}
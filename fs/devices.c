@@ -9,6 +9,8 @@
 #include <fiwix/errno.h>
 #include <fiwix/buffer.h>
 #include <fiwix/devices.h>
+#include <fiwix/blk_queue.h>
+#include <fiwix/ioctl.h>
 #include <fiwix/fs.h>
 #include <fiwix/mm.h>
 #include <fiwix/process.h>
@@ -359,8 +361,23 @@ int blk_dev_write(struct inode *i, struct fd *f, const char *buffer, __size_t co
 int blk_dev_ioctl(struct inode *i, struct fd *f, int cmd, unsigned int arg)
 {
 	struct device *d;
+	int errno;
 
 	if((d = get_device(BLK_DEV, i->rdev))) {
+		/* the I/O scheduler is common to all block devices */
+		switch(cmd) {
+			case BLKELVGET:
+				if((errno = check_user_area(VERIFY_WRITE, (void *)arg, sizeof(int)))) {
+					return errno;
+				}
+				*(int *)arg = d->elevator ? d->elevator : default_elevator;
+				return 0;
+			case BLKELVSET:
+				if(!IS_SUPERUSER) {
+					return -EPERM;
+				}
+				return set_elevator(d, arg);
+		}
 		return d->fsop->ioctl(i, f, cmd, arg);
 	}
 
@@ -0,0 +1,367 @@
+/*
+ * fiwix/fs/epollfs/epoll.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * Every file watched by an epoll instance has an item that stays linked in
+ * the wait queue of the file (or its tty, socket, ...) from epoll_ctl() until
+ * it's removed. When the queue is woken up, the item is appended to the ready
+ * list of the instance, so epoll_wait() only checks the files that had some
+ * activity and not all the files being watched.
+ *
+ * The items of a file are also linked in its 'struct fd', so they are removed
+ * when the last descriptor of the file is closed.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_epoll.h>
+#include <fiwix/poll.h>
+#include <fiwix/sleep.h>
+#include <fiwix/sched.h>
+#include <fiwix/mm.h>
+#include <fiwix/string.h>
+
+/* the following functions are called with the interrupts disabled */
+
+static void link_ready(struct epoll_item *epi)
+{
+	struct eventpoll *ep;
+
+	ep = epi->ep;
+	epi->ready = 1;
+	epi->next_ready = NULL;
+	if(ep->ready_tail) {
+		ep->ready_tail->next_ready = epi;
+	} else {
+		ep->ready_head = epi;
+	}
+	ep->ready_tail = epi;
+}
+
+static void unlink_ready(struct epoll_item *epi)
+{
+	struct eventpoll *ep;
+	struct epoll_item **p, *prev;
+
+	ep = epi->ep;
+	prev = NULL;
+	for(p = &ep->ready_head; *p; p = &(*p)->next_ready) {
+		if(*p == epi) {
+			*p = epi->next_ready;
+			if(ep->ready_tail == epi) {
+				ep->ready_tail = prev;
+			}
+			break;
+		}
+		prev = *p;
+	}
+	epi->ready = 0;
+}
+
+static void ep_ready(struct epoll_item *epi)
+{
+	if(!epi->ready) {
+		link_ready(epi);
+		wakeup(epi->ep);
+		wakeup_queue(&epi->ep->wq);
+	}
+}
+
+static void ep_wakeup(struct wait_entry *e)
+{
+	struct epoll_item *epi;
+
+	epi = (struct epoll_item *)e->data;
+
+	/* disabled by EPOLLONESHOT */
+	if(!(epi->event.events & ~EPOLL_FLAGS)) {
+		return;
+	}
+	ep_ready(epi);
+}
+
+static void ep_ptable_add(struct poll_table *pt, struct wait_queue *wq)
+{
+	struct epoll_item *epi;
+	struct wait_entry *e;
+	int n;
+
+	epi = (struct epoll_item *)pt->data;
+	for(n = 0; n < EPOLL_NR_WAITS; n++) {
+		e = &epi->wait[n];
+		if(e->queue == wq) {
+			return;
+		}
+		if(!e->queue) {
+			e->func = ep_wakeup;
+			e->data = epi;
+			add_wait_queue(wq, e);
+			return;
+		}
+	}
+}
+
+/* checks the file and, the first time, links the item in its wait queues */
+static void ep_check(struct epoll_item *epi, int reg)
+{
+	struct poll_table pt;
+	unsigned int flags;
+	int revents;
+
+	if(reg) {
+		poll_table_init(&pt);
+		pt.add = ep_ptable_add;
+		pt.data = epi;
+		current->poll_table = &pt;
+	}
+	revents = poll_events(epi->fd, epi->event.events);
+	current->poll_table = NULL;
+
+	if(revents) {
+		SAVE_FLAGS(flags); CLI();
+		ep_ready(epi);
+		RESTORE_FLAGS(flags);
+	}
+}
+
+static struct epoll_item *ep_find(struct eventpoll *ep, struct fd *f, int ufd)
+{
+	struct epoll_item *epi;
+
+	for(epi = f->ep_links; epi; epi = epi->next_link) {
+		if(epi->ep == ep && epi->ufd == ufd) {
+			return epi;
+		}
+	}
+	return NULL;
+}
+
+static int ep_insert(struct eventpoll *ep, struct fd *f, int ufd, struct epoll_event *event)
+{
+	struct epoll_item *epi;
+
+	if(!(epi = (struct epoll_item *)kmalloc(sizeof(struct epoll_item)))) {
+		return -ENOMEM;
+	}
+	memset_b(epi, 0, sizeof(struct epoll_item));
+	epi->ep = ep;
+	epi->fd = f;
+	epi->ufd = ufd;
+	epi->event.events = event->events | EPOLL_ALWAYS;
+	epi->event.data = event->data;
+
+	if((epi->next = ep->items)) {
+		ep->items->prev = epi;
+	}
+	ep->items = epi;
+	if((epi->next_link = f->ep_links)) {
+		f->ep_links->prev_link = epi;
+	}
+	f->ep_links = epi;
+
+	ep_check(epi, 1);
+	return 0;
+}
+
+static void ep_remove(struct epoll_item *epi)
+{
+	struct eventpoll *ep;
+	unsigned int flags;
+	int n;
+
+	ep = epi->ep;
+	for(n = 0; n < EPOLL_NR_WAITS; n++) {
+		if(epi->wait[n].queue) {
+			remove_wait_queue(&epi->wait[n]);
+		}
+	}
+
+	SAVE_FLAGS(flags); CLI();
+	if(epi->ready) {
+		unlink_ready(epi);
+	}
+	RESTORE_FLAGS(flags);
+
+	if(epi->next) {
+		epi->next->prev = epi->prev;
+	}
+	if(epi->prev) {
+		epi->prev->next = epi->next;
+	} else {
+		ep->items = epi->next;
+	}
+	if(epi->next_link) {
+		epi->next_link->prev_link = epi->prev_link;
+	}
+	if(epi->prev_link) {
+		epi->prev_link->next_link = epi->next_link;
+	} else {
+		epi->fd->ep_links = epi->next_link;
+	}
+	kfree((unsigned int)epi);
+}
+
+/* moves up to 'maxevents' events from the ready list to 'events' */
+static int ep_collect(struct eventpoll *ep, struct epoll_event *events, int maxevents)
+{
+	struct epoll_item *list, *epi;
+	unsigned int flags;
+	int revents, count;
+
+	/*
+	 * The ready list is detached, and its items keep the 'ready' flag
+	 * until they are checked, so ep_wakeup() won't link them again.
+	 */
+	SAVE_FLAGS(flags); CLI();
+	list = ep->ready_head;
+	ep->ready_head = ep->ready_tail = NULL;
+	RESTORE_FLAGS(flags);
+
+	count = 0;
+	while((epi = list)) {
+		list = epi->next_ready;
+
+		SAVE_FLAGS(flags); CLI();
+		epi->ready = 0;
+		if(count == maxevents) {
+			link_ready(epi);
+			RESTORE_FLAGS(flags);
+			continue;
+		}
+		RESTORE_FLAGS(flags);
+
+		if(!(revents = poll_events(epi->fd, epi->event.events))) {
+			continue;
+		}
+		events[count].events = revents;
+		events[count].data = epi->event.data;
+		count++;
+
+		if(epi->event.events & EPOLLONESHOT) {
+			epi->event.events &= EPOLL_FLAGS;
+			continue;
+		}
+
+		/* level-triggered items stay ready until a check fails */
+		if(!(epi->event.events & EPOLLET)) {
+			SAVE_FLAGS(flags); CLI();
+			if(!epi->ready) {
+				link_ready(epi);
+			}
+			RESTORE_FLAGS(flags);
+		}
+	}
+	return count;
+}
+
+int epollfs_ctl(struct inode *i, int op, int ufd, struct epoll_event *event)
+{
+	struct eventpoll *ep;
+	struct epoll_item *epi;
+	struct fd *f;
+
+	ep = i->u.epollfs.ep;
+	f = &fd_table[current->fd[ufd]];
+
+	/* nested instances are not supported */
+	if(f->inode->fsop == &epollfs_fsop) {
+		return -EINVAL;
+	}
+	if(!f->inode->fsop || !f->inode->fsop->select) {
+		return -EPERM;
+	}
+
+	epi = ep_find(ep, f, ufd);
+	switch(op) {
+		case EPOLL_CTL_ADD:
+			if(epi) {
+				return -EEXIST;
+			}
+			return ep_insert(ep, f, ufd, event);
+		case EPOLL_CTL_MOD:
+			if(!epi) {
+				return -ENOENT;
+			}
+			epi->event.events = event->events | EPOLL_ALWAYS;
+			epi->event.data = event->data;
+			ep_check(epi, 0);
+			return 0;
+		case EPOLL_CTL_DEL:
+			if(!epi) {
+				return -ENOENT;
+			}
+			ep_remove(epi);
+			return 0;
+	}
+	return -EINVAL;
+}
+
+int epollfs_wait(struct inode *i, struct epoll_event *events, int maxevents)
+{
+	struct eventpoll *ep;
+	unsigned int flags;
+	int count;
+
+	ep = i->u.epollfs.ep;
+	for(;;) {
+		if((count = ep_collect(ep, events, maxevents))) {
+			break;
+		}
+		if(!current->timeout || current->sigpending & ~current->sigblocked) {
+			break;
+		}
+		SAVE_FLAGS(flags); CLI();
+		if(!ep->ready_head) {
+			sleep(ep, PROC_INTERRUPTIBLE);
+		}
+		RESTORE_FLAGS(flags);
+	}
+	return count;
+}
+
+/* removes the items of a file whose last descriptor is being closed */
+void epollfs_release(struct fd *f)
+{
+	while(f->ep_links) {
+		ep_remove(f->ep_links);
+	}
+}
+
+int epollfs_close(struct inode *i, struct fd *f)
+{
+	struct eventpoll *ep;
+
+	ep = i->u.epollfs.ep;
+	while(ep->items) {
+		ep_remove(ep->items);
+	}
+	return 0;
+}
+
+__loff_t epollfs_llseek(struct inode *i, __loff_t offset)
+{
+	return -ESPIPE;
+}
+
+int epollfs_select(struct inode *i, struct fd *f, int flag)
+{
+	struct eventpoll *ep;
+
+	ep = i->u.epollfs.ep;
+	select_wait(&ep->wq);
+	switch(flag) {
+		case SEL_R:
+			if(ep->ready_head) {
+				return 1;
+			}
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * fiwix/fs/epollfs/super.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/errno.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fs_epoll.h>
+#include <fiwix/stat.h>
+#include <fiwix/mm.h>
+#include <fiwix/sched.h>
+#include <fiwix/string.h>
+
+static unsigned int i_counter;
+
+struct fs_operations epollfs_fsop = {
+	FSOP_KERN_MOUNT,
+	EPOLL_DEV,
+
+	NULL,			/* open */
+	epollfs_close,
+	NULL,			/* read */
+	NULL,			/* write */
+	NULL,			/* ioctl */
+	epollfs_llseek,
+	NULL,			/* readdir */
+	NULL,			/* readdir64 */
+	NULL,			/* mmap */
+	epollfs_select,
+
+	NULL,			/* readlink */
+	NULL,			/* followlink */
+	NULL,			/* bmap */
+	NULL,			/* lookup */
+	NULL,			/* rmdir */
+	NULL,			/* link */
+	NULL,			/* unlink */
+	NULL,			/* symlink */
+	NULL,			/* mkdir */
+	NULL,			/* mknod */
+	NULL,			/* truncate */
+	NULL,			/* create */
+	NULL,			/* rename */
+
+	NULL,			/* read_block */
+	NULL,			/* write_block */
+
+	NULL,			/* read_inode */
+	NULL,			/* write_inode */
+	epollfs_ialloc,
+	epollfs_ifree,
+	NULL,			/* statfs */
+	epollfs_read_superblock,
+	NULL,			/* remount_fs */
+	NULL,			/* write_superblock */
+	NULL			/* release_superblock */
+};
+
+int epollfs_ialloc(struct inode *i, int mode)
+{
+	struct superblock *sb = i->sb;
+	struct eventpoll *ep;
+
+	if(!(ep = (struct eventpoll *)kmalloc(sizeof(struct eventpoll)))) {
+		return -ENOMEM;
+	}
+	memset_b(ep, 0, sizeof(struct eventpoll));
+
+	superblock_lock(sb);
+	i_counter++;
+	superblock_unlock(sb);
+
+	i->i_mode = mode;
+	i->dev = i->rdev = sb->dev;
+	i->fsop = &epollfs_fsop;
+	i->inode = i_counter;
+	i->count = 1;
+	i->u.epollfs.ep = ep;
+	return 0;
+}
+
+void epollfs_ifree(struct inode *i)
+{
+	if(i->u.epollfs.ep) {
+		kfree((unsigned int)i->u.epollfs.ep);
+		i->u.epollfs.ep = NULL;
+	}
+}
+
+int epollfs_read_superblock(__dev_t dev, struct superblock *sb)
+{
+	superblock_lock(sb);
+	sb->dev = dev;
+	sb->fsop = &epollfs_fsop;
+	sb->s_blocksize = BLKSIZE_1K;
+	i_counter = 0;
+	superblock_unlock(sb);
+	return 0;
+}
+
+int epollfs_init(void)
+{
+	return register_filesystem("epollfs", &epollfs_fsop);
+}
@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/kernel.h>
+#include <fiwix/bitmap.h>
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
 #include <fiwix/filesystems.h>
@@ -17,23 +18,100 @@
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
-static int find_first_zero(struct superblock *sb, __blk_t bmblock, struct buffer **buf)
+static int test_bit(char *bitmap, int item)
 {
-	unsigned char c;
-	int n, n2;
+	return bitmap[item / 8] & (1 << (item % 8));
+}
 
-	if(!(*buf = bread(sb->dev, bmblock, sb->s_blocksize))) {
-		return -EIO;
+static void set_bit(char *bitmap, int item)
+{
+	bitmap[item / 8] |= 1 << (item % 8);
+}
+
+static void clear_bit(char *bitmap, int item)
+{
+	bitmap[item / 8] &= ~(1 << (item % 8));
+}
+
+static struct buffer *read_group_desc(struct superblock *sb, int bg, struct ext2_group_desc **gd)
+{
+	struct buffer *buf;
+	__blk_t block;
+
+	block = SUPERBLOCK + sb->u.ext2.sb.s_first_data_block + (bg / EXT2_DESC_PER_BLOCK(sb));
+	if(!(buf = bread(sb->dev, block, sb->s_blocksize))) {
+		return NULL;
 	}
-	for(n = 0; n < sb->s_blocksize; n++) {
-		if((c = (unsigned char)(*buf)->data[n]) == 0xFF) {
-			continue;
-		}
-		for(n2 = 0; n2 < 8; n2++) {
-			if(!(c & (1 << n2))) {
-				return (n * 8) + n2;
+	*gd = (struct ext2_group_desc *)(buf->data + ((bg % EXT2_DESC_PER_BLOCK(sb)) * sizeof(struct ext2_group_desc)));
+	return buf;
+}
+
+/* the last group might be smaller than the others */
+static int blocks_in_group(struct superblock *sb, int bg)
+{
+	if(bg == sb->u.ext2.block_groups - 1) {
+		return sb->u.ext2.sb.s_blocks_count - sb->u.ext2.sb.s_first_data_block - (bg * EXT2_BLOCKS_PER_GROUP(sb));
+	}
+	return EXT2_BLOCKS_PER_GROUP(sb);
+}
+
+/*
+ * Chooses the block group of a new inode. The directories are spread over
+ * the groups with more free inodes and blocks than the average, and the rest
+ * of inodes are placed in the group of their parent directory (or in one
+ * close to it), so their blocks will be near the directory entries.
+ */
+static int find_inode_group(struct superblock *sb, int parent_bg, int mode)
+{
+	struct ext2_group_desc *gd;
+	struct buffer *buf;
+	int bg, n, best, best_free, avg_free;
+
+	best = -1;
+	if(S_ISDIR(mode)) {
+		avg_free = sb->u.ext2.sb.s_free_inodes_count / sb->u.ext2.block_groups;
+		best_free = -1;
+		for(n = 0; n < sb->u.ext2.block_groups; n++) {
+			bg = (parent_bg + n) % sb->u.ext2.block_groups;
+			if(!(buf = read_group_desc(sb, bg, &gd))) {
+				return -EIO;
+			}
+			if(gd->bg_free_inodes_count && gd->bg_free_inodes_count >= avg_free) {
+				if(gd->bg_free_blocks_count > best_free) {
+					best = bg;
+					best_free = gd->bg_free_blocks_count;
+				}
 			}
+			brelse(buf);
+		}
+		if(best >= 0) {
+			return best;
+		}
+	}
+
+	/* parent's group first, then quadratic and linear probing */
+	bg = parent_bg;
+	for(n = 0; n < sb->u.ext2.block_groups; n = n ? n << 1 : 1) {
+		bg = (parent_bg + n) % sb->u.ext2.block_groups;
+		if(!(buf = read_group_desc(sb, bg, &gd))) {
+			return -EIO;
+		}
+		if(gd->bg_free_inodes_count && gd->bg_free_blocks_count) {
+			brelse(buf);
+			return bg;
+		}
+		brelse(buf);
+	}
+	for(n = 0; n < sb->u.ext2.block_groups; n++) {
+		bg = (parent_bg + n) % sb->u.ext2.block_groups;
+		if(!(buf = read_group_desc(sb, bg, &gd))) {
+			return -EIO;
 		}
+		if(gd->bg_free_inodes_count) {
+			brelse(buf);
+			return bg;
+		}
+		brelse(buf);
 	}
 	return -ENOSPC;
 }
@@ -75,66 +153,49 @@ static int change_bit(int mode, struct superblock *sb, __blk_t bmblock, struct b
 }
 
 /*
- * Unlike of what Ext2 specifies/suggests, this inode allocation does NOT
- * try to assign inodes in the same block group of the directory in which
- * they will be created.
+ * The new inode 'i' comes with the inode number of its parent directory
+ * as a placement hint.
  */
 int ext2_ialloc(struct inode *i, int mode)
 {
 	__ino_t inode;
-	__blk_t block;
 	struct superblock *sb;
 	struct ext2_group_desc *gd;
 	struct buffer *buf, *bmbuf;
-	int bg, d, errno;
+	int bg, parent_bg, errno;
 
 	sb = i->sb;
 	superblock_lock(sb);
 
-	block = SUPERBLOCK + sb->u.ext2.sb.s_first_data_block;
-	buf = bmbuf = NULL;
-	gd = NULL;
-	errno = -ENOSPC;
+	parent_bg = 0;
+	if(i->inode && i->inode <= sb->u.ext2.sb.s_inodes_count) {
+		parent_bg = (i->inode - 1) / EXT2_INODES_PER_GROUP(sb);
+	}
+	if((bg = find_inode_group(sb, parent_bg, mode)) < 0) {
+		superblock_unlock(sb);
+		return bg;
+	}
 
-	/* read through all group descriptors to find the first unallocated inode */
-	for(bg = 0, d = 0; bg < sb->u.ext2.block_groups; bg++, d++) {
-		if(!(bg % EXT2_DESC_PER_BLOCK(sb))) {
-			if(buf) {
-				brelse(buf);
-				block++;
-				d = 0;
-			}
-			if(!(buf = bread(sb->dev, block, sb->s_blocksize))) {
-				superblock_unlock(sb);
-				return -EIO;
-			}
-		}
-		gd = (struct ext2_group_desc *)(buf->data + (d * sizeof(struct ext2_group_desc)));
-		if(gd->bg_free_inodes_count) {
-			if((errno = find_first_zero(sb, gd->bg_inode_bitmap, &bmbuf)) != -ENOSPC) {
-				break;
-			}
-			brelse(bmbuf);
-		}
+	if(!(buf = read_group_desc(sb, bg, &gd))) {
+		superblock_unlock(sb);
+		return -EIO;
+	}
+	if(!(bmbuf = bread(sb->dev, gd->bg_inode_bitmap, sb->s_blocksize))) {
+		brelse(buf);
+		superblock_unlock(sb);
+		return -EIO;
 	}
-	if(errno < 0) {
+	if((errno = find_next_zero_bit((unsigned int *)bmbuf->data, EXT2_INODES_PER_GROUP(sb), 0)) < 0) {
+		printk("WARNING: %s(): block group %d has no free inodes but its descriptor says %d.\n", __FUNCTION__, bg, gd->bg_free_inodes_count);
+		brelse(bmbuf);
 		brelse(buf);
 		superblock_unlock(sb);
 		return errno;
 	}
 
 	inode = errno;
-	errno = change_bit(SET_BIT, sb, gd->bg_inode_bitmap, bmbuf, inode);
-	if(errno) {
-		if(errno < 0) {
-			printk("WARNING: %s(): unable to set inode %d.\n", __FUNCTION__, inode);
-			brelse(buf);
-			superblock_unlock(sb);
-			return errno;
-		} else {
-			printk("WARNING: %s(): inode %d is already marked as used!\n", __FUNCTION__, inode);
-		}
-	}
+	set_bit(bmbuf->data, inode);
+	bwrite(bmbuf);
 
 	inode += (bg * EXT2_INODES_PER_GROUP(sb)) + 1;
 	gd->bg_free_inodes_count--;
@@ -167,6 +228,7 @@ void ext2_ifree(struct inode *i)
 		return;
 	}
 
+	ext2_discard_prealloc(i);
 	if(i->i_blocks) {
 		invalidate_inode_pages(i);
 		ext2_truncate(i, 0);
@@ -212,109 +274,166 @@ void ext2_ifree(struct inode *i)
 	return;
 }
 
-int ext2_balloc(struct superblock *sb)
+/* clears 'count' consecutive bits of the same block group */
+static void free_blocks(struct superblock *sb, __blk_t block, int count)
 {
-	__blk_t block;
 	struct ext2_group_desc *gd;
 	struct buffer *buf, *bmbuf;
-	int bg, d, errno;
+	int bg, bit, n, freed;
+
+	bg = (block - sb->u.ext2.sb.s_first_data_block) / EXT2_BLOCKS_PER_GROUP(sb);
+	bit = (block - sb->u.ext2.sb.s_first_data_block) % EXT2_BLOCKS_PER_GROUP(sb);
+
+	if(!(buf = read_group_desc(sb, bg, &gd))) {
+		return;
+	}
+	if(!(bmbuf = bread(sb->dev, gd->bg_block_bitmap, sb->s_blocksize))) {
+		printk("WARNING: %s(): unable to free block %d.\n", __FUNCTION__, block);
+		brelse(buf);
+		return;
+	}
+
+	for(n = freed = 0; n < count; n++) {
+		if(!test_bit(bmbuf->data, bit + n)) {
+			printk("WARNING: %s(): block %d is already marked as free!\n", __FUNCTION__, block + n);
+			continue;
+		}
+		clear_bit(bmbuf->data, bit + n);
+		freed++;
+	}
+	bwrite(bmbuf);
+
+	gd->bg_free_blocks_count += freed;
+	sb->u.ext2.sb.s_free_blocks_count += freed;
+	sb->state |= SUPERBLOCK_DIRTY;
+	bwrite(buf);
+}
+
+/*
+ * Allocates a block for the inode 'i' as close as possible to the last one
+ * allocated, starting from its own block group if it has none yet.
+ *
+ * When a block is taken from the bitmap for a regular file, up to
+ * EXT2_PREALLOC_BLOCKS - 1 free blocks that follow it are reserved too, so
+ * the next sequential allocations don't need to touch the bitmap and their
+ * blocks won't be interleaved with those of other files growing at the same
+ * time. The unused preallocated blocks are freed on close.
+ */
+int ext2_balloc(struct inode *i)
+{
+	__blk_t goal, block;
+	struct superblock *sb;
+	struct ext2_group_desc *gd;
+	struct buffer *buf, *bmbuf;
+	int bg, bit, n, nbits, prealloc;
+
+	sb = i->sb;
+	goal = i->u.ext2.i_last_alloc ? i->u.ext2.i_last_alloc + 1 : 0;
+
+	if(i->u.ext2.i_prealloc_count) {
+		if(goal == i->u.ext2.i_prealloc_block) {
+			i->u.ext2.i_prealloc_block++;
+			i->u.ext2.i_prealloc_count--;
+			i->u.ext2.i_last_alloc = goal;
+			return goal;
+		}
+		ext2_discard_prealloc(i);
+	}
 
 	superblock_lock(sb);
 
-	block = SUPERBLOCK + sb->u.ext2.sb.s_first_data_block;
-	buf = bmbuf = NULL;
-	gd = NULL;
-	errno = -ENOSPC;
+	if(goal < sb->u.ext2.sb.s_first_data_block || goal >= sb->u.ext2.sb.s_blocks_count) {
+		/* start from the block group of the inode */
+		bg = (i->inode - 1) / EXT2_INODES_PER_GROUP(sb);
+		goal = (bg * EXT2_BLOCKS_PER_GROUP(sb)) + sb->u.ext2.sb.s_first_data_block;
+	}
+	bg = (goal - sb->u.ext2.sb.s_first_data_block) / EXT2_BLOCKS_PER_GROUP(sb);
+	bit = (goal - sb->u.ext2.sb.s_first_data_block) % EXT2_BLOCKS_PER_GROUP(sb);
 
-	/* read through all group descriptors to find the first unallocated block */
-	for(bg = 0, d = 0; bg < sb->u.ext2.block_groups; bg++, d++) {
-		if(!(bg % EXT2_DESC_PER_BLOCK(sb))) {
-			if(buf) {
+	gd = NULL;
+	buf = bmbuf = NULL;
+	for(n = 0; n < sb->u.ext2.block_groups; n++, bg = (bg + 1) % sb->u.ext2.block_groups, bit = 0) {
+		if(!(buf = read_group_desc(sb, bg, &gd))) {
+			superblock_unlock(sb);
+			return -EIO;
+		}
+		if(gd->bg_free_blocks_count) {
+			if(!(bmbuf = bread(sb->dev, gd->bg_block_bitmap, sb->s_blocksize))) {
 				brelse(buf);
-				block++;
-				d = 0;
-			}
-			if(!(buf = bread(sb->dev, block, sb->s_blocksize))) {
 				superblock_unlock(sb);
 				return -EIO;
 			}
-		}
-		gd = (struct ext2_group_desc *)(buf->data + (d * sizeof(struct ext2_group_desc)));
-		if(gd->bg_free_blocks_count) {
-			if((errno = find_first_zero(sb, gd->bg_block_bitmap, &bmbuf)) != -ENOSPC) {
+			nbits = blocks_in_group(sb, bg);
+			/* search forward from the goal, then from the start */
+			if((block = find_next_zero_bit((unsigned int *)bmbuf->data, nbits, bit)) >= 0) {
+				break;
+			}
+			if(bit && (block = find_next_zero_bit((unsigned int *)bmbuf->data, nbits, 0)) >= 0) {
 				break;
 			}
 			brelse(bmbuf);
+			bmbuf = NULL;
 		}
-	}
-	if(errno < 0) {
 		brelse(buf);
+		buf = NULL;
+	}
+	if(!bmbuf) {
 		superblock_unlock(sb);
-		return errno;
+		return -ENOSPC;
 	}
 
-	block = errno;
-	errno = change_bit(SET_BIT, sb, gd->bg_block_bitmap, bmbuf, block);
-	if(errno) {
-		if(errno < 0) {
-			printk("WARNING: %s(): unable to set block %d.\n", __FUNCTION__, block);
-			brelse(buf);
-			superblock_unlock(sb);
-			return errno;
-		} else {
-			printk("WARNING: %s(): block %d is already marked as used!\n", __FUNCTION__, block);
+	set_bit(bmbuf->data, block);
+	prealloc = 0;
+	if(S_ISREG(i->i_mode)) {
+		while(prealloc < EXT2_PREALLOC_BLOCKS - 1 && prealloc + 1 < gd->bg_free_blocks_count) {
+			if(block + prealloc + 1 >= nbits || test_bit(bmbuf->data, block + prealloc + 1)) {
+				break;
+			}
+			set_bit(bmbuf->data, block + prealloc + 1);
+			prealloc++;
 		}
 	}
+	bwrite(bmbuf);
 
 	block += (bg * EXT2_BLOCKS_PER_GROUP(sb)) + sb->u.ext2.sb.s_first_data_block;
-	gd->bg_free_blocks_count--;
-	sb->u.ext2.sb.s_free_blocks_count--;
+	gd->bg_free_blocks_count -= 1 + prealloc;
+	sb->u.ext2.sb.s_free_blocks_count -= 1 + prealloc;
 	sb->state |= SUPERBLOCK_DIRTY;
 	bwrite(buf);
 
+	i->u.ext2.i_last_alloc = block;
+	i->u.ext2.i_prealloc_block = block + 1;
+	i->u.ext2.i_prealloc_count = prealloc;
+
 	superblock_unlock(sb);
 	return block;
 }
 
-void ext2_bfree(struct superblock *sb, int block)
+/* gives back the preallocated blocks that weren't used */
+void ext2_discard_prealloc(struct inode *i)
 {
-	struct ext2_group_desc *gd;
-	struct buffer *buf;
-	__blk_t b, bg;
-	int errno;
+	__blk_t block;
+	int count;
 
-	if(!block || block > sb->u.ext2.sb.s_blocks_count) {
-		printk("WARNING: %s(): invalid block %d!\n", __FUNCTION__, block);
+	if(!(count = i->u.ext2.i_prealloc_count)) {
 		return;
 	}
+	block = i->u.ext2.i_prealloc_block;
+	i->u.ext2.i_prealloc_count = 0;
 
-	superblock_lock(sb);
+	superblock_lock(i->sb);
+	free_blocks(i->sb, block, count);
+	superblock_unlock(i->sb);
+}
 
-	b = SUPERBLOCK + sb->u.ext2.sb.s_first_data_block;
-	bg = (block - sb->u.ext2.sb.s_first_data_block) / EXT2_BLOCKS_PER_GROUP(sb);
-	if(!(buf = bread(sb->dev, b + (bg / EXT2_DESC_PER_BLOCK(sb)), sb->s_blocksize))) {
-		superblock_unlock(sb);
+void ext2_bfree(struct superblock *sb, int block)
+{
+	if(!block || block > sb->u.ext2.sb.s_blocks_count) {
+		printk("WARNING: %s(): invalid block %d!\n", __FUNCTION__, block);
 		return;
 	}
-	gd = (struct ext2_group_desc *)(buf->data + ((bg % EXT2_DESC_PER_BLOCK(sb)) * sizeof(struct ext2_group_desc)));
-	errno = change_bit(CLEAR_BIT, sb, gd->bg_block_bitmap, NULL, (block - sb->u.ext2.sb.s_first_data_block) % EXT2_BLOCKS_PER_GROUP(sb));
-
-	if(errno) {
-		if(errno < 0) {
-			printk("WARNING: %s(): unable to free block %d.\n", __FUNCTION__, block);
-			brelse(buf);
-			superblock_unlock(sb);
-			return;
-		} else {
-			printk("WARNING: %s(): block %d is already marked as free!\n", __FUNCTION__, block);
-		}
-	}
-
-	gd->bg_free_blocks_count++;
-	sb->u.ext2.sb.s_free_blocks_count++;
-	sb->state |= SUPERBLOCK_DIRTY;
-	bwrite(buf);
 
+	superblock_lock(sb);
+	free_blocks(sb, block, 1);
 	superblock_unlock(sb);
-	return;
 }
@@ -0,0 +1,345 @@
+/*
+ * fiwix/fs/ext2/dindex.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * In-memory hash index of the large (non-htree) directories.
+ *
+ * The first lookup in a directory of at least DINDEX_MIN_BLOCKS blocks
+ * scans it once and records, for every name, its hash and the (physical)
+ * block where the entry lives. The next lookups only read the blocks whose
+ * hash matches. The index is kept up to date by the operations that add or
+ * remove entries, which always run with the directory locked.
+ *
+ * Only the last NR_DINDEX directories used are indexed. Every time a table
+ * is replaced or freed its generation changes, so a lookup that slept while
+ * reading a block knows that it must start again.
+ *
+ *   dindex_table           slots (open addressing)
+ *   +-------------+        +------+------+------+-- ... --+------+
+ *   | dev, inode  |------->| hash | hash | free |         | hash |
+ *   +-------------+        | blk  | blk  |      |         | blk  |
+ *   |     ...     |        +------+------+------+-- ... --+------+
+ *   +-------------+
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/fs_ext2.h>
+#include <fiwix/buffer.h>
+#include <fiwix/mm.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+#define NR_DINDEX		8	/* indexed directories */
+#define DINDEX_MIN_BLOCKS	8	/* minimum directory size to be indexed */
+#define DINDEX_MIN_SLOTS	256
+#define DINDEX_MAX_SLOTS	((PAGE_SIZE << BUDDY_HIGH_MAX_ORDER) / sizeof(struct dindex_slot))
+
+#define DINDEX_DELETED		0xFFFFFFFF	/* tombstone */
+
+struct dindex_slot {
+	__u32 hash;
+	__blk_t block;			/* 0 = free slot */
+};
+
+struct dindex {
+	__dev_t dev;
+	__ino_t inode;
+	struct dindex_slot *slots;
+	int nr_slots;			/* always a power of two */
+	int nr_used;			/* live entries + tombstones */
+	int nr_live;
+	unsigned int gen;
+	unsigned int lru;
+};
+
+static struct dindex dindex_table[NR_DINDEX];
+static unsigned int dindex_gen;
+static unsigned int dindex_clock;
+
+static __u32 dindex_hash(const char *name, int len)
+{
+	return ext2_dirhash(name, len, DX_HASH_LEGACY_UNSIGNED, NULL);
+}
+
+static struct dindex *get_dindex(struct inode *dir)
+{
+	int n;
+
+	for(n = 0; n < NR_DINDEX; n++) {
+		if(dindex_table[n].slots && dindex_table[n].dev == dir->dev && dindex_table[n].inode == dir->inode) {
+			return &dindex_table[n];
+		}
+	}
+	return NULL;
+}
+
+static void free_dindex(struct dindex *x)
+{
+	kfree((unsigned int)x->slots);
+	x->slots = NULL;
+	x->dev = x->inode = 0;
+	x->gen = ++dindex_gen;
+}
+
+static void put_slot(struct dindex *x, __u32 hash, __blk_t block)
+{
+	struct dindex_slot *s;
+	int pos, mask;
+
+	mask = x->nr_slots - 1;
+	pos = (hash >> 1) & mask;
+	for(;;) {
+		s = &x->slots[pos];
+		if(!s->block || s->block == DINDEX_DELETED) {
+			break;
+		}
+		pos = (pos + 1) & mask;
+	}
+	if(!s->block) {
+		x->nr_used++;
+	}
+	s->hash = hash;
+	s->block = block;
+	x->nr_live++;
+}
+
+/* rebuilds the table, discarding the tombstones and making room if needed */
+static int resize_dindex(struct dindex *x)
+{
+	struct dindex_slot *old;
+	int n, old_slots, nr_slots;
+
+	nr_slots = x->nr_slots ? x->nr_slots : DINDEX_MIN_SLOTS;
+	while((x->nr_live + 1) * 2 > nr_slots) {
+		nr_slots <<= 1;
+	}
+	if(nr_slots > DINDEX_MAX_SLOTS) {
+		return -ENOMEM;
+	}
+
+	old = x->slots;
+	old_slots = x->nr_slots;
+	if(!(x->slots = (struct dindex_slot *)kmalloc(nr_slots * sizeof(struct dindex_slot)))) {
+		x->slots = old;
+		return -ENOMEM;
+	}
+	memset_b(x->slots, 0, nr_slots * sizeof(struct dindex_slot));
+	x->nr_slots = nr_slots;
+	x->nr_used = x->nr_live = 0;
+	for(n = 0; n < old_slots; n++) {
+		if(old[n].block && old[n].block != DINDEX_DELETED) {
+			put_slot(x, old[n].hash, old[n].block);
+		}
+	}
+	if(old) {
+		kfree((unsigned int)old);
+	}
+	x->gen = ++dindex_gen;
+	return 0;
+}
+
+static int insert_slot(struct dindex *x, __u32 hash, __blk_t block)
+{
+	/* keep the load factor (tombstones included) below 3/4 */
+	if((x->nr_used + 1) * 4 > x->nr_slots * 3) {
+		if(resize_dindex(x)) {
+			return -ENOMEM;
+		}
+	}
+	put_slot(x, hash, block);
+	return 0;
+}
+
+/* scans the whole directory (locked) and builds a new index */
+static int build_dindex(struct inode *dir)
+{
+	struct dindex tmp, *x;
+	struct buffer *buf;
+	struct ext2_dir_entry_2 *d;
+	__blk_t block;
+	unsigned int offset, doffset, blksize;
+	int n;
+
+	blksize = dir->sb->s_blocksize;
+	memset_b(&tmp, 0, sizeof(struct dindex));
+	if(resize_dindex(&tmp)) {
+		return -ENOMEM;
+	}
+
+	for(offset = 0; offset < dir->i_size; offset += blksize) {
+		if((block = bmap(dir, offset, FOR_READING)) <= 0) {
+			kfree((unsigned int)tmp.slots);
+			return -EIO;
+		}
+		if(!(buf = bread(dir->dev, block, blksize))) {
+			kfree((unsigned int)tmp.slots);
+			return -EIO;
+		}
+		doffset = 0;
+		while(doffset < blksize) {
+			d = (struct ext2_dir_entry_2 *)(buf->data + doffset);
+			if(d->rec_len < EXT2_DIR_REC_LEN(1) || doffset + d->rec_len > blksize || EXT2_DIR_REC_LEN(d->name_len) > d->rec_len) {
+				break;
+			}
+			if(d->inode) {
+				if(insert_slot(&tmp, dindex_hash(d->name, d->name_len), block)) {
+					brelse(buf);
+					kfree((unsigned int)tmp.slots);
+					return -ENOMEM;
+				}
+			}
+			doffset += d->rec_len;
+		}
+		brelse(buf);
+	}
+
+	/* replace the free or the least recently used index */
+	x = &dindex_table[0];
+	for(n = 0; n < NR_DINDEX; n++) {
+		if(!dindex_table[n].slots) {
+			x = &dindex_table[n];
+			break;
+		}
+		if(dindex_table[n].lru < x->lru) {
+			x = &dindex_table[n];
+		}
+	}
+	if(x->slots) {
+		free_dindex(x);
+	}
+	*x = tmp;
+	x->dev = dir->dev;
+	x->inode = dir->inode;
+	x->gen = ++dindex_gen;
+	x->lru = ++dindex_clock;
+	return 0;
+}
+
+/*
+ * Returns 0 and the buffer with the entry if 'name' was found, -ENOENT if
+ * it doesn't exist, and -EINVAL if the directory is not indexed. If 'build'
+ * is set (the directory is not locked by the caller) a missing index is
+ * built first.
+ */
+int ext2_dindex_find_entry(struct inode *dir, const char *name, int len, struct buffer **buf_res, struct ext2_dir_entry_2 **d_res, int build)
+{
+	struct dindex *x;
+	struct dindex_slot *s;
+	struct buffer *buf;
+	unsigned int gen;
+	int pos, mask, probes;
+	__u32 hash;
+
+	if(dir->i_size < DINDEX_MIN_BLOCKS * dir->sb->s_blocksize) {
+		return -EINVAL;
+	}
+	hash = dindex_hash(name, len);
+
+again:
+	if(!(x = get_dindex(dir))) {
+		if(!build) {
+			return -EINVAL;
+		}
+		inode_lock(dir);
+		if(!get_dindex(dir) && build_dindex(dir)) {
+			inode_unlock(dir);
+			return -EINVAL;
+		}
+		inode_unlock(dir);
+		build = 0;
+		goto again;
+	}
+	x->lru = ++dindex_clock;
+	gen = x->gen;
+
+	mask = x->nr_slots - 1;
+	pos = (hash >> 1) & mask;
+	for(probes = 0; probes < x->nr_slots; probes++, pos = (pos + 1) & mask) {
+		s = &x->slots[pos];
+		if(!s->block) {
+			break;
+		}
+		if(s->block == DINDEX_DELETED || s->hash != hash) {
+			continue;
+		}
+		if(!(buf = bread(dir->dev, s->block, dir->sb->s_blocksize))) {
+			return -EIO;
+		}
+		if((*d_res = ext2_match_dir_entry(buf->data, dir->sb->s_blocksize, name, len))) {
+			*buf_res = buf;
+			return 0;
+		}
+		brelse(buf);
+
+		/* the table might have changed while reading the block */
+		if(x->gen != gen) {
+			goto again;
+		}
+	}
+	return -ENOENT;
+}
+
+/* the following functions are called with the directory locked */
+
+void ext2_dindex_add(struct inode *dir, const char *name, int len, __blk_t block)
+{
+	struct dindex *x;
+
+	if((x = get_dindex(dir))) {
+		if(insert_slot(x, dindex_hash(name, len), block)) {
+			free_dindex(x);
+		}
+	}
+}
+
+void ext2_dindex_del(struct inode *dir, const char *name, int len, __blk_t block)
+{
+	struct dindex *x;
+	struct dindex_slot *s;
+	int pos, mask, probes;
+	__u32 hash;
+
+	if(!(x = get_dindex(dir))) {
+		return;
+	}
+	hash = dindex_hash(name, len);
+	mask = x->nr_slots - 1;
+	pos = (hash >> 1) & mask;
+	for(probes = 0; probes < x->nr_slots; probes++, pos = (pos + 1) & mask) {
+		s = &x->slots[pos];
+		if(!s->block) {
+			break;
+		}
+		if(s->block == block && s->hash == hash) {
+			s->block = DINDEX_DELETED;
+			x->nr_live--;
+			return;
+		}
+	}
+}
+
+void ext2_dindex_drop(struct inode *dir)
+{
+	struct dindex *x;
+
+	if((x = get_dindex(dir))) {
+		free_dindex(x);
+	}
+}
+
+void ext2_dindex_flush(__dev_t dev)
+{
+	int n;
+
+	for(n = 0; n < NR_DINDEX; n++) {
+		if(dindex_table[n].slots && dindex_table[n].dev == dev) {
+			free_dindex(&dindex_table[n]);
+		}
+	}
+}
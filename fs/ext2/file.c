@@ -65,6 +65,9 @@ int ext2_file_open(struct inode *i, struct fd *f)
 {
 	f->offset = 0;
 	if(f->flags & O_TRUNC) {
+		if(IS_SWAPFILE(i)) {
+			return -ETXTBSY;
+		}
 		i->i_size = 0;
 		ext2_truncate(i, 0);
 	}
@@ -73,6 +76,7 @@ int ext2_file_open(struct inode *i, struct fd *f)
 
 int ext2_file_close(struct inode *i, struct fd *f)
 {
+	ext2_discard_prealloc(i);
 	return 0;
 }
 
@@ -91,6 +95,9 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 	__off_t offset;
 #endif /* CONFIG_OFFSET64 */
 
+	if(IS_SWAPFILE(i)) {
+		return -ETXTBSY;
+	}
 	inode_lock(i);
 
 	blksize = i->sb->s_blocksize;
@@ -110,7 +117,7 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 		memset_b(&brh, 0, sizeof(struct blk_request));
 		tmp = NULL;
 		while(total_written < count) {
-			if(!(br = (struct blk_request *)kmalloc(sizeof(struct blk_request)))) {
+			if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
 				printk("WARNING: %s(): no more free memory for block requests.\n", __FUNCTION__);
 				retval = -ENOMEM;
 				break;
@@ -151,7 +158,7 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 				bytes = MIN(bytes, (count - total_written));
 				memcpy_b(br->buffer->data + boffset, buffer + total_written, bytes);
 				update_page_cache(i, offset, buffer + total_written, bytes);
-				bwrite(br->buffer);
+				bwrite_inode(br->buffer, i);
 				total_written += bytes;
 				offset += bytes;
 			} else {
@@ -160,7 +167,7 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 				}
 			}
 			tmp = br->next_group;
-			kfree((unsigned int)br);
+			kmem_cache_free(blk_request_cache, br);
 			br = tmp;
 		}
 	} else {
@@ -178,7 +185,7 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 			}
 			memcpy_b(buf->data + boffset, buffer + total_written, bytes);
 			update_page_cache(i, offset, buffer + total_written, bytes);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			total_written += bytes;
 			offset += bytes;
 		}
@@ -188,6 +195,7 @@ int ext2_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 		f->offset = offset;
 		if(f->offset > i->i_size) {
 			i->i_size = f->offset;
+			i->state |= INODE_DATASYNC;
 		}
 		i->i_ctime = CURRENT_TIME;
 		i->i_mtime = CURRENT_TIME;
@@ -0,0 +1,378 @@
+/*
+ * fiwix/fs/ext2/htree.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * Read support for the hash-indexed (htree) directories created by Linux
+ * on filesystems with the 'dir_index' feature.
+ *
+ * The hash of a name selects a single leaf block through one or two levels
+ * of sorted index blocks, so the entry is found without reading the rest of
+ * the directory. The names whose hash collides might continue in the next
+ * leaf, which is marked by setting the lowest bit of its hash.
+ *
+ *   block 0 (root)          index blocks            leaf blocks
+ *   +------------------+    +------------------+    +------------------+
+ *   | . | .. | dx_root |--->| (fake) | entries |--->| directory entries|
+ *   +------------------+    +------------------+    +------------------+
+ */
+
+#include <fiwix/kernel.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/fs_ext2.h>
+#include <fiwix/buffer.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+#define DX_MAX_LEVELS	2
+#define DX_BLOCK_MASK	0x00FFFFFF
+
+#define TEA_DELTA	0x9E3779B9
+
+#define ROL32(x, s)	(((x) << (s)) | ((x) >> (32 - (s))))
+
+#define F(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z)	(((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+
+#define ROUND(f, a, b, c, d, x, s) \
+	(a += f(b, c, d) + (x), a = ROL32(a, s))
+
+#define K1	0
+#define K2	013240474631UL
+#define K3	015666365641UL
+
+struct dx_frame {
+	struct buffer *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;
+	int count;
+};
+
+static void half_md4_transform(__u32 *buf, __u32 *in)
+{
+	__u32 a, b, c, d;
+
+	a = buf[0];
+	b = buf[1];
+	c = buf[2];
+	d = buf[3];
+
+	/* round 1 */
+	ROUND(F, a, b, c, d, in[0] + K1,  3);
+	ROUND(F, d, a, b, c, in[1] + K1,  7);
+	ROUND(F, c, d, a, b, in[2] + K1, 11);
+	ROUND(F, b, c, d, a, in[3] + K1, 19);
+	ROUND(F, a, b, c, d, in[4] + K1,  3);
+	ROUND(F, d, a, b, c, in[5] + K1,  7);
+	ROUND(F, c, d, a, b, in[6] + K1, 11);
+	ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* round 2 */
+	ROUND(G, a, b, c, d, in[1] + K2,  3);
+	ROUND(G, d, a, b, c, in[3] + K2,  5);
+	ROUND(G, c, d, a, b, in[5] + K2,  9);
+	ROUND(G, b, c, d, a, in[7] + K2, 13);
+	ROUND(G, a, b, c, d, in[0] + K2,  3);
+	ROUND(G, d, a, b, c, in[2] + K2,  5);
+	ROUND(G, c, d, a, b, in[4] + K2,  9);
+	ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* round 3 */
+	ROUND(H, a, b, c, d, in[3] + K3,  3);
+	ROUND(H, d, a, b, c, in[7] + K3,  9);
+	ROUND(H, c, d, a, b, in[2] + K3, 11);
+	ROUND(H, b, c, d, a, in[6] + K3, 15);
+	ROUND(H, a, b, c, d, in[1] + K3,  3);
+	ROUND(H, d, a, b, c, in[5] + K3,  9);
+	ROUND(H, c, d, a, b, in[0] + K3, 11);
+	ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+static void tea_transform(__u32 *buf, __u32 *in)
+{
+	__u32 sum, b0, b1;
+	int n;
+
+	sum = 0;
+	b0 = buf[0];
+	b1 = buf[1];
+	for(n = 0; n < 16; n++) {
+		sum += TEA_DELTA;
+		b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+		b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+	}
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+static __u32 dx_hack_hash(const char *name, int len, int is_unsigned)
+{
+	__u32 hash, hash0, hash1;
+	int c;
+
+	hash0 = 0x12A3FE2D;
+	hash1 = 0x37ABE8F9;
+	while(len--) {
+		c = is_unsigned ? (unsigned char)*name : (signed char)*name;
+		name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+		if(hash & 0x80000000) {
+			hash -= 0x7FFFFFFF;
+		}
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+/* packs the name into 'num' words padded with its length */
+static void str2hashbuf(const char *name, int len, __u32 *buf, int num, int is_unsigned)
+{
+	__u32 pad, val;
+	int n, c;
+
+	pad = (__u32)len | ((__u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if(len > num * 4) {
+		len = num * 4;
+	}
+	for(n = 0; n < len; n++) {
+		c = is_unsigned ? (unsigned char)name[n] : (signed char)name[n];
+		val = c + (val << 8);
+		if((n % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if(--num >= 0) {
+		*buf++ = val;
+	}
+	while(--num >= 0) {
+		*buf++ = pad;
+	}
+}
+
+/* computes the same hash of a name as the Linux ext2/ext3 dir_index code */
+__u32 ext2_dirhash(const char *name, int len, int version, __u32 *seed)
+{
+	__u32 buf[4], in[8], hash;
+	int n, is_unsigned;
+
+	buf[0] = 0x67452301;
+	buf[1] = 0xEFCDAB89;
+	buf[2] = 0x98BADCFE;
+	buf[3] = 0x10325476;
+	if(seed) {
+		for(n = 0; n < 4; n++) {
+			if(seed[n]) {
+				memcpy_b(buf, seed, sizeof(buf));
+				break;
+			}
+		}
+	}
+
+	is_unsigned = version >= DX_HASH_LEGACY_UNSIGNED;
+	switch(version) {
+		case DX_HASH_HALF_MD4:
+		case DX_HASH_HALF_MD4_UNSIGNED:
+			for(; len > 0; len -= 32, name += 32) {
+				str2hashbuf(name, len, in, 8, is_unsigned);
+				half_md4_transform(buf, in);
+			}
+			hash = buf[1];
+			break;
+		case DX_HASH_TEA:
+		case DX_HASH_TEA_UNSIGNED:
+			for(; len > 0; len -= 16, name += 16) {
+				str2hashbuf(name, len, in, 4, is_unsigned);
+				tea_transform(buf, in);
+			}
+			hash = buf[0];
+			break;
+		default:
+			hash = dx_hack_hash(name, len, is_unsigned);
+			break;
+	}
+
+	/* the lowest bit is reserved to mark the collisions */
+	hash &= ~1;
+	if(hash == 0xFFFFFFFE) {
+		hash = 0xFFFFFFFC;
+	}
+	return hash;
+}
+
+static struct buffer *read_dir_block(struct inode *dir, __blk_t lblock)
+{
+	__blk_t block;
+	__off_t offset;
+
+	offset = lblock << EXT2_BLOCK_SIZE_BITS(dir->sb);
+	if(offset >= dir->i_size) {
+		return NULL;
+	}
+	if((block = bmap(dir, offset, FOR_READING)) <= 0) {
+		return NULL;
+	}
+	return bread(dir->dev, block, dir->sb->s_blocksize);
+}
+
+static int load_frame(struct dx_frame *frame, struct buffer *buf, int offset, int blksize)
+{
+	struct dx_countlimit *cl;
+
+	cl = (struct dx_countlimit *)(buf->data + offset);
+	if(!cl->count || cl->count > cl->limit || offset + cl->limit * sizeof(struct dx_entry) > blksize) {
+		return 1;
+	}
+	frame->buf = buf;
+	frame->entries = (struct dx_entry *)(buf->data + offset);
+	frame->at = frame->entries;
+	frame->count = cl->count;
+	return 0;
+}
+
+/* selects the entry that covers 'hash' (the first entry has no hash) */
+static void search_frame(struct dx_frame *frame, __u32 hash)
+{
+	struct dx_entry *p, *q, *m;
+
+	p = frame->entries + 1;
+	q = frame->entries + frame->count - 1;
+	while(p <= q) {
+		m = p + (q - p) / 2;
+		if(m->hash > hash) {
+			q = m - 1;
+		} else {
+			p = m + 1;
+		}
+	}
+	frame->at = p - 1;
+}
+
+static void release_frames(struct dx_frame *frames, int nframes)
+{
+	while(nframes--) {
+		brelse(frames[nframes].buf);
+	}
+}
+
+/*
+ * Advances to the next leaf if it might contain the continuation of 'hash'.
+ * Returns 1 if there is a next leaf, 0 if not and -1 if the tree is broken.
+ */
+static int next_leaf(struct inode *dir, struct dx_frame *frames, int nframes, __u32 hash)
+{
+	struct buffer *buf;
+	int n;
+
+	n = nframes - 1;
+	while(++frames[n].at >= frames[n].entries + frames[n].count) {
+		if(!n) {
+			return 0;
+		}
+		n--;
+	}
+	if((frames[n].at->hash & ~1) != hash) {
+		return 0;
+	}
+
+	/* reload the index blocks below the one that has advanced */
+	while(++n < nframes) {
+		if(!(buf = read_dir_block(dir, frames[n - 1].at->block & DX_BLOCK_MASK))) {
+			return -1;
+		}
+		brelse(frames[n].buf);
+		if(load_frame(&frames[n], buf, DX_NODE_OFFSET, dir->sb->s_blocksize)) {
+			frames[n].buf = buf;
+			return -1;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Returns 0 and the buffer with the entry if 'name' was found, -ENOENT if
+ * it doesn't exist, and -EINVAL if the index can't be used (the directory
+ * must be scanned linearly).
+ */
+int ext2_dx_find_entry(struct inode *dir, const char *name, int len, struct buffer **buf_res, struct ext2_dir_entry_2 **d_res)
+{
+	struct dx_frame frames[DX_MAX_LEVELS];
+	struct dx_root_info *info;
+	struct buffer *buf;
+	int nframes, levels, version, blksize, errno;
+	__u32 hash;
+
+	blksize = dir->sb->s_blocksize;
+	if(!(buf = read_dir_block(dir, 0))) {
+		return -EINVAL;
+	}
+	info = (struct dx_root_info *)(buf->data + DX_ROOT_INFO_OFFSET);
+	if(info->reserved_zero || info->hash_version > DX_HASH_TEA || info->info_length < sizeof(struct dx_root_info) || info->indirect_levels >= DX_MAX_LEVELS) {
+		brelse(buf);
+		return -EINVAL;
+	}
+	version = info->hash_version;
+	if(dir->sb->u.ext2.sb.s_flags & EXT2_FLAGS_UNSIGNED_HASH) {
+		version += DX_HASH_LEGACY_UNSIGNED;
+	}
+	hash = ext2_dirhash(name, len, version, dir->sb->u.ext2.sb.s_hash_seed);
+	levels = info->indirect_levels;
+
+	/* walk down the index blocks */
+	nframes = 0;
+	if(load_frame(&frames[0], buf, DX_ROOT_INFO_OFFSET + info->info_length, blksize)) {
+		brelse(buf);
+		return -EINVAL;
+	}
+	for(;;) {
+		search_frame(&frames[nframes], hash);
+		nframes++;
+		if(nframes > levels) {
+			break;
+		}
+		if(!(buf = read_dir_block(dir, frames[nframes - 1].at->block & DX_BLOCK_MASK))) {
+			release_frames(frames, nframes);
+			return -EINVAL;
+		}
+		if(load_frame(&frames[nframes], buf, DX_NODE_OFFSET, blksize)) {
+			brelse(buf);
+			release_frames(frames, nframes);
+			return -EINVAL;
+		}
+	}
+
+	/* search the leaf and the ones with the continuation of the hash */
+	for(;;) {
+		if(!(buf = read_dir_block(dir, frames[nframes - 1].at->block & DX_BLOCK_MASK))) {
+			errno = -EINVAL;
+			break;
+		}
+		if((*d_res = ext2_match_dir_entry(buf->data, blksize, name, len))) {
+			*buf_res = buf;
+			errno = 0;
+			break;
+		}
+		brelse(buf);
+		if((errno = next_leaf(dir, frames, nframes, hash)) <= 0) {
+			errno = errno ? -EINVAL : -ENOENT;
+			break;
+		}
+	}
+	release_frames(frames, nframes);
+	return errno;
+}
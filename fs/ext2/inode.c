@@ -26,7 +26,7 @@
 #define BLOCKS_PER_DIND_BLOCK(sb)	(BLOCKS_PER_IND_BLOCK(sb) * BLOCKS_PER_IND_BLOCK(sb))
 #define BLOCKS_PER_TIND_BLOCK(sb)	(BLOCKS_PER_IND_BLOCK(sb) * BLOCKS_PER_IND_BLOCK(sb) * BLOCKS_PER_IND_BLOCK(sb))
 
-#define EXT2_INODES_PER_BLOCK(sb)	(EXT2_BLOCK_SIZE(sb) / sizeof(struct ext2_inode))
+#define EXT2_INODES_PER_BLOCK(sb)	(EXT2_BLOCK_SIZE(sb) / EXT2_INODE_SIZE(sb))
 
 static int free_dblock(struct inode *i, int block, int offset)
 {
@@ -46,7 +46,7 @@ static int free_dblock(struct inode *i, int block, int offset)
 			i->i_blocks -= i->sb->s_blocksize / 512;
 		}
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -76,7 +76,7 @@ static int free_indblock(struct inode *i, int block, int offset)
 		}
 		dblock = 0;
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -118,7 +118,7 @@ int ext2_read_inode(struct inode *i)
 	if(!(buf = bread(i->dev, gd.bg_inode_table + block, i->sb->s_blocksize))) {
 		return -EIO;
 	}
-	offset = ((((i->inode - 1) % EXT2_INODES_PER_GROUP(sb)) % EXT2_INODES_PER_BLOCK(sb)) * sizeof(struct ext2_inode));
+	offset = ((((i->inode - 1) % EXT2_INODES_PER_GROUP(sb)) % EXT2_INODES_PER_BLOCK(sb)) * EXT2_INODE_SIZE(sb));
 
 	ii = (struct ext2_inode *)(buf->data + offset);
 	memcpy_b(&i->u.ext2.i_data, ii->i_block, sizeof(ii->i_block));
@@ -188,6 +188,9 @@ int ext2_write_inode(struct inode *i)
 		printk("WARNING: %s(): get_superblock() has returned NULL.\n");
 		return -EINVAL;
 	}
+	if(!i->count) {
+		ext2_discard_prealloc(i);
+	}
 	block_group = ((i->inode - 1) / EXT2_INODES_PER_GROUP(sb));
 	if(get_group_desc(sb, block_group, &gd)) {
 		return -EIO;
@@ -197,7 +200,7 @@ int ext2_write_inode(struct inode *i)
 	if(!(buf = bread(i->dev, gd.bg_inode_table + block, i->sb->s_blocksize))) {
 		return -EIO;
 	}
-	offset = ((((i->inode - 1) % EXT2_INODES_PER_GROUP(sb)) % EXT2_INODES_PER_BLOCK(sb)) * sizeof(struct ext2_inode));
+	offset = ((((i->inode - 1) % EXT2_INODES_PER_GROUP(sb)) % EXT2_INODES_PER_BLOCK(sb)) * EXT2_INODE_SIZE(sb));
 	ii = (struct ext2_inode *)(buf->data + offset);
 	memset_b(ii, 0, sizeof(struct ext2_inode));
 
@@ -220,11 +223,66 @@ int ext2_write_inode(struct inode *i)
 		memcpy_b(ii->i_block, &i->u.ext2.i_data, sizeof(i->u.ext2.i_data));
 	}
 	i->state &= ~INODE_DIRTY;
-	bwrite(buf);
+	/* the last iput() must come back here to discard the preallocation */
+	if(i->u.ext2.i_prealloc_count) {
+		i->state |= INODE_DIRTY;
+	}
+	bwrite_inode(buf, i);
 	return 0;
 }
 
-int ext2_bmap(struct inode *i, __off_t offset, int mode)
+/* counts how many of the pointers that follow 'n' are physically contiguous */
+static int contiguous_run(__blk_t *table, int n, int entries)
+{
+	int run;
+
+	for(run = 1; n + run < entries; run++) {
+		if(table[n + run] != table[n] + run) {
+			break;
+		}
+	}
+	return run;
+}
+
+static __blk_t search_extent(struct inode *i, __blk_t lblock)
+{
+	struct ext2_extent *e;
+	int n;
+
+	for(n = 0; n < EXT2_NR_EXTENTS; n++) {
+		e = &i->u.ext2.i_ext[n];
+		if(e->len && lblock >= e->lblock && lblock < e->lblock + e->len) {
+			return e->pblock + (lblock - e->lblock);
+		}
+	}
+	return 0;
+}
+
+static void add_extent(struct inode *i, __blk_t lblock, __blk_t pblock, int len)
+{
+	struct ext2_extent *e;
+
+	e = &i->u.ext2.i_ext[i->u.ext2.i_ext_next];
+	e->lblock = lblock;
+	e->pblock = pblock;
+	e->len = len;
+	i->u.ext2.i_ext_next = (i->u.ext2.i_ext_next + 1) % EXT2_NR_EXTENTS;
+}
+
+/* must be called every time that blocks are removed from the inode */
+static void invalidate_extents(struct inode *i)
+{
+	memset_b(i->u.ext2.i_ext, 0, sizeof(i->u.ext2.i_ext));
+	i->u.ext2.i_ext_next = 0;
+	i->u.ext2.i_ext_gen++;
+}
+
+/*
+ * Walks the block pointers of the inode to map the block at 'offset' and
+ * returns in 'run' the number of blocks, starting from this one, that are
+ * contiguous on the disk according to the same table of pointers.
+ */
+static int map_block(struct inode *i, __off_t offset, int mode, int *run)
 {
 	unsigned char level;
 	__blk_t *indblock, *dindblock, *tindblock;
@@ -236,6 +294,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 	block = offset >> EXT2_BLOCK_SIZE_BITS(i->sb);
 	level = 0;
 	buf3 = NULL;	/* makes GCC happy */
+	*run = 1;
 
 	if(block < EXT2_NDIR_BLOCKS) {
 		level = EXT2_NDIR_BLOCKS - 1;
@@ -252,7 +311,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 
 	if(level < EXT2_NDIR_BLOCKS) {
 		if(!i->u.ext2.i_data[block] && mode == FOR_WRITING) {
-			if((newblock = ext2_balloc(i->sb)) < 0) {
+			if((newblock = ext2_balloc(i)) < 0) {
 				return -ENOSPC;
 			}
 			/* initialize the new block */
@@ -261,16 +320,20 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.ext2.i_data[block] = newblock;
+			i->state |= INODE_DATASYNC;
 			i->i_blocks += blksize / 512;
 		}
+		if(i->u.ext2.i_data[block]) {
+			*run = contiguous_run((__blk_t *)i->u.ext2.i_data, block, EXT2_NDIR_BLOCKS);
+		}
 		return i->u.ext2.i_data[block];
 	}
 
 	if(!i->u.ext2.i_data[level]) {
 		if(mode == FOR_WRITING) {
-			if((newblock = ext2_balloc(i->sb)) < 0) {
+			if((newblock = ext2_balloc(i)) < 0) {
 				return -ENOSPC;
 			}
 			/* initialize the new block */
@@ -279,8 +342,9 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.ext2.i_data[level] = newblock;
+			i->state |= INODE_DATASYNC;
 			i->i_blocks += blksize / 512;
 		} else {
 			return 0;
@@ -302,7 +366,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 
 	if(!indblock[block]) {
 		if(mode == FOR_WRITING) {
-			if((newblock = ext2_balloc(i->sb)) < 0) {
+			if((newblock = ext2_balloc(i)) < 0) {
 				brelse(buf);
 				return -ENOSPC;
 			}
@@ -313,14 +377,15 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf2->data, 0, blksize);
-			bwrite(buf2);
+			bwrite_inode(buf2, i);
 			indblock[block] = newblock;
+			i->state |= INODE_DATASYNC;
 			i->i_blocks += blksize / 512;
 			if(level == EXT2_IND_BLOCK) {
-				bwrite(buf);
+				bwrite_inode(buf, i);
 				return newblock;
 			}
-			buf->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+			mark_buffer_dirty(buf, i);
 		} else {
 			brelse(buf);
 			return 0;
@@ -328,6 +393,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 	}
 	if(level == EXT2_IND_BLOCK) {
 		newblock = indblock[block];
+		*run = contiguous_run(indblock, block, BLOCKS_PER_IND_BLOCK(i->sb));
 		brelse(buf);
 		return newblock;
 	}
@@ -343,7 +409,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 		block = tindblock[tblock / BLOCKS_PER_IND_BLOCK(i->sb)];
 		if(!block) {
 			if(mode == FOR_WRITING) {
-				if((newblock = ext2_balloc(i->sb)) < 0) {
+				if((newblock = ext2_balloc(i)) < 0) {
 					brelse(buf);
 					brelse(buf3);
 					return -ENOSPC;
@@ -356,10 +422,11 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 					return -EIO;
 				}
 				memset_b(buf4->data, 0, blksize);
-				bwrite(buf4);
+				bwrite_inode(buf4, i);
 				tindblock[tblock / BLOCKS_PER_IND_BLOCK(i->sb)] = newblock;
+				i->state |= INODE_DATASYNC;
 				i->i_blocks += blksize / 512;
-				buf3->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+				mark_buffer_dirty(buf3, i);
 				block = newblock;
 			} else {
 				brelse(buf);
@@ -387,7 +454,7 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 	dindblock = (__blk_t *)buf2->data;
 	block = dindblock[dblock - (iblock * BLOCKS_PER_IND_BLOCK(i->sb))];
 	if(!block && mode == FOR_WRITING) {
-		if((newblock = ext2_balloc(i->sb)) < 0) {
+		if((newblock = ext2_balloc(i)) < 0) {
 			brelse(buf);
 			if(level == EXT2_TIND_BLOCK) {
 				brelse(buf3);
@@ -406,11 +473,14 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 			return -EIO;
 		}
 		memset_b(buf4->data, 0, blksize);
-		bwrite(buf4);
+		bwrite_inode(buf4, i);
 		dindblock[dblock - (iblock * BLOCKS_PER_IND_BLOCK(i->sb))] = newblock;
+		i->state |= INODE_DATASYNC;
 		i->i_blocks += blksize / 512;
-		buf2->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+		mark_buffer_dirty(buf2, i);
 		block = newblock;
+	} else if(block) {
+		*run = contiguous_run(dindblock, dblock - (iblock * BLOCKS_PER_IND_BLOCK(i->sb)), BLOCKS_PER_IND_BLOCK(i->sb));
 	}
 	brelse(buf);
 	if(level == EXT2_TIND_BLOCK) {
@@ -420,6 +490,32 @@ int ext2_bmap(struct inode *i, __off_t offset, int mode)
 	return block;
 }
 
+/*
+ * The mappings found are kept as a few extents in the inode, so reading a
+ * file sequentially doesn't need to walk the indirect blocks again for
+ * every block of a contiguous run.
+ */
+int ext2_bmap(struct inode *i, __off_t offset, int mode)
+{
+	__blk_t lblock, block;
+	unsigned int gen;
+	int run;
+
+	lblock = offset >> EXT2_BLOCK_SIZE_BITS(i->sb);
+	if((block = search_extent(i, lblock))) {
+		return block;
+	}
+
+	gen = i->u.ext2.i_ext_gen;
+	block = map_block(i, offset, mode, &run);
+
+	/* the inode might have been truncated while reading its blocks */
+	if(block > 0 && mode == FOR_READING && gen == i->u.ext2.i_ext_gen) {
+		add_extent(i, lblock, block, run);
+	}
+	return block;
+}
+
 int ext2_truncate(struct inode *i, __off_t length)
 {
 	__blk_t block, indblock, *dindblock;
@@ -432,6 +528,12 @@ int ext2_truncate(struct inode *i, __off_t length)
 	if(!S_ISDIR(i->i_mode) && !S_ISREG(i->i_mode) && !S_ISLNK(i->i_mode)) {
 		return -EINVAL;
 	}
+	if(IS_SWAPFILE(i)) {
+		return -ETXTBSY;
+	}
+	truncate_inode_pages(i, length);
+	ext2_discard_prealloc(i);
+	invalidate_extents(i);
 
 	if(block < EXT2_NDIR_BLOCKS) {
 		for(n = block; n < EXT2_NDIR_BLOCKS; n++) {
@@ -506,7 +608,7 @@ int ext2_truncate(struct inode *i, __off_t length)
 				}
 				indblock = 0;
 			}
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			if(!block) {
 				ext2_bfree(i->sb, i->u.ext2.i_data[EXT2_TIND_BLOCK]);
 				i->u.ext2.i_data[EXT2_TIND_BLOCK] = 0;
@@ -515,10 +617,13 @@ int ext2_truncate(struct inode *i, __off_t length)
 		}
 	}
 
+	/* in case a reader has cached a mapping in the meantime */
+	invalidate_extents(i);
+
 	i->i_mtime = CURRENT_TIME;
 	i->i_ctime = CURRENT_TIME;
 	i->i_size = length;
-	i->state |= INODE_DIRTY;
+	i->state |= INODE_DIRTY | INODE_DATASYNC;
 
 	return 0;
 }
@@ -82,6 +82,71 @@ static struct buffer *find_first_free_dir_entry(struct inode *dir, struct ext2_d
 	return NULL;
 }
 
+/* returns the entry of 'name' if it's found in the block */
+struct ext2_dir_entry_2 *ext2_match_dir_entry(char *data, int blksize, const char *name, int len)
+{
+	struct ext2_dir_entry_2 *d;
+	int doffset;
+
+	doffset = 0;
+	while(doffset < blksize) {
+		d = (struct ext2_dir_entry_2 *)(data + doffset);
+		/* check dir entry */
+		if(d->rec_len < EXT2_DIR_REC_LEN(1) || doffset + d->rec_len > blksize || EXT2_DIR_REC_LEN(d->name_len) > d->rec_len) {
+			break;
+		}
+		if(d->inode && d->name_len == len) {
+			if(!strncmp(d->name, name, len)) {
+				return d;
+			}
+		}
+		doffset += d->rec_len;
+	}
+	return NULL;
+}
+
+/*
+ * Searches 'name' in 'dir' using its htree index or its in-memory index, and
+ * falls back to a linear scan of all its blocks if the directory is not
+ * indexed.
+ */
+static int search_dir(struct inode *dir, const char *name, int len, struct buffer **buf_res, struct ext2_dir_entry_2 **d_res, int build)
+{
+	__blk_t block;
+	unsigned int blksize;
+	unsigned int offset;
+	struct buffer *buf;
+	int errno;
+
+	if((dir->i_flags & EXT2_INDEX_FL) && EXT2_HAS_COMPAT_FEATURE(dir->sb, EXT2_FEATURE_COMPAT_DIR_INDEX)) {
+		if((errno = ext2_dx_find_entry(dir, name, len, buf_res, d_res)) != -EINVAL) {
+			return errno;
+		}
+	}
+	if((errno = ext2_dindex_find_entry(dir, name, len, buf_res, d_res, build)) != -EINVAL) {
+		return errno;
+	}
+
+	blksize = dir->sb->s_blocksize;
+	for(offset = 0; offset < dir->i_size; offset += blksize) {
+		if((block = bmap(dir, offset, FOR_READING)) < 0) {
+			return block;
+		}
+		if(!block) {
+			break;
+		}
+		if(!(buf = bread(dir->dev, block, blksize))) {
+			return -EIO;
+		}
+		if((*d_res = ext2_match_dir_entry(buf->data, blksize, name, len))) {
+			*buf_res = buf;
+			return 0;
+		}
+		brelse(buf);
+	}
+	return -ENOENT;
+}
+
 /* finds an entry in 'dir' based on the 'name' and/or on the inode 'i' */
 static struct buffer *find_dir_entry(struct inode *dir, struct inode *i, struct ext2_dir_entry_2 **d_res, char *name)
 {
@@ -89,19 +154,24 @@ static struct buffer *find_dir_entry(struct inode *dir, struct inode *i, struct
 	unsigned int blksize;
 	unsigned int offset, doffset;
 	struct buffer *buf;
-	int basesize, nlen;
 
-	basesize = sizeof((*d_res)->inode) + sizeof((*d_res)->rec_len) + sizeof((*d_res)->name_len) + sizeof((*d_res)->file_type);
+	if(name) {
+		/* the names are unique, so the inode only needs to match */
+		if(search_dir(dir, name, strlen(name), &buf, d_res, 0)) {
+			*d_res = NULL;
+			return NULL;
+		}
+		if(i && (*d_res)->inode != i->inode) {
+			brelse(buf);
+			*d_res = NULL;
+			return NULL;
+		}
+		return buf;
+	}
+
 	blksize = dir->sb->s_blocksize;
 	offset = 0;
 
-	/*
-	 * nlen is the length of the new entry to be used when searching for
-	 * the first usable entry.
-	 */
-	nlen = basesize + strlen(name) + 3;
-	nlen &= ~3;
-
 	while(offset < dir->i_size) {
 		if((block = bmap(dir, offset, FOR_READING)) < 0) {
 			break;
@@ -113,28 +183,12 @@ static struct buffer *find_dir_entry(struct inode *dir, struct inode *i, struct
 			doffset = 0;
 			do {
 				*d_res = (struct ext2_dir_entry_2 *)(buf->data + doffset);
-				if(!i) {
-					if((*d_res)->inode) {
-						/* returns the first matching name */
-						if((*d_res)->name_len == strlen(name)) {
-							if(!strncmp((*d_res)->name, name, (*d_res)->name_len)) {
-								return buf;
-							}
-						}
-					}
-				} else {
-					if((*d_res)->inode == i->inode) {
-						/* returns the first matching inode */
-						if(!name) {
-							return buf;
-						}
-						/* returns the matching inode and name */
-						if((*d_res)->name_len == strlen(name)) {
-							if(!strncmp((*d_res)->name, name, (*d_res)->name_len)) {
-								return buf;
-							}
-						}
-					}
+				if((*d_res)->rec_len < EXT2_DIR_REC_LEN(1)) {
+					break;
+				}
+				/* returns the first matching inode */
+				if((*d_res)->inode == i->inode) {
+					return buf;
 				}
 				doffset += (*d_res)->rec_len;
 			} while(doffset < blksize);
@@ -166,6 +220,12 @@ static struct buffer *add_dir_entry(struct inode *dir, struct ext2_dir_entry_2 *
 		(*d_res)->rec_len = dir->sb->s_blocksize;
 	}
 
+	/* the htree index (if any) is not maintained on writes */
+	if(dir->i_flags & EXT2_INDEX_FL) {
+		dir->i_flags &= ~EXT2_INDEX_FL;
+		dir->state |= INODE_DIRTY;
+	}
+	ext2_dindex_add(dir, name, strlen(name), buf->block);
 	return buf;
 }
 
@@ -242,68 +302,33 @@ static int is_subdir(struct inode *dir_new, struct inode *i_old)
 
 int ext2_lookup(const char *name, struct inode *dir, struct inode **i_res)
 {
-	__blk_t block;
-	unsigned int blksize;
-	unsigned int offset, doffset;
 	struct buffer *buf;
 	struct ext2_dir_entry_2 *d;
 	__ino_t inode;
+	int errno;
 
-	blksize = dir->sb->s_blocksize;
-	inode = offset = 0;
-
-	while(offset < dir->i_size && !inode) {
-		if((block = bmap(dir, offset, FOR_READING)) < 0) {
-			return block;
-		}
-		if(block) {
-			if(!(buf = bread(dir->dev, block, blksize))) {
-				iput(dir);
-				return -EIO;
-			}
-			doffset = 0;
-			do {
-				d = (struct ext2_dir_entry_2 *)(buf->data + doffset);
-				/* check dir entry */
-				if(d->rec_len < EXT2_DIR_REC_LEN(1)) {
-					break;
-				}
-				if(d->inode) {
-					if(d->name_len == strlen(name)) {
-						if(strncmp(d->name, name, d->name_len) == 0) {
-							inode = d->inode;
-						}
-					}
-				}
-				doffset += d->rec_len;
-			} while((doffset < blksize) && (!inode));
+	if((errno = search_dir(dir, name, strlen(name), &buf, &d, 1))) {
+		iput(dir);
+		return errno;
+	}
+	inode = d->inode;
+	brelse(buf);
 
-			brelse(buf);
-			offset += blksize;
-			if(inode) {
-				/*
-				 * This prevents a deadlock in iget() when
-				 * trying to lock '.' when 'dir' is the same
-				 * directory (ls -lai <dir>).
-				 */
-				if(inode == dir->inode) {
-					*i_res = dir;
-					return 0;
-				}
+	/*
+	 * This prevents a deadlock in iget() when trying to lock '.' when
+	 * 'dir' is the same directory (ls -lai <dir>).
+	 */
+	if(inode == dir->inode) {
+		*i_res = dir;
+		return 0;
+	}
 
-				if(!(*i_res = iget(dir->sb, inode))) {
-					iput(dir);
-					return -EACCES;
-				}
-				iput(dir);
-				return 0;
-			}
-		} else {
-			break;
-		}
+	if(!(*i_res = iget(dir->sb, inode))) {
+		iput(dir);
+		return -EACCES;
 	}
 	iput(dir);
-	return -ENOENT;
+	return 0;
 }
 
 int ext2_rmdir(struct inode *dir, struct inode *i)
@@ -326,6 +351,8 @@ int ext2_rmdir(struct inode *dir, struct inode *i)
 		return -ENOENT;
 	}
 
+	ext2_dindex_del(dir, d->name, d->name_len, buf->block);
+	ext2_dindex_drop(i);
 	d->inode = 0;
 	i->i_nlink = 0;
 	dir->i_nlink--;
@@ -407,6 +434,7 @@ int ext2_unlink(struct inode *dir, struct inode *i, char *name)
 	 * directories plenty of blank entries, it would be interesting
 	 * to merge every removed entry with the previous entry.
 	 */
+	ext2_dindex_del(dir, d->name, d->name_len, buf->block);
 	d->inode = 0;
 	if(!--i->i_nlink) {
 		i->u.ext2.i_dtime = CURRENT_TIME;
@@ -444,7 +472,7 @@ int ext2_symlink(struct inode *dir, char *name, char *oldname)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFLNK))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFLNK))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -464,7 +492,7 @@ int ext2_symlink(struct inode *dir, char *name, char *oldname)
 
 	if(strlen(oldname) >= EXT2_N_BLOCKS * sizeof(__u32)) {
 		/* this will be a slow symlink */
-		if((block = ext2_balloc(dir->sb)) < 0) {
+		if((block = ext2_balloc(i)) < 0) {
 			iput(i);
 			brelse(buf);
 			inode_unlock(dir);
@@ -544,7 +572,7 @@ int ext2_mkdir(struct inode *dir, char *name, __mode_t mode)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFDIR))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFDIR))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -642,7 +670,7 @@ int ext2_mknod(struct inode *dir, char *name, __mode_t mode, __dev_t dev)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, mode & S_IFMT))) {
+	if(!(i = ialloc(dir->sb, dir, mode & S_IFMT))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -737,7 +765,7 @@ int ext2_create(struct inode *dir, char *name, int flags, __mode_t mode, struct
 		}
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFREG))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFREG))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -844,6 +872,9 @@ int ext2_rename(struct inode *i_old, struct inode *dir_old, struct inode *i_new,
 		}
 	}
 	if(i_new) {
+		if(S_ISDIR(i_new->i_mode)) {
+			ext2_dindex_drop(i_new);
+		}
 		i_new->i_nlink--;
 	} else {
 		i_new = i_old;
@@ -876,6 +907,7 @@ int ext2_rename(struct inode *i_old, struct inode *dir_old, struct inode *i_new,
 			goto end;
 		}
 	}
+	ext2_dindex_del(dir_old, d_old->name, d_old->name_len, buf_old->block);
 	d_old->inode = 0;
 	bwrite(buf_old);
 
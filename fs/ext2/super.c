@@ -17,7 +17,7 @@
 #include <fiwix/string.h>
 
 struct fs_operations ext2_fsop = {
-	FSOP_REQUIRES_DEV,
+	FSOP_REQUIRES_DEV | FSOP_DCACHE,
 	0,
 
 	NULL,			/* open */
@@ -109,14 +109,42 @@ int ext2_read_superblock(__dev_t dev, struct superblock *sb)
 		return -EINVAL;
 	}
 
-	if(ext2sb->s_minor_rev_level || ext2sb->s_rev_level) {
+	if(ext2sb->s_rev_level > EXT2_DYNAMIC_REV) {
 		printk("WARNING: %s(): unsupported ext2 filesystem revision.\n", __FUNCTION__);
-		printk("Only revision 0 (original without features) is supported.\n");
+		printk("Only revisions 0 and 1 are supported.\n");
 		superblock_unlock(sb);
 		brelse(buf);
 		return -EINVAL;
 	}
 
+	if(ext2sb->s_rev_level == EXT2_DYNAMIC_REV) {
+		if(ext2sb->s_feature_incompat & ~EXT2_FEATURE_INCOMPAT_SUPP) {
+			printk("WARNING: %s(): unsupported ext2 filesystem features (0x%x) on device %d,%d.\n", __FUNCTION__, ext2sb->s_feature_incompat & ~EXT2_FEATURE_INCOMPAT_SUPP, MAJOR(dev), MINOR(dev));
+			superblock_unlock(sb);
+			brelse(buf);
+			return -EINVAL;
+		}
+		if(ext2sb->s_inode_size < EXT2_GOOD_OLD_INODE_SIZE || ext2sb->s_inode_size & (ext2sb->s_inode_size - 1)) {
+			printk("WARNING: %s(): unsupported inode size (%d) on device %d,%d.\n", __FUNCTION__, ext2sb->s_inode_size, MAJOR(dev), MINOR(dev));
+			superblock_unlock(sb);
+			brelse(buf);
+			return -EINVAL;
+		}
+		if(ext2sb->s_feature_ro_compat & ~EXT2_FEATURE_RO_COMPAT_SUPP && !(sb->flags & MS_RDONLY)) {
+			printk("WARNING: %s(): unsupported ext2 filesystem features (0x%x) on device %d,%d, mounting it readonly.\n", __FUNCTION__, ext2sb->s_feature_ro_compat & ~EXT2_FEATURE_RO_COMPAT_SUPP, MAJOR(dev), MINOR(dev));
+			sb->flags |= MS_RDONLY;
+		}
+		/*
+		 * The inodes of these filesystems might have extended
+		 * attributes and other fields that are not preserved yet
+		 * when an inode is written back.
+		 */
+		if(!(sb->flags & MS_RDONLY)) {
+			printk("WARNING: %s(): ext2 revision 1 on device %d,%d is only supported in readonly mode.\n", __FUNCTION__, MAJOR(dev), MINOR(dev));
+			sb->flags |= MS_RDONLY;
+		}
+	}
+
 	sb->dev = dev;
 	sb->fsop = &ext2_fsop;
 	sb->s_blocksize_bits = ext2sb->s_log_block_size + EXT2_MIN_BLOCK_LOG_SIZE;
@@ -168,6 +196,11 @@ int ext2_remount_fs(struct superblock *sb, int flags)
 		ext2sb->s_state |= EXT2_VALID_FS;
 	} else {
 		/* switching from RO to RW */
+		if(ext2sb->s_rev_level != EXT2_GOOD_OLD_REV || ext2sb->s_feature_ro_compat & ~EXT2_FEATURE_RO_COMPAT_SUPP) {
+			superblock_unlock(sb);
+			brelse(buf);
+			return -EROFS;
+		}
 		check_superblock(ext2sb);
 		memcpy_b(&sb->u.ext2.sb, ext2sb, sizeof(struct ext2_super_block));
 		sb->u.ext2.sb.s_state &= ~EXT2_VALID_FS;
@@ -201,6 +234,7 @@ int ext2_write_superblock(struct superblock *sb)
 
 void ext2_release_superblock(struct superblock *sb)
 {
+	ext2_dindex_flush(sb->dev);
 	if(sb->flags & MS_RDONLY) {
 		return;
 	}
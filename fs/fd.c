@@ -5,6 +5,8 @@
  * Distributed under the terms of the Fiwix License.
  */
 
+#include <fiwix/kernel.h>
+#include <fiwix/bitmap.h>
 #include <fiwix/errno.h>
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
@@ -13,58 +15,80 @@
 #include <fiwix/string.h>
 
 struct fd *fd_table;
+unsigned int *fd_bitmap;
 
 static struct resource fd_resource = { 0, 0 };
+static int fd_hint = 1;		/* all fd_table entries below it are used */
 
 int get_new_fd(struct inode *i)
 {
-	unsigned int n;
+	int n;
 
 	lock_resource(&fd_resource);
 
-	for(n = 1; n < NR_OPENS; n++) {
-		if(fd_table[n].count == 0) {
-			memset_b(&fd_table[n], 0, sizeof(struct fd));
-			fd_table[n].inode = i;
-			fd_table[n].count = 1;
-			unlock_resource(&fd_resource);
-			return n;
-		}
+	if((n = find_next_zero_bit(fd_bitmap, kstat.max_fds, fd_hint)) < 0) {
+		unlock_resource(&fd_resource);
+		return -ENFILE;
 	}
+	fd_bitmap[n / 32] |= 1 << (n % 32);
+	fd_hint = n + 1;
+	kstat.nr_fds++;
+	memset_b(&fd_table[n], 0, sizeof(struct fd));
+	fd_table[n].inode = i;
+	fd_table[n].count = 1;
 
 	unlock_resource(&fd_resource);
-
-	return -ENFILE;
+	return n;
 }
 
 void release_fd(unsigned int fd)
 {
 	lock_resource(&fd_resource);
 	fd_table[fd].count = 0;
+	fd_bitmap[fd / 32] &= ~(1 << (fd % 32));
+	if(fd < fd_hint) {
+		fd_hint = fd;
+	}
+	kstat.nr_fds--;
 	unlock_resource(&fd_resource);
 }
 
 int get_new_user_fd(int fd)
 {
-	int n;
+	int n, max;
 
-	for(n = fd; n < OPEN_MAX && n < current->rlim[RLIMIT_NOFILE].rlim_cur; n++) {
-		if(current->fd[n] == 0) {
-			current->fd[n] = -1;
-			current->fd_flags[n] = 0;
-			return n;
+	max = MIN(OPEN_MAX, current->rlim[RLIMIT_NOFILE].rlim_cur);
+	if(fd <= current->fd_hint) {
+		if((n = find_next_zero_bit(current->fd_bitmap, max, current->fd_hint)) < 0) {
+			return -EMFILE;
+		}
+		current->fd_hint = n + 1;
+	} else {
+		if((n = find_next_zero_bit(current->fd_bitmap, max, fd)) < 0) {
+			return -EMFILE;
 		}
 	}
-
-	return -EMFILE;
+	current->fd_bitmap[n / 32] |= 1 << (n % 32);
+	current->fd[n] = -1;
+	current->fd_flags[n] = 0;
+	return n;
 }
 
 void release_user_fd(int ufd)
 {
 	current->fd[ufd] = 0;
+	current->fd_bitmap[ufd / 32] &= ~(1 << (ufd % 32));
+	if(ufd < current->fd_hint) {
+		current->fd_hint = ufd;
+	}
 }
 
 void fd_init(void)
 {
 	memset_b(fd_table, 0, fd_table_size);
+	fd_bitmap = (unsigned int *)&fd_table[kstat.max_fds];
+
+	/* entry 0 is never used */
+	fd_bitmap[0] = 1;
+	fd_hint = 1;
 }
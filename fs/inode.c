@@ -27,6 +27,7 @@
 #include <fiwix/sleep.h>
 #include <fiwix/sched.h>
 #include <fiwix/fs.h>
+#include <fiwix/buffer.h>
 #include <fiwix/filesystems.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
@@ -78,6 +79,7 @@ static void del_inode_from_pool(struct inode *i)
 		return;
 	}
 
+	detach_inode_buffers(i);
 	SAVE_FLAGS(flags); CLI();
 	if(i->next) {
 		i->next->prev = i->prev;
@@ -202,6 +204,7 @@ static struct inode *get_free_inode(void)
 
 	remove_from_free_list(i);
 	remove_from_hash(i);
+	detach_inode_buffers(i);
 	i->i_mode = 0;
 	i->i_uid = 0;
 	i->i_size = 0;
@@ -220,6 +223,7 @@ static struct inode *get_free_inode(void)
 	i->rdev = 0;
 	i->fsop = NULL;
 	i->sb = NULL;
+	memset_b(&i->ra, 0, sizeof(struct readahead));
 	memset_b(&i->u, 0, sizeof(i->u));
 	RESTORE_FLAGS(flags);
 	return i;
@@ -306,7 +310,11 @@ void inode_unlock(struct inode *i)
 	RESTORE_FLAGS(flags);
 }
 
-struct inode *ialloc(struct superblock *sb, int mode)
+/*
+ * The inode number of the parent directory 'dir' (if any) is passed to the
+ * filesystem in the new inode as a hint to place it close to its parent.
+ */
+struct inode *ialloc(struct superblock *sb, struct inode *dir, int mode)
 {
 	int errno;
 	struct inode *i;
@@ -314,8 +322,10 @@ struct inode *ialloc(struct superblock *sb, int mode)
 	if((i = get_free_inode())) {
 		i->sb = sb;
 		i->rdev = sb->dev;
+		i->inode = dir ? dir->inode : 0;
 		if((errno = i->sb->fsop->ialloc(i, mode))) {
 			i->count = 1;
+			i->inode = 0;
 			i->sb = NULL;
 			iput(i);
 			return NULL;
@@ -481,6 +491,33 @@ void sync_inodes(__dev_t dev)
 	unlock_resource(&sync_resource);
 }
 
+/*
+ * Writes the dirty buffers of the inode and then the inode itself. With
+ * 'datasync' the inode is written only if its size or its blocks have
+ * changed, not for a change in the timestamps only.
+ */
+int fsync_inode(struct inode *i, int datasync)
+{
+	int errno;
+
+	if((errno = sync_inode_buffers(i))) {
+		return errno;
+	}
+	if(datasync && !(i->state & INODE_DATASYNC)) {
+		return 0;
+	}
+
+	/* the inode might be already in a dirty buffer, so it's always written */
+	inode_lock(i);
+	if((errno = write_inode(i))) {
+		inode_unlock(i);
+		return errno;
+	}
+	i->state &= ~INODE_DATASYNC;
+	inode_unlock(i);
+	return sync_inode_buffers(i);
+}
+
 void invalidate_inodes(__dev_t dev)
 {
 	unsigned int flags;
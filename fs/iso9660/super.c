@@ -18,7 +18,7 @@
 #include <fiwix/string.h>
 
 struct fs_operations iso9660_fsop = {
-	FSOP_REQUIRES_DEV,
+	FSOP_REQUIRES_DEV | FSOP_DCACHE,
 	0,
 
 	NULL,			/* open */
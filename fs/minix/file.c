@@ -65,6 +65,9 @@ int minix_file_open(struct inode *i, struct fd *f)
 {
 	f->offset = 0;
 	if(f->flags & O_TRUNC) {
+		if(IS_SWAPFILE(i)) {
+			return -ETXTBSY;
+		}
 		i->i_size = 0;
 		minix_truncate(i, 0);
 	}
@@ -84,6 +87,9 @@ int minix_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 	int blksize;
 	struct buffer *buf;
 
+	if(IS_SWAPFILE(i)) {
+		return -ETXTBSY;
+	}
 	inode_lock(i);
 
 	blksize = i->sb->s_blocksize;
@@ -107,13 +113,14 @@ int minix_file_write(struct inode *i, struct fd *f, const char *buffer, __size_t
 		}
 		memcpy_b(buf->data + boffset, buffer + total_written, bytes);
 		update_page_cache(i, f->offset, buffer + total_written, bytes);
-		bwrite(buf);
+		bwrite_inode(buf, i);
 		total_written += bytes;
 		f->offset += bytes;
 	}
 
 	if(f->offset > i->i_size) {
 		i->i_size = f->offset;
+		i->state |= INODE_DATASYNC;
 	}
 	i->i_ctime = CURRENT_TIME;
 	i->i_mtime = CURRENT_TIME;
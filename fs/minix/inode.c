@@ -15,6 +15,7 @@
 #include <fiwix/stat.h>
 #include <fiwix/sched.h>
 #include <fiwix/buffer.h>
+#include <fiwix/mm.h>
 #include <fiwix/process.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
@@ -68,6 +69,10 @@ int minix_bmap(struct inode *i, __off_t offset, int mode)
 
 int minix_truncate(struct inode *i, __off_t length)
 {
+	if(IS_SWAPFILE(i)) {
+		return -ETXTBSY;
+	}
+	truncate_inode_pages(i, length);
 	if(i->sb->u.minix.version == 1) {
 		return v1_minix_truncate(i, length);
 	}
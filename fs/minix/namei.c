@@ -381,7 +381,7 @@ int minix_symlink(struct inode *dir, char *name, char *oldname)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFLNK))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFLNK))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -478,7 +478,7 @@ int minix_mkdir(struct inode *dir, char *name, __mode_t mode)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFDIR))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFDIR))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -569,7 +569,7 @@ int minix_mknod(struct inode *dir, char *name, __mode_t mode, __dev_t dev)
 		return -EEXIST;
 	}
 
-	if(!(i = ialloc(dir->sb, mode & S_IFMT))) {
+	if(!(i = ialloc(dir->sb, dir, mode & S_IFMT))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -659,7 +659,7 @@ int minix_create(struct inode *dir, char *name, int flags, __mode_t mode, struct
 		}
 	}
 
-	if(!(i = ialloc(dir->sb, S_IFREG))) {
+	if(!(i = ialloc(dir->sb, dir, S_IFREG))) {
 		inode_unlock(dir);
 		return -ENOSPC;
 	}
@@ -18,7 +18,7 @@
 
 #ifdef CONFIG_FS_MINIX
 struct fs_operations minix_fsop = {
-	FSOP_REQUIRES_DEV,
+	FSOP_REQUIRES_DEV | FSOP_DCACHE,
 	0,
 
 	NULL,			/* open */
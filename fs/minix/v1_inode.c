@@ -48,7 +48,7 @@ static int free_zone(struct inode *i, int block, int offset)
 			zone[n] = 0;
 		}
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -78,7 +78,7 @@ static int free_indblock(struct inode *i, int block, int offset)
 		}
 		dblock = 0;
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -179,7 +179,7 @@ int v1_minix_write_inode(struct inode *i)
 		memcpy_b(ii->i_zone, i->u.minix.u.i1_zone, sizeof(i->u.minix.u.i1_zone));
 	}
 	i->state &= ~INODE_DIRTY;
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -281,8 +281,9 @@ int v1_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.minix.u.i1_zone[block] = newblock;
+			i->state |= INODE_DATASYNC;
 		}
 		return i->u.minix.u.i1_zone[block];
 	}
@@ -298,8 +299,9 @@ int v1_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.minix.u.i1_zone[level] = newblock;
+			i->state |= INODE_DATASYNC;
 		} else {
 			return 0;
 		}
@@ -327,13 +329,14 @@ int v1_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf2->data, 0, blksize);
-			bwrite(buf2);
+			bwrite_inode(buf2, i);
 			indblock[block] = newblock;
+			i->state |= INODE_DATASYNC;
 			if(level == MINIX_IND_BLOCK) {
-				bwrite(buf);
+				bwrite_inode(buf, i);
 				return newblock;
 			}
-			buf->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+			mark_buffer_dirty(buf, i);
 		} else {
 			brelse(buf);
 			return 0;
@@ -367,9 +370,10 @@ int v1_minix_bmap(struct inode *i, __off_t offset, int mode)
 			return -EIO;
 		}
 		memset_b(buf3->data, 0, blksize);
-		bwrite(buf3);
+		bwrite_inode(buf3, i);
 		dindblock[dblock - (iblock * BLOCKS_PER_IND_BLOCK(i->sb))] = newblock;
-		buf2->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+		i->state |= INODE_DATASYNC;
+		mark_buffer_dirty(buf2, i);
 		block = newblock;
 	}
 	brelse(buf);
@@ -434,7 +438,7 @@ int v1_minix_truncate(struct inode *i, __off_t length)
 	i->i_mtime = CURRENT_TIME;
 	i->i_ctime = CURRENT_TIME;
 	i->i_size = length;
-	i->state |= INODE_DIRTY;
+	i->state |= INODE_DIRTY | INODE_DATASYNC;
 
 	return 0;
 }
@@ -50,7 +50,7 @@ static int free_zone(struct inode *i, int block, int offset)
 			zone[n] = 0;
 		}
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -80,7 +80,7 @@ static int free_indblock(struct inode *i, int block, int offset)
 		}
 		dblock = 0;
 	}
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -183,7 +183,7 @@ int v2_minix_write_inode(struct inode *i)
 		memcpy_b(ii->i_zone, i->u.minix.u.i2_zone, sizeof(i->u.minix.u.i2_zone));
 	}
 	i->state &= ~INODE_DIRTY;
-	bwrite(buf);
+	bwrite_inode(buf, i);
 	return 0;
 }
 
@@ -288,8 +288,9 @@ int v2_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.minix.u.i2_zone[block] = newblock;
+			i->state |= INODE_DATASYNC;
 		}
 		return i->u.minix.u.i2_zone[block];
 	}
@@ -305,8 +306,9 @@ int v2_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf->data, 0, blksize);
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			i->u.minix.u.i2_zone[level] = newblock;
+			i->state |= INODE_DATASYNC;
 		} else {
 			return 0;
 		}
@@ -338,13 +340,14 @@ int v2_minix_bmap(struct inode *i, __off_t offset, int mode)
 				return -EIO;
 			}
 			memset_b(buf2->data, 0, blksize);
-			bwrite(buf2);
+			bwrite_inode(buf2, i);
 			indblock[block] = newblock;
+			i->state |= INODE_DATASYNC;
 			if(level == MINIX_IND_BLOCK) {
-				bwrite(buf);
+				bwrite_inode(buf, i);
 				return newblock;
 			}
-			buf->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+			mark_buffer_dirty(buf, i);
 		} else {
 			brelse(buf);
 			return 0;
@@ -380,9 +383,10 @@ int v2_minix_bmap(struct inode *i, __off_t offset, int mode)
 					return -EIO;
 				}
 				memset_b(buf4->data, 0, blksize);
-				bwrite(buf4);
+				bwrite_inode(buf4, i);
 				tindblock[tblock / BLOCKS_PER_IND_BLOCK(i->sb)] = newblock;
-				buf3->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+				i->state |= INODE_DATASYNC;
+				mark_buffer_dirty(buf3, i);
 				block = newblock;
 			} else {
 				brelse(buf);
@@ -429,9 +433,10 @@ int v2_minix_bmap(struct inode *i, __off_t offset, int mode)
 			return -EIO;
 		}
 		memset_b(buf4->data, 0, blksize);
-		bwrite(buf4);
+		bwrite_inode(buf4, i);
 		dindblock[dblock - (iblock * BLOCKS_PER_IND_BLOCK(i->sb))] = newblock;
-		buf2->flags |= (BUFFER_DIRTY | BUFFER_VALID);
+		i->state |= INODE_DATASYNC;
+		mark_buffer_dirty(buf2, i);
 		block = newblock;
 	}
 	brelse(buf);
@@ -523,7 +528,7 @@ int v2_minix_truncate(struct inode *i, __off_t length)
 				}
 				indblock = 0;
 			}
-			bwrite(buf);
+			bwrite_inode(buf, i);
 			if(!block) {
 				minix_bfree(i->sb, i->u.minix.u.i2_zone[MINIX_TIND_BLOCK]);
 				i->u.minix.u.i2_zone[MINIX_TIND_BLOCK] = 0;
@@ -534,7 +539,7 @@ int v2_minix_truncate(struct inode *i, __off_t length)
 	i->i_mtime = CURRENT_TIME;
 	i->i_ctime = CURRENT_TIME;
 	i->i_size = length;
-	i->state |= INODE_DIRTY;
+	i->state |= INODE_DIRTY | INODE_DATASYNC;
 
 	return 0;
 }
@@ -9,6 +9,7 @@
 #include <fiwix/sleep.h>
 #include <fiwix/sched.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/filesystems.h>
 #include <fiwix/stat.h>
 #include <fiwix/mm.h>
@@ -35,7 +36,7 @@ static int do_namei(char *path, struct inode *dir, struct inode **i_res, struct
 		}
 
 		/* extracts the next component of the path */
-		if(!(name = (char *)kmalloc(NAME_MAX + 1))) {
+		if(!(name = (char *)kmem_cache_alloc(name_cache))) {
 			return -ENOMEM;
 		}
 		ptr_name = name;
@@ -65,11 +66,11 @@ static int do_namei(char *path, struct inode *dir, struct inode **i_res, struct
 		}
 
 		dir->count++;
-		if((errno = dir->fsop->lookup(name, dir, &i))) {
+		if((errno = dcache_lookup(name, dir, &i))) {
 			break;
 		}
 
-		kfree((unsigned int)name);
+		kmem_cache_free(name_cache, name);
 		if(*path == '/') {
 			if(!S_ISDIR(i->i_mode) && !S_ISLNK(i->i_mode)) {
 				iput(dir);
@@ -105,7 +106,7 @@ static int do_namei(char *path, struct inode *dir, struct inode **i_res, struct
 		*i_res = i;
 	}
 
-	kfree((unsigned int)name);
+	kmem_cache_free(name_cache, name);
 	if(d_res) {
 		if(*d_res) {
 			iput(*d_res);
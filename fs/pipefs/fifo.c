@@ -20,22 +20,20 @@
 int fifo_open(struct inode *i, struct fd *f)
 {
 	/* first open */
-	if(i->count == 1) {
-		if(!(i->u.pipefs.i_data = (void *)kmalloc(PAGE_SIZE))) {
+	if(i->count == 1 && !i->u.pipefs.i_pages) {
+		if(pipefs_alloc_ring(i)) {
 			return -ENOMEM;
 		}
-		i->u.pipefs.i_readoff = 0;
-		i->u.pipefs.i_writeoff = 0;
 	}
 
 	if((f->flags & O_ACCMODE) == O_RDONLY) {
 		i->u.pipefs.i_readers++;
-		wakeup(&pipefs_write);
+		wakeup(PIPE_WRITE_WAIT(i));
 		if(!(f->flags & O_NONBLOCK)) {
 			while(!i->u.pipefs.i_writers) {
-				if(sleep(&pipefs_read, PROC_INTERRUPTIBLE)) {
+				if(sleep(PIPE_READ_WAIT(i), PROC_INTERRUPTIBLE)) {
 					if(!--i->u.pipefs.i_readers) {
-						wakeup(&pipefs_write);
+						wakeup(PIPE_WRITE_WAIT(i));
 					}
 					return -EINTR;
 				}
@@ -49,12 +47,12 @@ int fifo_open(struct inode *i, struct fd *f)
 		}
 
 		i->u.pipefs.i_writers++;
-		wakeup(&pipefs_read);
+		wakeup(PIPE_READ_WAIT(i));
 		if(!(f->flags & O_NONBLOCK)) {
 			while(!i->u.pipefs.i_readers) {
-				if(sleep(&pipefs_write, PROC_INTERRUPTIBLE)) {
+				if(sleep(PIPE_WRITE_WAIT(i), PROC_INTERRUPTIBLE)) {
 					if(!--i->u.pipefs.i_writers) {
-						wakeup(&pipefs_read);
+						wakeup(PIPE_READ_WAIT(i));
 					}
 					return -EINTR;
 				}
@@ -65,8 +63,8 @@ int fifo_open(struct inode *i, struct fd *f)
 	if((f->flags & O_ACCMODE) == O_RDWR) {
 		i->u.pipefs.i_readers++;
 		i->u.pipefs.i_writers++;
-		wakeup(&pipefs_write);
-		wakeup(&pipefs_read);
+		wakeup(PIPE_WRITE_WAIT(i));
+		wakeup(PIPE_READ_WAIT(i));
 	}
 
 	return 0;
@@ -5,6 +5,21 @@
  * Distributed under the terms of the Fiwix License.
  */
 
+/*
+ * The data of a pipe lives in a ring of pages whose size is a power of two
+ * (PIPE_DEF_PAGES by default, changed with F_SETPIPE_SZ). The pages are
+ * allocated the first time they are written, so a pipe that never holds
+ * much data only uses one page. Every pipe has its own lock, its own wait
+ * channels and its own select() wait queue, so readers and writers of
+ * different pipes never wait or wake up each other.
+ *
+ *   i_pages
+ *   +------+------+------+-- ... --+------+
+ *   | page | page | NULL |         | page |
+ *   +------+------+------+-- ... --+------+
+ *        ^ i_readoff      ^ i_readoff + i_size (modulo PIPE_SIZE)
+ */
+
 #include <fiwix/types.h>
 #include <fiwix/errno.h>
 #include <fiwix/fs.h>
@@ -13,35 +28,248 @@
 #include <fiwix/stat.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/ioctl.h>
+#include <fiwix/mm.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
 #include <fiwix/sched.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
-static struct resource pipe_resource = { 0, 0 };
+#define PIPE_ROOM(i)	(PIPE_SIZE(i) - (i)->i_size)
+
+/* returns the address of the byte 'offset' of the ring */
+static char *ring_addr(struct inode *i, unsigned int offset)
+{
+	char **pg;
+
+	pg = &i->u.pipefs.i_pages[offset >> PAGE_SHIFT];
+	if(!*pg) {
+		if(!(*pg = (char *)kmalloc(PAGE_SIZE))) {
+			return NULL;
+		}
+	}
+	return *pg + (offset & (PAGE_SIZE - 1));
+}
+
+/* bytes that can be accessed from 'offset' without crossing a page */
+static unsigned int ring_chunk(unsigned int offset, unsigned int count)
+{
+	return MIN(count, PAGE_SIZE - (offset & (PAGE_SIZE - 1)));
+}
+
+static unsigned int write_offset(struct inode *i)
+{
+	return (i->u.pipefs.i_readoff + i->i_size) & (PIPE_SIZE(i) - 1);
+}
+
+/* the following functions are called with the pipe locked */
+
+static int copy_to_ring(struct inode *i, const char *buffer, __size_t count)
+{
+	unsigned int offset, n;
+	__size_t done;
+	char *addr;
+
+	for(done = 0; done < count; done += n) {
+		offset = write_offset(i);
+		n = ring_chunk(offset, count - done);
+		if(!(addr = ring_addr(i, offset))) {
+			break;
+		}
+		memcpy_b(addr, (void *)(buffer + done), n);
+		i->i_size += n;
+	}
+	return done ? done : -ENOMEM;
+}
+
+/* copies (without consuming) 'count' bytes starting at 'skip' bytes of data */
+static void copy_from_ring(struct inode *i, unsigned int skip, char *buffer, __size_t count)
+{
+	unsigned int offset, n;
+	__size_t done;
+
+	for(done = 0; done < count; done += n) {
+		offset = (i->u.pipefs.i_readoff + skip + done) & (PIPE_SIZE(i) - 1);
+		n = ring_chunk(offset, count - done);
+		memcpy_b(buffer + done, i->u.pipefs.i_pages[offset >> PAGE_SHIFT] + (offset & (PAGE_SIZE - 1)), n);
+	}
+}
+
+static void consume(struct inode *i, __size_t count)
+{
+	i->u.pipefs.i_readoff = (i->u.pipefs.i_readoff + count) & (PIPE_SIZE(i) - 1);
+	i->i_size -= count;
+	if(!i->i_size) {
+		i->u.pipefs.i_readoff = 0;
+	}
+}
+
+/* the following functions wake up only the processes waiting for this pipe */
+
+static void data_added(struct inode *i, __size_t old_size)
+{
+	wakeup(PIPE_READ_WAIT(i));
+	if(!old_size) {
+		wakeup_queue(&i->u.pipefs.i_wq);
+	}
+}
+
+static void data_removed(struct inode *i, __size_t old_size)
+{
+	wakeup(PIPE_WRITE_WAIT(i));
+	if(PIPE_SIZE(i) - old_size < PIPE_BUF) {
+		wakeup_queue(&i->u.pipefs.i_wq);
+	}
+}
+
+/* returns 1 if there is data, 0 on end of file or an error */
+static int wait_for_data(struct inode *i, int nonblock)
+{
+	while(!i->i_size) {
+		if(!i->u.pipefs.i_writers) {
+			return 0;
+		}
+		if(nonblock) {
+			return -EAGAIN;
+		}
+		if(sleep(PIPE_READ_WAIT(i), PROC_INTERRUPTIBLE)) {
+			return -EINTR;
+		}
+	}
+	return 1;
+}
+
+/* returns 1 if there is room for 'count' bytes (at least one) or an error */
+static int wait_for_room(struct inode *i, __size_t count, int nonblock)
+{
+	for(;;) {
+		/* if there are no readers then send signal and return */
+		if(!i->u.pipefs.i_readers) {
+			send_sig(current, SIGPIPE);
+			return -EPIPE;
+		}
+		if(PIPE_ROOM(i) >= MAX(count, 1)) {
+			break;
+		}
+		if(nonblock) {
+			return -EAGAIN;
+		}
+		if(sleep(PIPE_WRITE_WAIT(i), PROC_INTERRUPTIBLE)) {
+			return -EINTR;
+		}
+	}
+	return 1;
+}
+
+int pipefs_alloc_ring(struct inode *i)
+{
+	if(!(i->u.pipefs.i_pages = (char **)kmalloc(PIPE_DEF_PAGES * sizeof(char *)))) {
+		return -ENOMEM;
+	}
+	memset_b(i->u.pipefs.i_pages, 0, PIPE_DEF_PAGES * sizeof(char *));
+	i->u.pipefs.i_nr_pages = PIPE_DEF_PAGES;
+	i->u.pipefs.i_readoff = 0;
+	return 0;
+}
+
+void pipefs_free_ring(struct inode *i)
+{
+	int n;
+
+	for(n = 0; n < i->u.pipefs.i_nr_pages; n++) {
+		if(i->u.pipefs.i_pages[n]) {
+			kfree((unsigned int)i->u.pipefs.i_pages[n]);
+		}
+	}
+	kfree((unsigned int)i->u.pipefs.i_pages);
+	i->u.pipefs.i_pages = NULL;
+	i->u.pipefs.i_nr_pages = 0;
+}
+
+/* changes the capacity of the pipe (F_SETPIPE_SZ) */
+int pipefs_set_size(struct inode *i, unsigned int size)
+{
+	char **pages, *pg, *split;
+	unsigned int first, used;
+	int n, nr_pages;
+
+	if(size > (PIPE_MAX_PAGES << PAGE_SHIFT)) {
+		return -EPERM;
+	}
+	for(nr_pages = 1; (nr_pages << PAGE_SHIFT) < size; nr_pages <<= 1);
+	if(!(pages = (char **)kmalloc(nr_pages * sizeof(char *)))) {
+		return -ENOMEM;
+	}
+	memset_b(pages, 0, nr_pages * sizeof(char *));
+
+	lock_resource(&i->u.pipefs.i_lock);
+	used = ((i->u.pipefs.i_readoff & (PAGE_SIZE - 1)) + i->i_size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	if(used > nr_pages) {
+		unlock_resource(&i->u.pipefs.i_lock);
+		kfree((unsigned int)pages);
+		return -EBUSY;
+	}
+
+	/*
+	 * If the data wraps around into the page where it starts, that page
+	 * holds both ends of it, so the end is copied to a page of its own.
+	 */
+	split = NULL;
+	if(used > i->u.pipefs.i_nr_pages) {
+		if(!(split = (char *)kmalloc(PAGE_SIZE))) {
+			unlock_resource(&i->u.pipefs.i_lock);
+			kfree((unsigned int)pages);
+			return -ENOMEM;
+		}
+		memcpy_b(split, i->u.pipefs.i_pages[i->u.pipefs.i_readoff >> PAGE_SHIFT], PAGE_SIZE);
+	}
+
+	/* the pages are rotated so the data starts at the first one */
+	first = i->u.pipefs.i_readoff >> PAGE_SHIFT;
+	for(n = 0; n < i->u.pipefs.i_nr_pages; n++) {
+		pg = i->u.pipefs.i_pages[(first + n) & (i->u.pipefs.i_nr_pages - 1)];
+		if(n < nr_pages) {
+			pages[n] = pg;
+		} else if(pg) {
+			kfree((unsigned int)pg);
+		}
+	}
+	if(split) {
+		pages[i->u.pipefs.i_nr_pages] = split;
+	}
+	kfree((unsigned int)i->u.pipefs.i_pages);
+	i->u.pipefs.i_pages = pages;
+	i->u.pipefs.i_nr_pages = nr_pages;
+	i->u.pipefs.i_readoff &= PAGE_SIZE - 1;
+	unlock_resource(&i->u.pipefs.i_lock);
+
+	wakeup(PIPE_WRITE_WAIT(i));
+	wakeup_queue(&i->u.pipefs.i_wq);
+	return PIPE_SIZE(i);
+}
 
 int pipefs_close(struct inode *i, struct fd *f)
 {
 	if((f->flags & O_ACCMODE) == O_RDONLY) {
 		if(!--i->u.pipefs.i_readers) {
-			wakeup(&do_select);
-			wakeup(&pipefs_write);
+			wakeup_queue(&i->u.pipefs.i_wq);
+			wakeup(PIPE_WRITE_WAIT(i));
 		}
 	}
 	if((f->flags & O_ACCMODE) == O_WRONLY) {
 		if(!--i->u.pipefs.i_writers) {
-			wakeup(&do_select);
-			wakeup(&pipefs_read);
+			wakeup_queue(&i->u.pipefs.i_wq);
+			wakeup(PIPE_READ_WAIT(i));
 		}
 	}
 	if((f->flags & O_ACCMODE) == O_RDWR) {
 		if(!--i->u.pipefs.i_readers) {
-			wakeup(&do_select);
-			wakeup(&pipefs_write);
+			wakeup_queue(&i->u.pipefs.i_wq);
+			wakeup(PIPE_WRITE_WAIT(i));
 		}
 		if(!--i->u.pipefs.i_writers) {
-			wakeup(&do_select);
-			wakeup(&pipefs_read);
+			wakeup_queue(&i->u.pipefs.i_wq);
+			wakeup(PIPE_READ_WAIT(i));
 		}
 	}
 	return 0;
@@ -49,122 +277,64 @@ int pipefs_close(struct inode *i, struct fd *f)
 
 int pipefs_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 {
-	__size_t bytes_read;
-	__size_t n, limit;
-	char *data;
-
-	bytes_read = 0;
-	data = i->u.pipefs.i_data;
+	__size_t n, old_size;
+	int errno;
 
-	while(count) {
-		if(i->u.pipefs.i_writeoff) {
-			if(i->u.pipefs.i_readoff >= i->u.pipefs.i_writeoff) {
-				limit = PIPE_BUF - i->u.pipefs.i_readoff;
-			} else {
-				limit = i->u.pipefs.i_writeoff - i->u.pipefs.i_readoff;
-			}
-		} else {
-			limit = PIPE_BUF - i->u.pipefs.i_readoff;
-		}
-		n = MIN(limit, count);
-		if(i->i_size && n) {
-			lock_resource(&pipe_resource);
-			memcpy_b(buffer + bytes_read, data + i->u.pipefs.i_readoff, n);
-			bytes_read += n;
-			i->u.pipefs.i_readoff += n;
-			i->i_size -= n;
-			if(i->u.pipefs.i_writeoff >= PIPE_BUF) {
-				i->u.pipefs.i_writeoff = 0;
-			}
-			unlock_resource(&pipe_resource);
-			wakeup(&do_select);
-			wakeup(&pipefs_write);
-			break;
-		} else {
-			if(i->u.pipefs.i_writers) {
-				if(f->flags & O_NONBLOCK) {
-					return -EAGAIN;
-				}
-				if(sleep(&pipefs_read, PROC_INTERRUPTIBLE)) {
-					return -EINTR;
-				}
-			} else {
-				if(i->i_size) {
-					if(i->u.pipefs.i_readoff >= PIPE_BUF) {
-						i->u.pipefs.i_readoff = 0;
-						continue;
-					}
-				}
-				break;
-			}
+	for(;;) {
+		if((errno = wait_for_data(i, f->flags & O_NONBLOCK)) <= 0) {
+			return errno;
 		}
+		lock_resource(&i->u.pipefs.i_lock);
+		if((n = MIN(count, i->i_size))) {
+			old_size = i->i_size;
+			copy_from_ring(i, 0, buffer, n);
+			consume(i, n);
+			unlock_resource(&i->u.pipefs.i_lock);
+			data_removed(i, old_size);
+			return n;
+		}
+		/* another reader took the data while waiting for the lock */
+		unlock_resource(&i->u.pipefs.i_lock);
 	}
-	if(!i->i_size) {
-		i->u.pipefs.i_readoff = 0;
-		i->u.pipefs.i_writeoff = 0;
-	}
-	return bytes_read;
 }
 
 int pipefs_write(struct inode *i, struct fd *f, const char *buffer, __size_t count)
 {
 	__size_t bytes_written;
-	__size_t n;
-	char *data;
-	int limit;
+	__size_t n, room, old_size;
+	int errno;
 
 	bytes_written = 0;
-	data = i->u.pipefs.i_data;
 
 	while(bytes_written < count) {
-		/* if there are no readers then send signal and return */
-		if(!i->u.pipefs.i_readers) {
-			send_sig(current, SIGPIPE);
-			return -EPIPE;
-		}
-
-		if(i->u.pipefs.i_readoff) {
-			if(i->u.pipefs.i_writeoff <= i->u.pipefs.i_readoff) {
-				limit = i->u.pipefs.i_readoff;
-			} else {
-				limit = PIPE_BUF;
-			}
-		} else {
-			limit = PIPE_BUF;
-		}
-
-		n = MIN((count - bytes_written), (limit - i->u.pipefs.i_writeoff));
+		n = count - bytes_written;
 
 		/*
 		 * POSIX requires that any write operation involving less than
 		 * or equal to PIPE_BUF bytes, must be automatically executed
 		 * and finished without being interleaved with write operations
 		 * of other processes to the same pipe.
-		*/
-		if(n && n <= PIPE_BUF) {
-			lock_resource(&pipe_resource);
-			memcpy_b(data + i->u.pipefs.i_writeoff, buffer + bytes_written, n);
-			bytes_written += n;
-			i->u.pipefs.i_writeoff += n;
-			i->i_size += n;
-			if(i->u.pipefs.i_readoff >= PIPE_BUF) {
-				i->u.pipefs.i_readoff = 0;
+		 */
+		if((errno = wait_for_room(i, n <= PIPE_BUF ? n : 1, f->flags & O_NONBLOCK)) < 0) {
+			if(errno == -EPIPE || !bytes_written) {
+				return errno;
 			}
-			unlock_resource(&pipe_resource);
-			wakeup(&do_select);
-			wakeup(&pipefs_read);
-			continue;
+			break;
 		}
-
-		wakeup(&do_select);
-		wakeup(&pipefs_read);
-		if(!(f->flags & O_NONBLOCK)) {
-			if(sleep(&pipefs_write, PROC_INTERRUPTIBLE)) {
-				return -EINTR;
+		lock_resource(&i->u.pipefs.i_lock);
+		room = PIPE_ROOM(i);
+		if(room && (n > PIPE_BUF || room >= n)) {
+			old_size = i->i_size;
+			errno = copy_to_ring(i, buffer + bytes_written, MIN(n, room));
+			unlock_resource(&i->u.pipefs.i_lock);
+			if(errno < 0) {
+				return bytes_written ? bytes_written : errno;
 			}
-		} else {
-			return -EAGAIN;
+			bytes_written += errno;
+			data_added(i, old_size);
+			continue;
 		}
+		unlock_resource(&i->u.pipefs.i_lock);
 	}
 	return bytes_written;
 }
@@ -193,25 +363,274 @@ __loff_t pipefs_llseek(struct inode *i, __loff_t offset)
 
 int pipefs_select(struct inode *i, struct fd *f, int flag)
 {
+	select_wait(&i->u.pipefs.i_wq);
 	switch(flag) {
 		case SEL_R:
-			/*
-			 * if !i->i_size && !i->u.pipefs.i_writers
-			 * should also return 1?
-			 */
 			if(i->i_size || !i->u.pipefs.i_writers) {
 				return 1;
 			}
 			break;
 		case SEL_W:
-			/*
-			 * if i->i_size == PIPE_BUF && !i->u.pipefs.i_readers
-			 * should also return 1?
-			 */
-			if(i->i_size < PIPE_BUF || !i->u.pipefs.i_readers) {
+			if(PIPE_ROOM(i) >= PIPE_BUF || !i->u.pipefs.i_readers) {
+				return 1;
+			}
+			break;
+		case SEL_HUP:
+			/* the reading end has no writers left */
+			if((f->flags & O_ACCMODE) != O_WRONLY && !i->u.pipefs.i_writers) {
+				return 1;
+			}
+			break;
+		case SEL_ERR:
+			/* the writing end has no readers left */
+			if((f->flags & O_ACCMODE) != O_RDONLY && !i->u.pipefs.i_readers) {
 				return 1;
 			}
 			break;
 	}
 	return 0;
 }
+
+/*
+ * splice() and tee() move the data between a pipe and another file (or pipe)
+ * without passing it through a user buffer. Whole pages are moved between
+ * two pipes by exchanging them in the rings, everything else is copied once.
+ */
+
+#define IS_NONBLOCK(f, flags)	(((f)->flags & O_NONBLOCK) || ((flags) & SPLICE_F_NONBLOCK))
+
+static void lock_pipes(struct inode *a, struct inode *b)
+{
+	/* always in the same order to avoid deadlocks */
+	if(a > b) {
+		lock_pipes(b, a);
+		return;
+	}
+	lock_resource(&a->u.pipefs.i_lock);
+	lock_resource(&b->u.pipefs.i_lock);
+}
+
+static void unlock_pipes(struct inode *a, struct inode *b)
+{
+	unlock_resource(&a->u.pipefs.i_lock);
+	unlock_resource(&b->u.pipefs.i_lock);
+}
+
+static int move_data(struct inode *src, struct inode *dst, __size_t count)
+{
+	unsigned int roff, woff, n;
+	__size_t done;
+	char **spg, **dpg, *addr;
+
+	for(done = 0; done < count; done += n) {
+		roff = src->u.pipefs.i_readoff;
+		woff = write_offset(dst);
+		spg = &src->u.pipefs.i_pages[roff >> PAGE_SHIFT];
+		dpg = &dst->u.pipefs.i_pages[woff >> PAGE_SHIFT];
+		if(!(roff & (PAGE_SIZE - 1)) && !(woff & (PAGE_SIZE - 1)) && count - done >= PAGE_SIZE) {
+			/* the full page goes to 'dst' and the free one to 'src' */
+			addr = *dpg;
+			*dpg = *spg;
+			*spg = addr;
+			n = PAGE_SIZE;
+		} else {
+			n = ring_chunk(woff, ring_chunk(roff, count - done));
+			if(!(addr = ring_addr(dst, woff))) {
+				break;
+			}
+			memcpy_b(addr, *spg + (roff & (PAGE_SIZE - 1)), n);
+		}
+		dst->i_size += n;
+		consume(src, n);
+	}
+	return done ? done : -ENOMEM;
+}
+
+static int splice_pipes(struct fd *f_in, struct fd *f_out, __size_t len, int flags)
+{
+	struct inode *src, *dst;
+	__size_t n, src_size, dst_size;
+	int errno;
+
+	src = f_in->inode;
+	dst = f_out->inode;
+	for(;;) {
+		if((errno = wait_for_data(src, IS_NONBLOCK(f_in, flags))) <= 0) {
+			return errno;
+		}
+		if((errno = wait_for_room(dst, 1, IS_NONBLOCK(f_out, flags))) < 0) {
+			return errno;
+		}
+		lock_pipes(src, dst);
+		n = MIN(len, src->i_size);
+		if((n = MIN(n, PIPE_ROOM(dst)))) {
+			src_size = src->i_size;
+			dst_size = dst->i_size;
+			errno = move_data(src, dst, n);
+			unlock_pipes(src, dst);
+			if(errno > 0) {
+				data_removed(src, src_size);
+				data_added(dst, dst_size);
+			}
+			return errno;
+		}
+		unlock_pipes(src, dst);
+	}
+}
+
+static int splice_from_file(struct fd *f_in, struct fd *f_out, __size_t len, int flags)
+{
+	struct inode *i, *dst;
+	unsigned int woff, n;
+	__size_t count, total, old_size;
+	char *addr;
+	int errno;
+
+	i = f_in->inode;
+	dst = f_out->inode;
+
+	/*
+	 * The file is read with the pipe locked, so only regular files are
+	 * accepted, the others (ttys, sockets, FIFOs) might block forever.
+	 */
+	if(!S_ISREG(i->i_mode) || !i->fsop || !i->fsop->read) {
+		return -EINVAL;
+	}
+	if((errno = wait_for_room(dst, 1, IS_NONBLOCK(f_out, flags))) < 0) {
+		return errno;
+	}
+
+	lock_resource(&dst->u.pipefs.i_lock);
+	old_size = dst->i_size;
+	count = MIN(len, PIPE_ROOM(dst));
+	for(total = 0; total < count; total += errno) {
+		woff = write_offset(dst);
+		n = ring_chunk(woff, count - total);
+		if(!(addr = ring_addr(dst, woff))) {
+			errno = -ENOMEM;
+			break;
+		}
+		if((errno = i->fsop->read(i, f_in, addr, n)) <= 0) {
+			break;
+		}
+		dst->i_size += errno;
+		if(errno < n) {
+			total += errno;
+			break;
+		}
+	}
+	unlock_resource(&dst->u.pipefs.i_lock);
+
+	if(total) {
+		data_added(dst, old_size);
+		return total;
+	}
+	return errno;
+}
+
+static int splice_to_file(struct fd *f_in, struct fd *f_out, __size_t len, int flags)
+{
+	struct inode *src, *i;
+	unsigned int roff, n;
+	__size_t count, total, old_size;
+	int errno;
+
+	src = f_in->inode;
+	i = f_out->inode;
+
+	/* as in splice_from_file(), the file is written with the pipe locked */
+	if(!S_ISREG(i->i_mode) || !i->fsop || !i->fsop->write) {
+		return -EINVAL;
+	}
+	if((errno = wait_for_data(src, IS_NONBLOCK(f_in, flags))) <= 0) {
+		return errno;
+	}
+
+	lock_resource(&src->u.pipefs.i_lock);
+	old_size = src->i_size;
+	count = MIN(len, src->i_size);
+	for(total = 0; total < count; total += errno) {
+		roff = src->u.pipefs.i_readoff;
+		n = ring_chunk(roff, count - total);
+		if((errno = i->fsop->write(i, f_out, src->u.pipefs.i_pages[roff >> PAGE_SHIFT] + (roff & (PAGE_SIZE - 1)), n)) <= 0) {
+			break;
+		}
+		consume(src, errno);
+		if(errno < n) {
+			total += errno;
+			break;
+		}
+	}
+	unlock_resource(&src->u.pipefs.i_lock);
+
+	if(total) {
+		data_removed(src, old_size);
+		return total;
+	}
+	return errno;
+}
+
+int pipefs_splice(struct fd *f_in, struct fd *f_out, __size_t len, int flags)
+{
+	int in_pipe, out_pipe;
+
+	in_pipe = f_in->inode->fsop == &pipefs_fsop;
+	out_pipe = f_out->inode->fsop == &pipefs_fsop;
+	if(in_pipe && out_pipe) {
+		if(f_in->inode == f_out->inode) {
+			return -EINVAL;
+		}
+		return splice_pipes(f_in, f_out, len, flags);
+	}
+	if(in_pipe) {
+		return splice_to_file(f_in, f_out, len, flags);
+	}
+	if(out_pipe) {
+		return splice_from_file(f_in, f_out, len, flags);
+	}
+	return -EINVAL;
+}
+
+int pipefs_tee(struct fd *f_in, struct fd *f_out, __size_t len, int flags)
+{
+	struct inode *src, *dst;
+	unsigned int woff, n;
+	__size_t count, done, old_size;
+	char *addr;
+	int errno;
+
+	src = f_in->inode;
+	dst = f_out->inode;
+	if(src->fsop != &pipefs_fsop || dst->fsop != &pipefs_fsop || src == dst) {
+		return -EINVAL;
+	}
+	for(;;) {
+		if((errno = wait_for_data(src, IS_NONBLOCK(f_in, flags))) <= 0) {
+			return errno;
+		}
+		if((errno = wait_for_room(dst, 1, IS_NONBLOCK(f_out, flags))) < 0) {
+			return errno;
+		}
+		lock_pipes(src, dst);
+		old_size = dst->i_size;
+		count = MIN(len, src->i_size);
+		count = MIN(count, PIPE_ROOM(dst));
+		for(done = 0; done < count; done += n) {
+			woff = write_offset(dst);
+			n = ring_chunk(woff, count - done);
+			if(!(addr = ring_addr(dst, woff))) {
+				break;
+			}
+			copy_from_ring(src, done, addr, n);
+			dst->i_size += n;
+		}
+		unlock_pipes(src, dst);
+		if(done) {
+			data_added(dst, old_size);
+			return done;
+		}
+		if(count) {
+			return -ENOMEM;
+		}
+	}
+}
@@ -18,6 +18,9 @@
 #include <fiwix/locks.h>
 #include <fiwix/mm.h>
 #include <fiwix/mman.h>
+#include <fiwix/stat.h>
+#include <fiwix/swap.h>
+#include <fiwix/zram.h>
 #include <fiwix/fs_proc.h>
 #include <fiwix/cpu.h>
 #include <fiwix/irq.h>
@@ -69,6 +72,23 @@ int data_proc_buddyinfo(char *buffer, __pid_t pid)
 	size += sprintk(buffer + size, "\n\n");
 	size += sprintk(buffer + size, "Memory requested (used): %d KB (%d KB)\n", kstat.buddy_low_mem_requested / 1024, (kstat.buddy_low_num_pages * PAGE_SIZE / 1024));
 
+	size += sprintk(buffer + size, "\nOrder:");
+	for(n = 0; n <= BUDDY_HIGH_MAX_ORDER; n++) {
+		size += sprintk(buffer + size, "\t%d", n);
+	}
+	size += sprintk(buffer + size, "\n");
+	size += sprintk(buffer + size, "------------------------------------------------------------------------------------------\n");
+	size += sprintk(buffer + size, "Used:");
+	for(n = 0; n <= BUDDY_HIGH_MAX_ORDER; n++) {
+		size += sprintk(buffer + size, "\t%d", kstat.buddy_high_count[n]);
+	}
+	size += sprintk(buffer + size, "\nFree:");
+	for(n = 0; n <= BUDDY_HIGH_MAX_ORDER; n++) {
+		size += sprintk(buffer + size, "\t%d", kstat.buddy_high_free[n]);
+	}
+	size += sprintk(buffer + size, "\n\n");
+	size += sprintk(buffer + size, "Memory held by buddy_high: %d KB\n", kstat.buddy_high_num_pages * PAGE_SIZE / 1024);
+
 	return size;
 }
 
@@ -163,7 +183,7 @@ int data_proc_filesystems(char *buffer, __pid_t pid)
 	for(n = 0; n < NR_FILESYSTEMS; n++) {
 		if(filesystems_table[n].name) {
 			nodev = 0;
-			if(filesystems_table[n].fsop->flags != FSOP_REQUIRES_DEV) {
+			if(!(filesystems_table[n].fsop->flags & FSOP_REQUIRES_DEV)) {
 				nodev = 1;
 			}
 			size += sprintk(buffer + size, "%s %s\n", nodev ? "nodev" : "     ", filesystems_table[n].name);
@@ -255,15 +275,24 @@ int data_proc_meminfo(char *buffer, __pid_t pid)
 	size = 0;
 	size += sprintk(buffer + size, "        total:    used:    free:  shared: buffers:  cached:\n");
 	size += sprintk(buffer + size, "Mem:  %8u %8u %8u %8u %8u %8u\n", kstat.total_mem_pages << PAGE_SHIFT, (kstat.total_mem_pages << PAGE_SHIFT) - (kstat.free_pages << PAGE_SHIFT), kstat.free_pages << PAGE_SHIFT, kstat.shared * 1024, kstat.buffers_size * 1024, kstat.cached * 1024);
-	size += sprintk(buffer + size, "Swap: %8u %8u %8u\n", 0, 0, 0);
+	size += sprintk(buffer + size, "Swap: %8u %8u %8u\n", kstat.total_swap_pages << PAGE_SHIFT, (kstat.total_swap_pages - kstat.free_swap_pages) << PAGE_SHIFT, kstat.free_swap_pages << PAGE_SHIFT);
 	size += sprintk(buffer + size, "MemTotal: %9d kB\n", kstat.total_mem_pages << 2);
 	size += sprintk(buffer + size, "MemFree:  %9d kB\n", kstat.free_pages << 2);
 	size += sprintk(buffer + size, "MemShared:%9d kB\n", kstat.shared);
 	size += sprintk(buffer + size, "Buffers:  %9d kB\n", kstat.buffers_size);
 	size += sprintk(buffer + size, "Cached:   %9d kB\n", kstat.cached);
-	size += sprintk(buffer + size, "SwapTotal:%9d kB\n", 0);
-	size += sprintk(buffer + size, "SwapFree: %9d kB\n", 0);
+	size += sprintk(buffer + size, "BufActive:%9d kB\n", kstat.active_buffers);
+	size += sprintk(buffer + size, "BufInact: %9d kB\n", kstat.inactive_buffers);
+	size += sprintk(buffer + size, "BufHits:  %9u\n", kstat.buffer_hits);
+	size += sprintk(buffer + size, "BufMisses:%9u\n", kstat.buffer_misses);
+	size += sprintk(buffer + size, "BufEvicts:%9u\n", kstat.buffer_evictions);
+	size += sprintk(buffer + size, "SwapTotal:%9d kB\n", kstat.total_swap_pages << 2);
+	size += sprintk(buffer + size, "SwapFree: %9d kB\n", kstat.free_swap_pages << 2);
 	size += sprintk(buffer + size, "Dirty:    %9d kB\n", kstat.dirty_buffers);
+	size += sprintk(buffer + size, "Slab:     %9d kB\n", kstat.slab_pages << 2);
+	size += sprintk(buffer + size, "ReadAhead:%9d kB\n", kstat.ra_pages << 2);
+	size += sprintk(buffer + size, "RaHits:   %9u\n", kstat.ra_hits);
+	size += sprintk(buffer + size, "RaMisses: %9u\n", kstat.ra_misses);
 	return size;
 }
 
@@ -277,7 +306,7 @@ int data_proc_mounts(char *buffer, __pid_t pid)
 	mp = mount_table;
 
 	while(mp) {
-		if(mp->fs->fsop->flags != FSOP_KERN_MOUNT) {
+		if(!(mp->fs->fsop->flags & FSOP_KERN_MOUNT)) {
 			flag = mp->sb.flags & MS_RDONLY ? "ro" : "rw";
 			size += sprintk(buffer + size, "%s %s %s %s 0 0\n", mp->devname, mp->dirname, mp->fs->name, flag);
 		}
@@ -355,6 +384,33 @@ int data_proc_rtc(char *buffer, __pid_t pid)
 	return size;
 }
 
+/* prints the average and maximum of a latency counter in nanoseconds */
+static int sprintk_latency(char *buffer, char *name, struct latency *l)
+{
+	unsigned int avg, max, mhz;
+
+	avg = max = 0;
+	if(cpu_table.hz >= 1000000) {
+		mhz = cpu_table.hz / 1000000;
+		/* split to not overflow with long latencies */
+		avg = (l->avg_cycles / mhz) * 1000 + (l->avg_cycles % mhz) * 1000 / mhz;
+		max = (l->max_cycles / mhz) * 1000 + (l->max_cycles % mhz) * 1000 / mhz;
+	}
+	return sprintk(buffer, "%s %u %u\n", name, avg, max);
+}
+
+int data_proc_slabinfo(char *buffer, __pid_t pid)
+{
+	struct kmem_cache *cache;
+	int size;
+
+	size = sprintk(buffer, "name          active_objs num_objs objsize objperslab num_slabs\n");
+	for(cache = kmem_cache_list; cache; cache = cache->next) {
+		size += sprintk(buffer + size, "%-13s %11d %8d %7d %10d %9d\n", cache->name, cache->active_objs, cache->num_slabs * cache->num, cache->objsize, cache->num, cache->num_slabs);
+	}
+	return size;
+}
+
 int data_proc_stat(char *buffer, __pid_t pid)
 {
 	int n, size;
@@ -366,7 +422,7 @@ int data_proc_stat(char *buffer, __pid_t pid)
 	size += sprintk(buffer + size, "cpu %d %d %d %d\n", kstat.cpu_user, kstat.cpu_nice, kstat.cpu_system, idle);
 	size += sprintk(buffer + size, "disk 0 0 0 0\n");
 	size += sprintk(buffer + size, "page 0 0\n");
-	size += sprintk(buffer + size, "swap 0 0\n");
+	size += sprintk(buffer + size, "swap %u %u\n", kstat.swap_ins, kstat.swap_outs);
 	size += sprintk(buffer + size, "intr %u", kstat.irqs);
 	for(n = 0; n < NR_IRQS; n++) {
 		irq = irq_table[n];
@@ -376,11 +432,32 @@ int data_proc_stat(char *buffer, __pid_t pid)
 	}
 	size += sprintk(buffer + size, "\n");
 	size += sprintk(buffer + size, "ctxt %u\n", kstat.ctxt);
+	size += sprintk(buffer + size, "wakeups %u %u %u\n", kstat.wakeups, kstat.wakeup_procs, kstat.wakeup_herds);
+	size += sprintk_latency(buffer + size, "ctxt_latency", &kstat.ctxt_latency);
+	size += sprintk_latency(buffer + size, "fork_latency", &kstat.fork_latency);
+	size += sprintk_latency(buffer + size, "forkexec_latency", &kstat.forkexec_latency);
 	size += sprintk(buffer + size, "btime %d\n", kstat.boot_time);
 	size += sprintk(buffer + size, "processes %d\n", kstat.processes);
 	return size;
 }
 
+int data_proc_swaps(char *buffer, __pid_t pid)
+{
+	struct swap_info *si;
+	int n, size;
+
+	size = 0;
+	size += sprintk(buffer + size, "Filename                                Type            Size    Used    Priority\n");
+	for(n = 0; n < MAX_SWAPFILES; n++) {
+		si = &swap_info[n];
+		if(!(si->flags & SWP_WRITEOK)) {
+			continue;
+		}
+		size += sprintk(buffer + size, "%-40s%-16s%-8d%-8d%d\n", si->name, S_ISBLK(si->inode->i_mode) ? "partition" : "file", si->pages << 2, si->inuse << 2, si->prio);
+	}
+	return size;
+}
+
 int data_proc_uptime(char *buffer, __pid_t pid)
 {
 	struct proc *p;
@@ -397,6 +474,29 @@ int data_proc_fullversion(char *buffer, __pid_t pid)
 	return sprintk(buffer, "Fiwix version %s %s\n", UTS_RELEASE, UTS_VERSION);
 }
 
+#ifdef CONFIG_ZRAM
+int data_proc_zram(char *buffer, __pid_t pid)
+{
+	struct zram *zram;
+	struct zram_stats *st;
+	int n, size, ratio;
+
+	size = 0;
+	size += sprintk(buffer + size, "Device   DiskSize  OrigData ComprData   MemUsed ZeroPages  RawPages  Ratio\n");
+	for(n = 0; n < ZRAM_DRIVES; n++) {
+		zram = &zram_table[n];
+		if(!zram->table) {
+			continue;
+		}
+		st = &zram->stats;
+		ratio = st->mem_used ? (st->orig_data_size >> 10) * 100 / (st->mem_used >> 10) : 0;
+		size += sprintk(buffer + size, "zram%d  %7d kB%7d kB%7d kB%7d kB %9u %9u %3d.%02d\n", n, zram->size, st->orig_data_size >> 10, st->compr_data_size >> 10, st->mem_used >> 10, st->zero_pages, st->raw_pages, ratio / 100, ratio % 100);
+	}
+	size += sprintk(buffer + size, "Pool:  %7d kB\n", zram_pool_pages() << 2);
+	return size;
+}
+#endif /* CONFIG_ZRAM */
+
 
 int data_proc_unix(char *buffer, __pid_t pid)
 {
@@ -435,6 +535,12 @@ int data_proc_buffernr(char *buffer, __pid_t pid)
 	return sprintk(buffer, "%d\n", kstat.nr_buffers);
 }
 
+/* cached names, negative names, cache hits and cache misses */
+int data_proc_dentrystate(char *buffer, __pid_t pid)
+{
+	return sprintk(buffer, "%d\t%d\t%u\t%u\n", kstat.nr_dentries, kstat.nr_negative_dentries, kstat.dcache_hits, kstat.dcache_misses);
+}
+
 int data_proc_domainname(char *buffer, __pid_t pid)
 {
 	return sprintk(buffer, "%s\n", sys_utsname.domainname);
@@ -442,20 +548,12 @@ int data_proc_domainname(char *buffer, __pid_t pid)
 
 int data_proc_filemax(char *buffer, __pid_t pid)
 {
-	return sprintk(buffer, "%d\n", NR_OPENS);
+	return sprintk(buffer, "%d\n", kstat.max_fds);
 }
 
 int data_proc_filenr(char *buffer, __pid_t pid)
 {
-	int n, nr;
-
-	nr = 0;
-	for(n = 1; n < NR_OPENS; n++) {
-		if(fd_table[n].count != 0) {
-			nr++;
-		}
-	}
-	return sprintk(buffer, "%d\n", nr);
+	return sprintk(buffer, "%d\n", kstat.nr_fds);
 }
 
 int data_proc_hostname(char *buffer, __pid_t pid)
@@ -526,12 +624,17 @@ int data_proc_pid_cmdline(char *buffer, __pid_t pid)
 		for(n = 0; n < p->argc && (p->argv + n); n++) {
 			argv = p->argv + n;
 			offset = (int)argv & ~PAGE_MASK;
-			addr = get_mapped_addr(p, (int)argv) & PAGE_MASK;
-			addr = P2V(addr);
+			/* the page could be in a swap area */
+			if(!((addr = get_mapped_addr(p, (int)argv)) & PAGE_PRESENT)) {
+				break;
+			}
+			addr = P2V((addr & PAGE_MASK));
 			argv = (char **)(addr + offset);
 			offset = (int)argv[0] & ~PAGE_MASK;
-			addr = get_mapped_addr(p, (int)argv[0]) & PAGE_MASK;
-			addr = P2V(addr);
+			if(!((addr = get_mapped_addr(p, (int)argv[0])) & PAGE_PRESENT)) {
+				break;
+			}
+			addr = P2V((addr & PAGE_MASK));
 			arg = (char *)(addr + offset);
 			if(size + strlen(arg) < (PAGE_SIZE - 1)) {
 				size += sprintk(buffer + size, "%s", arg);
@@ -577,12 +680,17 @@ int data_proc_pid_environ(char *buffer, __pid_t pid)
 		for(n = 0; n < p->envc && (p->envp + n); n++) {
 			envp = p->envp + n;
 			offset = (int)envp & ~PAGE_MASK;
-			addr = get_mapped_addr(p, (int)envp) & PAGE_MASK;
-			addr = P2V(addr);
+			/* the page could be in a swap area */
+			if(!((addr = get_mapped_addr(p, (int)envp)) & PAGE_PRESENT)) {
+				break;
+			}
+			addr = P2V((addr & PAGE_MASK));
 			envp = (char **)(addr + offset);
 			offset = (int)envp[0] & ~PAGE_MASK;
-			addr = get_mapped_addr(p, (int)envp[0]) & PAGE_MASK;
-			addr = P2V(addr);
+			if(!((addr = get_mapped_addr(p, (int)envp[0])) & PAGE_PRESENT)) {
+				break;
+			}
+			addr = P2V((addr & PAGE_MASK));
 			env = (char *)(addr + offset);
 			if(size + strlen(env) < (PAGE_SIZE - 1)) {
 				size += sprintk(buffer + size, "%s", env);
@@ -687,7 +795,7 @@ int data_proc_pid_mountinfo(char *buffer, __pid_t pid)
 	mp = mount_table;
 
 	while(mp) {
-		if(mp->fs->fsop->flags != FSOP_KERN_MOUNT) {
+		if(!(mp->fs->fsop->flags & FSOP_KERN_MOUNT)) {
 			flag = mp->sb.flags & MS_RDONLY ? "ro" : "rw";
 			devname = mp->devname;
 			if(!strcmp(devname, "/dev/root")) {
@@ -5,6 +5,7 @@
  * Distributed under the terms of the Fiwix License.
  */
 
+#include <fiwix/config.h>
 #include <fiwix/types.h>
 #include <fiwix/stat.h>
 #include <fiwix/fs.h>
@@ -45,9 +46,14 @@ struct procfs_dir_entry procfs_array[][PROC_ARRAY_ENTRIES + 1] = {
 	{ 16,    REG,  1, 0, 10, "partitions",   data_proc_partitions },
 	{ 17,    REG,  1, 0, 3,  "rtc",          data_proc_rtc },
 	{ 18,    LNK,  1, 0, 4,  "self",         data_proc_self },
-	{ 19,    REG,  1, 0, 4,  "stat",         data_proc_stat },
-	{ 20,    REG,  1, 0, 6,  "uptime",       data_proc_uptime },
-	{ 21,    REG,  1, 0, 7,  "version",      data_proc_fullversion },
+	{ 19,    REG,  1, 0, 8,  "slabinfo",     data_proc_slabinfo },
+	{ 20,    REG,  1, 0, 4,  "stat",         data_proc_stat },
+	{ 21,    REG,  1, 0, 5,  "swaps",        data_proc_swaps },
+	{ 22,    REG,  1, 0, 6,  "uptime",       data_proc_uptime },
+	{ 23,    REG,  1, 0, 7,  "version",      data_proc_fullversion },
+#ifdef CONFIG_ZRAM
+	{ 24,    REG,  1, 0, 4,  "zram",         data_proc_zram },
+#endif /* CONFIG_ZRAM */
 	{ 0, 0, 0, 0, 0, NULL, NULL }
    },
    {	/* [1] /PID/ */
@@ -90,15 +96,16 @@ struct procfs_dir_entry procfs_array[][PROC_ARRAY_ENTRIES + 1] = {
 	{ 4001,  DIR,  2, 5, 1,  ".",            NULL },
 	{ 4,     DIR,  2, 3, 2,  "..",           NULL },
 	{ 5001,  REG,  1, 5, 9,  "buffer-nr",    data_proc_buffernr },
-	{ 5002,  REG,  1, 5, 10, "domainname",   data_proc_domainname },
-	{ 5003,  REG,  1, 5, 8,  "file-max",     data_proc_filemax },
-	{ 5004,  REG,  1, 5, 7,  "file-nr",      data_proc_filenr },
-	{ 5005,  REG,  1, 5, 8,  "hostname",     data_proc_hostname },
-	{ 5006,  REG,  1, 5, 9,  "inode-max",    data_proc_inodemax },
-	{ 5007,  REG,  1, 5, 8,  "inode-nr",     data_proc_inodenr },
-	{ 5008,  REG,  1, 5, 9,  "osrelease",    data_proc_osrelease },
-	{ 5009,  REG,  1, 5, 6,  "ostype",       data_proc_ostype },
-	{ 5010,  REG,  1, 5, 7,  "version",      data_proc_version },
+	{ 5002,  REG,  1, 5, 12, "dentry-state", data_proc_dentrystate },
+	{ 5003,  REG,  1, 5, 10, "domainname",   data_proc_domainname },
+	{ 5004,  REG,  1, 5, 8,  "file-max",     data_proc_filemax },
+	{ 5005,  REG,  1, 5, 7,  "file-nr",      data_proc_filenr },
+	{ 5006,  REG,  1, 5, 8,  "hostname",     data_proc_hostname },
+	{ 5007,  REG,  1, 5, 9,  "inode-max",    data_proc_inodemax },
+	{ 5008,  REG,  1, 5, 8,  "inode-nr",     data_proc_inodenr },
+	{ 5009,  REG,  1, 5, 9,  "osrelease",    data_proc_osrelease },
+	{ 5010,  REG,  1, 5, 6,  "ostype",       data_proc_ostype },
+	{ 5011,  REG,  1, 5, 7,  "version",      data_proc_version },
 	{ 0, 0, 0, 0, 0, NULL, NULL }
    },
    {	/* [4002] /sys/vm/ */
@@ -96,10 +96,21 @@ void invalidate_tlb(void);
 #define NOP() __asm__ __volatile__ ("nop":::"memory")
 #define HLT() __asm__ __volatile__ ("hlt":::"memory")
 
+/* no interrupt can be served between the 'sti' and the 'hlt' */
+#define STI_HLT() __asm__ __volatile__ ("sti ; hlt":::"memory")
+
 #define GET_CR2(cr2) __asm__ __volatile__ ("movl %%cr2, %0" : "=r" (cr2));
+#define SET_CR3(cr3) __asm__ __volatile__ ("movl %0, %%cr3" :: "r" (cr3) : "memory");
 #define GET_ESP(esp) __asm__ __volatile__ ("movl %%esp, %0" : "=r" (esp));
 #define SET_ESP(esp) __asm__ __volatile__ ("movl %0, %%esp" :: "r" (esp));
 
+/* bit scan forward/reverse of a non-zero word */
+#define BSF(bit, word) __asm__ __volatile__ ("bsfl %1, %0" : "=r" (bit) : "rm" (word));
+#define BSR(bit, word) __asm__ __volatile__ ("bsrl %1, %0" : "=r" (bit) : "rm" (word));
+
+/* low 32 bits of the TSC (without the serializing cpuid of get_rdtsc) */
+#define RDTSC_LOW(low) __asm__ __volatile__ ("rdtsc" : "=a" (low) :: "edx");
+
 #define SAVE_FLAGS(flags)			\
 	__asm__ __volatile__(			\
 		"pushfl ; popl %0\n\t"		\
@@ -167,6 +167,7 @@
 #define DRIVE_HAS_DATA32	0x80
 
 #define PRDT_MARK_END		0x8000
+#define ATA_MAX_SECTORS		256	/* max. sectors per command (LBA28) */
 #define WAKEUP_AND_RETURN	1
 
 /* ATA/ATAPI-4 based */
@@ -263,6 +264,7 @@ struct xfer_data {
 	int bm_cmd;
 	int cmd;
 	char *mode;
+	struct blk_request *br;		/* request (merged) being transferred */
 	int (*rw_end_fn)(struct ide *, struct xfer_data *);
 };
 
@@ -272,7 +274,7 @@ struct ata_xfer {
 	void (*copy_write_fn)(unsigned int, void *, unsigned int);
 	int write_cmd;
 	char copy_raw_factor;		/* 2 for 16bit, 4 for 32bit */
-	struct prd prd_table;		/* Physical Region Descriptor table */
+	struct prd *prd_table;		/* Physical Region Descriptor table */
 	unsigned char bm_command;	/* bus master command register */
 	unsigned char bm_status;	/* bus master status register */
 	unsigned char bm_prd_addr;	/* bus master PRD table address */
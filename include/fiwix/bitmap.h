@@ -0,0 +1,13 @@
+/*
+ * fiwix/include/fiwix/bitmap.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_BITMAP_H
+#define _FIWIX_BITMAP_H
+
+int find_next_zero_bit(const unsigned int *, int, int);
+
+#endif /* _FIWIX_BITMAP_H */
@@ -16,6 +16,14 @@
 #define BR_COMPLETED	2
 
 #define BRF_NOBLOCK	1
+#define BRF_ASYNC	2	/* nobody waits for it (read-ahead, write-back) */
+
+#define ELEVATOR_NOOP		1	/* FIFO order */
+#define ELEVATOR_DEADLINE	2	/* sorted by block with deadlines */
+#define NR_ELEVATORS		2
+
+#define READ_EXPIRE	(HZ / 2)	/* deadline for read requests */
+#define WRITE_EXPIRE	(5 * HZ)	/* deadline for write requests */
 
 struct blk_request {
 	int status;
@@ -28,13 +36,26 @@ struct blk_request {
 	struct device *device;
 	int (*fn)(__dev_t, __blk_t, char *, int);
 	int left;
+	int merged;			/* following requests merged in this one */
+	unsigned int expires;		/* deadline (in ticks) to be serviced */
 	struct blk_request *next;
 	struct blk_request *next_group;
 	struct blk_request *head_group;
 };
 
+struct elevator {
+	char *name;
+	void (*add)(struct device *, struct blk_request *);
+};
+
+extern int default_elevator;
+extern struct kmem_cache *blk_request_cache;
+
+int set_elevator(struct device *, int);
 void add_blk_request(struct blk_request *);
 int do_blk_request(struct device *, void *, struct buffer *);
 void run_blk_request(struct device *);
+int merge_blk_request(struct blk_request *, int);
+struct blk_request *end_blk_request(struct blk_request *, int);
 
 #endif /* _FIWIX_BLKQUEUE_H */
@@ -11,20 +11,27 @@
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
 #include <fiwix/blk_queue.h>
+#include <fiwix/timer.h>
 
 /* buffer flags */
 #define BUFFER_VALID	0x01
 #define BUFFER_LOCKED	0x02
 #define BUFFER_DIRTY	0x04
+#define BUFFER_ACTIVE	0x08	/* in (or back to) the active list */
 
 #define BLK_READ	1
 #define BLK_WRITE	2
 
+#define DIRTY_WRITEBACK	(5 * HZ)	/* interval of kbdflushd */
+#define DIRTY_EXPIRE	(30 * HZ)	/* age of a dirty buffer to be written */
+#define WRITEBACK_BATCH	256		/* buffers written in a single batch */
+
 struct buffer {
 	__dev_t dev;			/* device number */
 	__blk_t block;			/* block number */
 	int size;			/* block size (in bytes) */
 	int flags;
+	unsigned int dirty_time;	/* tick when it was dirtied */
 	char *data;			/* block contents */
 	struct buffer *prev;
 	struct buffer *next;
@@ -34,6 +41,9 @@ struct buffer {
 	struct buffer *next_free;
 	struct buffer *prev_dirty;
 	struct buffer *next_dirty;
+	struct inode *inode;		/* file that owns it (if dirty) */
+	struct buffer *prev_idirty;	/* dirty buffers of the same inode */
+	struct buffer *next_idirty;
 	struct buffer *first_sibling;
 	struct buffer *next_sibling;
 	struct buffer *next_retained;
@@ -47,9 +57,14 @@ extern unsigned int buffer_hash_table_size;	/* size in bytes */
 int gbread(struct device *, struct blk_request *);
 struct buffer *bread(__dev_t, __blk_t, int);
 void bwrite(struct buffer *);
+void mark_buffer_dirty(struct buffer *, struct inode *);
+void bwrite_inode(struct buffer *, struct inode *);
 void brelse(struct buffer *);
 void sync_buffers(__dev_t);
+int sync_inode_buffers(struct inode *);
+void detach_inode_buffers(struct inode *);
 void invalidate_buffers(__dev_t);
+void invalidate_buffer(__dev_t, __blk_t, int);
 int reclaim_buffers(void);
 int kbdflushd(void);
 void buffer_init(void);
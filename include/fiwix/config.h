@@ -10,10 +10,11 @@
 
 /* kernel tuning options */
 #define NR_PROCS		64	/* max. number of processes */
-#define NR_CALLOUTS		NR_PROCS	/* max. active callouts */
 #define NR_MOUNT_POINTS		8	/* max. number of mounted filesystems */
-#define NR_OPENS		1024	/* max. number of opened files */
+#define NR_OPENS		1024	/* min. number of opened files */
+#define NR_OPENS_PER_MB		64	/* opened files per MB of memory */
 #define NR_FLOCKS		(NR_PROCS * 5)	/* max. number of flocks */
+#define NR_DENTRIES		1024	/* max. number of cached names */
 
 #define FREE_PAGES_RATIO	5	/* % minimum of free memory pages */
 #define PAGE_HASH_PER_10K	10	/* % of % of hash buckets relative to
@@ -35,6 +36,7 @@
 #define MAX_SPU_NOTICES		10	/* max. number of messages on spurious
 					   interrupts */
 #define RAMDISK_DRIVES		1	/* num. of all-purpose ramdisk drives */
+#define ZRAM_DRIVES		1	/* num. of compressed ramdisk drives */
 #define NR_SYSCONSOLES		1	/* max. number of system consoles */
 
 
@@ -54,6 +56,7 @@
 #define CONFIG_PRINTK64
 #define CONFIG_PSAUX
 #define CONFIG_UNIX98_PTYS
+#define CONFIG_ZRAM
 
 
 /* configuration options to help debugging */
@@ -0,0 +1,36 @@
+/*
+ * fiwix/include/fiwix/dcache.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_DCACHE_H
+#define _FIWIX_DCACHE_H
+
+#include <fiwix/config.h>
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+
+#define DNAME_LEN		31	/* longer names are not cached */
+#define NR_DENTRY_HASH		(NR_DENTRIES / 4)
+
+struct dentry {
+	__dev_t dev;
+	__ino_t dir;			/* inode of the parent directory */
+	__ino_t inode;			/* 0 means negative entry */
+	unsigned char name_len;
+	char name[DNAME_LEN + 1];
+	struct dentry *prev_hash;
+	struct dentry *next_hash;
+	struct dentry *prev_lru;
+	struct dentry *next_lru;
+};
+
+int dcache_lookup(const char *, struct inode *, struct inode **);
+void dcache_remove(struct inode *, const char *);
+void dcache_purge(__dev_t, __ino_t);
+void dcache_flush(__dev_t);
+void dcache_init(void);
+
+#endif /* _FIWIX_DCACHE_H */
@@ -31,6 +31,8 @@ struct device {
 	void *requests_queue;
 	void *xfer_data;
 	struct device *next;
+	void *requests_tail;		/* last request in the queue */
+	int elevator;			/* I/O scheduler (0 = default) */
 };
 
 extern struct device *chr_device_table[NR_CHRDEV];
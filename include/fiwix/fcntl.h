@@ -40,6 +40,8 @@
 #define F_SETLK64	13
 #define F_SETLKW64	14
 #define F_DUPFD_CLOEXEC	1030	/* duplicate file descriptor with close-on-exec*/
+#define F_SETPIPE_SZ	1031	/* set the capacity of a pipe */
+#define F_GETPIPE_SZ	1032	/* get the capacity of a pipe */
 
 /* get/set process or process group ID to receive SIGURG signals */
 #define F_SETOWN	8	/* for sockets only */
@@ -11,6 +11,9 @@
 #include <fiwix/config.h>
 #include <fiwix/types.h>
 
+/* the fd numbers are stored in 'unsigned short int' (0xFFFF is reserved) */
+#define MAX_NR_OPENS	0xFFFF
+
 #define CHECK_UFD(ufd)							\
 {									\
 	if((ufd) > (OPEN_MAX - 1) || current->fd[(ufd)] == 0) {		\
@@ -18,8 +21,17 @@
 	}								\
 }									\
 
-extern unsigned int fd_table_size;	/* size in bytes */
+/* sequential read-ahead state */
+struct readahead {
+	__off_t next;			/* offset expected on sequential access */
+	__off_t start;			/* first page of the current window */
+	__off_t end;			/* end of the current window */
+	int size;			/* window size (in pages) */
+};
+
+extern unsigned int fd_table_size;	/* size in bytes (with the bitmap) */
 extern struct fd *fd_table;
+extern unsigned int *fd_bitmap;		/* used entries of fd_table */
 
 struct fd {
 	struct inode *inode;		/* file inode */
@@ -31,6 +43,8 @@ struct fd {
 	__off_t offset;			/* r/w pointer position */
 #endif /* CONFIG_OFFSET64 */
 	void *private_data;		/* needed for tty driver */
+	struct readahead ra;		/* read-ahead window */
+	struct epoll_item *ep_links;	/* epoll instances watching it */
 };
 
 #endif /* _FIWIX_FS_H */
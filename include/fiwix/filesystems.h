@@ -11,7 +11,7 @@
 #include <fiwix/types.h>
 #include <fiwix/limits.h>
 
-#define NR_FILESYSTEMS		6	/* supported filesystems */
+#define NR_FILESYSTEMS		7	/* supported filesystems */
 
 /* special device numbers for nodev filesystems */
 enum {
@@ -20,6 +20,7 @@ enum {
 	PIPE_DEV,
 	PROC_DEV,
 	SOCK_DEV,
+	EPOLL_DEV,
 };
 
 struct filesystems {
@@ -125,6 +126,11 @@ int pipefs_write(struct inode *, struct fd *, const char *, __size_t);
 int pipefs_ioctl(struct inode *, struct fd *, int, unsigned int);
 __loff_t pipefs_llseek(struct inode *, __loff_t);
 int pipefs_select(struct inode *, struct fd *, int);
+int pipefs_alloc_ring(struct inode *);
+void pipefs_free_ring(struct inode *);
+int pipefs_set_size(struct inode *, unsigned int);
+int pipefs_splice(struct fd *, struct fd *, __size_t, int);
+int pipefs_tee(struct fd *, struct fd *, __size_t, int);
 int pipefs_ialloc(struct inode *, int);
 void pipefs_ifree(struct inode *);
 int pipefs_read_superblock(__dev_t, struct superblock *);
@@ -166,6 +172,18 @@ void procfs_statfs(struct superblock *, struct statfs *);
 int procfs_read_superblock(__dev_t, struct superblock *);
 int procfs_init(void);
 
+/* epollfs prototypes */
+int epollfs_close(struct inode *, struct fd *);
+__loff_t epollfs_llseek(struct inode *, __loff_t);
+int epollfs_select(struct inode *, struct fd *, int);
+int epollfs_ctl(struct inode *, int, int, struct epoll_event *);
+int epollfs_wait(struct inode *, struct epoll_event *, int);
+void epollfs_release(struct fd *);
+int epollfs_ialloc(struct inode *, int);
+void epollfs_ifree(struct inode *);
+int epollfs_read_superblock(__dev_t, struct superblock *);
+int epollfs_init(void);
+
 #ifdef CONFIG_NET
 /* sockfs prototypes */
 int sockfs_open(struct inode *, struct fd *);
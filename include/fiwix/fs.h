@@ -19,6 +19,7 @@
 #include <fiwix/fs_iso9660.h>
 #include <fiwix/fs_proc.h>
 #include <fiwix/fs_sock.h>
+#include <fiwix/fs_epoll.h>
 
 #define BPS			512	/* bytes per sector */
 #define BLKSIZE_1K		1024	/* 1KB block size */
@@ -38,6 +39,7 @@
 #define MS_MGC_MSK		0xFFFF0000
 
 #define IS_RDONLY_FS(inode) (((inode)->sb) && ((inode)->sb->flags & MS_RDONLY))
+#define IS_SWAPFILE(inode) ((inode)->state & INODE_SWAPFILE)
 
 #define FOLLOW_LINKS	1
 #define MAX_SYMLINKS	8	/* this prevents infinite loops in symlinks */
@@ -55,12 +57,16 @@
 #define SEL_R		1
 #define SEL_W		2
 #define SEL_E		4
+#define SEL_HUP		8	/* the other end is gone (poll() only) */
+#define SEL_ERR		16	/* error condition (poll() only) */
 
 #define CLEAR_BIT	0
 #define SET_BIT		1
 
 #define INODE_LOCKED	0x01
 #define INODE_DIRTY	0x02
+#define INODE_DATASYNC	0x04	/* size or blocks changed since last fsync */
+#define INODE_SWAPFILE	0x08	/* active swap file, its blocks can't change */
 
 struct inode {
 	__mode_t	i_mode;		/* file mode */
@@ -81,6 +87,8 @@ struct inode {
 	__dev_t		rdev;
 	struct fs_operations *fsop;
 	struct superblock *sb;
+	struct readahead ra;		/* read-ahead window of mmap faults */
+	struct buffer *dirty_buffers;	/* dirty buffers of this inode */
 	struct inode *prev;
 	struct inode *next;
 	struct inode *prev_hash;
@@ -98,6 +106,7 @@ struct inode {
 #ifdef CONFIG_NET
 		struct sockfs_inode sockfs;
 #endif /* CONFIG_NET */
+		struct epollfs_inode epollfs;
 	} u;
 };
 extern struct inode *inode_table;
@@ -130,6 +139,7 @@ struct superblock {
 
 #define FSOP_REQUIRES_DEV	1	/* requires a block device */
 #define FSOP_KERN_MOUNT		2	/* mounted by kernel */
+#define FSOP_DCACHE		4	/* lookups are kept in the dentry cache */
 
 struct fs_operations {
 	int flags;
@@ -198,8 +208,9 @@ extern struct fs_operations ext2_fsop;
 extern struct fs_operations ext2_file_fsop;
 extern struct fs_operations ext2_dir_fsop;
 extern struct fs_operations ext2_symlink_fsop;
-extern int ext2_balloc(struct superblock *);
+extern int ext2_balloc(struct inode *);
 extern void ext2_bfree(struct superblock *, int);
+extern void ext2_discard_prealloc(struct inode *);
 
 /* fs_proc.h prototypes */
 extern struct fs_operations procfs_fsop;
@@ -231,12 +242,13 @@ extern struct fs_operations devpts_dir_fsop;
 /* generic VFS function prototypes */
 void inode_lock(struct inode *);
 void inode_unlock(struct inode *);
-struct inode *ialloc(struct superblock *, int);
+struct inode *ialloc(struct superblock *, struct inode *, int);
 struct inode *iget(struct superblock *, __ino_t);
 int bmap(struct inode *, __off_t, int);
 int check_fs_busy(__dev_t, struct inode *);
 void iput(struct inode *);
 void sync_inodes(__dev_t);
+int fsync_inode(struct inode *, int);
 void invalidate_inodes(__dev_t);
 void inode_init(void);
 
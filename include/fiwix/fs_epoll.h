@@ -0,0 +1,49 @@
+/*
+ * fiwix/include/fiwix/fs_epoll.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_FS_EPOLL_H
+#define _FIWIX_FS_EPOLL_H
+
+#include <fiwix/types.h>
+#include <fiwix/fd.h>
+#include <fiwix/wait.h>
+#include <fiwix/poll.h>
+
+#define EPOLL_NR_WAITS	2	/* wait queues per watched file */
+
+/* events that are always reported (even if not requested) */
+#define EPOLL_ALWAYS	(EPOLLERR | EPOLLHUP)
+#define EPOLL_FLAGS	(EPOLLONESHOT | EPOLLET)
+
+extern struct fs_operations epollfs_fsop;
+
+struct epoll_item {
+	struct eventpoll *ep;		/* instance that owns it */
+	struct fd *fd;			/* file being watched */
+	int ufd;			/* user fd used in epoll_ctl() */
+	struct epoll_event event;	/* requested events and user data */
+	int ready;			/* linked in the ready list */
+	struct wait_entry wait[EPOLL_NR_WAITS];
+	struct epoll_item *prev;	/* items of the instance */
+	struct epoll_item *next;
+	struct epoll_item *next_ready;	/* ready list of the instance */
+	struct epoll_item *prev_link;	/* items watching the same file */
+	struct epoll_item *next_link;
+};
+
+struct eventpoll {
+	struct epoll_item *items;
+	struct epoll_item *ready_head;
+	struct epoll_item *ready_tail;
+	struct wait_queue wq;		/* processes selecting the instance */
+};
+
+struct epollfs_inode {
+	struct eventpoll *ep;
+};
+
+#endif /* _FIWIX_FS_EPOLL_H */
@@ -17,6 +17,17 @@
 #define EXT2_ROOT_INO		 2	/* Root inode */
 #define EXT2_SUPER_MAGIC	0xEF53
 
+/*
+ * Revision levels
+ */
+#define EXT2_GOOD_OLD_REV	0	/* The good old (original) format */
+#define EXT2_DYNAMIC_REV	1 	/* V2 format w/ dynamic inode sizes */
+
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+#define EXT2_INODE_SIZE(s)	((s)->u.ext2.sb.s_rev_level == EXT2_GOOD_OLD_REV ? \
+				 EXT2_GOOD_OLD_INODE_SIZE : \
+				 (s)->u.ext2.sb.s_inode_size)
+
 /*
  * Macro-instructions used to manage several block sizes
  */
@@ -58,6 +69,11 @@ struct ext2_group_desc
 #define	EXT2_TIND_BLOCK			(EXT2_DIND_BLOCK + 1)
 #define	EXT2_N_BLOCKS			(EXT2_TIND_BLOCK + 1)
 
+/*
+ * Inode flags
+ */
+#define EXT2_INDEX_FL			0x00001000 /* hash-indexed directory */
+
 /*
  * Structure of an inode on the disk
  */
@@ -121,6 +137,12 @@ struct ext2_inode {
 #define	EXT2_VALID_FS			0x0001	/* Unmounted cleanly */
 #define	EXT2_ERROR_FS			0x0002	/* Errors detected */
 
+/*
+ * Misc. filesystem flags
+ */
+#define EXT2_FLAGS_SIGNED_HASH		0x0001	/* Signed dirhash in use */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002	/* Unsigned dirhash in use */
+
 /*
  * Structure of the super block
  */
@@ -193,9 +215,34 @@ struct ext2_super_block {
 	__u16	s_reserved_word_pad;
 	__u32	s_default_mount_opts;
  	__u32	s_first_meta_bg; 	/* First metablock block group */
-	__u32	s_reserved[190];	/* Padding to the end of the block */
+	__u32	s_mkfs_time;		/* When the filesystem was created */
+	__u32	s_jnl_blocks[17]; 	/* Backup of the journal inode */
+	__u32	s_blocks_count_hi;	/* Blocks count (ext4) */
+	__u32	s_r_blocks_count_hi;	/* Reserved blocks count (ext4) */
+	__u32	s_free_blocks_hi; 	/* Free blocks count (ext4) */
+	__u16	s_min_extra_isize;	/* All inodes have at least # bytes */
+	__u16	s_want_extra_isize; 	/* New inodes should reserve # bytes */
+	__u32	s_flags;		/* Miscellaneous flags */
+	__u32	s_reserved[167];	/* Padding to the end of the block */
 };
 
+/*
+ * Feature set definitions
+ */
+#define EXT2_FEATURE_COMPAT_DIR_INDEX		0x0020
+
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE	0x0002
+
+#define EXT2_FEATURE_INCOMPAT_FILETYPE		0x0002
+
+#define EXT2_FEATURE_RO_COMPAT_SUPP	(EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | \
+					 EXT2_FEATURE_RO_COMPAT_LARGE_FILE)
+#define EXT2_FEATURE_INCOMPAT_SUPP	EXT2_FEATURE_INCOMPAT_FILETYPE
+
+#define EXT2_HAS_COMPAT_FEATURE(s, mask) \
+	((s)->u.ext2.sb.s_feature_compat & (mask))
+
 /*
  * Structure of a directory entry
  */
@@ -245,6 +292,42 @@ struct ext2_dir_entry_2 {
 #define EXT2_FT_SOCK		6
 #define EXT2_FT_SYMLINK		7
 
+/*
+ * Hash tree (htree) directories.
+ *
+ * The first block of an indexed directory contains the entries '.' and '..'
+ * followed by the root of the tree, and every block of the tree is seen by
+ * older implementations as a single empty directory entry.
+ */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define DX_ROOT_INFO_OFFSET		24	/* after '.' and '..' */
+#define DX_NODE_OFFSET			8	/* after the empty fake entry */
+
+struct dx_root_info {
+	__u32	reserved_zero;
+	__u8	hash_version;
+	__u8	info_length;		/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+struct dx_entry {
+	__u32	hash;
+	__u32	block;			/* logical block of the directory */
+};
+
+/* overlaps the hash of the first dx_entry of every block of the tree */
+struct dx_countlimit {
+	__u16	limit;
+	__u16	count;
+};
+
 /* superblock in memory */
 struct ext2_sb_info {
 	unsigned int desc_per_block;
@@ -252,10 +335,43 @@ struct ext2_sb_info {
 	struct ext2_super_block sb;
 };
 
+#define EXT2_PREALLOC_BLOCKS	8	/* blocks reserved for sequential writers */
+#define EXT2_NR_EXTENTS		4	/* cached mappings per inode */
+
+/* run of logical blocks mapped to contiguous physical blocks */
+struct ext2_extent {
+	__u32	lblock;
+	__u32	pblock;
+	__u32	len;			/* 0 = unused */
+};
+
 /* inode in memory */
 struct ext2_i_info {
 	__u32	i_data[EXT2_N_BLOCKS];	/* Pointers to blocks */
 	__u32	i_dtime;
+	__u32	i_last_alloc;		/* last block allocated (goal) */
+	__u32	i_prealloc_block;	/* first preallocated block */
+	__u32	i_prealloc_count;	/* number of preallocated blocks */
+	struct ext2_extent i_ext[EXT2_NR_EXTENTS];
+	int	i_ext_next;		/* next entry to be replaced */
+	unsigned int i_ext_gen;		/* changes on every invalidation */
 };
 
+struct inode;
+struct buffer;
+
+/* namei.c */
+struct ext2_dir_entry_2 *ext2_match_dir_entry(char *, int, const char *, int);
+
+/* htree.c */
+__u32 ext2_dirhash(const char *, int, int, __u32 *);
+int ext2_dx_find_entry(struct inode *, const char *, int, struct buffer **, struct ext2_dir_entry_2 **);
+
+/* dindex.c */
+int ext2_dindex_find_entry(struct inode *, const char *, int, struct buffer **, struct ext2_dir_entry_2 **, int);
+void ext2_dindex_add(struct inode *, const char *, int, __blk_t);
+void ext2_dindex_del(struct inode *, const char *, int, __blk_t);
+void ext2_dindex_drop(struct inode *);
+void ext2_dindex_flush(__dev_t);
+
 #endif	/* _FIWIX_FS_EXT2_H */
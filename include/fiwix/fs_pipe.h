@@ -8,14 +8,33 @@
 #ifndef _FIWIX_FS_PIPE_H
 #define _FIWIX_FS_PIPE_H
 
+#include <fiwix/sleep.h>
+#include <fiwix/wait.h>
+
+#define PIPE_DEF_PAGES	16	/* default capacity (in pages) of a pipe */
+#define PIPE_MAX_PAGES	256	/* maximum capacity set by F_SETPIPE_SZ */
+
+#define PIPE_SIZE(i)	((i)->u.pipefs.i_nr_pages << PAGE_SHIFT)
+
+/* readers wait for data and writers wait for room in their own pipe */
+#define PIPE_READ_WAIT(i)	((void *)&(i)->u.pipefs.i_readers)
+#define PIPE_WRITE_WAIT(i)	((void *)&(i)->u.pipefs.i_writers)
+
+/* flags for splice() and tee() */
+#define SPLICE_F_MOVE		0x01
+#define SPLICE_F_NONBLOCK	0x02
+#define SPLICE_F_MORE		0x04
+
 extern struct fs_operations pipefs_fsop;
 
 struct pipefs_inode {
-	char *i_data;			/* buffer */
+	char **i_pages;			/* ring of pages (allocated on demand) */
+	unsigned int i_nr_pages;	/* size of the ring (a power of two) */
 	unsigned int i_readoff;		/* offset for reads */
-	unsigned int i_writeoff;	/* offset for writes */
 	unsigned int i_readers;		/* number of readers */
 	unsigned int i_writers;		/* number of writers */
+	struct resource i_lock;		/* serializes the accesses to the ring */
+	struct wait_queue i_wq;		/* processes selecting the pipe */
 };
 
 #endif /* _FIWIX_FS_PIPE_H */
@@ -10,6 +10,8 @@
 #define BLKRRPART	0x125F		/* re-read partition table */
 #define BLKGETSIZE	0x1260		/* return device size */
 #define BLKFLSBUF	0x1261		/* flush buffer cache */
+#define BLKELVGET	0x126A		/* get the I/O scheduler */
+#define BLKELVSET	0x126B		/* set the I/O scheduler */
 
 /* 0x54 is just a magic number to make these relatively unique ('T') */
 #define TCGETS		0x5401
@@ -13,6 +13,7 @@
 
 #define QEMU_DEBUG_PORT		0xE9	/* for Bochs-style debug console */
 #define BUDDY_MAX_LEVEL		7
+#define BUDDY_HIGH_MAX_ORDER	10
 
 #define PANIC(format, args...)						\
 {									\
@@ -42,6 +43,7 @@ extern int kparm_memsize;
 extern int kparm_extmemsize;
 extern int kparm_rootdev;
 extern int kparm_ramdisksize;
+extern int kparm_zramsize;
 extern char kparm_rootfstype[10];
 extern char kparm_rootdevname[DEVNAME_MAX + 1];
 extern char kparm_initrd[DEVNAME_MAX + 1];
@@ -66,6 +68,11 @@ extern char _etext[], _edata[], _end[];
 
 extern char kernel_cmdline[NAME_MAX + 1];
 
+struct latency {
+	unsigned int avg_cycles;	/* moving average (in CPU cycles) */
+	unsigned int max_cycles;	/* longest sample (in CPU cycles) */
+};
+
 struct kernel_stat {
 	int flags;			/* kernel flags */
 	unsigned int cpu_user;		/* ticks in user-mode */
@@ -74,6 +81,12 @@ struct kernel_stat {
 	unsigned int irqs;		/* irq counter */
 	unsigned int sirqs;		/* spurious irq counter */
 	unsigned int ctxt;		/* context switches */
+	unsigned int wakeups;		/* wakeups that found sleepers */
+	unsigned int wakeup_procs;	/* processes woken up by them */
+	unsigned int wakeup_herds;	/* wakeups of more than one process */
+	struct latency ctxt_latency;	/* context switch */
+	struct latency fork_latency;	/* fork() */
+	struct latency forkexec_latency;/* from fork() to execve() in the child */
 	unsigned int ticks;		/* ticks (1/HZths of sec) since boot */
 	unsigned int system_time;	/* current system time (since the Epoch) */
 	unsigned int boot_time;		/* boot time (since the Epoch) */
@@ -87,6 +100,8 @@ struct kernel_stat {
 	int total_mem_pages;		/* total memory (in pages) */
 	int free_pages;			/* pages on free list */
 	int min_free_pages;		/* minimal free pages in system */
+	int max_fds;			/* max. number of opened files */
+	int nr_fds;			/* current opened files */
 	int max_inodes;			/* max. number of allocated inodes */
 	int nr_inodes;			/* current allocated inodes */
 	int max_buffers_size;		/* max. allocated buffers (in KB) */
@@ -97,14 +112,36 @@ struct kernel_stat {
 	int max_dirty_buffers;		/* max. number of dirty buffers */
 	int dirty_buffers;		/* dirty buffers (in KB) */
 	int nr_dirty_buffers;		/* current dirty buffers */
+	int active_buffers;		/* buffers in the active list (in KB) */
+	int inactive_buffers;		/* buffers in the inactive list (in KB) */
+	unsigned int buffer_hits;	/* blocks found in the buffer cache */
+	unsigned int buffer_misses;	/* blocks not found in the buffer cache */
+	unsigned int buffer_evictions;	/* valid blocks dropped from the cache */
 	unsigned int random_seed;	/* next random seed */
 	int pages_reclaimed;		/* last pages reclaimed from buffer */
 	int nr_flocks;			/* current allocated file locks */
+	int nr_dentries;		/* current cached names */
+	int nr_negative_dentries;	/* cached names that don't exist */
+	unsigned int dcache_hits;	/* lookups found in dentry cache */
+	unsigned int dcache_misses;	/* lookups not found in dentry cache */
+	unsigned int ra_pages;		/* pages requested by read-ahead */
+	unsigned int ra_hits;		/* page cache misses read ahead */
+	unsigned int ra_misses;		/* page cache misses not read ahead */
+	int total_swap_pages;		/* slots in the swap areas */
+	int free_swap_pages;		/* free slots in the swap areas */
+	unsigned int swap_ins;		/* pages read from swap */
+	unsigned int swap_outs;		/* pages written to swap */
 
 	/* buddy_low algorithm statistics */
 	int buddy_low_count[BUDDY_MAX_LEVEL + 1];
 	int buddy_low_num_pages;	/* number of pages used */
 	int buddy_low_mem_requested;	/* total memory requested (in bytes) */
+	int slab_pages;			/* pages used by object caches */
+
+	/* buddy_high algorithm statistics */
+	int buddy_high_count[BUDDY_HIGH_MAX_ORDER + 1];
+	int buddy_high_free[BUDDY_HIGH_MAX_ORDER + 1];
+	int buddy_high_num_pages;	/* number of pages used */
 
 	int mount_points;		/* number of fs currently mounted */
 };
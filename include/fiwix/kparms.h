@@ -36,6 +36,10 @@ static struct kparms parm_table[] = {
 	     0x440, 0x441, 0x442, 0x443
 	   }
 	},
+	{ "elevator=",
+	   { "noop", "deadline" },
+	   { 1, 2 },
+	},
 	{ "initrd=",
 	   { 0 },
 	   { 0 },
@@ -80,6 +84,12 @@ static struct kparms parm_table[] = {
 	   { "minix", "ext2", "iso9660" },
 	   { 0 }
 	},
+#ifdef CONFIG_ZRAM
+	{ "zramsize=",
+	   { 0 },
+	   { 0 },
+	},
+#endif /* CONFIG_ZRAM */
 
 	{ NULL }
 };
@@ -0,0 +1,21 @@
+/*
+ * fiwix/include/fiwix/lz4.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_LZ4_H
+#define _FIWIX_LZ4_H
+
+#define LZ4_HASH_LOG		12
+#define LZ4_HASH_SIZE		(1 << LZ4_HASH_LOG)
+
+/* work memory needed by lz4_compress() */
+#define LZ4_WRKMEM_SIZE		(LZ4_HASH_SIZE * sizeof(unsigned short int))
+
+/* input sizes are limited to 64KB, enough for a page */
+int lz4_compress(const unsigned char *, int, unsigned char *, int, void *);
+int lz4_decompress(const unsigned char *, int, unsigned char *, int);
+
+#endif /* _FIWIX_LZ4_H */
@@ -26,9 +26,16 @@
 
 #define PAGE_LOCKED		0x001
 #define PAGE_BUDDYLOW		0x010	/* page belongs to buddy_low */
+#define PAGE_SLAB		0x020	/* page is a slab of an object cache */
+#define PAGE_BUDDYHIGH		0x040	/* page belongs to buddy_high */
 #define PAGE_RESERVED		0x100	/* kernel, BIOS address, ... */
 #define PAGE_COW		0x200	/* marked for Copy-On-Write */
 
+#define SLAB_ALIGN		32	/* objects start at a cache line boundary */
+
+#define RA_MIN_PAGES		4	/* initial read-ahead window */
+#define RA_MAX_PAGES		32	/* maximum read-ahead window */
+
 #define PFAULT_V		0x01	/* protection violation */
 #define PFAULT_W		0x02	/* during write */
 #define PFAULT_U		0x04	/* in user mode */
@@ -36,10 +43,14 @@
 #define GET_PGDIR(address)	((unsigned int)((address) >> 22) & 0x3FF)
 #define GET_PGTBL(address)	((unsigned int)((address) >> 12) & 0x3FF)
 
+/* a page table shared copy-on-write since fork() is mapped read-only */
+#define PGTBL_SHARED(pde)	(((pde) & (PAGE_PRESENT | PAGE_RW | PAGE_USER)) == (PAGE_PRESENT | PAGE_USER))
+
 struct page {
 	int page;		/* page number */
 	int count;		/* usage counter */
 	int flags;
+	int order;		/* block order (buddy_high) */
 	__ino_t inode;		/* inode of the file */
 	__off_t offset;		/* file offset */
 	__dev_t dev;		/* device where file resides */
@@ -82,6 +93,44 @@ unsigned int bl_malloc(__size_t);
 void bl_free(unsigned int);
 void buddy_low_init(void);
 
+/* buddy_high.c */
+unsigned int bh_malloc(__size_t);
+void bh_free(unsigned int);
+int bh_shrink(void);
+void buddy_high_init(void);
+
+/* slab.c */
+struct kmem_cache {
+	char *name;
+	int objsize;		/* size requested by the creator */
+	int size;		/* objsize aligned to SLAB_ALIGN */
+	int num;		/* objects per slab */
+	void (*ctor)(void *);
+	struct slab *partial;	/* slabs with some free objects */
+	struct slab *full;	/* slabs without free objects */
+	struct slab *free;	/* one unused slab kept in reserve */
+	int active_objs;
+	int num_slabs;
+	struct kmem_cache *next;
+};
+
+struct slab {
+	struct kmem_cache *cache;
+	void *freelist;		/* first free object */
+	int inuse;		/* objects allocated */
+	struct slab *prev;
+	struct slab *next;
+};
+
+extern struct kmem_cache *kmem_cache_list;
+extern struct kmem_cache *vma_cache;
+extern struct kmem_cache *name_cache;
+
+struct kmem_cache *kmem_cache_create(char *, __size_t, void (*)(void *));
+void *kmem_cache_alloc(struct kmem_cache *);
+void kmem_cache_free(struct kmem_cache *, void *);
+void slab_init(void);
+
 /* alloc.c */
 unsigned int kmalloc(__size_t);
 void kfree(unsigned int);
@@ -90,13 +139,16 @@ void kfree(unsigned int);
 void page_lock(struct page *);
 void page_unlock(struct page *);
 struct page *get_free_page(void);
+struct page *get_free_page_run(int);
 struct page *search_page_hash(struct inode *, __off_t);
 void release_page(struct page *);
 int is_valid_page(int);
+void truncate_inode_pages(struct inode *, __off_t);
 void invalidate_inode_pages(struct inode *);
 void update_page_cache(struct inode *, __off_t, const char *, int);
 int write_page(struct page *, struct inode *, __off_t, unsigned int);
-int bread_page(struct page *, struct inode *, __off_t, char, char);
+int bread_page(struct page *, struct inode *, __off_t);
+void readahead(struct inode *, struct readahead *, __off_t, int);
 int file_read(struct inode *, struct fd *, char *, __size_t);
 void reserve_pages(unsigned int, unsigned int);
 void page_init(int);
@@ -106,6 +158,8 @@ unsigned int map_kaddr(unsigned int *,unsigned int, unsigned int, unsigned int,
 void bss_init(void);
 unsigned int setup_tmp_pgdir(unsigned int, unsigned int);
 unsigned int get_mapped_addr(struct proc *, unsigned int);
+int unshare_page_table(struct proc *, unsigned int);
+void release_shared_page_tables(struct proc *);
 int clone_pages(struct proc *);
 int free_page_tables(struct proc *);
 unsigned int map_page(struct proc *, unsigned int, unsigned int, unsigned int);
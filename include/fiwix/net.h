@@ -13,6 +13,7 @@
 #include <fiwix/types.h>
 #include <fiwix/socket.h>
 #include <fiwix/fd.h>
+#include <fiwix/wait.h>
 #include <fiwix/net/unix.h>
 
 #define SYS_SOCKET	1
@@ -43,6 +44,7 @@ struct socket {
 	int queue_limit;		/* max. number of pending connections */
 	struct socket *queue_head;	/* first connection in queue */
 	struct socket *next_queue;	/* next connection in queue */
+	struct wait_queue wq;		/* processes selecting the socket */
 	union {
 		struct unix_info unix;
 	} u;
@@ -1,7 +1,7 @@
 /*
  * fiwix/include/fiwix/pit.h
  *
- * Copyright 2018, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
@@ -23,6 +23,10 @@
 #define LSB_MSB		0x30	/* LSB then MSB */
 #define SEL_CHAN0	0x00	/* select channel 0 */
 #define SEL_CHAN2	0x80	/* select channel 2 */
+#define READ_BACK	0xC0	/* read-back command (latch count and status) */
+#define RB_CHAN0	0x02	/* read-back of channel 0 */
+
+#define PIT_OUTPUT	0x80	/* status: state of the OUT pin */
 
 /*
  * PS/2 System Control Port B bits
@@ -46,6 +50,8 @@
 void pit_beep_on(void);
 void pit_beep_off(unsigned int);
 int pit_getcounter0(void);
+int pit_readback0(int *);
+void pit_oneshot(unsigned short int);
 void pit_init(unsigned short int);
 
 #endif /* _FIWIX_PIT_H */
@@ -0,0 +1,78 @@
+/*
+ * fiwix/include/fiwix/poll.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_POLL_H
+#define _FIWIX_POLL_H
+
+#include <fiwix/types.h>
+#include <fiwix/fd.h>
+#include <fiwix/wait.h>
+
+#define POLLIN		0x0001	/* there is data to read */
+#define POLLPRI		0x0002	/* there is urgent data to read */
+#define POLLOUT		0x0004	/* writing now will not block */
+#define POLLERR		0x0008	/* error condition */
+#define POLLHUP		0x0010	/* hung up */
+#define POLLNVAL	0x0020	/* invalid file descriptor */
+#define POLLRDNORM	0x0040	/* normal data may be read */
+#define POLLRDBAND	0x0080	/* priority data may be read */
+#define POLLWRNORM	0x0100	/* writing now will not block */
+#define POLLWRBAND	0x0200	/* priority data may be written */
+
+/* events reported by the files without the select() method */
+#define DEFAULT_POLLMASK	(POLLIN | POLLOUT | POLLRDNORM | POLLWRNORM)
+
+struct pollfd {
+	int fd;
+	short int events;	/* requested events */
+	short int revents;	/* returned events */
+};
+
+#define EPOLLIN		POLLIN
+#define EPOLLPRI	POLLPRI
+#define EPOLLOUT	POLLOUT
+#define EPOLLERR	POLLERR
+#define EPOLLHUP	POLLHUP
+#define EPOLLRDNORM	POLLRDNORM
+#define EPOLLRDBAND	POLLRDBAND
+#define EPOLLWRNORM	POLLWRNORM
+#define EPOLLWRBAND	POLLWRBAND
+#define EPOLLONESHOT	0x40000000	/* disabled after the first event */
+#define EPOLLET		0x80000000	/* edge-triggered */
+
+/* opcodes for epoll_ctl() */
+#define EPOLL_CTL_ADD	1
+#define EPOLL_CTL_DEL	2
+#define EPOLL_CTL_MOD	3
+
+#define EPOLL_MAX_EVENTS	1024	/* maximum value of 'maxevents' */
+
+struct epoll_event {
+	__u32 events;
+	__u64 data;
+} __attribute__((packed));
+
+/*
+ * While a process scans its files in select(), poll() or epoll_ctl(), its
+ * 'poll_table' is set and every select() method links it (through the
+ * 'add' function) in the wait queue of the object being checked.
+ */
+struct poll_table {
+	void (*add)(struct poll_table *, struct wait_queue *);
+	void *data;			/* epoll item (epoll_ctl() only) */
+	struct poll_page *pages;	/* wait entries of select() and poll() */
+	int triggered;			/* a queue was woken up */
+	int error;
+};
+
+void select_wait(struct wait_queue *);
+void poll_table_init(struct poll_table *);
+void poll_table_sleep(struct poll_table *);
+void poll_table_free(struct poll_table *);
+int poll_events(struct fd *, int);
+
+#endif /* _FIWIX_POLL_H */
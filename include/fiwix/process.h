@@ -41,6 +41,7 @@ struct vma {
 #define PF_PEXEC	0x00000002	/* has performed a sys_execve() */
 #define PF_USEREAL	0x00000004	/* use real UID in permission checks */
 #define PF_NOTINTERRUPT	0x00000008	/* non-interruptible sleeping */
+#define PF_VFORK	0x00000010	/* borrows the address space of its parent */
 
 #define MMAP_START	0x40000000	/* mmap()s start at 1GB */
 #define IS_SUPERUSER	(current->euid == 0)
@@ -116,6 +117,8 @@ struct proc {
 	int priority;
 	int cpu_count;			/* time of process running */
 	__time_t start_time;
+	unsigned int fork_start;	/* TSC value when fork() created it */
+	unsigned int vfork_cr3;		/* own Page Directory after vfork() */
 	int exit_code;	
 	void *sleep_address;
 	unsigned short int uid;		/* real user ID */
@@ -126,6 +129,8 @@ struct proc {
 	unsigned short int sgid;	/* saved group ID */
 	unsigned short int fd[OPEN_MAX];
 	unsigned char fd_flags[OPEN_MAX];
+	unsigned int fd_bitmap[OPEN_MAX / 32];	/* used entries of fd[] */
+	int fd_hint;			/* all fd[] below it are used */
 	struct inode *root;
 	struct inode *pwd;		/* process working directory */
 	unsigned int entry_address;
@@ -150,6 +155,7 @@ struct proc {
 	unsigned int it_virt_interval, it_virt_value;
 	unsigned int it_prof_interval, it_prof_value;
 	unsigned int timeout;
+	struct poll_table *poll_table;	/* select(), poll() or epoll_ctl() */
 	struct rlimit rlim[RLIM_NLIMITS];
 	unsigned int rss;
 	__mode_t umask;
@@ -163,6 +169,10 @@ struct proc {
 	struct proc *next_sleep;
 	struct proc *prev_run;
 	struct proc *next_run;
+	struct runqueue *rq;		/* run queue where it is linked */
+	int rq_level;			/* level inside that run queue */
+	struct proc *prev_rq;
+	struct proc *next_rq;
 };
 
 extern struct proc *current;
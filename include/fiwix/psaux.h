@@ -13,6 +13,7 @@
 #include <fiwix/fs.h>
 #include <fiwix/charq.h>
 #include <fiwix/sigcontext.h>
+#include <fiwix/wait.h>
 
 #define PSAUX_IRQ	12
 
@@ -23,6 +24,7 @@ struct psaux {
 	int count;
 	struct clist read_q;
 	struct clist write_q;
+	struct wait_queue wq;		/* processes selecting the device */
 };
 extern struct psaux psaux_table;
 
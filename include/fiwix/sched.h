@@ -8,6 +8,7 @@
 #ifndef _FIWIX_SCHED_H
 #define _FIWIX_SCHED_H
 
+#include <fiwix/kernel.h>
 #include <fiwix/process.h>
 
 #define PRIO_PROCESS	0
@@ -25,6 +26,20 @@
 
 #define DEF_PRIORITY	(20 * HZ / 100)	/* 200ms of time slice */
 
+/*
+ * Each run queue has a list of processes per level (the remaining quantum)
+ * and a bitmap of non-empty levels, so the process with the highest
+ * 'cpu_count' is found with a single bit scan. Quanta beyond the last level
+ * share it.
+ */
+#define NR_SCHED_LEVELS	32	/* one bit per level in the bitmap */
+
+struct runqueue {
+	unsigned int bitmap;
+	struct proc *head[NR_SCHED_LEVELS];
+	struct proc *tail[NR_SCHED_LEVELS];
+};
+
 extern int need_resched;
 
 #define SI_LOAD_SHIFT   16
@@ -48,6 +63,10 @@ extern unsigned int avenrun[3];		/* Load averages */
 /* ------------------------------------------------------------------------ */
 
 
+void sched_enqueue(struct proc *);
+void sched_dequeue(struct proc *);
+void sched_tick(struct proc *);
+void add_latency(struct latency *, unsigned int);
 void do_sched(void);
 void set_tss(struct proc *);
 void sched_init(void);
@@ -22,6 +22,8 @@
 #define PAGE_PRESENT	0x001	/* Present */
 #define PAGE_RW		0x002	/* Read/Write */
 #define PAGE_USER	0x004	/* User */
+#define PAGE_ACCESSED	0x020	/* Accessed (set by the CPU) */
+#define PAGE_DIRTY	0x040	/* Dirty (set by the CPU) */
 #define PAGE_NOALLOC	0x200	/* No Page Allocated (OS managed) */
 
 #ifndef ASM_FILE
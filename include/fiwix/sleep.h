@@ -1,14 +1,21 @@
 /*
  * fiwix/include/fiwix/sleep.h
  *
- * Copyright 2018-2021, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
 #ifndef _FIWIX_SLEEP_H
 #define _FIWIX_SLEEP_H
 
+/* defined before the includes, it's also embedded in the inodes (pipefs) */
+struct resource {
+	char locked;
+	char wanted;
+};
+
 #include <fiwix/process.h>
+#include <fiwix/wait.h>
 
 #define AREA_BH			0x00000001
 #define AREA_CALLOUT		0x00000002
@@ -17,15 +24,11 @@
 
 extern struct proc *proc_run_head;
 
-struct resource {
-	char locked;
-	char wanted;
-};
-
 void runnable(struct proc *);
 void not_runnable(struct proc *, int);
 int sleep(void *, int);
 void wakeup(void *);
+int wakeup_one(void *);
 void wakeup_proc(struct proc *);
 
 void lock_resource(struct resource *);
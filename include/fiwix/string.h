@@ -20,6 +20,23 @@
 #define IS_NUMERIC(c)	((c) >= '0' && (c) <= '9')
 #define IS_SPACE(c)	((c) == ' ')
 
+#define NR_BENCH_PAGES	32	/* pages used to benchmark the memops */
+
+/* x87 FPU state as saved by the 'fnsave' instruction */
+struct fpu_state {
+	unsigned int data[27];
+};
+
+struct memops {
+	char *name;
+	int cpu_flag;			/* CPU feature needed (0 = none) */
+	void (*copy)(void *, const void *);
+	void (*zero)(void *);
+};
+
+extern void (*memcpy_page)(void *, const void *);
+extern void (*memzero_page)(void *);
+
 void swap_asc_word(char *, int);
 int strcmp(const char *, const char *);
 int strncmp(const char *, const char *, __ssize_t);
@@ -38,5 +55,6 @@ void memcpy_l(void *, const void *, unsigned int);
 void memset_b(void *, unsigned char, unsigned int);
 void memset_w(void *, unsigned short int, unsigned int);
 void memset_l(void *, unsigned int, unsigned int);
+void strings_init(void);
 
 #endif /* _INCLUDE_STRING_H */
@@ -0,0 +1,88 @@
+/*
+ * fiwix/include/fiwix/swap.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_SWAP_H
+#define _FIWIX_SWAP_H
+
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/mm.h>
+
+#define MAX_SWAPFILES		8	/* maximum number of swap areas */
+#define SWAP_NAME_LEN		64	/* length of the name in /proc/swaps */
+
+#define SWAP_FLAG_PREFER	0x8000	/* set if swap priority specified */
+#define SWAP_FLAG_PRIO_MASK	0x7FFF
+
+#define SWAP_CLUSTER		8	/* slots in a swap-in read-ahead */
+#define NR_SWAP_RECLAIM		32	/* pages reclaimed in a single shot */
+
+#define SWAP_MAP_BAD		0xFFFF	/* slot not usable */
+
+/* swap_info flags */
+#define SWP_USED		0x01
+#define SWP_WRITEOK		0x02	/* accepts new pages */
+
+/*
+ * A page moved to a swap area leaves in its (non-present) page table entry
+ * the area and the slot where it was written:
+ *
+ * 31                    12 11      8 7         2 1    0
+ * +-----------------------+---------+-----------+--+---+
+ * |    offset (slot)      | (unused)|   type    |1 | 0 |
+ * +-----------------------+---------+-----------+--+---+
+ */
+#define SWP_MARK		0x002
+#define SWP_ENTRY(type, offset)	(((offset) << PAGE_SHIFT) | ((type) << 2) | SWP_MARK)
+#define SWP_TYPE(entry)		(((entry) >> 2) & 0x3F)
+#define SWP_OFFSET(entry)	((entry) >> PAGE_SHIFT)
+#define IS_SWP_ENTRY(pte)	(((pte) & (PAGE_PRESENT | SWP_MARK)) == SWP_MARK)
+
+/* first page of a swap area (Linux SWAPSPACE2 format) */
+union swap_header {
+	struct {
+		char reserved[PAGE_SIZE - 10];
+		char magic[10];			/* "SWAPSPACE2" */
+	} magic;
+	struct {
+		char bootbits[1024];		/* space for disklabel, etc. */
+		__u32 version;
+		__u32 last_page;
+		__u32 nr_badpages;
+		unsigned char uuid[16];
+		char volume_name[16];
+		__u32 padding[117];
+		__u32 badpages[1];
+	} info;
+};
+
+struct swap_info {
+	int flags;
+	int prio;			/* higher values are used first */
+	__dev_t dev;			/* device where the slots are */
+	struct inode *inode;		/* swap partition or swap file */
+	unsigned short int *map;	/* users of each slot */
+	__blk_t *blocks;		/* blocks of each slot (swap files) */
+	int blksize;
+	unsigned int max;		/* size of the map */
+	unsigned int pages;		/* usable slots */
+	unsigned int inuse;		/* slots being used */
+	unsigned int cluster_next;	/* next slot to be tried */
+	char name[SWAP_NAME_LEN + 1];
+};
+
+extern struct swap_info swap_info[MAX_SWAPFILES];
+
+unsigned int get_swap_page(void);
+void swap_free(unsigned int);
+void swap_duplicate(unsigned int);
+int swap_in(struct vma *, unsigned int);
+int swap_out(int);
+int swap_on(struct inode *, const char *, int);
+int swap_off(struct inode *);
+
+#endif /* _FIWIX_SWAP_H */
@@ -24,6 +24,7 @@
 #include <fiwix/sigcontext.h>
 #include <fiwix/mman.h>
 #include <fiwix/ipc.h>
+#include <fiwix/poll.h>
 
 #define NR_SYSCALLS	(sizeof(syscall_table) / sizeof(unsigned int))
 
@@ -117,6 +118,7 @@ int old_select(unsigned int *);
 int sys_symlink(const char *, const char *);
 int sys_lstat(const char *, struct old_stat *);
 int sys_readlink(const char *, char *, __size_t);
+int sys_swapon(const char *, int);
 int sys_reboot(int, int, int);
 int old_mmap(struct mmap *);
 int sys_munmap(unsigned int, __size_t);
@@ -140,6 +142,7 @@ int sys_iopl(int, int, int, int, int, int, struct sigcontext *);
 int sys_iopl(int, int, int, int, int, struct sigcontext *);
 #endif /* CONFIG_SYSCALL_6TH_ARG */
 int sys_wait4(__pid_t, int *, int, struct rusage *);
+int sys_swapoff(const char *);
 int sys_sysinfo(struct sysinfo *);
 #ifdef CONFIG_SYSVIPC
 int sys_ipc(unsigned int, struct sysvipc_args *);
@@ -168,8 +171,14 @@ int sys_writev(int, struct iovec *, int);
 int sys_getsid(__pid_t);
 int sys_fdatasync(int);
 int sys_nanosleep(const struct timespec *, struct timespec *);
+int sys_poll(struct pollfd *, unsigned int, int);
 int sys_chown(const char *, __uid_t, __gid_t);
 int sys_getcwd(char *, __size_t);
+#ifdef CONFIG_SYSCALL_6TH_ARG
+int sys_vfork(int, int, int, int, int, int, struct sigcontext *);
+#else
+int sys_vfork(int, int, int, int, int, struct sigcontext *);
+#endif /* CONFIG_SYSCALL_6TH_ARG */
 #ifdef CONFIG_MMAP2
 int sys_mmap2(unsigned int, unsigned int, unsigned int, unsigned int, int, unsigned int);
 #endif /* CONFIG_MMAP2 */
@@ -181,6 +190,13 @@ int sys_fstat64(unsigned int, struct stat64 *);
 int sys_chown32(const char *, unsigned int, unsigned int);
 int sys_getdents64(unsigned int, struct dirent64 *, unsigned int);
 int sys_fcntl64(unsigned int, int, unsigned int);
+int sys_epoll_create(int);
+int sys_epoll_ctl(int, int, int, struct epoll_event *);
+int sys_epoll_wait(int, struct epoll_event *, int, int);
 int sys_utimes(const char *, struct timeval times[2]);
+#ifdef CONFIG_SYSCALL_6TH_ARG
+int sys_splice(int, __loff_t *, int, __loff_t *, __size_t, unsigned int);
+#endif /* CONFIG_SYSCALL_6TH_ARG */
+int sys_tee(int, int, __size_t, unsigned int);
 
 #endif /* _FIWIX_SYSCALLS_H */
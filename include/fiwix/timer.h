@@ -1,7 +1,7 @@
 /*
  * fiwix/include/fiwix/timer.h
  *
- * Copyright 2018, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
@@ -26,21 +26,35 @@
 
 #define INFINITE_WAIT	0xFFFFFFFF
 
-struct callout {
-	int expires;
-	void (*fn)(unsigned int);
-	unsigned int arg;
-	struct callout *next;
-};
+/* timing wheel: 256 slots of 1 tick plus 4 levels of 64 slots each */
+#define TVR_BITS	8
+#define TVN_BITS	6
+#define TVR_SIZE	(1 << TVR_BITS)
+#define TVN_SIZE	(1 << TVN_BITS)
+#define TVR_MASK	(TVR_SIZE - 1)
+#define TVN_MASK	(TVN_SIZE - 1)
+#define NR_TVN		4
 
+/*
+ * A callout_req is the handle of a callout. It's linked directly in the
+ * timing wheel, so it must be zeroed before its first use and it must live
+ * (static or embedded in another structure) until it has expired or it has
+ * been deleted.
+ */
 struct callout_req {
 	void (*fn)(unsigned int);
 	unsigned int arg;
+	unsigned int expires;		/* tick when it expires */
+	struct callout_req *next;
+	struct callout_req **pprev;	/* NULL when it's not pending */
 };
 
 void add_callout(struct callout_req *, unsigned int);
 void del_callout(struct callout_req *);
 void irq_timer(int, struct sigcontext *);
+void timer_idle_enter(void);
+void timer_idle_exit(void);
+unsigned int timer_nsleep(unsigned int);
 void irq_timer_bh(struct sigcontext *);
 void do_callouts_bh(struct sigcontext *);
 void get_system_time(void);
@@ -14,6 +14,7 @@
 #include <fiwix/charq.h>
 #include <fiwix/console.h>
 #include <fiwix/serial.h>
+#include <fiwix/wait.h>
 
 #define TAB_SIZE	8
 #define MAX_TAB_COLS	132	/* maximum number of tab stops */
@@ -44,6 +45,7 @@ struct tty {
 	int flags;
 	struct tty *link;
 	struct tty *next;
+	struct wait_queue wq;		/* processes selecting the tty */
 
 	/* tty driver operations */
 	void (*stop)(struct tty *);
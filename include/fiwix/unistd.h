@@ -100,7 +100,7 @@
 #define SYS_oldlstat		84
 #define SYS_readlink		85
 /* #define SYS_uselib */
-/* #define SYS_swapon */
+#define SYS_swapon		87
 #define SYS_reboot		88
 /* #define SYS_oldreaddir */
 #define SYS_old_mmap		90
@@ -128,7 +128,7 @@
 /* #define SYS_idle		112		 -ENOSYS */
 /* #define SYS_vm86old */
 #define SYS_wait4		114
-/* #define SYS_swapoff */
+#define SYS_swapoff		115
 #define SYS_sysinfo		116
 #define SYS_ipc			117
 #define SYS_fsync		118
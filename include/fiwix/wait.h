@@ -0,0 +1,33 @@
+/*
+ * fiwix/include/fiwix/wait.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifndef _FIWIX_WAIT_H
+#define _FIWIX_WAIT_H
+
+/*
+ * A wait queue is embedded in every object that can be selected (pipe, tty,
+ * socket, ...) and it links the select(), poll() and epoll waiters of that
+ * object only. It has no includes since it's used by the headers that define
+ * those objects.
+ */
+struct wait_entry {
+	struct wait_queue *queue;		/* queue where it is linked */
+	void (*func)(struct wait_entry *);	/* called by wakeup_queue() */
+	void *data;				/* owner of the entry */
+	struct wait_entry *prev;
+	struct wait_entry *next;
+};
+
+struct wait_queue {
+	struct wait_entry *head;
+};
+
+void add_wait_queue(struct wait_queue *, struct wait_entry *);
+void remove_wait_queue(struct wait_entry *);
+void wakeup_queue(struct wait_queue *);
+
+#endif /* _FIWIX_WAIT_H */
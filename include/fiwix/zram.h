@@ -0,0 +1,70 @@
+/*
+ * fiwix/include/fiwix/zram.h
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#ifdef CONFIG_ZRAM
+
+#ifndef _FIWIX_ZRAM_H
+#define _FIWIX_ZRAM_H
+
+#include <fiwix/fs.h>
+#include <fiwix/mm.h>
+
+#define ZRAM_MAJOR	252	/* zram device major number (local use) */
+
+#define ZRAM_GETSTATS	0x5A01	/* get the statistics ('Z') */
+
+/* compressed pages are kept in caches of objects of 64, 128, ... bytes */
+#define ZRAM_CLASS_SIZE		64
+#define ZRAM_MAX_ZSIZE		(PAGE_SIZE / 2 - ZRAM_CLASS_SIZE)
+#define ZRAM_NR_CLASSES		(ZRAM_MAX_ZSIZE / ZRAM_CLASS_SIZE)
+
+/* zram_slot flags */
+#define ZRAM_ZERO	0x01	/* zero-filled page, nothing is stored */
+#define ZRAM_RAW	0x02	/* incompressible page, stored as is */
+
+struct zram_slot {
+	char *data;
+	unsigned short int size;	/* compressed size */
+	unsigned short int flags;
+};
+
+/* sizes are in bytes */
+struct zram_stats {
+	unsigned int disksize;
+	unsigned int orig_data_size;	/* pages stored (zero pages excluded) */
+	unsigned int compr_data_size;	/* the same pages once compressed */
+	unsigned int mem_used;		/* pool memory taken by them */
+	unsigned int pages_stored;
+	unsigned int zero_pages;
+	unsigned int raw_pages;
+	unsigned int num_reads;
+	unsigned int num_writes;
+	unsigned int failed_writes;
+};
+
+struct zram {
+	struct zram_slot *table;	/* one slot per page */
+	int size;			/* in KB */
+	struct zram_stats stats;
+};
+
+extern struct zram zram_table[ZRAM_DRIVES];
+
+int zram_open(struct inode *, struct fd *);
+int zram_close(struct inode *, struct fd *);
+int zram_read(__dev_t, __blk_t, char *, int);
+int zram_write(__dev_t, __blk_t, char *, int);
+int zram_ioctl(struct inode *, struct fd *, int, unsigned int);
+__loff_t zram_llseek(struct inode *, __loff_t);
+
+void zram_free_page(__dev_t, unsigned int);
+int zram_pool_pages(void);
+void zram_init(void);
+
+#endif /* _FIWIX_ZRAM_H */
+
+#endif /* CONFIG_ZRAM */
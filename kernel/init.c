@@ -76,6 +76,8 @@ void init_init(void)
 	init->suid = init->sgid = 0;
 	memset_b(init->fd, 0, sizeof(init->fd));
 	memset_b(init->fd_flags, 0, sizeof(init->fd_flags));
+	memset_b(init->fd_bitmap, 0, sizeof(init->fd_bitmap));
+	init->fd_hint = 0;
 	init->root = current->root;
 	init->pwd = current->pwd;
 	strcpy(init->argv0, init_argv[0]);
@@ -92,7 +94,7 @@ void init_init(void)
 		init->rlim[n].rlim_cur = init->rlim[n].rlim_max = RLIM_INFINITY;
 	}
 	init->rlim[RLIMIT_NOFILE].rlim_cur = OPEN_MAX;
-	init->rlim[RLIMIT_NOFILE].rlim_max = NR_OPENS;
+	init->rlim[RLIMIT_NOFILE].rlim_max = kstat.max_fds;
 	init->rlim[RLIMIT_NPROC].rlim_cur = CHILD_MAX;
 	init->rlim[RLIMIT_NPROC].rlim_max = NR_PROCS;
 	init->umask = 0022;
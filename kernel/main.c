@@ -9,6 +9,7 @@
 #include <fiwix/kernel.h>
 #include <fiwix/limits.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/system.h>
 #include <fiwix/version.h>
 #include <fiwix/utsname.h>
@@ -38,6 +39,7 @@ int kparm_memsize;
 int kparm_extmemsize;
 int kparm_rootdev;
 int kparm_ramdisksize;
+int kparm_zramsize;
 char kparm_rootfstype[10];
 char kparm_rootdevname[DEVNAME_MAX + 1];
 char kparm_initrd[DEVNAME_MAX + 1];
@@ -110,6 +112,7 @@ void start_kernel(unsigned int magic, unsigned int info, unsigned int last_boot_
 	dev_init();
 	tty_init();
 	mem_init();
+	strings_init();
 
 #ifdef CONFIG_PCI
 	pci_init();
@@ -124,6 +127,7 @@ void start_kernel(unsigned int magic, unsigned int info, unsigned int last_boot_
 	buffer_init();
 	sched_init();
 	inode_init();
+	dcache_init();
 	fd_init();
 
 #ifdef CONFIG_SYSVIPC
@@ -214,6 +218,13 @@ void cpu_idle()
 		if(need_resched) {
 			do_sched();
 		}
-		HLT();
+		CLI();
+		if(!need_resched) {
+			timer_idle_enter();
+			STI_HLT();
+			CLI();
+			timer_idle_exit();
+		}
+		STI();
 	}
 }
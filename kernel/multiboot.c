@@ -14,6 +14,7 @@
 #include <fiwix/kparms.h>
 #include <fiwix/i386elf.h>
 #include <fiwix/ramdisk.h>
+#include <fiwix/blk_queue.h>
 #include <fiwix/kexec.h>
 #include <fiwix/mm.h>
 #include <fiwix/bios.h>
@@ -59,6 +60,15 @@ static int check_parm(struct kparms *parm, const char *value)
 		}
 		return 1;
 	}
+	if(!strcmp(parm->name, "elevator=")) {
+		for(n = 0; parm->value[n]; n++) {
+			if(!strcmp(parm->value[n], value)) {
+				default_elevator = parm->sysval[n];
+				return 0;
+			}
+		}
+		return 1;
+	}
 	if(!strcmp(parm->name, "initrd=")) {
 		if(value[0]) {
 			strncpy(kparm_initrd, value, DEVNAME_MAX);
@@ -122,6 +132,12 @@ static int check_parm(struct kparms *parm, const char *value)
 		}
 		return 1;
 	}
+#ifdef CONFIG_ZRAM
+	if(!strcmp(parm->name, "zramsize=")) {
+		kparm_zramsize = atoi(value);
+		return 0;
+	}
+#endif /* CONFIG_ZRAM */
 	printk("WARNING: the parameter '%s' looks valid but it's not defined!\n", parm->name);
 	return 0;
 }
@@ -1,7 +1,7 @@
 /*
  * fiwix/kernel/pit.c
  *
- * Copyright 2018, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
@@ -32,6 +32,26 @@ int pit_getcounter0(void)
 	return count;
 }
 
+/* latches the status and the value of counter 0, and returns its status */
+int pit_readback0(int *count)
+{
+	int status;
+
+	outport_b(MODEREG, READ_BACK | RB_CHAN0);
+	status = inport_b(CHANNEL0);
+	*count = inport_b(CHANNEL0);
+	*count |= inport_b(CHANNEL0) << 8;
+	return status;
+}
+
+/* counter 0 will interrupt once after 'count' cycles */
+void pit_oneshot(unsigned short int count)
+{
+	outport_b(MODEREG, SEL_CHAN0 | LSB_MSB | TERM_COUNT | BINARY_CTR);
+	outport_b(CHANNEL0, count & 0xFF);	/* LSB */
+	outport_b(CHANNEL0, count >> 8);	/* MSB */
+}
+
 void pit_init(unsigned short int hertz)
 {
 	outport_b(MODEREG, SEL_CHAN0 | LSB_MSB | RATE_GEN | BINARY_CTR);
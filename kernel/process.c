@@ -314,6 +314,8 @@ void proc_slot_init(struct proc *p)
 	}
 	p->prev_sleep = p->next_sleep = NULL;
 	p->prev_run = p->next_run = NULL;
+	p->prev_rq = p->next_rq = NULL;
+	p->rq = NULL;
 	unlock_resource(&slot_resource);
 
 	memset_b(&p->tss, 0, sizeof(struct i386tss) - IO_BITMAP_SIZE);
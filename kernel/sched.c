@@ -13,12 +13,87 @@
 #include <fiwix/segments.h>
 #include <fiwix/timer.h>
 #include <fiwix/pic.h>
+#include <fiwix/cpu.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
 extern struct seg_desc gdt[NR_GDT_ENTRIES];
 int need_resched = 0;
 
+/*
+ * Runnable processes with quantum left are in the active run queue. When a
+ * process consumes its quantum it's moved to the expired run queue with a new
+ * quantum already assigned, and once the active run queue becomes empty both
+ * run queues are swapped. This keeps the same Round Robin behaviour as the
+ * old linear scan, but in constant time.
+ */
+static struct runqueue rq_table[2];
+static struct runqueue *rq_active = &rq_table[0];
+static struct runqueue *rq_expired = &rq_table[1];
+static unsigned int ctxt_start;		/* TSC when the last do_sched() began */
+
+static void rq_insert(struct runqueue *rq, struct proc *p, int level)
+{
+	if(level >= NR_SCHED_LEVELS) {
+		level = NR_SCHED_LEVELS - 1;
+	}
+	p->rq = rq;
+	p->rq_level = level;
+	p->next_rq = NULL;
+
+	/* insert process at the end of its level */
+	if(rq->tail[level]) {
+		p->prev_rq = rq->tail[level];
+		rq->tail[level]->next_rq = p;
+	} else {
+		p->prev_rq = NULL;
+		rq->head[level] = p;
+		rq->bitmap |= 1 << level;
+	}
+	rq->tail[level] = p;
+}
+
+static void rq_remove(struct proc *p)
+{
+	struct runqueue *rq;
+	int level;
+
+	rq = p->rq;
+	level = p->rq_level;
+	if(p->next_rq) {
+		p->next_rq->prev_rq = p->prev_rq;
+	} else {
+		rq->tail[level] = p->prev_rq;
+	}
+	if(p->prev_rq) {
+		p->prev_rq->next_rq = p->next_rq;
+	} else {
+		rq->head[level] = p->next_rq;
+	}
+	if(!rq->head[level]) {
+		rq->bitmap &= ~(1 << level);
+	}
+	p->prev_rq = p->next_rq = NULL;
+	p->rq = NULL;
+}
+
+/* adds the time elapsed since 'start' (a TSC value) to a latency counter */
+void add_latency(struct latency *l, unsigned int start)
+{
+	unsigned int cycles;
+
+	if(!(cpu_table.flags & CPU_TSC)) {
+		return;
+	}
+	RDTSC_LOW(cycles);
+	cycles -= start;
+	/* moving average with a weight of 1/16 for the new sample */
+	l->avg_cycles += ((int)(cycles - l->avg_cycles)) >> 4;
+	if(cycles > l->max_cycles) {
+		l->max_cycles = cycles;
+	}
+}
+
 static void context_switch(struct proc *next)
 {
 	struct proc *prev;
@@ -29,6 +104,9 @@ static void context_switch(struct proc *next)
 	set_tss(next);
 	current = next;
 	do_switch(&prev->tss.esp, &prev->tss.eip, next->tss.esp, next->tss.eip, next->tss.cr3, TSS);
+
+	/* 'prev' is running again, so a switch to it has just finished */
+	add_latency(&kstat.ctxt_latency, ctxt_start);
 	STI();
 }
 
@@ -43,34 +121,82 @@ void set_tss(struct proc *p)
 	g->sd_hibase = (char)(((unsigned int)&p->tss) >> 24);
 }
 
+/* this must be called with interrupts disabled */
+void sched_enqueue(struct proc *p)
+{
+	if(p->cpu_count > 0) {
+		rq_insert(rq_active, p, p->cpu_count);
+	} else {
+		p->cpu_count = p->priority;
+		rq_insert(rq_expired, p, p->cpu_count);
+	}
+}
+
+/* this must be called with interrupts disabled */
+void sched_dequeue(struct proc *p)
+{
+	if(!p->rq) {
+		return;
+	}
+
+	/* the new quantum is granted only if still runnable on the next swap */
+	if(p->rq == rq_expired) {
+		p->cpu_count = 0;
+	}
+	rq_remove(p);
+}
+
+/* consumes one tick of the quantum of the running process */
+void sched_tick(struct proc *p)
+{
+	unsigned int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	if(p->rq == rq_expired) {
+		/* it already consumed its quantum */
+		need_resched = 1;
+		RESTORE_FLAGS(flags);
+		return;
+	}
+	if(--p->cpu_count <= 0) {
+		p->cpu_count = 0;
+		need_resched = 1;
+	}
+	if(p->rq && (!p->cpu_count || p->cpu_count < p->rq_level)) {
+		rq_remove(p);
+		sched_enqueue(p);
+	}
+	RESTORE_FLAGS(flags);
+}
+
 /* Round Robin algorithm */
 void do_sched(void)
 {
-	int count;
-	struct proc *p, *selected;
+	unsigned int flags;
+	struct proc *selected;
+	struct runqueue *rq;
+	int level;
 
+	if(cpu_table.flags & CPU_TSC) {
+		RDTSC_LOW(ctxt_start);
+	}
 	need_resched = 0;
-	for(;;) {
-		count = -1;
-		selected = &proc_table[IDLE];
 
-		FOR_EACH_PROCESS_RUNNING(p) {
-			if(p->cpu_count > count) {
-				count = p->cpu_count;
-				selected = p;
-			}
-			p = p->next_run;
-		}
-		if(count) {
-			break;
-		}
-
-		/* reassigns new quantum to all running processes */
-		FOR_EACH_PROCESS_RUNNING(p) {
-			p->cpu_count = p->priority;
-			p = p->next_run;
-		}
+	SAVE_FLAGS(flags); CLI();
+	if(!rq_active->bitmap) {
+		/* all quanta have been consumed, reassign them */
+		rq = rq_active;
+		rq_active = rq_expired;
+		rq_expired = rq;
 	}
+	if(rq_active->bitmap) {
+		BSR(level, rq_active->bitmap);
+		selected = rq_active->head[level];
+	} else {
+		selected = &proc_table[IDLE];
+	}
+	RESTORE_FLAGS(flags);
+
 	if(current != selected) {
 		context_switch(selected);
 	}
@@ -15,10 +15,15 @@
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
-#define NR_BUCKETS		((NR_PROCS * 10) / 100)	/* 10% of NR_PROCS */
-#define SLEEP_HASH(addr)	((addr) % (NR_BUCKETS))
+/*
+ * The sleep addresses are multiplied by a constant (from the golden ratio)
+ * before taking the bucket, otherwise the addresses of the kernel objects,
+ * which share their alignment bits, would fall into very few buckets.
+ */
+#define NR_BUCKETS		NR_PROCS
+#define SLEEP_HASH(addr)	((((addr) * 0x9E370001) >> 16) % (NR_BUCKETS))
 
-struct proc *sleep_hash_table[NR_BUCKETS];
+static struct proc *sleep_hash_table[NR_BUCKETS];
 struct proc *proc_run_head;
 static unsigned int area = 0;
 
@@ -38,6 +43,7 @@ void runnable(struct proc *p)
 	}
 	proc_run_head = p;
 	p->state = PROC_RUNNING;
+	sched_enqueue(p);
 	RESTORE_FLAGS(flags);
 }
 
@@ -57,6 +63,7 @@ void not_runnable(struct proc *p, int state)
 	}
 	p->prev_run = p->next_run = NULL;
 	p->state = state;
+	sched_dequeue(p);
 	RESTORE_FLAGS(flags);
 }
 
@@ -112,43 +119,96 @@ int sleep(void *address, int state)
 	return signum;
 }
 
+/* removes the process from its sleep hash chain (interrupts disabled) */
+static void unlink_sleep(struct proc *p)
+{
+	struct proc **h;
+
+	h = &sleep_hash_table[SLEEP_HASH((unsigned int)p->sleep_address)];
+	if(p->next_sleep) {
+		p->next_sleep->prev_sleep = p->prev_sleep;
+	}
+	if(p->prev_sleep) {
+		p->prev_sleep->next_sleep = p->next_sleep;
+	}
+	if(*h == p) {	/* if it's the head */
+		*h = p->next_sleep;
+	}
+	p->prev_sleep = p->next_sleep = NULL;
+	p->sleep_address = NULL;
+}
+
+static void wakeup_sleeper(struct proc *p)
+{
+	unlink_sleep(p);
+	p->flags &= ~PF_NOTINTERRUPT;
+	runnable(p);
+	need_resched = 1;
+}
+
 void wakeup(void *address)
 {
 	unsigned int flags;
-	struct proc **h;
-	int i;
+	struct proc *p, *next;
+	int woken;
 
 	SAVE_FLAGS(flags); CLI();
-	i = SLEEP_HASH((unsigned int)address);
-	h = &sleep_hash_table[i];
+	woken = 0;
+	p = sleep_hash_table[SLEEP_HASH((unsigned int)address)];
+	while(p) {
+		next = p->next_sleep;
+		if(p->sleep_address == address) {
+			wakeup_sleeper(p);
+			woken++;
+		}
+		p = next;
+	}
+	if(woken) {
+		kstat.wakeups++;
+		kstat.wakeup_procs += woken;
+		if(woken > 1) {
+			kstat.wakeup_herds++;
+		}
+	}
+	RESTORE_FLAGS(flags);
+}
 
-	while(*h) {
-		if((*h)->sleep_address == address) {
-			(*h)->sleep_address = NULL;
-			(*h)->flags &= ~PF_NOTINTERRUPT;
-			runnable(*h);
-			need_resched = 1;
-			if((*h)->next_sleep) {
-				(*h)->next_sleep->prev_sleep = (*h)->prev_sleep;
-			}
-			if((*h)->prev_sleep) {
-				(*h)->prev_sleep->next_sleep = (*h)->next_sleep;
-			}
-			if(h == &sleep_hash_table[i]) {	/* if it's the head */
-				*h = (*h)->next_sleep;
+/*
+ * Wakes up only the process that has been sleeping the longest on 'address',
+ * for the cases where just one of them can proceed (e.g. a resource handoff).
+ * It returns 1 if there are more processes sleeping on it.
+ */
+int wakeup_one(void *address)
+{
+	unsigned int flags;
+	struct proc *p, *oldest;
+	int others;
+
+	SAVE_FLAGS(flags); CLI();
+	oldest = NULL;
+	others = 0;
+
+	/* the processes are inserted in the head */
+	for(p = sleep_hash_table[SLEEP_HASH((unsigned int)address)]; p; p = p->next_sleep) {
+		if(p->sleep_address == address) {
+			if(oldest) {
+				others = 1;
 			}
-			continue;
+			oldest = p;
 		}
-		h = &(*h)->next_sleep;
+	}
+	if(oldest) {
+		wakeup_sleeper(oldest);
+		kstat.wakeups++;
+		kstat.wakeup_procs++;
 	}
 	RESTORE_FLAGS(flags);
+	return others;
 }
 
 void wakeup_proc(struct proc *p)
 {
 	unsigned int flags;
-	struct proc **h;
-	int i;
 
 	if(p->state != PROC_SLEEPING && p->state != PROC_STOPPED) {
 		return;
@@ -163,19 +223,7 @@ void wakeup_proc(struct proc *p)
 
 	/* stopped processes don't have sleep address */
 	if(p->sleep_address) {
-		if(p->next_sleep) {
-			p->next_sleep->prev_sleep = p->prev_sleep;
-		}
-		if(p->prev_sleep) {
-			p->prev_sleep->next_sleep = p->next_sleep;
-		}
-
-		i = SLEEP_HASH((unsigned int)p->sleep_address);
-		h = &sleep_hash_table[i];
-
-		if(*h == p) {	/* if it's the head */
-			*h = (*h)->next_sleep;
-		}
+		unlink_sleep(p);
 	}
 	p->sleep_address = NULL;
 	p->cpu_count = p->priority;
@@ -185,6 +233,52 @@ void wakeup_proc(struct proc *p)
 	RESTORE_FLAGS(flags);
 }
 
+void add_wait_queue(struct wait_queue *wq, struct wait_entry *e)
+{
+	unsigned int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	e->queue = wq;
+	e->prev = NULL;
+	if((e->next = wq->head)) {
+		wq->head->prev = e;
+	}
+	wq->head = e;
+	RESTORE_FLAGS(flags);
+}
+
+void remove_wait_queue(struct wait_entry *e)
+{
+	unsigned int flags;
+
+	SAVE_FLAGS(flags); CLI();
+	if(e->next) {
+		e->next->prev = e->prev;
+	}
+	if(e->prev) {
+		e->prev->next = e->next;
+	}
+	if(e == e->queue->head) {
+		e->queue->head = e->next;
+	}
+	e->queue = NULL;
+	e->prev = e->next = NULL;
+	RESTORE_FLAGS(flags);
+}
+
+/* calls the function of every entry linked in the queue */
+void wakeup_queue(struct wait_queue *wq)
+{
+	unsigned int flags;
+	struct wait_entry *e;
+
+	SAVE_FLAGS(flags); CLI();
+	for(e = wq->head; e; e = e->next) {
+		e->func(e);
+	}
+	RESTORE_FLAGS(flags);
+}
+
 void lock_resource(struct resource *resource)
 {
 	unsigned int flags;
@@ -209,9 +303,10 @@ void unlock_resource(struct resource *resource)
 
 	SAVE_FLAGS(flags); CLI();
 	resource->locked = 0;
+
+	/* only one waiter can get the resource, it stays wanted for the rest */
 	if(resource->wanted) {
-		resource->wanted = 0;
-		wakeup(resource);
+		resource->wanted = wakeup_one(resource);
 	}
 	RESTORE_FLAGS(flags);
 }
@@ -279,7 +279,7 @@ void *syscall_table[] = {
 	sys_lstat,
 	sys_readlink,			/* 85 */
 	NULL,	/* sys_uselib */
-	NULL,	/* sys_swapon */
+	sys_swapon,
 	sys_reboot,
 	NULL,	/* old_readdir */
 	old_mmap,			/* 90 */
@@ -307,7 +307,7 @@ void *syscall_table[] = {
 	NULL,					/* sys_idle (-ENOSYS) */
 	NULL,	/* sys_vm86old */
 	sys_wait4,
-	NULL,	/* sys_swapoff */	/* 115 */
+	sys_swapoff,			/* 115 */
 	sys_sysinfo,
 #ifdef CONFIG_SYSVIPC
 	sys_ipc,
@@ -364,7 +364,7 @@ void *syscall_table[] = {
 	NULL,				/* 165 */
 	NULL,
 	NULL,
-	NULL,
+	sys_poll,
 	NULL,
 	NULL,				/* 170 */
 	NULL,
@@ -386,7 +386,7 @@ void *syscall_table[] = {
 	NULL,
 	NULL,
 	NULL,
-	sys_fork,			/* 190 (sys_vfork) */
+	sys_vfork,			/* 190 */
 	NULL,
 #ifdef CONFIG_MMAP2
 	sys_mmap2,
@@ -454,9 +454,9 @@ void *syscall_table[] = {
 	NULL,
 	NULL,
 	NULL,
-	NULL,
-	NULL,				/* 255 */
-	NULL,
+	sys_epoll_create,
+	sys_epoll_ctl,			/* 255 */
+	sys_epoll_wait,
 	NULL,
 	NULL,
 	NULL,
@@ -472,6 +472,54 @@ void *syscall_table[] = {
 	NULL,
 	NULL,				/* 270 */
 	sys_utimes,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 275 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 280 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 285 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 290 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 295 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 300 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 305 */
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,				/* 310 */
+	NULL,
+	NULL,
+#ifdef CONFIG_SYSCALL_6TH_ARG
+	sys_splice,
+#else
+	NULL,
+#endif
+	NULL,
+	sys_tee,			/* 315 */
 };
 
 static void do_bad_syscall(unsigned int num)
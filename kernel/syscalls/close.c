@@ -8,6 +8,7 @@
 #include <fiwix/syscalls.h>
 #include <fiwix/fd.h>
 #include <fiwix/locks.h>
+#include <fiwix/filesystems.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 
@@ -29,6 +30,9 @@ int sys_close(unsigned int ufd)
 	}
 	i = fd_table[fd].inode;
 	flock_release_inode(i);
+	if(fd_table[fd].ep_links) {
+		epollfs_release(&fd_table[fd]);
+	}
 	if(i->fsop && i->fsop->close) {
 		i->fsop->close(i, &fd_table[fd]);
 		release_fd(fd);
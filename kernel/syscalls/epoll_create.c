@@ -0,0 +1,48 @@
+/*
+ * fiwix/kernel/syscalls/epoll_create.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/stat.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+int sys_epoll_create(int size)
+{
+	struct filesystems *fs;
+	struct inode *i;
+	int fd, ufd;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_epoll_create(%d)\n", current->pid, size);
+#endif /*__DEBUG__ */
+
+	if(size <= 0) {
+		return -EINVAL;
+	}
+	if(!(fs = get_filesystem("epollfs"))) {
+		printk("WARNING: %s(): epollfs filesystem is not registered!\n", __FUNCTION__);
+		return -EINVAL;
+	}
+	if(!(i = ialloc(&fs->mp->sb, NULL, S_IRUSR | S_IWUSR))) {
+		return -ENOMEM;
+	}
+	if((fd = get_new_fd(i)) < 0) {
+		iput(i);
+		return -ENFILE;
+	}
+	if((ufd = get_new_user_fd(0)) < 0) {
+		release_fd(fd);
+		iput(i);
+		return -EMFILE;
+	}
+	current->fd[ufd] = fd;
+	fd_table[fd].flags = O_RDWR;
+	return ufd;
+}
@@ -0,0 +1,42 @@
+/*
+ * fiwix/kernel/syscalls/epoll_ctl.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/poll.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#include <fiwix/process.h>
+#endif /*__DEBUG__ */
+
+int sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+	struct inode *i;
+	struct epoll_event ev;
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_epoll_ctl(%d, %d, %d, 0x%08x)\n", current->pid, epfd, op, fd, (unsigned int)event);
+#endif /*__DEBUG__ */
+
+	CHECK_UFD(epfd);
+	CHECK_UFD(fd);
+	i = fd_table[current->fd[epfd]].inode;
+	if(i->fsop != &epollfs_fsop || epfd == fd) {
+		return -EINVAL;
+	}
+	if(op != EPOLL_CTL_DEL) {
+		if((errno = check_user_area(VERIFY_READ, event, sizeof(struct epoll_event)))) {
+			return errno;
+		}
+		memcpy_b(&ev, event, sizeof(struct epoll_event));
+	}
+	return epollfs_ctl(i, op, fd, &ev);
+}
@@ -0,0 +1,54 @@
+/*
+ * fiwix/kernel/syscalls/epoll_wait.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/poll.h>
+#include <fiwix/timer.h>
+#include <fiwix/sched.h>
+#include <fiwix/errno.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#endif /*__DEBUG__ */
+
+int sys_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+	struct inode *i;
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_epoll_wait(%d, 0x%08x, %d, %d)\n", current->pid, epfd, (unsigned int)events, maxevents, timeout);
+#endif /*__DEBUG__ */
+
+	CHECK_UFD(epfd);
+	i = fd_table[current->fd[epfd]].inode;
+	if(i->fsop != &epollfs_fsop) {
+		return -EINVAL;
+	}
+	if(maxevents <= 0 || maxevents > EPOLL_MAX_EVENTS) {
+		return -EINVAL;
+	}
+	if((errno = check_user_area(VERIFY_WRITE, events, sizeof(struct epoll_event) * maxevents))) {
+		return errno;
+	}
+
+	/* a negative timeout means an infinite wait */
+	if(timeout < 0) {
+		current->timeout = INFINITE_WAIT;
+	} else {
+		current->timeout = (timeout / 1000) * HZ + ((timeout % 1000) * HZ + 999) / 1000;
+	}
+	errno = epollfs_wait(i, events, maxevents);
+
+	/* interrupted by a signal before the timeout expired */
+	if(!errno && current->timeout && current->sigpending & ~current->sigblocked) {
+		errno = -EINTR;
+	}
+	current->timeout = 0;
+	return errno;
+}
@@ -10,6 +10,7 @@
 #include <fiwix/buffer.h>
 #include <fiwix/mm.h>
 #include <fiwix/process.h>
+#include <fiwix/sched.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -378,6 +379,10 @@ int sys_execve(const char *filename, char *argv[], char *envp[], int arg4, int a
 	}
 	current->sleep_address = NULL;
 	current->flags |= PF_PEXEC;
+	if(current->fork_start) {
+		add_latency(&kstat.forkexec_latency, current->fork_start);
+		current->fork_start = 0;
+	}
 	free_name(tmp_name);
 	return 0;
 }
@@ -8,6 +8,8 @@
 #include <fiwix/syscalls.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/locks.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/mm.h>
 #include <fiwix/errno.h>
 
 #ifdef __DEBUG__
@@ -17,6 +19,7 @@
 
 int sys_fcntl(unsigned int ufd, int cmd, unsigned int arg)
 {
+	struct inode *i;
 	int new_ufd, errno;
 
 #ifdef __DEBUG__
@@ -60,6 +63,16 @@ int sys_fcntl(unsigned int ufd, int cmd, unsigned int arg)
 				return errno;
 			}
 			return posix_lock(ufd, cmd, (struct flock *)arg);
+		case F_SETPIPE_SZ:
+		case F_GETPIPE_SZ:
+			i = fd_table[current->fd[ufd]].inode;
+			if(i->fsop != &pipefs_fsop) {
+				return -EBADF;
+			}
+			if(cmd == F_GETPIPE_SZ) {
+				return PIPE_SIZE(i);
+			}
+			return pipefs_set_size(i, arg);
 		default:
 			return -EINVAL;
 	}
@@ -9,12 +9,15 @@
 #include <fiwix/syscalls.h>
 #include <fiwix/fcntl.h>
 #include <fiwix/locks.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/mm.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 #include <fiwix/process.h>
 
 int sys_fcntl64(unsigned int ufd, int cmd, unsigned int arg)
 {
+	struct inode *i;
 	int new_ufd;
 
 #ifdef __DEBUG__
@@ -56,6 +59,16 @@ int sys_fcntl64(unsigned int ufd, int cmd, unsigned int arg)
 		case F_SETLKW64:
 			printk("(pid %d) sys_fcntl64: WARNING: locks not implemented!\n", current->pid);
 			return 0;
+		case F_SETPIPE_SZ:
+		case F_GETPIPE_SZ:
+			i = fd_table[current->fd[ufd]].inode;
+			if(i->fsop != &pipefs_fsop) {
+				return -EBADF;
+			}
+			if(cmd == F_GETPIPE_SZ) {
+				return PIPE_SIZE(i);
+			}
+			return pipefs_set_size(i, arg);
 		default:
 			return -EINVAL;
 	}
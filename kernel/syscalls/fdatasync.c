@@ -1,22 +1,35 @@
 /*
  * fiwix/kernel/syscalls/fdatasync.c
  *
- * Copyright 2018, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
-#include <fiwix/syscalls.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/process.h>
+#include <fiwix/stat.h>
+#include <fiwix/errno.h>
 
 #ifdef __DEBUG__
 #include <fiwix/stdio.h>
-#include <fiwix/process.h>
 #endif /*__DEBUG__ */
 
 int sys_fdatasync(int ufd)
 {
+	struct inode *i;
+
 #ifdef __DEBUG__
 	printk("(pid %d) sys_fdatasync(%d)\n", current->pid, ufd);
 #endif /*__DEBUG__ */
 
-	return sys_fsync(ufd);
+	CHECK_UFD(ufd);
+	i = fd_table[current->fd[ufd]].inode;
+	if(!S_ISREG(i->i_mode)) {
+		return -EINVAL;
+	}
+	if(IS_RDONLY_FS(i)) {
+		return -EROFS;
+	}
+	return fsync_inode(i, 1);
 }
@@ -11,6 +11,7 @@
 #include <fiwix/segments.h>
 #include <fiwix/sigcontext.h>
 #include <fiwix/process.h>
+#include <fiwix/cpu.h>
 #include <fiwix/sched.h>
 #include <fiwix/sleep.h>
 #include <fiwix/mm.h>
@@ -26,27 +27,30 @@ static void free_vma_table(struct proc *p)
 	while(vma) {
 		tmp = vma;
 		vma = vma->next;
-		kfree((unsigned int)tmp);
+		kmem_cache_free(vma_cache, tmp);
 	}
 }
 
-#ifdef CONFIG_SYSCALL_6TH_ARG
-int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, int arg6, struct sigcontext *sc)
-#else
-int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext *sc)
-#endif /* CONFIG_SYSCALL_6TH_ARG */
+/*
+ * A vfork() child runs in the address space of its parent (which sleeps
+ * meanwhile) until it calls execve() or exits. Then release_binary() gives
+ * it its own Page Directory and wakes up the parent. This makes its cost
+ * independent of the size of the parent.
+ */
+static int do_fork(struct sigcontext *sc, int vfork)
 {
 	int count, pages;
-	unsigned int n;
+	unsigned int n, start;
 	unsigned int *child_pgdir;
 	struct sigcontext *stack;
 	struct proc *child, *p;
 	struct vma *vma, *child_vma;
 	__pid_t pid;
 
-#ifdef __DEBUG__
-	printk("(pid %d) sys_fork()\n", current->pid);
-#endif /*__DEBUG__ */
+	start = 0;
+	if(cpu_table.flags & CPU_TSC) {
+		RDTSC_LOW(start);
+	}
 
 	/* check the number of processes already allocated by this UID */
 	count = 0;
@@ -82,21 +86,29 @@ int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext
 		release_proc(child);
 		return -ENOMEM;
 	}
+	memcpy_page(child_pgdir, kpage_dir);
+	if(vfork) {
+		child->rss = 0;
+		child->vfork_cr3 = V2P((unsigned int)child_pgdir);
+	} else {
+		child->tss.cr3 = V2P((unsigned int)child_pgdir);
+	}
 	child->rss++;
-	memcpy_b(child_pgdir, kpage_dir, PAGE_SIZE);
-	child->tss.cr3 = V2P((unsigned int)child_pgdir);
 
 	child->ppid = current;
-	child->flags = 0;
+	child->flags = vfork ? PF_VFORK : 0;
 	child->children = 0;
 	child->cpu_count = child->priority;
 	child->start_time = CURRENT_TICKS;
+	child->fork_start = start;
 	child->sleep_address = NULL;
 
-	vma = current->vma_table;
-	child->vma_table = NULL;
+	vma = vfork ? NULL : current->vma_table;
+	if(!vfork) {
+		child->vma_table = NULL;
+	}
 	while(vma) {
-		if(!(child_vma = (struct vma *)kmalloc(sizeof(struct vma)))) {
+		if(!(child_vma = (struct vma *)kmem_cache_alloc(vma_cache))) {
 			kfree((unsigned int)child_pgdir);
 			free_vma_table(child);
 			release_proc(child);
@@ -135,27 +147,32 @@ int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext
 
 	if(!(child->tss.esp0 = kmalloc(PAGE_SIZE))) {
 		kfree((unsigned int)child_pgdir);
-		free_vma_table(child);
+		if(!vfork) {
+			free_vma_table(child);
+		}
 		release_proc(child);
 		return -ENOMEM;
 	}
 
-	if(!(pages = clone_pages(child))) {
-		printk("WARNING: %s(): not enough memory when cloning pages.\n", __FUNCTION__);
-		free_page_tables(child);
-		kfree((unsigned int)child_pgdir);
-		free_vma_table(child);
-		release_proc(child);
-		return -ENOMEM;
+	if(!vfork) {
+		if((pages = clone_pages(child)) < 0) {
+			printk("WARNING: %s(): not enough memory when cloning pages.\n", __FUNCTION__);
+			free_page_tables(child);
+			kfree(child->tss.esp0);
+			kfree((unsigned int)child_pgdir);
+			free_vma_table(child);
+			release_proc(child);
+			return -ENOMEM;
+		}
+		child->rss += pages;
+		invalidate_tlb();
 	}
-	child->rss += pages;
-	invalidate_tlb();
 
 	child->tss.esp0 += PAGE_SIZE - 4;
 	child->rss++;
 	child->tss.ss0 = KERNEL_DS;
 
-	memcpy_b((unsigned int *)(child->tss.esp0 & PAGE_MASK), (void *)((unsigned int)(sc) & PAGE_MASK), PAGE_SIZE);
+	memcpy_page((unsigned int *)(child->tss.esp0 & PAGE_MASK), (void *)((unsigned int)(sc) & PAGE_MASK));
 	stack = (struct sigcontext *)((child->tss.esp0 & PAGE_MASK) + ((unsigned int)(sc) & ~PAGE_MASK));
 
 	child->tss.eip = (unsigned int)return_from_syscall;
@@ -179,6 +196,39 @@ int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext
 	nr_processes++;
 	current->children++;
 	runnable(child);
+	add_latency(&kstat.fork_latency, start);
+
+	if(vfork) {
+		while(child->flags & PF_VFORK) {
+			sleep(child, PROC_UNINTERRUPTIBLE);
+		}
+	}
 
 	return child->pid;	/* parent returns child's PID */
 }
+
+#ifdef CONFIG_SYSCALL_6TH_ARG
+int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, int arg6, struct sigcontext *sc)
+#else
+int sys_fork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext *sc)
+#endif /* CONFIG_SYSCALL_6TH_ARG */
+{
+#ifdef __DEBUG__
+	printk("(pid %d) sys_fork()\n", current->pid);
+#endif /*__DEBUG__ */
+
+	return do_fork(sc, 0);
+}
+
+#ifdef CONFIG_SYSCALL_6TH_ARG
+int sys_vfork(int arg1, int arg2, int arg3, int arg4, int arg5, int arg6, struct sigcontext *sc)
+#else
+int sys_vfork(int arg1, int arg2, int arg3, int arg4, int arg5, struct sigcontext *sc)
+#endif /* CONFIG_SYSCALL_6TH_ARG */
+{
+#ifdef __DEBUG__
+	printk("(pid %d) sys_vfork()\n", current->pid);
+#endif /*__DEBUG__ */
+
+	return do_fork(sc, 1);
+}
@@ -9,7 +9,6 @@
 #include <fiwix/filesystems.h>
 #include <fiwix/process.h>
 #include <fiwix/stat.h>
-#include <fiwix/buffer.h>
 #include <fiwix/errno.h>
 
 #ifdef __DEBUG__
@@ -32,8 +31,5 @@ int sys_fsync(unsigned int ufd)
 	if(IS_RDONLY_FS(i)) {
 		return -EROFS;
 	}
-	sync_superblocks(i->dev);
-	sync_inodes(i->dev);
-	sync_buffers(i->dev);
-	return 0;
+	return fsync_inode(i, 0);
 }
@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -104,6 +105,7 @@ int sys_link(const char *oldname, const char *newname)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir_new, basename);
 	iput(i);
 	iput(dir);
 	iput(dir_new);
@@ -7,6 +7,7 @@
 
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -60,6 +61,7 @@ int sys_mkdir(const char *dirname, __mode_t mode)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir, basename);
 	iput(dir);
 	free_name(tmp_dirname);
 	return errno;
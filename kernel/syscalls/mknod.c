@@ -7,6 +7,7 @@
 
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -47,6 +48,7 @@ int do_mknod(char *pathname, __mode_t mode, __dev_t dev)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir, basename);
 	iput(dir);
 	return errno;
 }
@@ -7,6 +7,7 @@
 
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/buffer.h>
 #include <fiwix/filesystems.h>
@@ -117,7 +118,7 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 		free_name(tmp_fstype);
 		return errno;
 	}
-	if(fs->fsop->flags == FSOP_REQUIRES_DEV) {
+	if(fs->fsop->flags & FSOP_REQUIRES_DEV) {
 		if((errno = namei(tmp_source, &i_source, NULL, FOLLOW_LINKS))) {
 			iput(i_target);
 			free_name(tmp_target);
@@ -154,7 +155,7 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 	}
 
 	if(!(mp = add_mount_point(dev, tmp_source, tmp_target))) {
-		if(fs->fsop->flags == FSOP_REQUIRES_DEV) {
+		if(fs->fsop->flags & FSOP_REQUIRES_DEV) {
 			i_source->fsop->close(i_source, NULL);
 			iput(i_source);
 		}
@@ -169,7 +170,7 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 	if(fs->fsop->read_superblock) {
 		if((errno = fs->fsop->read_superblock(dev, &mp->sb))) {
 			i_source->fsop->close(i_source, NULL);
-			if(fs->fsop->flags == FSOP_REQUIRES_DEV) {
+			if(fs->fsop->flags & FSOP_REQUIRES_DEV) {
 				iput(i_source);
 			}
 			iput(i_target);
@@ -180,7 +181,7 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 			return errno;
 		}
 	} else {
-		if(fs->fsop->flags == FSOP_REQUIRES_DEV) {
+		if(fs->fsop->flags & FSOP_REQUIRES_DEV) {
 			iput(i_source);
 		}
 		iput(i_target);
@@ -191,6 +192,7 @@ int sys_mount(const char *source, const char *target, const char *fstype, unsign
 		return -EINVAL;
 	}
 
+	dcache_flush(dev);
 	mp->sb.dir = i_target;
 	mp->fs = fs;
 	fs->mp = mp;
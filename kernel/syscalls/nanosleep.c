@@ -1,7 +1,7 @@
 /*
  * fiwix/kernel/syscalls/nanosleep.c
  *
- * Copyright 2018, Jordi Sanfeliu. All rights reserved.
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
  * Distributed under the terms of the Fiwix License.
  */
 
@@ -12,6 +12,7 @@
 #include <fiwix/process.h>
 #include <fiwix/sched.h>
 #include <fiwix/sleep.h>
+#include <fiwix/cpu.h>
 #include <fiwix/errno.h>
 
 #ifdef __DEBUG__
@@ -20,8 +21,8 @@
 
 int sys_nanosleep(const struct timespec *req, struct timespec *rem)
 {
-	int errno, nsec;
-	unsigned int timeout, flags;
+	int errno;
+	unsigned int timeout, flags, nsec;
 
 #ifdef __DEBUG__
 	printk("(pid %d) sys_nanosleep(0x%08x, 0x%08x)\n", current->pid, (unsigned int)req, (unsigned int)rem);
@@ -35,13 +36,22 @@ int sys_nanosleep(const struct timespec *req, struct timespec *rem)
 	}
 
 	/*
-	 * Since the current maximum precision of the kernel is only 10ms, we
-	 * need to convert any lower request to a minimum of 10ms, even knowing
-	 * that this might increase the sleep a bit more than the requested.
+	 * Requests shorter than a tick sleep until a PIT one-shot at their
+	 * deadline (if there is a TSC to measure it), the rest sleep the number
+	 * of ticks rounded up.
 	 */
-	nsec = req->tv_nsec;
-	if(nsec < 10000000L) {
-		nsec *= 10;
+	if(!req->tv_sec && req->tv_nsec < 1000000000L / HZ && cpu_table.flags & CPU_TSC && cpu_table.hz >= 1000000) {
+		if((nsec = timer_nsleep(req->tv_nsec))) {
+			if(rem) {
+				if((errno = check_user_area(VERIFY_WRITE, rem, sizeof(struct timespec)))) {
+					return errno;
+				}
+				rem->tv_sec = 0;
+				rem->tv_nsec = nsec;
+			}
+			return -EINTR;
+		}
+		return 0;
 	}
 
 	/*
@@ -51,7 +61,7 @@ int sys_nanosleep(const struct timespec *req, struct timespec *rem)
 	 * case, the process would miss the wakeup() and would stay in the sleep
 	 * queue forever.
 	 */
-	timeout = (req->tv_sec * HZ) + (nsec * HZ / 1000000000L);
+	timeout = (req->tv_sec * HZ) + (req->tv_nsec + (1000000000L / HZ) - 1) / (1000000000L / HZ);
 	if(timeout) {
 		SAVE_FLAGS(flags); CLI();
 		current->timeout = timeout;
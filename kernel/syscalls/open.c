@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/syscalls.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/types.h>
 #include <fiwix/fcntl.h>
@@ -87,6 +88,7 @@ int sys_open(const char *filename, int flags, __mode_t mode)
 		if(errno) {	/* assumes -ENOENT */
 			if(dir->fsop && dir->fsop->create) {
 				errno = dir->fsop->create(dir, basename, flags, mode, &i);
+				dcache_remove(dir, basename);
 				if(errno) {
 					iput(dir);
 					free_name(tmp_name);
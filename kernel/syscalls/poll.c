@@ -0,0 +1,89 @@
+/*
+ * fiwix/kernel/syscalls/poll.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/types.h>
+#include <fiwix/fs.h>
+#include <fiwix/process.h>
+#include <fiwix/timer.h>
+#include <fiwix/sched.h>
+#include <fiwix/poll.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+static int do_poll(struct pollfd *ufds, unsigned int nfds)
+{
+	unsigned int n;
+	int count, fd;
+	struct poll_table pt;
+
+	poll_table_init(&pt);
+	current->poll_table = &pt;
+
+	for(;;) {
+		count = 0;
+		for(n = 0; n < nfds; n++) {
+			fd = ufds[n].fd;
+			ufds[n].revents = 0;
+			if(fd < 0) {
+				continue;
+			}
+			if(fd >= OPEN_MAX || !current->fd[fd]) {
+				ufds[n].revents = POLLNVAL;
+				count++;
+				continue;
+			}
+			if((ufds[n].revents = poll_events(&fd_table[current->fd[fd]], ufds[n].events))) {
+				count++;
+			}
+		}
+
+		current->poll_table = NULL;
+		if(count || !current->timeout || current->sigpending & ~current->sigblocked) {
+			break;
+		}
+		if(pt.error) {
+			count = pt.error;
+			break;
+		}
+		poll_table_sleep(&pt);
+	}
+
+	poll_table_free(&pt);
+	return count;
+}
+
+int sys_poll(struct pollfd *ufds, unsigned int nfds, int timeout)
+{
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_poll(0x%08x, %d, %d)\n", current->pid, (unsigned int)ufds, nfds, timeout);
+#endif /*__DEBUG__ */
+
+	if(nfds > OPEN_MAX) {
+		return -EINVAL;
+	}
+	if((errno = check_user_area(VERIFY_WRITE, ufds, sizeof(struct pollfd) * nfds))) {
+		return errno;
+	}
+
+	/* a negative timeout means an infinite wait */
+	if(timeout < 0) {
+		current->timeout = INFINITE_WAIT;
+	} else {
+		current->timeout = (timeout / 1000) * HZ + ((timeout % 1000) * HZ + 999) / 1000;
+	}
+	errno = do_poll(ufds, nfds);
+
+	/* interrupted by a signal before the timeout expired */
+	if(!errno && current->timeout && current->sigpending & ~current->sigblocked) {
+		errno = -EINTR;
+	}
+	current->timeout = 0;
+	return errno;
+}
@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -105,6 +106,14 @@ int sys_rename(const char *oldpath, const char *newpath)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir, oldbasename);
+	dcache_remove(dir_new, newbasename);
+	if(S_ISDIR(i->i_mode)) {
+		dcache_purge(i->dev, i->inode);
+	}
+	if(i_new && S_ISDIR(i_new->i_mode)) {
+		dcache_purge(i_new->dev, i_new->inode);
+	}
 
 end:
 	iput(i);
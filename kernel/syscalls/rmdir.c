@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 
@@ -76,6 +77,7 @@ int sys_rmdir(const char *dirname)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_purge(i->dev, i->inode);
 	iput(i);
 	iput(dir);
 	return errno;
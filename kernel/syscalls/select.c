@@ -5,16 +5,150 @@
  * Distributed under the terms of the Fiwix License.
  */
 
+/*
+ * The select() method of every file links the process (through its poll
+ * table) in the wait queue of the object being checked, during the first
+ * scan only. From then on, the process sleeps on its own poll table and it's
+ * woken up only by the objects it's selecting, instead of by any I/O event
+ * in the system.
+ */
+
+#include <fiwix/asm.h>
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
 #include <fiwix/process.h>
 #include <fiwix/timer.h>
 #include <fiwix/sched.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
+#include <fiwix/mm.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
+#define POLL_PAGE_ENTRIES	((PAGE_SIZE - (2 * sizeof(int))) / sizeof(struct wait_entry))
+
+struct poll_page {
+	struct poll_page *next;
+	int count;
+	struct wait_entry entry[POLL_PAGE_ENTRIES];
+};
+
+static void poll_wakeup(struct wait_entry *e)
+{
+	struct poll_table *pt;
+
+	pt = (struct poll_table *)e->data;
+	pt->triggered = 1;
+	wakeup(pt);
+}
+
+static void poll_add(struct poll_table *pt, struct wait_queue *wq)
+{
+	struct poll_page *pp;
+	struct wait_entry *e;
+
+	pp = pt->pages;
+
+	/* the same object is usually checked for several events in a row */
+	if(pp && pp->count && pp->entry[pp->count - 1].queue == wq) {
+		return;
+	}
+	if(!pp || pp->count == POLL_PAGE_ENTRIES) {
+		if(!(pp = (struct poll_page *)kmalloc(PAGE_SIZE))) {
+			pt->error = -ENOMEM;
+			return;
+		}
+		pp->next = pt->pages;
+		pp->count = 0;
+		pt->pages = pp;
+	}
+	e = &pp->entry[pp->count++];
+	e->func = poll_wakeup;
+	e->data = pt;
+	add_wait_queue(wq, e);
+}
+
+/* called by the select() methods before checking the object */
+void select_wait(struct wait_queue *wq)
+{
+	if(current->poll_table) {
+		current->poll_table->add(current->poll_table, wq);
+	}
+}
+
+void poll_table_init(struct poll_table *pt)
+{
+	memset_b(pt, 0, sizeof(struct poll_table));
+	pt->add = poll_add;
+}
+
+void poll_table_sleep(struct poll_table *pt)
+{
+	unsigned int flags;
+
+	/* an object might have been woken up since the last scan */
+	SAVE_FLAGS(flags); CLI();
+	if(!pt->triggered) {
+		sleep(pt, PROC_INTERRUPTIBLE);
+	}
+	pt->triggered = 0;
+	RESTORE_FLAGS(flags);
+}
+
+void poll_table_free(struct poll_table *pt)
+{
+	struct poll_page *pp;
+	int n;
+
+	while((pp = pt->pages)) {
+		for(n = 0; n < pp->count; n++) {
+			remove_wait_queue(&pp->entry[n]);
+		}
+		pt->pages = pp->next;
+		kfree((unsigned int)pp);
+	}
+}
+
+/*
+ * Returns the events of 'events' that are ready in the file. POLLHUP and
+ * POLLERR are always reported, even if they were not requested.
+ */
+int poll_events(struct fd *f, int events)
+{
+	struct inode *i;
+	int revents;
+
+	i = f->inode;
+	if(!i->fsop || !i->fsop->select) {
+		return events & DEFAULT_POLLMASK;
+	}
+
+	revents = 0;
+	if(events & (POLLIN | POLLRDNORM)) {
+		if(i->fsop->select(i, f, SEL_R)) {
+			revents |= events & (POLLIN | POLLRDNORM);
+		}
+	}
+	if(events & (POLLOUT | POLLWRNORM)) {
+		if(i->fsop->select(i, f, SEL_W)) {
+			revents |= events & (POLLOUT | POLLWRNORM);
+		}
+	}
+	if(events & (POLLPRI | POLLRDBAND)) {
+		if(i->fsop->select(i, f, SEL_E)) {
+			revents |= events & (POLLPRI | POLLRDBAND);
+		}
+	}
+	if(i->fsop->select(i, f, SEL_HUP)) {
+		revents |= POLLHUP;
+	}
+	if(i->fsop->select(i, f, SEL_ERR)) {
+		revents |= POLLERR;
+	}
+	return revents;
+}
+
 static int check_fds(int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds)
 {
 	int n, bit;
@@ -55,6 +189,10 @@ int do_select(int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds, fd_set *res_rf
 {
 	int n, count;
 	struct inode *i;
+	struct poll_table pt;
+
+	poll_table_init(&pt);
+	current->poll_table = &pt;
 
 	count = 0;
 	for(;;) {
@@ -83,12 +221,18 @@ int do_select(int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds, fd_set *res_rf
 			}
 		}
 
+		current->poll_table = NULL;
 		if(count || !current->timeout || current->sigpending & ~current->sigblocked) {
 			break;
 		}
-		sleep(&do_select, PROC_INTERRUPTIBLE);
+		if(pt.error) {
+			count = pt.error;
+			break;
+		}
+		poll_table_sleep(&pt);
 	}
 
+	poll_table_free(&pt);
 	return count;
 }
 
@@ -106,8 +250,8 @@ int sys_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, s
 	if(nfds < 0) {
 		return -EINVAL;
 	}
-	if(nfds > MIN(__FD_SETSIZE, NR_OPENS)) {
-		nfds = MIN(__FD_SETSIZE, NR_OPENS);
+	if(nfds > MIN(__FD_SETSIZE, kstat.max_fds)) {
+		nfds = MIN(__FD_SETSIZE, kstat.max_fds);
 	}
 
 	if(readfds) {
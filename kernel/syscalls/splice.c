@@ -0,0 +1,76 @@
+/*
+ * fiwix/kernel/syscalls/splice.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/fcntl.h>
+#include <fiwix/errno.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#include <fiwix/process.h>
+#endif /*__DEBUG__ */
+
+#ifdef CONFIG_SYSCALL_6TH_ARG
+int sys_splice(int fd_in, __loff_t *off_in, int fd_out, __loff_t *off_out, __size_t len, unsigned int flags)
+{
+	struct fd *f_in, *f_out;
+	__loff_t in_offset, out_offset;
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_splice(%d, 0x%08x, %d, 0x%08x, %d, 0x%x)\n", current->pid, fd_in, (unsigned int)off_in, fd_out, (unsigned int)off_out, len, flags);
+#endif /*__DEBUG__ */
+
+	CHECK_UFD(fd_in);
+	CHECK_UFD(fd_out);
+	f_in = &fd_table[current->fd[fd_in]];
+	f_out = &fd_table[current->fd[fd_out]];
+	if((f_in->flags & O_ACCMODE) == O_WRONLY || (f_out->flags & O_ACCMODE) == O_RDONLY) {
+		return -EBADF;
+	}
+	if(off_in) {
+		if(f_in->inode->fsop == &pipefs_fsop) {
+			return -ESPIPE;
+		}
+		if((errno = check_user_area(VERIFY_WRITE, off_in, sizeof(__loff_t)))) {
+			return errno;
+		}
+	}
+	if(off_out) {
+		if(f_out->inode->fsop == &pipefs_fsop) {
+			return -ESPIPE;
+		}
+		if((errno = check_user_area(VERIFY_WRITE, off_out, sizeof(__loff_t)))) {
+			return errno;
+		}
+	}
+	if(!len) {
+		return 0;
+	}
+
+	/* the explicit offsets don't change the file offsets */
+	in_offset = f_in->offset;
+	out_offset = f_out->offset;
+	if(off_in) {
+		f_in->offset = *off_in;
+	}
+	if(off_out) {
+		f_out->offset = *off_out;
+	}
+	errno = pipefs_splice(f_in, f_out, len, flags);
+	if(off_in) {
+		*off_in = f_in->offset;
+		f_in->offset = in_offset;
+	}
+	if(off_out) {
+		*off_out = f_out->offset;
+		f_out->offset = out_offset;
+	}
+	return errno;
+}
+#endif /* CONFIG_SYSCALL_6TH_ARG */
@@ -0,0 +1,42 @@
+/*
+ * fiwix/kernel/syscalls/swapoff.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/process.h>
+#include <fiwix/swap.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#endif /*__DEBUG__ */
+
+int sys_swapoff(const char *specialfile)
+{
+	struct inode *i;
+	char *tmp_name;
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_swapoff('%s')\n", current->pid, specialfile);
+#endif /*__DEBUG__ */
+
+	if(!IS_SUPERUSER) {
+		return -EPERM;
+	}
+	if((errno = malloc_name(specialfile, &tmp_name)) < 0) {
+		return errno;
+	}
+	if((errno = namei(tmp_name, &i, NULL, FOLLOW_LINKS))) {
+		free_name(tmp_name);
+		return errno;
+	}
+	errno = swap_off(i);
+	iput(i);
+	free_name(tmp_name);
+	return errno;
+}
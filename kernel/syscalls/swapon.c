@@ -0,0 +1,45 @@
+/*
+ * fiwix/kernel/syscalls/swapon.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/fs.h>
+#include <fiwix/process.h>
+#include <fiwix/swap.h>
+#include <fiwix/errno.h>
+#include <fiwix/string.h>
+
+#ifdef __DEBUG__
+#include <fiwix/stdio.h>
+#endif /*__DEBUG__ */
+
+int sys_swapon(const char *specialfile, int swap_flags)
+{
+	struct inode *i;
+	char *tmp_name;
+	int errno;
+
+#ifdef __DEBUG__
+	printk("(pid %d) sys_swapon('%s', 0x%08x)\n", current->pid, specialfile, swap_flags);
+#endif /*__DEBUG__ */
+
+	if(!IS_SUPERUSER) {
+		return -EPERM;
+	}
+	if((errno = malloc_name(specialfile, &tmp_name)) < 0) {
+		return errno;
+	}
+	if((errno = namei(tmp_name, &i, NULL, FOLLOW_LINKS))) {
+		free_name(tmp_name);
+		return errno;
+	}
+
+	/* the swap area keeps the inode until swapoff() */
+	if((errno = swap_on(i, tmp_name, swap_flags))) {
+		iput(i);
+	}
+	free_name(tmp_name);
+	return errno;
+}
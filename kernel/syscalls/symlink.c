@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
 #include <fiwix/string.h>
@@ -66,6 +67,7 @@ int sys_symlink(const char *oldpath, const char *newpath)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir, basename);
 	iput(dir);
 	free_name(tmp_oldpath);
 	free_name(tmp_newpath);
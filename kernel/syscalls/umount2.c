@@ -7,6 +7,7 @@
 
 #include <fiwix/types.h>
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/filesystems.h>
 #include <fiwix/stat.h>
 #include <fiwix/sleep.h>
@@ -108,6 +109,7 @@ int sys_umount2(const char *target, int flags)
 	sync_buffers(dev);
 	invalidate_buffers(dev);
 	invalidate_inodes(dev);
+	dcache_flush(dev);
 
 	del_mount_point(mp);
 	unlock_resource(&umount_resource);
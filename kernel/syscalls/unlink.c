@@ -6,6 +6,7 @@
  */
 
 #include <fiwix/fs.h>
+#include <fiwix/dcache.h>
 #include <fiwix/syscalls.h>
 #include <fiwix/stat.h>
 #include <fiwix/errno.h>
@@ -71,6 +72,7 @@ int sys_unlink(const char *filename)
 	} else {
 		errno = -EPERM;
 	}
+	dcache_remove(dir, basename);
 	iput(i);
 	iput(dir);
 	free_name(tmp_name);
@@ -10,6 +10,7 @@
 #include <fiwix/segments.h>
 #include <fiwix/cmos.h>
 #include <fiwix/pit.h>
+#include <fiwix/cpu.h>
 #include <fiwix/timer.h>
 #include <fiwix/time.h>
 #include <fiwix/irq.h>
@@ -24,21 +25,60 @@
 #include <fiwix/string.h>
 
 /*
- * timer.c implements a callout table using a singly linked list.
+ * timer.c implements the callouts using a hierarchical timing wheel. The
+ * callouts that expire within the next 256 ticks are linked in the slot of
+ * their tick in 'tv1'. The later ones are linked in one of the 4 levels of
+ * 64 slots, each one covering 64 times the range of the previous one, and
+ * they are moved (cascaded) to a lower level every time the wheel of that
+ * level completes a turn. Adding and deleting a callout is O(1).
  *
- *  head
- * +---------+  ----------+  ...  ----------+
- * |data|next|  |data|next|  ...  |data|next|
- * |    |  -->  |    |  -->  ...  |    |  / |
- * +---------+  ----------+  ...  ----------+
- *  (callout)    (callout)         (callout)
+ *   tv1 (1 tick)    tvn[0] (256 ticks)   ...   tvn[3] (2^26 ticks)
+ *   +---------+     +---------+                +---------+
+ *   |    0    |-->  |    0    |                |    0    |
+ *   +---------+     +---------+                +---------+
+ *   |   ...   |     |   ...   |                |   ...   |
+ *   +---------+     +---------+                +---------+
+ *   |   255   |     |   63    |                |   63    |
+ *   +---------+     +---------+                +---------+
+ *
+ * The PIT runs in periodic mode while there is something to do. When the
+ * CPU goes idle and the next timer event (callout, process timeout or real
+ * interval timer) is more than one tick away, the PIT is switched to one-shot
+ * mode to interrupt directly in the tick boundary of that event, and all the
+ * ticks in between are accounted at once.
  */
 
 #define LATCH	(OSCIL / HZ)
+#define MAX_ONESHOT_TICKS	(0xFFFF / LATCH)	/* PIT counter is 16bit */
+#define NSLEEP_GUARD	(LATCH / 256)	/* PIT cycles too close to a tick boundary */
 
-struct callout callout_pool[NR_CALLOUTS];
-struct callout *callout_pool_head;
-struct callout *callout_head;
+/*
+ * Conversions done as a multiply and a shift, so they don't need the libgcc
+ * helpers. The factors for the TSC are set in timer_init().
+ */
+#define NSEC_TSC_SHIFT	28
+#define TSC_NSEC_SHIFT	22
+#define NSEC_TO_TSC(ns)	(((unsigned long long int)(ns) * nsec_tsc_mult) >> NSEC_TSC_SHIFT)
+#define TSC_TO_NSEC(c)	(((unsigned long long int)(c) * tsc_nsec_mult) >> TSC_NSEC_SHIFT)
+#define NSEC_PIT_MULT	((unsigned int)(((unsigned long long int)OSCIL << 32) / 1000000000))
+#define NSEC_TO_PIT(ns)	(((unsigned long long int)(ns) * NSEC_PIT_MULT) >> 32)
+#define NSLEEP_GUARD_NSEC	(NSLEEP_GUARD * (1000000000 / OSCIL))
+
+static struct callout_req *tv1[TVR_SIZE];
+static struct callout_req *tvn[NR_TVN][TVN_SIZE];
+static unsigned int callout_ticks;	/* next tick to be processed */
+static unsigned int nr_callouts;	/* number of pending callouts */
+
+static unsigned int pending_ticks;	/* ticks not yet seen by irq_timer_bh */
+static unsigned int cpu_ticks;		/* of them, ticks of the current process */
+static unsigned int oneshot_ticks;	/* ticks until the one-shot ends (0 = periodic) */
+static unsigned int oneshot_base;	/* PIT cycles of the tick already elapsed */
+static unsigned int oneshot_count;	/* PIT cycles programmed */
+static unsigned int tsc_tick;		/* TSC (low 32 bits) at the last tick */
+static unsigned int tsc_mult;		/* TSC cycles to usecs (0 = no TSC) */
+static unsigned int tsc_nsec_mult;	/* TSC cycles to nsecs */
+static unsigned int nsec_tsc_mult;	/* nsecs to TSC cycles */
+static unsigned int nsleep_split;	/* PIT cycles from a nanosleep() deadline to the tick */
 
 static char month[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 unsigned int avenrun[3] = { 0, 0, 0 };
@@ -63,12 +103,12 @@ static unsigned int count_active_procs(void)
 	return counter;
 }
 
-static void calc_load(void)
+static void calc_load(unsigned int ticks)
 {
 	unsigned int active_procs;
 	static int count = LOAD_FREQ;
 
-	if(count-- >= 0) {
+	if((count -= ticks) >= 0) {
 		return;
 	}
 
@@ -79,117 +119,374 @@ static void calc_load(void)
 	CALC_LOAD(avenrun[2], EXP_15, active_procs);
 }
 
-static struct callout *get_free_callout(void)
+static void link_callout(struct callout_req *creq)
 {
-	struct callout *new;
+	struct callout_req **slot;
+	unsigned int expires, idx;
+	int level;
+
+	expires = creq->expires;
+	idx = expires - callout_ticks;
+	if((int)idx < 0) {
+		/* already expired, it goes to the next tick */
+		slot = &tv1[callout_ticks & TVR_MASK];
+	} else if(idx < TVR_SIZE) {
+		slot = &tv1[expires & TVR_MASK];
+	} else {
+		for(level = 0; level < NR_TVN - 1; level++) {
+			if(idx < 1 << (TVR_BITS + (level + 1) * TVN_BITS)) {
+				break;
+			}
+		}
+		slot = &tvn[level][(expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
+	}
 
-	new = NULL;
-	if(callout_pool_head) {
-		new = callout_pool_head;
-		callout_pool_head = callout_pool_head->next;
-		new->next = NULL;
+	if((creq->next = *slot)) {
+		(*slot)->pprev = &creq->next;
 	}
-	return new;
+	creq->pprev = slot;
+	*slot = creq;
 }
 
-static void put_free_callout(struct callout *old)
+static void unlink_callout(struct callout_req *creq)
 {
-	old->next = callout_pool_head;
-	callout_pool_head = old;
+	if(creq->next) {
+		creq->next->pprev = creq->pprev;
+	}
+	*creq->pprev = creq->next;
+	creq->next = NULL;
+	creq->pprev = NULL;
 }
 
-static void do_del_callout(struct callout *c)
+/* moves the callouts of a slot to the lower levels */
+static int cascade(int level, int index)
 {
-	struct callout **tmp;
-
-	if(callout_head) {
-		tmp = &callout_head;
-		while(*tmp) {
-			if((*tmp) == c) {
-				if((*tmp)->next != NULL) {
-					*tmp = (*tmp)->next;
-					(*tmp)->expires += c->expires;
-				} else {
-					*tmp = NULL;
+	struct callout_req *creq, *next;
+
+	creq = tvn[level][index];
+	tvn[level][index] = NULL;
+	while(creq) {
+		next = creq->next;
+		link_callout(creq);
+		creq = next;
+	}
+	return index;
+}
+
+/* returns (unlinked) the next expired callout, if any */
+static struct callout_req *get_expired_callout(void)
+{
+	struct callout_req *creq;
+	int level;
+
+	while((int)(kstat.ticks - callout_ticks) >= 0) {
+		if((creq = tv1[callout_ticks & TVR_MASK])) {
+			unlink_callout(creq);
+			nr_callouts--;
+			return creq;
+		}
+		callout_ticks++;
+		if(!(callout_ticks & TVR_MASK)) {
+			for(level = 0; level < NR_TVN; level++) {
+				if(cascade(level, (callout_ticks >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK)) {
+					break;
 				}
-				put_free_callout(c);
-				break;
 			}
-			tmp = &(*tmp)->next;
 		}
 	}
+	return NULL;
 }
 
 void add_callout(struct callout_req *creq, unsigned int ticks)
 {
 	unsigned int flags;
-	struct callout *c, **tmp;
 
-	del_callout(creq);
 	SAVE_FLAGS(flags); CLI();
-
-	if(!(c = get_free_callout())) {
-		printk("WARNING: %s(): no more callout slots!\n", __FUNCTION__);
-		RESTORE_FLAGS(flags);
-		return;
+	if(creq->pprev) {
+		unlink_callout(creq);
+		nr_callouts--;
 	}
 
-	/* setup the new callout */
-	memset_b(c, 0, sizeof(struct callout));
-	c->expires = ticks;
-	c->fn = creq->fn;
-	c->arg = creq->arg;
-
-	if(!callout_head) {
-		callout_head = c;
-	} else {
-		tmp = &callout_head;
-		while(*tmp) {
-			if((*tmp)->expires > c->expires) {
-				(*tmp)->expires -= c->expires;
-				c->next = *tmp;
-				break;
-			}
-			c->expires -= (*tmp)->expires;
-			tmp = &(*tmp)->next;
-		}
-		*tmp = c;
+	/* an empty wheel is moved to the current time */
+	if(!nr_callouts) {
+		callout_ticks = kstat.ticks;
 	}
+	creq->expires = kstat.ticks + ticks;
+	link_callout(creq);
+	nr_callouts++;
 	RESTORE_FLAGS(flags);
 }
 
 void del_callout(struct callout_req *creq)
 {
 	unsigned int flags;
-	struct callout *c;
 
 	SAVE_FLAGS(flags); CLI();
-	c = callout_head;
-	while(c) {
-		if(c->fn == creq->fn && c->arg == creq->arg) {
-			do_del_callout(c);
-			break;
-		}
-		c = c->next;
+	if(creq->pprev) {
+		unlink_callout(creq);
+		nr_callouts--;
 	}
 	RESTORE_FLAGS(flags);
 }
 
+static void do_ticks(unsigned int ticks)
+{
+	pending_ticks += ticks;
+	while(ticks--) {
+		if((++kstat.ticks % HZ) == 0) {
+			CURRENT_TIME++;
+			kstat.uptime++;
+		}
+	}
+}
+
+static void add_usage(struct timeval *tv, unsigned int ticks)
+{
+	tv->tv_usec += ticks * TICK;
+	while(tv->tv_usec >= 1000000) {
+		tv->tv_sec++;
+		tv->tv_usec -= 1000000;
+	}
+}
+
+/* returns the number of ticks until the next timer event (up to 'max') */
+static unsigned int next_timer_event(unsigned int max)
+{
+	struct proc *p;
+	unsigned int ticks, n;
+	int left;
+
+	ticks = max;
+	FOR_EACH_PROCESS(p) {
+		if(p->timeout > 0 && p->timeout < ticks) {
+			ticks = p->timeout;
+		}
+		if(p->it_real_value > 0 && p->it_real_value < ticks) {
+			ticks = p->it_real_value;
+		}
+		p = p->next;
+	}
+
+	if(nr_callouts) {
+		/* stop also in the next cascade, it might bring new callouts */
+		for(n = callout_ticks; (int)(n - kstat.ticks) < (int)ticks; n++) {
+			if(tv1[n & TVR_MASK] || (n != callout_ticks && !(n & TVR_MASK))) {
+				break;
+			}
+		}
+		if((left = n - kstat.ticks) < (int)ticks) {
+			ticks = left > 0 ? left : 0;
+		}
+	}
+	return ticks;
+}
+
 void irq_timer(int num, struct sigcontext *sc)
 {
-	if((++kstat.ticks % HZ) == 0) {
-		CURRENT_TIME++;
-		kstat.uptime++;
+	int late;
+
+	/*
+	 * A nanosleep() deadline within the tick. The PIT is programmed again
+	 * to end the tick in its boundary, discounting the cycles elapsed since
+	 * the terminal count.
+	 */
+	if(nsleep_split) {
+		late = (0x10000 - pit_getcounter0()) & 0xFFFF;
+		if(late >= nsleep_split) {
+			late = nsleep_split - 1;
+		}
+		oneshot_base = LATCH - nsleep_split + late;
+		oneshot_count = nsleep_split - late;
+		oneshot_ticks = 1;
+		pit_oneshot(oneshot_count);
+		nsleep_split = 0;
+		wakeup(&nsleep_split);
+		need_resched = 1;
+		return;
+	}
+
+	/* a one-shot ends always in a tick boundary */
+	if(oneshot_ticks) {
+		do_ticks(oneshot_ticks);
+		cpu_ticks += oneshot_ticks;
+		oneshot_ticks = 0;
+		pit_init(HZ);
+	} else {
+		do_ticks(1);
+		cpu_ticks++;
+	}
+	if(tsc_mult) {
+		RDTSC_LOW(tsc_tick);
 	}
 
 	timer_bh.flags |= BH_ACTIVE;
 }
 
+/*
+ * Called from the idle loop with the interrupts disabled, just before halting
+ * the CPU. The one-shot is programmed taking into account the cycles of the
+ * current tick already elapsed, so the tick boundaries are kept.
+ */
+void timer_idle_enter(void)
+{
+	unsigned int ticks;
+	int count;
+
+	if(oneshot_ticks || pending_ticks || nsleep_split) {
+		return;
+	}
+	if((ticks = next_timer_event(MAX_ONESHOT_TICKS)) < 2) {
+		return;
+	}
+	/* too close to the tick, it could end before the PIT is programmed */
+	count = pit_getcounter0();
+	if(count < LATCH / 16 || count > LATCH) {
+		return;
+	}
+	oneshot_base = LATCH - count;
+	oneshot_count = ticks * LATCH - oneshot_base;
+	oneshot_ticks = ticks;
+	pit_oneshot(oneshot_count);
+}
+
+/*
+ * Called from the idle loop with the interrupts disabled, once the CPU has
+ * been woken up. If it was woken up by another interrupt, the ticks elapsed
+ * are accounted (to the idle process) and the one-shot is shortened to end in
+ * the next tick boundary, where the periodic mode will be restored.
+ */
+void timer_idle_exit(void)
+{
+	unsigned int elapsed;
+	int count;
+
+	if(!oneshot_ticks) {
+		return;
+	}
+
+	/* it has already ended and the interrupt is pending */
+	if(pit_readback0(&count) & PIT_OUTPUT) {
+		return;
+	}
+
+	elapsed = oneshot_base + oneshot_count - count;
+	if(elapsed / LATCH) {
+		do_ticks(elapsed / LATCH);
+		add_usage(&current->usage.ru_stime, elapsed / LATCH);
+	}
+	oneshot_base = elapsed % LATCH;
+	oneshot_count = LATCH - oneshot_base;
+	oneshot_ticks = 1;
+	pit_oneshot(oneshot_count);
+	if(tsc_mult) {
+		RDTSC_LOW(tsc_tick);
+		tsc_tick -= oneshot_base * (cpu_table.hz / OSCIL);
+	}
+}
+
+/*
+ * Busy-waits 'nsec' nanoseconds using the TSC. It returns the nanoseconds
+ * left if a signal has interrupted the wait.
+ */
+static unsigned int tsc_delay(unsigned int nsec)
+{
+	unsigned int start, now, cycles, elapsed;
+
+	cycles = NSEC_TO_TSC(nsec);
+	RDTSC_LOW(start);
+	for(;;) {
+		RDTSC_LOW(now);
+		if((elapsed = now - start) >= cycles) {
+			break;
+		}
+		if(current->sigpending & ~current->sigblocked) {
+			return nsec - TSC_TO_NSEC(elapsed);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Sleeps 'nsec' nanoseconds (less than a tick) using the TSC to know when the
+ * deadline is reached. If it falls within the current tick, the PIT is
+ * switched to one-shot mode to interrupt there, and then once more to end the
+ * tick in its boundary. Otherwise, or if the PIT is in use, the process sleeps
+ * until the next tick and tries again. Only the remainders too short to
+ * program the PIT are busy-waited. It returns the nanoseconds left if a
+ * signal has interrupted the sleep.
+ */
+unsigned int timer_nsleep(unsigned int nsec)
+{
+	unsigned int flags, end, now, left;
+	int count, elapsed, busy, intr;
+
+	RDTSC_LOW(end);
+	end += NSEC_TO_TSC(nsec);
+
+	for(;;) {
+		SAVE_FLAGS(flags); CLI();
+		RDTSC_LOW(now);
+		if((int)(end - now) <= 0) {
+			RESTORE_FLAGS(flags);
+			return 0;
+		}
+		nsec = TSC_TO_NSEC(end - now);
+		left = NSEC_TO_PIT(nsec);
+
+		if(left <= NSLEEP_GUARD) {
+			RESTORE_FLAGS(flags);
+			return tsc_delay(nsec);
+		}
+
+		/* PIT cycles of the current tick already elapsed */
+		count = pit_getcounter0();
+		if(oneshot_ticks) {
+			elapsed = oneshot_base + oneshot_count - count;
+		} else {
+			elapsed = LATCH - count;
+		}
+
+		busy = oneshot_ticks > 1 || nsleep_split;
+
+		if(!busy && (elapsed < NSLEEP_GUARD || elapsed > LATCH)) {
+			/* the tick has just ended, its interrupt may be pending */
+			RESTORE_FLAGS(flags);
+			intr = tsc_delay(MIN(nsec, NSLEEP_GUARD_NSEC));
+		} else {
+			if(!busy && elapsed + left <= LATCH - NSLEEP_GUARD) {
+				nsleep_split = LATCH - elapsed - left;
+				pit_oneshot(left);
+				intr = sleep(&nsleep_split, PROC_INTERRUPTIBLE);
+			} else {
+				/* the deadline is beyond this tick or the PIT is in use */
+				current->timeout = 1;
+				intr = sleep(&timer_nsleep, PROC_INTERRUPTIBLE);
+				current->timeout = 0;
+			}
+			RESTORE_FLAGS(flags);
+		}
+
+		if(intr) {
+			RDTSC_LOW(now);
+			if((int)(end - now) <= 0) {
+				return 0;
+			}
+			return TSC_TO_NSEC(end - now);
+		}
+	}
+}
+
 unsigned int tv2ticks(const struct timeval *tv)
 {
 	return((tv->tv_sec * HZ) + tv->tv_usec * HZ / 1000000);
 }
 
+/* as tv2ticks() but rounding up, so a short interval doesn't become zero */
+static unsigned int tv2ticks_up(const struct timeval *tv)
+{
+	return((tv->tv_sec * HZ) + ((tv->tv_usec * HZ) + 999999) / 1000000);
+}
+
 void ticks2tv(int ticks, struct timeval *tv)
 {
 	tv->tv_sec = ticks / HZ;
@@ -204,24 +501,24 @@ int setitimer(int which, const struct itimerval *new_value, struct itimerval *ol
 				ticks2tv(current->it_real_interval, &old_value->it_interval);
 				ticks2tv(current->it_real_value, &old_value->it_value);
 			}
-			current->it_real_interval = tv2ticks(&new_value->it_interval);
-			current->it_real_value = tv2ticks(&new_value->it_value);
+			current->it_real_interval = tv2ticks_up(&new_value->it_interval);
+			current->it_real_value = tv2ticks_up(&new_value->it_value);
 			break;
 		case ITIMER_VIRTUAL:
 			if((unsigned int)old_value) {
 				ticks2tv(current->it_virt_interval, &old_value->it_interval);
 				ticks2tv(current->it_virt_value, &old_value->it_value);
 			}
-			current->it_virt_interval = tv2ticks(&new_value->it_interval);
-			current->it_virt_value = tv2ticks(&new_value->it_value);
+			current->it_virt_interval = tv2ticks_up(&new_value->it_interval);
+			current->it_virt_value = tv2ticks_up(&new_value->it_value);
 			break;
 		case ITIMER_PROF:
 			if((unsigned int)old_value) {
 				ticks2tv(current->it_prof_interval, &old_value->it_interval);
 				ticks2tv(current->it_prof_value, &old_value->it_value);
 			}
-			current->it_prof_interval = tv2ticks(&new_value->it_interval);
-			current->it_prof_value = tv2ticks(&new_value->it_value);
+			current->it_prof_interval = tv2ticks_up(&new_value->it_interval);
+			current->it_prof_value = tv2ticks_up(&new_value->it_value);
 			break;
 		default:
 			return -EINVAL;
@@ -258,30 +555,33 @@ unsigned int mktime(struct mt *mt)
 void irq_timer_bh(struct sigcontext *sc)
 {
 	struct proc *p;
+	unsigned int ticks, cticks, flags;
+
+	SAVE_FLAGS(flags); CLI();
+	ticks = pending_ticks;
+	cticks = cpu_ticks;
+	pending_ticks = cpu_ticks = 0;
+	RESTORE_FLAGS(flags);
+	if(!ticks) {
+		return;
+	}
 
 	if(sc->cs == KERNEL_CS) {
-		current->usage.ru_stime.tv_usec += TICK;
-		if(current->usage.ru_stime.tv_usec >= 1000000) {
-			current->usage.ru_stime.tv_sec++;
-			current->usage.ru_stime.tv_usec -= 1000000;
-		}
+		add_usage(&current->usage.ru_stime, cticks);
 		if(current->pid != IDLE) {
-			kstat.cpu_system++;
+			kstat.cpu_system += cticks;
 		}
 	} else {
-		current->usage.ru_utime.tv_usec += TICK;
-		if(current->usage.ru_utime.tv_usec >= 1000000) {
-			current->usage.ru_utime.tv_sec++;
-			current->usage.ru_utime.tv_usec -= 1000000;
-		}
+		add_usage(&current->usage.ru_utime, cticks);
 		if(current->pid != IDLE) {
-			kstat.cpu_user++;
+			kstat.cpu_user += cticks;
 		}
-		if(current->it_virt_value > 0) {
-			current->it_virt_value--;
-			if(!current->it_virt_value) {
+		if(current->it_virt_value > 0 && cticks) {
+			if(current->it_virt_value <= cticks) {
 				current->it_virt_value = current->it_virt_interval;
 				send_sig(current, SIGVTALRM);
+			} else {
+				current->it_virt_value -= cticks;
 			}
 		}
 	}
@@ -290,70 +590,66 @@ void irq_timer_bh(struct sigcontext *sc)
 		send_sig(current, SIGXCPU);
 	}
 
-	if(current->it_prof_value > 0) {
-		current->it_prof_value--;
-		if(!current->it_prof_value) {
+	if(current->it_prof_value > 0 && cticks) {
+		if(current->it_prof_value <= cticks) {
 			current->it_prof_value = current->it_prof_interval;
 			send_sig(current, SIGPROF);
+		} else {
+			current->it_prof_value -= cticks;
 		}
 	}
 
-	calc_load();
+	calc_load(ticks);
 	FOR_EACH_PROCESS(p) {
 		if(p->timeout > 0 && p->timeout < INFINITE_WAIT) {
-			p->timeout--;
-			if(!p->timeout) {
+			if(p->timeout <= ticks) {
+				p->timeout = 0;
 				wakeup_proc(p);
+			} else {
+				p->timeout -= ticks;
 			}
 		}
 		if(p->it_real_value > 0) {
-			p->it_real_value--;
-			if(!p->it_real_value) {
+			if(p->it_real_value <= ticks) {
 				p->it_real_value = p->it_real_interval;
 				send_sig(p, SIGALRM);
+			} else {
+				p->it_real_value -= ticks;
 			}
 		}
 		p = p->next;
 	}
 
 	/* callouts */
-	if(callout_head) {
-		if(callout_head->expires > 0) {
-			callout_head->expires--;
-			if(!callout_head->expires) {
-				callouts_bh.flags |= BH_ACTIVE;
-			}
-		} else {
-			printk("%s(): callout losing ticks.\n", __FUNCTION__);
-			callouts_bh.flags |= BH_ACTIVE;
-		}
+	if(nr_callouts) {
+		callouts_bh.flags |= BH_ACTIVE;
 	}
 
-	if(current->pid > IDLE && --current->cpu_count <= 0) {
-		current->cpu_count = 0;
-		need_resched = 1;
+	if(current->pid > IDLE) {
+		sched_tick(current);
 	}
 }
 
 void do_callouts_bh(struct sigcontext *sc)
 {
-	struct callout *c;
+	struct callout_req *creq;
 	void (*fn)(unsigned int);
-	unsigned int arg;
+	unsigned int arg, flags;
 
-	while(callout_head) {
-		if(callout_head->expires) {
-			break;
-		}
+	for(;;) {
 		if(lock_area(AREA_CALLOUT)) {
 			break;
 		}
-		fn = callout_head->fn;
-		arg = callout_head->arg;
-		c = callout_head;
-		callout_head = callout_head->next;
-		put_free_callout(c);
+		SAVE_FLAGS(flags); CLI();
+		if((creq = get_expired_callout())) {
+			fn = creq->fn;
+			arg = creq->arg;
+		}
+		RESTORE_FLAGS(flags);
 		unlock_area(AREA_CALLOUT);
+		if(!creq) {
+			break;
+		}
 		fn(arg);
 	}
 }
@@ -428,39 +724,61 @@ void set_system_time(__time_t t)
 	CURRENT_TIME = t;
 }
 
+/* returns the usecs elapsed since the last tick */
 int gettimeoffset(void)
 {
+	unsigned int now;
 	int count;
 
-	count = pit_getcounter0();
-	count = (LATCH - count) * TICK;
-	count /= LATCH;
+	if(tsc_mult) {
+		RDTSC_LOW(now);
+		count = ((unsigned long long int)(now - tsc_tick) * tsc_mult) >> 32;
+	} else {
+		count = pit_getcounter0();
+		count = (LATCH - count) * TICK;
+		count /= LATCH;
+	}
 
-	return count;
+	/* the tick might be pending */
+	if(count < 0) {
+		count = 0;
+	}
+	return count < TICK ? count : TICK - 1;
 }
 
-void timer_init(void)
+/* returns n / d, the quotient must fit in 32 bits */
+static unsigned int div64_32(unsigned long long int n, unsigned int d)
 {
-	int n;
-	struct callout *c;
+	unsigned int q, r;
 
+	__asm__("divl %4"
+		: "=a" (q), "=d" (r)
+		: "0" ((unsigned int)n), "1" ((unsigned int)(n >> 32)), "rm" (d)
+	);
+	return q;
+}
+
+void timer_init(void)
+{
 	add_bh(&timer_bh);
 	add_bh(&callouts_bh);
 
 	pit_init(HZ);
 
-	memset_b(callout_pool, 0, sizeof(callout_pool));
-
-	/* callout free list initialization */
-	callout_pool_head = NULL;
-	n = NR_CALLOUTS;
-	while(n--) {
-		c = &callout_pool[n];
-		put_free_callout(c);
+	memset_b(tv1, 0, sizeof(tv1));
+	memset_b(tvn, 0, sizeof(tvn));
+	callout_ticks = kstat.ticks;
+	nr_callouts = 0;
+
+	/* the TSC (if any) interpolates the time between ticks */
+	if(cpu_table.flags & CPU_TSC && cpu_table.hz >= 1000000) {
+		tsc_mult = div64_32((unsigned long long int)1000000 << 32, cpu_table.hz);
+		tsc_nsec_mult = div64_32((unsigned long long int)1000000000 << TSC_NSEC_SHIFT, cpu_table.hz);
+		nsec_tsc_mult = div64_32((unsigned long long int)cpu_table.hz << NSEC_TSC_SHIFT, 1000000000);
+		RDTSC_LOW(tsc_tick);
 	}
-	callout_head = NULL;
 
-	printk("clock     -                 %d\ttype=PIT Hz=%d\n", TIMER_IRQ, HZ);
+	printk("clock     -                 %d\ttype=PIT Hz=%d%s\n", TIMER_IRQ, HZ, tsc_mult ? " clocksource=TSC" : "");
 	if(!register_irq(TIMER_IRQ, &irq_config_timer)) {
 		enable_irq(TIMER_IRQ);
 	}
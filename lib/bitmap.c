@@ -0,0 +1,37 @@
+/*
+ * fiwix/lib/bitmap.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/bitmap.h>
+
+/*
+ * Returns the bit number of the first zero found from 'start' in a bitmap of
+ * 'nbits' bits (or -1), scanning it a 32-bit word at a time.
+ */
+int find_next_zero_bit(const unsigned int *bitmap, int nbits, int start)
+{
+	unsigned int w;
+	int n, bit, nwords;
+
+	if(start >= nbits) {
+		return -1;
+	}
+	nwords = (nbits + 31) / 32;
+	n = start / 32;
+
+	/* ignore the bits before 'start' in the first word */
+	w = ~bitmap[n] & (~0U << (start % 32));
+	while(!w) {
+		if(++n >= nwords) {
+			return -1;
+		}
+		w = ~bitmap[n];
+	}
+	BSF(bit, w);
+	bit += n * 32;
+	return bit < nbits ? bit : -1;
+}
@@ -0,0 +1,206 @@
+/*
+ * fiwix/lib/lz4.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * A compressor and decompressor for the LZ4 block format. The data is a list
+ * of sequences, each one made of a run of literals followed by a copy of a
+ * previous match:
+ *
+ * +-------+-----------+----------+--------+-----------+
+ * | token | (lit len) | literals | offset | (mat len) |
+ * +-------+-----------+----------+--------+-----------+
+ *
+ * The token keeps the lengths of the literals (high nibble) and of the match
+ * minus MINMATCH (low nibble); a nibble of 15 is followed by more bytes that
+ * are added up until one of them is not 255. The offset is 16 bits (little
+ * endian), and the last sequence has only literals.
+ *
+ * The compressor finds the matches with a single hash table of positions, so
+ * it trades some ratio for a lot of speed, which is what it's used for.
+ */
+
+#include <fiwix/lz4.h>
+#include <fiwix/string.h>
+
+#define MINMATCH	4
+#define LASTLITERALS	5	/* the last bytes are always literals */
+#define MFLIMIT		12	/* a match can't start in the last bytes */
+#define RUN_MASK	15
+#define ML_MASK		15
+
+#define READ32(p)	((p)[0] | ((p)[1] << 8) | ((p)[2] << 16) | ((unsigned int)(p)[3] << 24))
+#define HASH(v)		(((v) * 2654435761U) >> (32 - LZ4_HASH_LOG))
+
+/* bytes needed to store a length that doesn't fit in its nibble */
+#define EXTRA_LEN(len)	((len) >= 15 ? ((len) - 15) / 255 + 1 : 0)
+
+static unsigned char *put_length(unsigned char *op, int len)
+{
+	for(len -= 15; len >= 255; len -= 255) {
+		*op++ = 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+/*
+ * Compresses 'srclen' bytes of 'src' into 'dst'. Returns the compressed
+ * size, or 0 if it doesn't fit in 'dstmax' bytes. 'wrkmem' must have at
+ * least LZ4_WRKMEM_SIZE bytes.
+ */
+int lz4_compress(const unsigned char *src, int srclen, unsigned char *dst, int dstmax, void *wrkmem)
+{
+	const unsigned char *ip, *ref, *anchor, *mflimit, *matchlimit, *iend;
+	unsigned char *op, *oend, *token;
+	unsigned short int *table;
+	int litlen, len, offset;
+	unsigned int h;
+
+	table = (unsigned short int *)wrkmem;
+	memset_b(table, 0, LZ4_WRKMEM_SIZE);
+
+	ip = anchor = src;
+	iend = src + srclen;
+	mflimit = iend - MFLIMIT;
+	matchlimit = iend - LASTLITERALS;
+	op = dst;
+	oend = dst + dstmax;
+
+	if(srclen > MFLIMIT) {
+		ip++;
+		while(ip <= mflimit) {
+			h = HASH(READ32(ip));
+			ref = src + table[h];
+			table[h] = ip - src;
+			if(READ32(ref) != READ32(ip)) {
+				ip++;
+				continue;
+			}
+
+			/* the match could also cover some of the previous bytes */
+			while(ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+			for(len = MINMATCH; ip + len < matchlimit && ip[len] == ref[len]; len++);
+
+			litlen = ip - anchor;
+			if(op + 1 + EXTRA_LEN(litlen) + litlen + 2 + EXTRA_LEN(len - MINMATCH) > oend) {
+				return 0;
+			}
+			token = op++;
+			if(litlen >= RUN_MASK) {
+				*token = RUN_MASK << 4;
+				op = put_length(op, litlen);
+			} else {
+				*token = litlen << 4;
+			}
+			memcpy_b(op, (void *)anchor, litlen);
+			op += litlen;
+
+			offset = ip - ref;
+			*op++ = offset & 0xFF;
+			*op++ = offset >> 8;
+			if(len - MINMATCH >= ML_MASK) {
+				*token |= ML_MASK;
+				op = put_length(op, len - MINMATCH);
+			} else {
+				*token |= len - MINMATCH;
+			}
+
+			ip += len;
+			anchor = ip;
+			if(ip <= mflimit) {
+				table[HASH(READ32(ip - 2))] = ip - 2 - src;
+			}
+		}
+	}
+
+	litlen = iend - anchor;
+	if(op + 1 + EXTRA_LEN(litlen) + litlen > oend) {
+		return 0;
+	}
+	token = op++;
+	if(litlen >= RUN_MASK) {
+		*token = RUN_MASK << 4;
+		op = put_length(op, litlen);
+	} else {
+		*token = litlen << 4;
+	}
+	memcpy_b(op, (void *)anchor, litlen);
+	op += litlen;
+	return op - dst;
+}
+
+/*
+ * Decompresses 'srclen' bytes of 'src' into 'dst'. Returns the size of the
+ * data, or -1 if it's corrupted or it doesn't fit in 'dstlen' bytes.
+ */
+int lz4_decompress(const unsigned char *src, int srclen, unsigned char *dst, int dstlen)
+{
+	const unsigned char *ip, *iend;
+	unsigned char *op, *oend, *ref;
+	int token, len, offset, n;
+
+	ip = src;
+	iend = src + srclen;
+	op = dst;
+	oend = dst + dstlen;
+
+	while(ip < iend) {
+		token = *ip++;
+
+		if((len = token >> 4) == RUN_MASK) {
+			do {
+				if(ip >= iend) {
+					return -1;
+				}
+				len += (n = *ip++);
+			} while(n == 255);
+		}
+		if(len > iend - ip || len > oend - op) {
+			return -1;
+		}
+		memcpy_b(op, (void *)ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence has no match */
+		if(ip == iend) {
+			break;
+		}
+
+		if(iend - ip < 2) {
+			return -1;
+		}
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(!offset || offset > op - dst) {
+			return -1;
+		}
+		ref = op - offset;
+
+		if((len = token & ML_MASK) == ML_MASK) {
+			do {
+				if(ip >= iend) {
+					return -1;
+				}
+				len += (n = *ip++);
+			} while(n == 255);
+		}
+		len += MINMATCH;
+		if(len > oend - op) {
+			return -1;
+		}
+
+		/* the match can overlap the bytes being copied */
+		while(len--) {
+			*op++ = *ref++;
+		}
+	}
+	return op - dst;
+}
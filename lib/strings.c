@@ -5,7 +5,9 @@
  * Distributed under the terms of the Fiwix License.
  */
 
+#include <fiwix/asm.h>
 #include <fiwix/types.h>
+#include <fiwix/cpu.h>
 #include <fiwix/tty.h>
 #include <fiwix/mm.h>
 #include <fiwix/stdio.h>
@@ -206,77 +208,324 @@ int atoi(const char *str)
 
 void memcpy_b(void *dest, const void *src, unsigned int count)
 {
-	unsigned char *d;
-	unsigned char *s;
-
-	d = (unsigned char *)dest;
-	s = (unsigned char *)src;
-	while(count--) {
-		*d = *s;
-		d++;
-		s++;
+	int d0, d1, d2;
+
+	/* align the destination when it's worth */
+	if(count >= 16) {
+		while((unsigned int)dest & 3) {
+			*(unsigned char *)dest = *(unsigned char *)src;
+			dest = (unsigned char *)dest + 1;
+			src = (unsigned char *)src + 1;
+			count--;
+		}
 	}
+	__asm__ __volatile__(
+		"rep ; movsl\n\t"
+		"movl %4, %%ecx\n\t"
+		"rep ; movsb\n\t"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (count >> 2), "g" (count & 3), "1" (dest), "2" (src)
+		: "memory"
+	);
 }
 
 void memcpy_w(void *dest, const void *src, unsigned int count)
 {
-	unsigned short int *d;
-	unsigned short int *s;
+	int d0, d1, d2;
+
+	__asm__ __volatile__(
+		"rep ; movsw\n\t"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (count), "1" (dest), "2" (src)
+		: "memory"
+	);
+}
+
+void memcpy_l(void *dest, const void *src, unsigned int count)
+{
+	int d0, d1, d2;
+
+	__asm__ __volatile__(
+		"rep ; movsl\n\t"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (count), "1" (dest), "2" (src)
+		: "memory"
+	);
+}
+
+void memset_b(void *dest, unsigned char value, unsigned int count)
+{
+	int d0, d1;
 
-	d = (unsigned short int *)dest;
-	s = (unsigned short int *)src;
-	while(count--) {
-		*d = *s;
-		d++;
-		s++;
+	if(count >= 16) {
+		while((unsigned int)dest & 3) {
+			*(unsigned char *)dest = value;
+			dest = (unsigned char *)dest + 1;
+			count--;
+		}
 	}
+	__asm__ __volatile__(
+		"rep ; stosl\n\t"
+		"movl %3, %%ecx\n\t"
+		"rep ; stosb\n\t"
+		: "=&c" (d0), "=&D" (d1)
+		: "0" (count >> 2), "g" (count & 3), "1" (dest), "a" ((unsigned int)value * 0x01010101)
+		: "memory"
+	);
 }
 
-void memcpy_l(void *dest, const void *src, unsigned int count)
+void memset_w(void *dest, unsigned short int value, unsigned int count)
 {
-	unsigned int *d;
-	unsigned int *s;
+	int d0, d1;
+
+	__asm__ __volatile__(
+		"rep ; stosw\n\t"
+		: "=&c" (d0), "=&D" (d1)
+		: "0" (count), "1" (dest), "a" (value)
+		: "memory"
+	);
+}
 
-	d = (unsigned int *)dest;
-	s = (unsigned int *)src;
-	while(count--) {
-		*d = *s;
-		d++;
-		s++;
+void memset_l(void *dest, unsigned int value, unsigned int count)
+{
+	int d0, d1;
+
+	__asm__ __volatile__(
+		"rep ; stosl\n\t"
+		: "=&c" (d0), "=&D" (d1)
+		: "0" (count), "1" (dest), "a" (value)
+		: "memory"
+	);
+}
+
+static void memcpy_page_rep(void *dest, const void *src)
+{
+	memcpy_l(dest, src, PAGE_SIZE / sizeof(unsigned int));
+}
+
+static void memzero_page_rep(void *dest)
+{
+	memset_l(dest, 0, PAGE_SIZE / sizeof(unsigned int));
+}
+
+#ifndef __TINYC__
+/*
+ * The kernel doesn't keep a per-process FPU context, so the MMX registers
+ * (aliased with the x87 ones) must be saved and restored around their use.
+ */
+#define FNSAVE(s) __asm__ __volatile__ ("fnsave %0 ; fwait" : "=m" (s));
+#define FRSTOR(s) __asm__ __volatile__ ("frstor %0" :: "m" (s));
+
+static void memcpy_page_mmx(void *dest, const void *src)
+{
+	struct fpu_state fpu;
+	int n;
+
+	FNSAVE(fpu);
+	for(n = 0; n < PAGE_SIZE / 64; n++) {
+		__asm__ __volatile__(
+			"movq (%0), %%mm0\n\t"
+			"movq 8(%0), %%mm1\n\t"
+			"movq 16(%0), %%mm2\n\t"
+			"movq 24(%0), %%mm3\n\t"
+			"movq 32(%0), %%mm4\n\t"
+			"movq 40(%0), %%mm5\n\t"
+			"movq 48(%0), %%mm6\n\t"
+			"movq 56(%0), %%mm7\n\t"
+			"movq %%mm0, (%1)\n\t"
+			"movq %%mm1, 8(%1)\n\t"
+			"movq %%mm2, 16(%1)\n\t"
+			"movq %%mm3, 24(%1)\n\t"
+			"movq %%mm4, 32(%1)\n\t"
+			"movq %%mm5, 40(%1)\n\t"
+			"movq %%mm6, 48(%1)\n\t"
+			"movq %%mm7, 56(%1)\n\t"
+			: /* no output */
+			: "r" (src), "r" (dest)
+			: "memory"
+		);
+		src = (unsigned char *)src + 64;
+		dest = (unsigned char *)dest + 64;
 	}
+	FRSTOR(fpu);
 }
 
-void memset_b(void *dest, unsigned char value, unsigned int count)
+static void memzero_page_mmx(void *dest)
 {
-	unsigned char *d;
-	
-	d = (unsigned char *)dest;
-	while(count--) {
-		*d = value;
-		d++;
+	struct fpu_state fpu;
+	int n;
+
+	FNSAVE(fpu);
+	__asm__ __volatile__("pxor %%mm0, %%mm0" ::);
+	for(n = 0; n < PAGE_SIZE / 64; n++) {
+		__asm__ __volatile__(
+			"movq %%mm0, (%0)\n\t"
+			"movq %%mm0, 8(%0)\n\t"
+			"movq %%mm0, 16(%0)\n\t"
+			"movq %%mm0, 24(%0)\n\t"
+			"movq %%mm0, 32(%0)\n\t"
+			"movq %%mm0, 40(%0)\n\t"
+			"movq %%mm0, 48(%0)\n\t"
+			"movq %%mm0, 56(%0)\n\t"
+			: /* no output */
+			: "r" (dest)
+			: "memory"
+		);
+		dest = (unsigned char *)dest + 64;
 	}
+	FRSTOR(fpu);
 }
 
-void memset_w(void *dest, unsigned short int value, unsigned int count)
+/*
+ * The SSE variants still use the MMX registers (so CR4.OSFXSR is not needed),
+ * but with non-temporal stores that don't pollute the caches with the
+ * destination page.
+ */
+static void memcpy_page_sse(void *dest, const void *src)
 {
-	unsigned short int *d;
-	
-	d = (unsigned short int *)dest;
-	while(count--) {
-		*d = value;
-		d++;
+	struct fpu_state fpu;
+	int n;
+
+	FNSAVE(fpu);
+	for(n = 0; n < PAGE_SIZE / 64; n++) {
+		__asm__ __volatile__(
+			"prefetchnta 320(%0)\n\t"
+			"movq (%0), %%mm0\n\t"
+			"movq 8(%0), %%mm1\n\t"
+			"movq 16(%0), %%mm2\n\t"
+			"movq 24(%0), %%mm3\n\t"
+			"movq 32(%0), %%mm4\n\t"
+			"movq 40(%0), %%mm5\n\t"
+			"movq 48(%0), %%mm6\n\t"
+			"movq 56(%0), %%mm7\n\t"
+			"movntq %%mm0, (%1)\n\t"
+			"movntq %%mm1, 8(%1)\n\t"
+			"movntq %%mm2, 16(%1)\n\t"
+			"movntq %%mm3, 24(%1)\n\t"
+			"movntq %%mm4, 32(%1)\n\t"
+			"movntq %%mm5, 40(%1)\n\t"
+			"movntq %%mm6, 48(%1)\n\t"
+			"movntq %%mm7, 56(%1)\n\t"
+			: /* no output */
+			: "r" (src), "r" (dest)
+			: "memory"
+		);
+		src = (unsigned char *)src + 64;
+		dest = (unsigned char *)dest + 64;
 	}
+	__asm__ __volatile__("sfence" ::: "memory");
+	FRSTOR(fpu);
 }
 
-void memset_l(void *dest, unsigned int value, unsigned int count)
+static void memzero_page_sse(void *dest)
 {
-	unsigned int *d;
-	
-	d = (unsigned int *)dest;
-	while(count--) {
-		*d = value;
-		d++;
+	struct fpu_state fpu;
+	int n;
+
+	FNSAVE(fpu);
+	__asm__ __volatile__("pxor %%mm0, %%mm0" ::);
+	for(n = 0; n < PAGE_SIZE / 64; n++) {
+		__asm__ __volatile__(
+			"movntq %%mm0, (%0)\n\t"
+			"movntq %%mm0, 8(%0)\n\t"
+			"movntq %%mm0, 16(%0)\n\t"
+			"movntq %%mm0, 24(%0)\n\t"
+			"movntq %%mm0, 32(%0)\n\t"
+			"movntq %%mm0, 40(%0)\n\t"
+			"movntq %%mm0, 48(%0)\n\t"
+			"movntq %%mm0, 56(%0)\n\t"
+			: /* no output */
+			: "r" (dest)
+			: "memory"
+		);
+		dest = (unsigned char *)dest + 64;
+	}
+	__asm__ __volatile__("sfence" ::: "memory");
+	FRSTOR(fpu);
+}
+#endif /* __TINYC__ */
+
+static struct memops memops_table[] = {
+	{ "rep", 0, memcpy_page_rep, memzero_page_rep },
+#ifndef __TINYC__
+	{ "mmx", CPU_MMX, memcpy_page_mmx, memzero_page_mmx },
+	{ "sse", CPU_SSE, memcpy_page_sse, memzero_page_sse },
+#endif /* __TINYC__ */
+	{ NULL, 0, NULL, NULL }
+};
+
+/* page-sized copy and fill, selected during the boot by strings_init() */
+void (*memcpy_page)(void *, const void *) = memcpy_page_rep;
+void (*memzero_page)(void *) = memzero_page_rep;
+
+/* returns the MB/s of a page copy or fill function */
+static unsigned int bench_memops(struct memops *m, unsigned int *pages, int copy)
+{
+	unsigned int start, cycles;
+	int n;
+
+	RDTSC_LOW(start);
+	for(n = 0; n < NR_BENCH_PAGES; n++) {
+		if(copy) {
+			m->copy((void *)pages[n], (void *)pages[NR_BENCH_PAGES + n]);
+		} else {
+			m->zero((void *)pages[n]);
+		}
+	}
+	RDTSC_LOW(cycles);
+	cycles -= start;
+	if(!cycles) {
+		return 0;
+	}
+	return ((cpu_table.hz / cycles) * (NR_BENCH_PAGES * PAGE_SIZE / 1024)) / 1024;
+}
+
+void strings_init(void)
+{
+	struct memops *m, *selected;
+	unsigned int pages[NR_BENCH_PAGES * 2];
+	unsigned int copy, zero, best;
+	int n;
+
+	selected = &memops_table[0];
+	for(m = &memops_table[0]; m->name; m++) {
+		if((cpu_table.flags & m->cpu_flag) == m->cpu_flag) {
+			selected = m;
+		}
+	}
+
+	/* the benchmark needs the TSC to measure the time */
+	if(cpu_table.flags & CPU_TSC && cpu_table.hz) {
+		for(n = 0; n < NR_BENCH_PAGES * 2; n++) {
+			if(!(pages[n] = kmalloc(PAGE_SIZE))) {
+				break;
+			}
+			memset_b((void *)pages[n], n, PAGE_SIZE);
+		}
+		if(n == NR_BENCH_PAGES * 2) {
+			printk("memcpy    -                 -\t");
+			best = 0;
+			for(m = &memops_table[0]; m->name; m++) {
+				if((cpu_table.flags & m->cpu_flag) != m->cpu_flag) {
+					continue;
+				}
+				copy = bench_memops(m, pages, 1);
+				zero = bench_memops(m, pages, 0);
+				printk("%s=%d/%dMB/s ", m->name, copy, zero);
+				if(copy + zero > best) {
+					best = copy + zero;
+					selected = m;
+				}
+			}
+			printk("\n");
+		}
+		while(--n >= 0) {
+			kfree(pages[n]);
+		}
 	}
+	memcpy_page = selected->copy;
+	memzero_page = selected->zero;
+	printk("\t\t\t\tusing '%s' for page copy/fill\n", selected->name);
 }
 
 #ifdef __TINYC__
@@ -0,0 +1,190 @@
+/*
+ * fiwix/mm/buddy_high.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * This buddy algorithm is intended to handle memory requests bigger than a
+ * PAGE_SIZE, in blocks of physically contiguous pages from order 0 (1 page)
+ * up to order BUDDY_HIGH_MAX_ORDER (1024 pages).
+ *
+ * The blocks are carved out of the free list of pages on demand, and the
+ * free ones stay in this allocator (where they are split and coalesced with
+ * their buddies) until kswapd gives them back when the memory runs low.
+ *
+ * All the pages of a block are marked with PAGE_BUDDYHIGH, and only the
+ * first one (the head) keeps the order of the block.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+static struct page *freelist[BUDDY_HIGH_MAX_ORDER + 1];
+
+static void add_to_freelist(struct page *pg, int order)
+{
+	struct page **h;
+
+	pg->order = order;
+	h = &freelist[order];
+	pg->prev_free = NULL;
+	pg->next_free = *h;
+	if(*h) {
+		(*h)->prev_free = pg;
+	}
+	*h = pg;
+	kstat.buddy_high_free[order]++;
+}
+
+static void remove_from_freelist(struct page *pg)
+{
+	struct page **h;
+
+	h = &freelist[pg->order];
+	if(pg->next_free) {
+		pg->next_free->prev_free = pg->prev_free;
+	}
+	if(pg->prev_free) {
+		pg->prev_free->next_free = pg->next_free;
+	}
+	if(pg == *h) {
+		*h = pg->next_free;
+	}
+	pg->prev_free = pg->next_free = NULL;
+	kstat.buddy_high_free[pg->order]--;
+}
+
+unsigned int bh_malloc(__size_t size)
+{
+	unsigned int flags, addr;
+	struct page *pg, *buddy;
+	int n, order, level;
+
+	for(order = 0; (PAGE_SIZE << order) < size; order++) {
+		if(order == BUDDY_HIGH_MAX_ORDER) {
+			printk("WARNING: %s(): size (%d) is too big!\n", __FUNCTION__, size);
+			return 0;
+		}
+	}
+
+	SAVE_FLAGS(flags); CLI();
+	for(level = order; level <= BUDDY_HIGH_MAX_ORDER; level++) {
+		if(freelist[level]) {
+			break;
+		}
+	}
+
+	if(level > BUDDY_HIGH_MAX_ORDER) {
+		/* no free blocks, take a new one from the free list of pages */
+		if(!(pg = get_free_page_run(order))) {
+			RESTORE_FLAGS(flags);
+			printk("WARNING: %s(): not enough contiguous memory (order %d)!\n", __FUNCTION__, order);
+			return 0;
+		}
+		for(n = 0; n < (1 << order); n++) {
+			pg[n].flags |= PAGE_BUDDYHIGH;
+		}
+		kstat.buddy_high_num_pages += 1 << order;
+		level = order;
+	} else {
+		pg = freelist[level];
+		remove_from_freelist(pg);
+	}
+
+	/* split the block and put the upper halves on the free lists */
+	while(level > order) {
+		level--;
+		buddy = pg + (1 << level);
+		add_to_freelist(buddy, level);
+	}
+
+	for(n = 0; n < (1 << order); n++) {
+		pg[n].count = 1;
+		pg[n].order = -1;
+	}
+	pg->order = order;
+	kstat.buddy_high_count[order]++;
+	RESTORE_FLAGS(flags);
+	addr = pg->page << PAGE_SHIFT;
+	return P2V(addr);
+}
+
+void bh_free(unsigned int addr)
+{
+	unsigned int flags;
+	struct page *pg, *buddy;
+	int n, order;
+
+	pg = &page_table[V2P(addr) >> PAGE_SHIFT];
+	order = pg->order;
+
+	SAVE_FLAGS(flags); CLI();
+	for(n = 0; n < (1 << order); n++) {
+		pg[n].count = 0;
+	}
+	kstat.buddy_high_count[order]--;
+
+	/* coalesce the block with its buddy while it's free */
+	while(order < BUDDY_HIGH_MAX_ORDER) {
+		n = pg->page ^ (1 << order);
+		if(!is_valid_page(n)) {
+			break;
+		}
+		buddy = &page_table[n];
+		if(!(buddy->flags & PAGE_BUDDYHIGH) || buddy->count || buddy->order != order) {
+			break;
+		}
+		remove_from_freelist(buddy);
+		if(buddy < pg) {
+			pg->order = -1;
+			pg = buddy;
+		} else {
+			buddy->order = -1;
+		}
+		order++;
+	}
+	add_to_freelist(pg, order);
+	RESTORE_FLAGS(flags);
+}
+
+/* gives all the free blocks back to the free list of pages */
+int bh_shrink(void)
+{
+	unsigned int flags;
+	struct page *pg;
+	int n, order, pages;
+
+	pages = 0;
+	for(order = 0; order <= BUDDY_HIGH_MAX_ORDER; order++) {
+		for(;;) {
+			SAVE_FLAGS(flags); CLI();
+			if(!(pg = freelist[order])) {
+				RESTORE_FLAGS(flags);
+				break;
+			}
+			remove_from_freelist(pg);
+			for(n = 0; n < (1 << order); n++) {
+				pg[n].flags &= ~PAGE_BUDDYHIGH;
+				pg[n].count = 1;
+			}
+			kstat.buddy_high_num_pages -= 1 << order;
+			RESTORE_FLAGS(flags);
+
+			for(n = 0; n < (1 << order); n++) {
+				release_page(&pg[n]);
+			}
+			pages += 1 << order;
+		}
+	}
+	return pages;
+}
+
+void buddy_high_init(void)
+{
+	memset_b(freelist, 0, sizeof(freelist));
+}
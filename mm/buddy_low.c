@@ -10,6 +10,7 @@
  * than a PAGE_SIZE.
  */
 
+#include <fiwix/asm.h>
 #include <fiwix/kernel.h>
 #include <fiwix/mm.h>
 #include <fiwix/stdio.h>
@@ -144,28 +145,35 @@ static struct bl_head *allocate(int size)
 
 unsigned int bl_malloc(__size_t size)
 {
+	unsigned int flags;
 	struct bl_head *block;
 	int level;
 
 	for(level = 0; bl_blocksize[level] < size; level++);
 
+	/* block requests are also freed from interrupt context */
+	SAVE_FLAGS(flags); CLI();
 	kstat.buddy_low_count[level]++;
 	kstat.buddy_low_mem_requested += bl_blocksize[level];
 	block = allocate(size);
+	RESTORE_FLAGS(flags);
 	return block ? (unsigned int)(block + 1) : 0;
 }
 
 void bl_free(unsigned int addr)
 {
+	unsigned int flags;
 	struct bl_head *block;
 	int level;
 
 	block = (struct bl_head *)addr;
 	block--;
 	level = block->level;
+	SAVE_FLAGS(flags); CLI();
 	kstat.buddy_low_count[level]--;
 	kstat.buddy_low_mem_requested -= bl_blocksize[level];
 	deallocate(block);
+	RESTORE_FLAGS(flags);
 }
 
 void buddy_low_init(void)
@@ -19,6 +19,7 @@
 #include <fiwix/string.h>
 #include <fiwix/syscalls.h>
 #include <fiwix/shm.h>
+#include <fiwix/swap.h>
 
 /* send the SIGSEGV signal to the ofending process */
 static void send_sigsegv(struct sigcontext *sc)
@@ -42,13 +43,29 @@ static int page_protection_violation(struct vma *vma, unsigned int cr2, struct s
 	pde = GET_PGDIR(cr2);
 	pte = GET_PGTBL(cr2);
 	pgdir = (unsigned int *)P2V(current->tss.cr3);
+
+	/* first write into a page table shared since fork() */
+	if(PGTBL_SHARED(pgdir[pde])) {
+		if(unshare_page_table(current, pde)) {
+			printk("%s(): not enough memory!\n", __FUNCTION__);
+			return 1;
+		}
+		pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+		if(pgtbl[pte] & PAGE_RW) {
+			return 0;
+		}
+	}
+
 	pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 	page = (pgtbl[pte] & PAGE_MASK) >> PAGE_SHIFT;
 
 	pg = &page_table[page];
 
-	/* Copy On Write feature */
-	if(pg->count > 1) {
+	/*
+	 * Copy On Write feature. A page still in the page cache is never
+	 * written in place by a private mapping, even if it's its last user.
+	 */
+	if(pg->count > 1 || (pg->inode && !(vma->flags & MAP_SHARED))) {
 		/* a page not marked as copy-on-write means it's read-only */
 		if(!(pg->flags & PAGE_COW)) {
 			printk("Oops!, page %d NOT marked for CoW.\n", pg->page);
@@ -60,7 +77,7 @@ static int page_protection_violation(struct vma *vma, unsigned int cr2, struct s
 			return 1;
 		}
 		current->rss++;
-		memcpy_b((void *)addr, (void *)P2V((page << PAGE_SHIFT)), PAGE_SIZE);
+		memcpy_page((void *)addr, (void *)P2V((page << PAGE_SHIFT)));
 		pgtbl[pte] = V2P(addr) | PAGE_PRESENT | PAGE_RW | PAGE_USER;
 		kfree(P2V((page << PAGE_SHIFT)));
 		current->rss--;
@@ -86,7 +103,7 @@ static int page_protection_violation(struct vma *vma, unsigned int cr2, struct s
 
 static int page_not_present(struct vma *vma, unsigned int cr2, struct sigcontext *sc)
 {
-	unsigned int addr, file_offset;
+	unsigned int addr, file_offset, prot;
 	struct page *pg;
 
 	if(!vma) {
@@ -109,34 +126,49 @@ static int page_not_present(struct vma *vma, unsigned int cr2, struct sigcontext
 		return 0;
 	}
 
+	/* the page was moved to a swap area */
+	if(IS_SWP_ENTRY(get_mapped_addr(current, cr2))) {
+		return swap_in(vma, cr2);
+	}
+
 	/* fill the page with its corresponding file content */
 	if(vma->inode) {
 		file_offset = (cr2 & PAGE_MASK) - vma->start + vma->offset;
 		file_offset &= PAGE_MASK;
-		pg = NULL;
+		prot = vma->prot;
 
-		if(!(vma->prot & PROT_WRITE) || vma->flags & MAP_SHARED) {
-			/* check if it's already in cache */
-			if((pg = search_page_hash(vma->inode, file_offset))) {
-				if(!map_page(current, cr2, (unsigned int)V2P(pg->data), vma->prot)) {
-					printk("%s(): Oops, map_page() returned 0!\n", __FUNCTION__);
-					return 1;
-				}
-				page_lock(pg);
-				addr = (unsigned int)pg->data;
-				page_unlock(pg);
+		/* private writable pages are shared with the cache until written */
+		if(prot & PROT_WRITE && !(vma->flags & MAP_SHARED)) {
+			prot &= ~PROT_WRITE;
+		}
+
+		/* check if it's already in cache */
+		if((pg = search_page_hash(vma->inode, file_offset))) {
+			if(prot != vma->prot) {
+				pg->flags |= PAGE_COW;
 			}
+			if(!map_page(current, cr2, (unsigned int)V2P(pg->data), prot)) {
+				printk("%s(): Oops, map_page() returned 0!\n", __FUNCTION__);
+				return 1;
+			}
+			page_lock(pg);
+			addr = (unsigned int)pg->data;
+			page_unlock(pg);
 		}
+		readahead(vma->inode, &vma->inode->ra, file_offset, pg != NULL);
 		if(!pg) {
-			if(!(addr = map_page(current, cr2, 0, vma->prot))) {
+			if(!(addr = map_page(current, cr2, 0, prot))) {
 				printk("%s(): Oops, map_page() returned 0!\n", __FUNCTION__);
 				return 1;
 			}
 			pg = &page_table[V2P(addr) >> PAGE_SHIFT];
-			if(bread_page(pg, vma->inode, file_offset, vma->prot, vma->flags)) {
+			if(bread_page(pg, vma->inode, file_offset)) {
 				unmap_page(cr2);
 				return 1;
 			}
+			if(prot != vma->prot) {
+				pg->flags |= PAGE_COW;
+			}
 			current->usage.ru_majflt++;
 		}
 	} else {
@@ -158,7 +190,7 @@ static int page_not_present(struct vma *vma, unsigned int cr2, struct sigcontext
 				return 1;
 			}
 		}
-		memset_b((void *)(addr & PAGE_MASK), 0, PAGE_SIZE);
+		memzero_page((void *)(addr & PAGE_MASK));
 	}
 
 	return 0;
@@ -17,6 +17,8 @@
 #include <fiwix/buffer.h>
 #include <fiwix/fs.h>
 #include <fiwix/kexec.h>
+#include <fiwix/swap.h>
+#include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 
@@ -123,7 +125,7 @@ unsigned int setup_tmp_pgdir(unsigned int magic, unsigned int info)
 	return (unsigned int)kpage_dir - PAGE_OFFSET;
 }
 
-/* returns the mapped address of a virtual address */
+/* returns the page table entry of a virtual address (0 if it has none) */
 unsigned int get_mapped_addr(struct proc *p, unsigned int addr)
 {
 	unsigned int *pgdir, *pgtbl;
@@ -132,10 +134,119 @@ unsigned int get_mapped_addr(struct proc *p, unsigned int addr)
 	pgdir = (unsigned int *)P2V(p->tss.cr3);
 	pde = GET_PGDIR(addr);
 	pte = GET_PGTBL(addr);
+	if(!(pgdir[pde] & PAGE_PRESENT)) {
+		return 0;
+	}
 	pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 	return pgtbl[pte];
 }
 
+/*
+ * Gives the process its own copy of a page table that was shared with
+ * other processes by fork(). From now on, the pages mapped by both copies
+ * are shared as copy-on-write.
+ */
+int unshare_page_table(struct proc *p, unsigned int pde)
+{
+	unsigned int *pgdir, *src_pgtbl, *dst_pgtbl;
+	unsigned int n, end, pte, addr;
+	struct page *pg;
+	struct vma *vma;
+
+	pgdir = (unsigned int *)P2V(p->tss.cr3);
+	src_pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+	pg = &page_table[(pgdir[pde] & PAGE_MASK) >> PAGE_SHIFT];
+
+	/* the other processes have already got their own copy */
+	if(pg->count == 1) {
+		pgdir[pde] |= PAGE_RW;
+		invalidate_tlb();
+		return 0;
+	}
+
+	if(!(addr = kmalloc(PAGE_SIZE))) {
+		return 1;
+	}
+	p->rss++;
+	dst_pgtbl = (unsigned int *)addr;
+	memzero_page(dst_pgtbl);
+
+	vma = p->vma_table;
+	while(vma) {
+		n = MAX(vma->start, pde << 22);
+		end = MIN(vma->end, (pde + 1) << 22);
+		for(; n < end; n += PAGE_SIZE) {
+			pte = GET_PGTBL(n);
+			if(!(src_pgtbl[pte] & PAGE_PRESENT)) {
+				if(IS_SWP_ENTRY(src_pgtbl[pte])) {
+					swap_duplicate(src_pgtbl[pte]);
+					dst_pgtbl[pte] = src_pgtbl[pte];
+				}
+				continue;
+			}
+			if(!(src_pgtbl[pte] & PAGE_NOALLOC)) {
+				pg = &page_table[src_pgtbl[pte] >> PAGE_SHIFT];
+				if(!(pg->flags & PAGE_RESERVED)) {
+					src_pgtbl[pte] &= ~PAGE_RW;
+					/* mark writable pages as copy-on-write */
+					if(vma->prot & PROT_WRITE) {
+						pg->flags |= PAGE_COW;
+					}
+					pg->count++;
+				}
+			}
+			dst_pgtbl[pte] = src_pgtbl[pte];
+		}
+		vma = vma->next;
+	}
+
+	kfree((unsigned int)src_pgtbl);
+	pgdir[pde] = V2P(addr) | PAGE_PRESENT | PAGE_RW | PAGE_USER;
+	invalidate_tlb();
+	return 0;
+}
+
+/*
+ * Drops the references to the page tables still shared since fork(), so
+ * that a process calling execve() or exit() doesn't need to copy them.
+ */
+void release_shared_page_tables(struct proc *p)
+{
+	unsigned int *pgdir, *pgtbl;
+	unsigned int pde, pte;
+	struct page *pg;
+
+	pgdir = (unsigned int *)P2V(p->tss.cr3);
+	for(pde = 0; pde < GET_PGDIR(PAGE_OFFSET); pde++) {
+		if(!PGTBL_SHARED(pgdir[pde])) {
+			continue;
+		}
+		pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+		pg = &page_table[(pgdir[pde] & PAGE_MASK) >> PAGE_SHIFT];
+		if(pg->count == 1) {
+			/* last user, its pages will be freed as usual */
+			pgdir[pde] |= PAGE_RW;
+			continue;
+		}
+		for(pte = 0; pte < PT_ENTRIES; pte++) {
+			if(pgtbl[pte] & PAGE_PRESENT) {
+				p->rss--;
+			}
+		}
+		kfree((unsigned int)pgtbl);
+		p->rss--;
+		pgdir[pde] = 0;
+	}
+	invalidate_tlb();
+}
+
+/*
+ * The page tables that only map private regions are shared read-only
+ * with the child, and they are copied later, only if one of the processes
+ * writes into the 4MB region they cover (see unshare_page_table()). The
+ * ones that also map shared regions or shm segments are still copied entry
+ * by entry.
+ */
 int clone_pages(struct proc *child)
 {
 	unsigned int *src_pgdir, *dst_pgdir;
@@ -143,14 +254,39 @@ int clone_pages(struct proc *child)
 	unsigned int pde, pte;
 	unsigned int p_addr, c_addr;
 	unsigned int n, pages;
+	unsigned int eager[PD_ENTRIES / 32];
 	struct page *pg;
 	struct vma *vma;
 
 	src_pgdir = (unsigned int *)P2V(current->tss.cr3);
 	dst_pgdir = (unsigned int *)P2V(child->tss.cr3);
-	vma = current->vma_table;
 	pages = 0;
 
+	memset_b(eager, 0, sizeof(eager));
+	vma = current->vma_table;
+	while(vma) {
+		if(vma->flags & MAP_SHARED || vma->object) {
+			for(pde = GET_PGDIR(vma->start); pde <= GET_PGDIR(vma->end - 1); pde++) {
+				eager[pde / 32] |= 1 << (pde % 32);
+			}
+		}
+		vma = vma->next;
+	}
+
+	for(pde = 0; pde < GET_PGDIR(PAGE_OFFSET); pde++) {
+		if((src_pgdir[pde] & (PAGE_PRESENT | PAGE_USER)) != (PAGE_PRESENT | PAGE_USER)) {
+			continue;
+		}
+		if(eager[pde / 32] & (1 << (pde % 32))) {
+			continue;
+		}
+		src_pgdir[pde] &= ~PAGE_RW;
+		dst_pgdir[pde] = src_pgdir[pde];
+		pg = &page_table[(src_pgdir[pde] & PAGE_MASK) >> PAGE_SHIFT];
+		pg->count++;
+	}
+
+	vma = current->vma_table;
 	while(vma) {
 		if(vma->flags & MAP_SHARED) {
 			vma = vma->next;
@@ -159,19 +295,27 @@ int clone_pages(struct proc *child)
 		for(n = vma->start; n < vma->end; n += PAGE_SIZE) {
 			pde = GET_PGDIR(n);
 			pte = GET_PGTBL(n);
+			if(!(eager[pde / 32] & (1 << (pde % 32)))) {
+				continue;
+			}
 			if(src_pgdir[pde] & PAGE_PRESENT) {
 				src_pgtbl = (unsigned int *)P2V((src_pgdir[pde] & PAGE_MASK));
 				if(!(dst_pgdir[pde] & PAGE_PRESENT)) {
 					if(!(c_addr = kmalloc(PAGE_SIZE))) {
-						printk("%s(): returning 0!\n", __FUNCTION__);
-						return 0;
+						printk("%s(): returning -ENOMEM!\n", __FUNCTION__);
+						return -ENOMEM;
 					}
 					current->rss++;
 					pages++;
 					dst_pgdir[pde] = V2P(c_addr) | PAGE_PRESENT | PAGE_RW | PAGE_USER;
-					memset_b((void *)c_addr, 0, PAGE_SIZE);
+					memzero_page((void *)c_addr);
 				}
 				dst_pgtbl = (unsigned int *)P2V((dst_pgdir[pde] & PAGE_MASK));
+				if(IS_SWP_ENTRY(src_pgtbl[pte])) {
+					swap_duplicate(src_pgtbl[pte]);
+					dst_pgtbl[pte] = src_pgtbl[pte];
+					continue;
+				}
 				if(src_pgtbl[pte] & PAGE_PRESENT) {
 					if (src_pgtbl[pte] & PAGE_NOALLOC) {
 						dst_pgtbl[pte] = src_pgtbl[pte];
@@ -208,7 +352,8 @@ int free_page_tables(struct proc *p)
 
 	pgdir = (unsigned int *)P2V(p->tss.cr3);
 	for(n = 0, count = 0; n < PD_ENTRIES; n++) {
-		if((pgdir[n] & (PAGE_PRESENT | PAGE_RW | PAGE_USER)) == (PAGE_PRESENT | PAGE_RW | PAGE_USER)) {
+		/* this also drops the references to the shared ones */
+		if((pgdir[n] & (PAGE_PRESENT | PAGE_USER)) == (PAGE_PRESENT | PAGE_USER)) {
 			kfree(P2V(pgdir[n]) & PAGE_MASK);
 			pgdir[n] = 0;
 			count++;
@@ -232,13 +377,18 @@ unsigned int map_page_flags(struct proc *p, unsigned int vaddr, unsigned int add
 	pde = GET_PGDIR(vaddr);
 	pte = GET_PGTBL(vaddr);
 
+	if(PGTBL_SHARED(pgdir[pde])) {
+		if(unshare_page_table(p, pde)) {
+			return 0;
+		}
+	}
 	if(!(pgdir[pde] & PAGE_PRESENT)) {	/* allocating page table */
 		if(!(newaddr = kmalloc(PAGE_SIZE))) {
 			return 0;
 		}
 		p->rss++;
 		pgdir[pde] = V2P(newaddr) | PAGE_PRESENT | PAGE_RW | PAGE_USER;
-		memset_b((void *)newaddr, 0, PAGE_SIZE);
+		memzero_page((void *)newaddr);
 	}
 	pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 	if(!(pgtbl[pte] & PAGE_PRESENT)) {	/* allocating page */
@@ -270,6 +420,11 @@ int unmap_page(unsigned int vaddr)
 		printk("WARNING: %s(): trying to unmap an unallocated pde '0x%08x'\n", __FUNCTION__, vaddr);
 		return 1;
 	}
+	if(PGTBL_SHARED(pgdir[pde])) {
+		if(unshare_page_table(current, pde)) {
+			return 1;
+		}
+	}
 
 	pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 	if(!(pgtbl[pte] & PAGE_PRESENT)) {
@@ -373,8 +528,11 @@ void mem_init(void)
 	_last_data_addr += inode_hash_table_size;
 
 
-	/* reserve memory space for fd_table[NR_OPENS] */
-	fd_table_size = PAGE_ALIGN(sizeof(struct fd) * NR_OPENS);
+	/* reserve memory space for fd_table and its bitmap */
+	kstat.max_fds = (kstat.physical_pages / (1024 / 4)) * NR_OPENS_PER_MB;
+	kstat.max_fds = MAX(kstat.max_fds, NR_OPENS);
+	kstat.max_fds = MIN(kstat.max_fds, MAX_NR_OPENS);
+	fd_table_size = PAGE_ALIGN(sizeof(struct fd) * kstat.max_fds + ((kstat.max_fds + 31) / 32) * sizeof(unsigned int));
 	if(!is_addr_in_bios_map(V2P(_last_data_addr) + fd_table_size)) {
 		PANIC("Not enough memory for fd_table.\n");
 	}
@@ -460,6 +618,8 @@ void mem_init(void)
 
 	page_init(kstat.physical_pages);
 	buddy_low_init();
+	buddy_high_init();
+	slab_init();
 }
 
 void mem_stats(void)
@@ -474,7 +634,7 @@ void mem_stats(void)
 		kstat.kernel_reserved, kstat.physical_reserved);
 	printk("tables: procs=%d (%dKB), opens=%d (%dKB), pages=%dKB, inodes=%d\n",
 		NR_PROCS, proc_table_size / 1024,
-		NR_OPENS, fd_table_size / 1024,
+		kstat.max_fds, fd_table_size / 1024,
 		page_table_size / 1024,
 		kstat.max_inodes);
 	printk("hash tables: buffers=%d (%dKB), inodes=%d (%dKB), pages=%d (%dKB)\n",
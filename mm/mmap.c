@@ -12,11 +12,13 @@
 #include <fiwix/fcntl.h>
 #include <fiwix/stat.h>
 #include <fiwix/process.h>
+#include <fiwix/sleep.h>
 #include <fiwix/mman.h>
 #include <fiwix/errno.h>
 #include <fiwix/stdio.h>
 #include <fiwix/string.h>
 #include <fiwix/shm.h>
+#include <fiwix/swap.h>
 
 void merge_vma_regions(struct vma *, struct vma *);
 
@@ -164,7 +166,7 @@ static void del_vma_region(struct vma *vma)
 	}
 	RESTORE_FLAGS(flags);
 
-	kfree((unsigned int)tmp);
+	kmem_cache_free(vma_cache, tmp);
 }
 
 static int can_be_merged(struct vma *a, struct vma *b)
@@ -189,7 +191,7 @@ static int free_vma_region(struct vma *vma, unsigned int start, __ssize_t length
 	struct vma *new;
 
 	if(start + length < vma->end) {
-		if(!(new = (struct vma *)kmalloc(sizeof(struct vma)))) {
+		if(!(new = (struct vma *)kmem_cache_alloc(vma_cache))) {
 			return -ENOMEM;
 		}
 		memset_b(new, 0, sizeof(struct vma));
@@ -235,7 +237,7 @@ void merge_vma_regions(struct vma *a, struct vma *b)
 	}
 
 	if((b->start < a->end)) {
-		if(!(new = (struct vma *)kmalloc(sizeof(struct vma)))) {
+		if(!(new = (struct vma *)kmem_cache_alloc(vma_cache))) {
 			return;
 		}
 		memset_b(new, 0, sizeof(struct vma));
@@ -254,7 +256,7 @@ void merge_vma_regions(struct vma *a, struct vma *b)
 			del_vma_region(a);
 		}
 		if(new->start >= new->end) {
-			kfree((unsigned int)new);
+			kmem_cache_free(vma_cache, new);
 		} else {
 			insert_vma_region(new);
 		}
@@ -275,6 +277,12 @@ void free_vma_pages(struct vma *vma, unsigned int start, __size_t length)
 	for(n = 0; n < (length / PAGE_SIZE); n++) {
 		pde = GET_PGDIR(start + (n * PAGE_SIZE));
 		pte = GET_PGTBL(start + (n * PAGE_SIZE));
+		if(PGTBL_SHARED(pgdir[pde])) {
+			if(unshare_page_table(current, pde)) {
+				printk("WARNING: %s(): unable to unshare the page table of 0x%08x.\n", __FUNCTION__, start + (n * PAGE_SIZE));
+				continue;
+			}
+		}
 		if(pgdir[pde] & PAGE_PRESENT) {
 			pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
 			if(pgtbl[pte] & PAGE_PRESENT) {
@@ -299,20 +307,24 @@ void free_vma_pages(struct vma *vma, unsigned int start, __size_t length)
 					shm_rss--;
 				}
 #endif /* CONFIG_SYSVIPC */
-				pgtbl[pte] = 0;
+			} else if(IS_SWP_ENTRY(pgtbl[pte])) {
+				swap_free(pgtbl[pte]);
+			} else {
+				continue;
+			}
+			pgtbl[pte] = 0;
 
-				/* check if a page table can be freed */
-				for(pte = 0; pte < PT_ENTRIES; pte++) {
-					if(pgtbl[pte] & PAGE_MASK) {
-						break;
-					}
-				}
-				if(pte == PT_ENTRIES) {
-					kfree((unsigned int)pgtbl & PAGE_MASK);
-					current->rss--;
-					pgdir[pde] = 0;
+			/* check if a page table can be freed */
+			for(pte = 0; pte < PT_ENTRIES; pte++) {
+				if(pgtbl[pte] & PAGE_MASK) {
+					break;
 				}
 			}
+			if(pte == PT_ENTRIES) {
+				kfree((unsigned int)pgtbl & PAGE_MASK);
+				current->rss--;
+				pgdir[pde] = 0;
+			}
 		}
 	}
 }
@@ -321,6 +333,18 @@ void release_binary(void)
 {
 	struct vma *vma, *tmp;
 
+	/* a vfork() child gives back the address space to its parent */
+	if(current->flags & PF_VFORK) {
+		current->ppid->vma_table = current->vma_table;
+		current->vma_table = NULL;
+		current->tss.cr3 = current->vfork_cr3;
+		SET_CR3(current->tss.cr3);
+		current->flags &= ~PF_VFORK;
+		wakeup(current);
+		return;
+	}
+
+	release_shared_page_tables(current);
 	vma = current->vma_table;
 
 	while(vma) {
@@ -493,7 +517,7 @@ int do_mmap(struct inode *i, unsigned int start, unsigned int length, unsigned i
 		}
 	}
 
-	if(!(vma = (struct vma *)kmalloc(sizeof(struct vma)))) {
+	if(!(vma = (struct vma *)kmem_cache_alloc(vma_cache))) {
                 return -ENOMEM;
         }
         memset_b(vma, 0, sizeof(struct vma));
@@ -512,7 +536,7 @@ int do_mmap(struct inode *i, unsigned int start, unsigned int length, unsigned i
 	if(i && i->fsop->mmap) {
 		if((errno = i->fsop->mmap(i, vma))) {
 			free_vma_region(vma, start, length);
-			kfree((unsigned int)vma);
+			kmem_cache_free(vma_cache, vma);
 			return errno;
 		}
 	}
@@ -555,7 +579,7 @@ int do_mprotect(struct vma *vma, unsigned int addr, __size_t length, int prot)
 {
 	struct vma *new;
 
-	if(!(new = (struct vma *)kmalloc(sizeof(struct vma)))) {
+	if(!(new = (struct vma *)kmem_cache_alloc(vma_cache))) {
                 return -ENOMEM;
         }
         memset_b(new, 0, sizeof(struct vma));
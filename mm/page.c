@@ -25,7 +25,6 @@
 #include <fiwix/asm.h>
 #include <fiwix/kernel.h>
 #include <fiwix/mm.h>
-#include <fiwix/mman.h>
 #include <fiwix/bios.h>
 #include <fiwix/sleep.h>
 #include <fiwix/sched.h>
@@ -171,7 +170,7 @@ repeat:
 					goto repeat;
 				}
 				/* definitely out of memory! (no more pages) */
-				printk("WARNING: %s(): out of memory and swapping is not implemented yet, sorry.\n", __FUNCTION__);
+				printk("WARNING: %s(): out of memory (free swap: %dKB).\n", __FUNCTION__, kstat.free_swap_pages << 2);
 				printk("%s(): pid %d ran out of memory. OOM killer needed!\n", __FUNCTION__, current->pid);
 				return NULL;
 			}
@@ -208,7 +207,46 @@ repeat:
 	return pg;
 }
 
-struct page *search_page_hash(struct inode *inode, __off_t offset)
+/*
+ * Detaches from the free list a run of 2^order contiguous pages aligned to
+ * its size. This is only used by buddy_high, so a slow scan is acceptable.
+ */
+struct page *get_free_page_run(int order)
+{
+	unsigned int flags;
+	struct page *pg;
+	int base, n, npages;
+
+	npages = 1 << order;
+
+	SAVE_FLAGS(flags); CLI();
+	for(base = 0; base + npages <= NR_PAGES; base += npages) {
+		for(n = 0; n < npages; n++) {
+			pg = &page_table[base + n];
+			if(pg->count || (pg->flags & (PAGE_RESERVED | PAGE_BUDDYHIGH))) {
+				break;
+			}
+		}
+		if(n < npages) {
+			continue;
+		}
+		for(n = 0; n < npages; n++) {
+			pg = &page_table[base + n];
+			remove_from_free_list(pg);
+			remove_from_hash(pg);
+			pg->count = 1;
+			pg->inode = 0;
+			pg->offset = 0;
+			pg->dev = 0;
+		}
+		RESTORE_FLAGS(flags);
+		return &page_table[base];
+	}
+	RESTORE_FLAGS(flags);
+	return NULL;
+}
+
+static struct page *lookup_page_hash(struct inode *inode, __off_t offset)
 {
 	struct page *pg;
 	int i;
@@ -218,10 +256,6 @@ struct page *search_page_hash(struct inode *inode, __off_t offset)
 
 	while(pg) {
 		if(pg->inode == inode->inode && pg->offset == offset && pg->dev == inode->dev) {
-			if(!pg->count) {
-				remove_from_free_list(pg);
-			}
-			pg->count++;
 			return pg;
 		}
 		pg = pg->next_hash;
@@ -230,6 +264,20 @@ struct page *search_page_hash(struct inode *inode, __off_t offset)
 	return NULL;
 }
 
+struct page *search_page_hash(struct inode *inode, __off_t offset)
+{
+	struct page *pg;
+
+	if((pg = lookup_page_hash(inode, offset))) {
+		if(!pg->count) {
+			remove_from_free_list(pg);
+		}
+		pg->count++;
+	}
+
+	return pg;
+}
+
 void release_page(struct page *pg)
 {
 	unsigned int flags;
@@ -277,25 +325,44 @@ int is_valid_page(int page)
 	return (page >= 0 && page < NR_PAGES);
 }
 
-void invalidate_inode_pages(struct inode *i)
+/* drops the cached pages beyond 'length' and zeroes the tail of the last one */
+void truncate_inode_pages(struct inode *i, __off_t length)
 {
 	struct page *pg;
 	__off_t offset;
 
-	for(offset = 0; offset < i->i_size; offset += PAGE_SIZE) {
+	offset = length & PAGE_MASK;
+	if(length & ~PAGE_MASK) {
 		if((pg = search_page_hash(i, offset))) {
 			page_lock(pg);
-			release_page(pg);
+			memset_b(pg->data + (length & ~PAGE_MASK), 0, PAGE_SIZE - (length & ~PAGE_MASK));
 			page_unlock(pg);
+			release_page(pg);
+		}
+		offset += PAGE_SIZE;
+	}
+
+	for(; offset < i->i_size; offset += PAGE_SIZE) {
+		if((pg = search_page_hash(i, offset))) {
+			page_lock(pg);
 			remove_from_hash(pg);
+			pg->inode = 0;
+			release_page(pg);
+			page_unlock(pg);
 		}
 	}
 }
 
+void invalidate_inode_pages(struct inode *i)
+{
+	truncate_inode_pages(i, 0);
+}
+
 void update_page_cache(struct inode *i, __off_t offset, const char *buf, int count)
 {
 	__off_t poffset;
 	struct page *pg;
+	unsigned int addr;
 	int bytes;
 
 	poffset = offset & (PAGE_SIZE - 1);	/* mod PAGE_SIZE */
@@ -304,12 +371,29 @@ void update_page_cache(struct inode *i, __off_t offset, const char *buf, int cou
 
 	if(count) {
 		bytes = MIN(bytes, count);
-		if((pg = search_page_hash(i, offset))) {
-			page_lock(pg);
-			memcpy_b(pg->data + poffset, buf, bytes);
-			page_unlock(pg);
-			release_page(pg);
+		if(!(pg = search_page_hash(i, offset))) {
+			/*
+			 * A page that starts beyond the end of the file can be
+			 * cached without reading it, since it only has zeros
+			 * besides the data being written.
+			 */
+			if(offset < i->i_size) {
+				return;
+			}
+			if(!(addr = kmalloc(PAGE_SIZE))) {
+				return;
+			}
+			pg = &page_table[V2P(addr) >> PAGE_SHIFT];
+			memzero_page(pg->data);
+			pg->inode = i->inode;
+			pg->offset = offset;
+			pg->dev = i->dev;
+			insert_to_hash(pg);
 		}
+		page_lock(pg);
+		memcpy_b(pg->data + poffset, buf, bytes);
+		page_unlock(pg);
+		release_page(pg);
 	}
 }
 
@@ -333,7 +417,7 @@ int write_page(struct page *pg, struct inode *i, __off_t offset, unsigned int le
 	return errno;
 }
 
-int bread_page(struct page *pg, struct inode *i, __off_t offset, char prot, char flags)
+int bread_page(struct page *pg, struct inode *i, __off_t offset)
 {
 	__blk_t block;
 	__off_t size_read;
@@ -353,16 +437,14 @@ int bread_page(struct page *pg, struct inode *i, __off_t offset, char prot, char
 	memset_b(&brh, 0, sizeof(struct blk_request));
 	page_lock(pg);
 
-	/* cache any read-only or public (shared) pages */
-	if(!(prot & PROT_WRITE) || flags & MAP_SHARED) {
-		pg->inode = i->inode;
-		pg->offset = offset;
-		pg->dev = i->dev;
-		insert_to_hash(pg);
-	}
+	/* private mappings share it too until their first write (CoW) */
+	pg->inode = i->inode;
+	pg->offset = offset;
+	pg->dev = i->dev;
+	insert_to_hash(pg);
 
 	while(size_read < PAGE_SIZE) {
-		if(!(br = (struct blk_request *)kmalloc(sizeof(struct blk_request)))) {
+		if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
 			printk("WARNING: %s(): no more free memory for block requests.\n", __FUNCTION__);
 			retval = 1;
 			break;
@@ -413,14 +495,120 @@ int bread_page(struct page *pg, struct inode *i, __off_t offset, char prot, char
 			brelse(br->buffer);
 		}
 		tmp = br->next_group;
-		kfree((unsigned int)br);
+		kmem_cache_free(blk_request_cache, br);
 		br = tmp;
 	}
 
+	/* don't leave a page with garbage in the cache */
+	if(retval) {
+		remove_from_hash(pg);
+		pg->inode = 0;
+	}
 	page_unlock(pg);
 	return retval;
 }
 
+/* queues asynchronous reads of the pages not yet cached in [offset, end) */
+static void readahead_pages(struct inode *i, __off_t offset, __off_t end)
+{
+	__blk_t block;
+	int blksize, n;
+	struct device *d;
+	struct blk_request brh, *br, *tmp;
+
+	if(!(d = get_device(BLK_DEV, i->dev))) {
+		return;
+	}
+
+	blksize = i->sb->s_blocksize;
+	memset_b(&brh, 0, sizeof(struct blk_request));
+	brh.flags = BRF_ASYNC;
+	tmp = NULL;
+
+	for(; offset < end; offset += PAGE_SIZE) {
+		if(lookup_page_hash(i, offset)) {
+			continue;
+		}
+		for(n = 0; n < PAGE_SIZE; n += blksize) {
+			/* holes and errors are left to bread_page() */
+			if((block = bmap(i, offset + n, FOR_READING)) <= 0) {
+				continue;
+			}
+			if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
+				break;
+			}
+			memset_b(br, 0, sizeof(struct blk_request));
+			br->dev = i->dev;
+			br->block = block;
+			br->size = blksize;
+			br->device = d;
+			br->fn = d->fsop->read_block;
+			if(!brh.next_group) {
+				brh.next_group = br;
+			} else {
+				tmp->next_group = br;
+			}
+			tmp = br;
+		}
+		kstat.ra_pages++;
+	}
+	if(brh.next_group) {
+		gbread(d, &brh);
+	}
+}
+
+/*
+ * Sequential read-ahead. The window opens with RA_MIN_PAGES pages when
+ * the page accessed is the one that follows the previous access, doubles
+ * (up to RA_MAX_PAGES) every time the reader enters its second half, and
+ * it's halved on random access. The pages are only read into the buffer
+ * cache, so bread_page() will find them there without waiting for the disk.
+ */
+void readahead(struct inode *i, struct readahead *ra, __off_t offset, int cached)
+{
+	__off_t start, end;
+
+	offset &= PAGE_MASK;
+
+	/* same page as the previous access */
+	if(offset + PAGE_SIZE == ra->next) {
+		return;
+	}
+
+	if(!cached) {
+		if(offset >= ra->start && offset < ra->end) {
+			kstat.ra_hits++;
+		} else {
+			kstat.ra_misses++;
+		}
+	}
+
+	if(offset != ra->next) {
+		ra->next = offset + PAGE_SIZE;
+		ra->size >>= 1;
+		ra->start = ra->end = 0;
+		return;
+	}
+	ra->next = offset + PAGE_SIZE;
+
+	if(ra->end) {
+		if(offset + ((ra->size << PAGE_SHIFT) >> 1) < ra->end) {
+			return;
+		}
+		ra->size = MIN(ra->size << 1, RA_MAX_PAGES);
+		start = MAX(ra->end, ra->next);
+	} else {
+		ra->size = MAX(ra->size, RA_MIN_PAGES);
+		ra->start = start = ra->next;
+	}
+
+	end = MIN(ra->next + (ra->size << PAGE_SHIFT), PAGE_ALIGN(i->i_size));
+	if(start < end) {
+		readahead_pages(i, start, end);
+	}
+	ra->end = MAX(end, start);
+}
+
 int file_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 {
 	__size_t total_read;
@@ -442,14 +630,16 @@ int file_read(struct inode *i, struct fd *f, char *buffer, __size_t count)
 		}
 
 		poffset = f->offset & (PAGE_SIZE - 1);	/* mod PAGE_SIZE */
-		if(!(pg = search_page_hash(i, f->offset & PAGE_MASK))) {
+		pg = search_page_hash(i, f->offset & PAGE_MASK);
+		readahead(i, &f->ra, f->offset, pg != NULL);
+		if(!pg) {
 			if(!(addr = kmalloc(PAGE_SIZE))) {
 				inode_unlock(i);
 				printk("%s(): returning -ENOMEM\n", __FUNCTION__);
 				return -ENOMEM;
 			}
 			pg = &page_table[V2P(addr) >> PAGE_SHIFT];
-			if(bread_page(pg, i, f->offset & PAGE_MASK, 0, MAP_SHARED)) {
+			if(bread_page(pg, i, f->offset & PAGE_MASK)) {
 				kfree(addr);
 				inode_unlock(i);
 				printk("%s(): returning -EIO\n", __FUNCTION__);
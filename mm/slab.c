@@ -0,0 +1,204 @@
+/*
+ * fiwix/mm/slab.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * This is an object-cache allocator for the kernel structures that are
+ * allocated and freed all the time (block requests, vmas, buffers, ...).
+ *
+ * Every cache keeps its objects in one-page slabs. The slab header is placed
+ * at the beginning of the page and it is followed by the objects, each one
+ * aligned to a cache line boundary. Free objects are chained through their
+ * first word, so allocating and freeing an object takes constant time and
+ * doesn't suffer from the internal fragmentation of the buddy algorithm.
+ *
+ *    page
+ *    +--------+--------+--------+--------+-- ... --+--------+
+ *    | (slab) | object | object | object |         | object |
+ *    +--------+--------+--------+--------+-- ... --+--------+
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/limits.h>
+#include <fiwix/mm.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+#define SLAB_HDR_SIZE	((sizeof(struct slab) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+struct kmem_cache *kmem_cache_list;
+struct kmem_cache *vma_cache;
+struct kmem_cache *name_cache;
+
+static void slab_link(struct slab **head, struct slab *slab)
+{
+	slab->prev = NULL;
+	slab->next = *head;
+	if(*head) {
+		(*head)->prev = slab;
+	}
+	*head = slab;
+}
+
+static void slab_unlink(struct slab **head, struct slab *slab)
+{
+	if(slab->next) {
+		slab->next->prev = slab->prev;
+	}
+	if(slab->prev) {
+		slab->prev->next = slab->next;
+	}
+	if(slab == *head) {
+		*head = slab->next;
+	}
+	slab->prev = slab->next = NULL;
+}
+
+static struct slab *new_slab(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	struct page *pg;
+	unsigned int addr;
+	char *obj;
+	int n;
+
+	if(!(addr = kmalloc(PAGE_SIZE))) {
+		return NULL;
+	}
+	pg = &page_table[V2P(addr) >> PAGE_SHIFT];
+	pg->flags |= PAGE_SLAB;
+	kstat.slab_pages++;
+
+	slab = (struct slab *)addr;
+	slab->cache = cache;
+	slab->inuse = 0;
+	slab->freelist = NULL;
+	obj = (char *)addr + SLAB_HDR_SIZE + ((cache->num - 1) * cache->size);
+	for(n = 0; n < cache->num; n++) {
+		*(void **)obj = slab->freelist;
+		slab->freelist = obj;
+		obj -= cache->size;
+	}
+	cache->num_slabs++;
+	return slab;
+}
+
+static void free_slab(struct kmem_cache *cache, struct slab *slab)
+{
+	struct page *pg;
+	unsigned int addr;
+
+	addr = (unsigned int)slab;
+	pg = &page_table[V2P(addr) >> PAGE_SHIFT];
+	pg->flags &= ~PAGE_SLAB;
+	kstat.slab_pages--;
+	cache->num_slabs--;
+	kfree(addr);
+}
+
+struct kmem_cache *kmem_cache_create(char *name, __size_t size, void (*ctor)(void *))
+{
+	struct kmem_cache *cache;
+	unsigned int flags;
+
+	if(size < sizeof(void *)) {
+		size = sizeof(void *);
+	}
+	if(SLAB_HDR_SIZE + size > PAGE_SIZE) {
+		printk("WARNING: %s(): object size (%d) of cache '%s' is too big.\n", __FUNCTION__, size, name);
+		return NULL;
+	}
+	if(!(cache = (struct kmem_cache *)kmalloc(sizeof(struct kmem_cache)))) {
+		return NULL;
+	}
+	memset_b(cache, 0, sizeof(struct kmem_cache));
+	cache->name = name;
+	cache->objsize = size;
+	cache->size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+	cache->num = (PAGE_SIZE - SLAB_HDR_SIZE) / cache->size;
+	cache->ctor = ctor;
+
+	SAVE_FLAGS(flags); CLI();
+	cache->next = kmem_cache_list;
+	kmem_cache_list = cache;
+	RESTORE_FLAGS(flags);
+	return cache;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	unsigned int flags;
+	void *obj;
+
+	/* objects are also freed from interrupt context */
+	SAVE_FLAGS(flags); CLI();
+	if(!(slab = cache->partial)) {
+		if((slab = cache->free)) {
+			slab_unlink(&cache->free, slab);
+		} else if(!(slab = new_slab(cache))) {
+			RESTORE_FLAGS(flags);
+			printk("WARNING: %s(): not enough memory for cache '%s'.\n", __FUNCTION__, cache->name);
+			return NULL;
+		}
+		slab_link(&cache->partial, slab);
+	}
+
+	obj = slab->freelist;
+	slab->freelist = *(void **)obj;
+	slab->inuse++;
+	cache->active_objs++;
+	if(!slab->freelist) {
+		slab_unlink(&cache->partial, slab);
+		slab_link(&cache->full, slab);
+	}
+	RESTORE_FLAGS(flags);
+
+	if(cache->ctor) {
+		cache->ctor(obj);
+	}
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *cache, void *obj)
+{
+	struct slab *slab;
+	unsigned int flags;
+
+	slab = (struct slab *)((unsigned int)obj & PAGE_MASK);
+	if(slab->cache != cache) {
+		printk("WARNING: %s(): object 0x%x doesn't belong to cache '%s'.\n", __FUNCTION__, (unsigned int)obj, cache->name);
+		return;
+	}
+
+	SAVE_FLAGS(flags); CLI();
+	if(!slab->freelist) {
+		slab_unlink(&cache->full, slab);
+		slab_link(&cache->partial, slab);
+	}
+	*(void **)obj = slab->freelist;
+	slab->freelist = obj;
+	slab->inuse--;
+	cache->active_objs--;
+
+	if(!slab->inuse) {
+		slab_unlink(&cache->partial, slab);
+		if(!cache->free) {
+			slab_link(&cache->free, slab);
+		} else {
+			free_slab(cache, slab);
+		}
+	}
+	RESTORE_FLAGS(flags);
+}
+
+void slab_init(void)
+{
+	kmem_cache_list = NULL;
+	vma_cache = kmem_cache_create("vma", sizeof(struct vma), NULL);
+	name_cache = kmem_cache_create("names", NAME_MAX + 1, NULL);
+}
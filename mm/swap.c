@@ -0,0 +1,912 @@
+/*
+ * fiwix/mm/swap.c
+ *
+ * Copyright 2018-2022, Jordi Sanfeliu. All rights reserved.
+ * Distributed under the terms of the Fiwix License.
+ */
+
+/*
+ * The anonymous pages of the processes are written into the swap areas
+ * (partitions or files) enabled with swapon(). Each area has a map with the
+ * number of page table entries that point to every slot, and the entry of a
+ * page that is swapped out keeps the area and the slot (see swap.h) until
+ * the page fault handler reads it back.
+ *
+ * kswapd looks for pages to be reclaimed with a CLOCK algorithm: the hand
+ * goes through the regions of every process and gives a second chance to
+ * the pages that have been accessed since its last pass.
+ */
+
+#include <fiwix/asm.h>
+#include <fiwix/kernel.h>
+#include <fiwix/mm.h>
+#include <fiwix/mman.h>
+#include <fiwix/swap.h>
+#include <fiwix/buffer.h>
+#include <fiwix/blk_queue.h>
+#include <fiwix/devices.h>
+#include <fiwix/fs.h>
+#include <fiwix/filesystems.h>
+#include <fiwix/stat.h>
+#include <fiwix/process.h>
+#include <fiwix/sleep.h>
+#include <fiwix/sched.h>
+#include <fiwix/zram.h>
+#include <fiwix/errno.h>
+#include <fiwix/stdio.h>
+#include <fiwix/string.h>
+
+/* badpages that fit in the header after the fields of 'info' */
+#define MAX_SWAP_BADPAGES	((PAGE_SIZE - 1024 - 512 - 10) / sizeof(__u32))
+
+struct swap_info swap_info[MAX_SWAPFILES];
+
+static struct resource swap_resource = { 0, 0 };
+static int least_prio = 0;
+
+/* the CLOCK hand: next process and address to be scanned */
+static __pid_t swap_pid = 0;
+static unsigned int swap_addr = 0;
+
+static struct swap_info *get_swap_info(unsigned int entry)
+{
+	struct swap_info *si;
+
+	if(SWP_TYPE(entry) < MAX_SWAPFILES) {
+		si = &swap_info[SWP_TYPE(entry)];
+		if(si->flags & SWP_USED && SWP_OFFSET(entry) && SWP_OFFSET(entry) < si->max) {
+			return si;
+		}
+	}
+	printk("WARNING: %s(): bad swap entry 0x%08x.\n", __FUNCTION__, entry);
+	return NULL;
+}
+
+/* returns the block where the part 'n' of the slot 'offset' is stored */
+static __blk_t swap_block(struct swap_info *si, unsigned int offset, int n)
+{
+	unsigned int block;
+
+	block = offset * (PAGE_SIZE / si->blksize) + n;
+	return si->blocks ? si->blocks[block] : block;
+}
+
+static int read_swap_page(unsigned int entry, char *data)
+{
+	struct swap_info *si;
+	struct device *d;
+	struct blk_request brh, *br, *tmp;
+	int n, errno;
+
+	si = &swap_info[SWP_TYPE(entry)];
+	if(!(d = get_device(BLK_DEV, si->dev))) {
+		printk("WARNING: %s(): device major %d not found!\n", __FUNCTION__, MAJOR(si->dev));
+		return -ENXIO;
+	}
+
+	memset_b(&brh, 0, sizeof(struct blk_request));
+	tmp = NULL;
+	errno = 0;
+	for(n = 0; n < PAGE_SIZE / si->blksize; n++) {
+		if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
+			errno = -ENOMEM;
+			break;
+		}
+		memset_b(br, 0, sizeof(struct blk_request));
+		br->dev = si->dev;
+		br->block = swap_block(si, SWP_OFFSET(entry), n);
+		br->size = si->blksize;
+		br->device = d;
+		br->fn = d->fsop->read_block;
+		br->head_group = &brh;
+		if(!brh.next_group) {
+			brh.next_group = br;
+		} else {
+			tmp->next_group = br;
+		}
+		tmp = br;
+	}
+	if(!errno) {
+		errno = gbread(d, &brh);
+		errno = errno < 0 ? errno : 0;
+	}
+
+	br = brh.next_group;
+	n = 0;
+	while(br) {
+		if(!errno) {
+			memcpy_b(data + n, br->buffer->data, br->size);
+			br->buffer->flags |= BUFFER_VALID;
+		}
+		n += br->size;
+		if(br->buffer) {
+			brelse(br->buffer);
+		}
+		tmp = br->next_group;
+		kmem_cache_free(blk_request_cache, br);
+		br = tmp;
+	}
+	if(errno) {
+		printk("WARNING: %s(): unable to read the slot %d of the swap area %d.\n", __FUNCTION__, SWP_OFFSET(entry), SWP_TYPE(entry));
+	}
+	return errno;
+}
+
+/*
+ * The page is written directly from its frame through private buffers,
+ * so there is no need to copy it into the buffer cache (which would also
+ * need memory) while kswapd is trying to free some.
+ */
+static int write_swap_page(unsigned int entry, char *data)
+{
+	unsigned int flags;
+	struct swap_info *si;
+	struct device *d;
+	struct buffer buf[PAGE_SIZE / BLKSIZE_1K];
+	struct blk_request brh, br[PAGE_SIZE / BLKSIZE_1K];
+	int n;
+
+	si = &swap_info[SWP_TYPE(entry)];
+	if(!(d = get_device(BLK_DEV, si->dev))) {
+		printk("WARNING: %s(): device major %d not found!\n", __FUNCTION__, MAJOR(si->dev));
+		return -ENXIO;
+	}
+
+	memset_b(&brh, 0, sizeof(struct blk_request));
+	for(n = 0; n < PAGE_SIZE / si->blksize; n++) {
+		memset_b(&buf[n], 0, sizeof(struct buffer));
+		buf[n].dev = si->dev;
+		buf[n].block = swap_block(si, SWP_OFFSET(entry), n);
+		buf[n].size = si->blksize;
+		buf[n].data = data + (n * si->blksize);
+		memset_b(&br[n], 0, sizeof(struct blk_request));
+		br[n].dev = buf[n].dev;
+		br[n].block = buf[n].block;
+		br[n].size = buf[n].size;
+		br[n].buffer = &buf[n];
+		br[n].device = d;
+		br[n].fn = d->fsop->write_block;
+		br[n].head_group = &brh;
+		if(!n) {
+			brh.next_group = &br[n];
+		} else {
+			br[n - 1].next_group = &br[n];
+		}
+		brh.left++;
+		add_blk_request(&br[n]);
+	}
+	run_blk_request(d);
+
+	SAVE_FLAGS(flags); CLI();
+	if(brh.left) {
+		sleep(&brh, PROC_UNINTERRUPTIBLE);
+	}
+	RESTORE_FLAGS(flags);
+
+	/* a read-ahead could have cached the old contents of the slot */
+	for(n = 0; n < PAGE_SIZE / si->blksize; n++) {
+		invalidate_buffer(buf[n].dev, buf[n].block, buf[n].size);
+	}
+	if(brh.errno < 0) {
+		printk("WARNING: %s(): unable to write the slot %d of the swap area %d.\n", __FUNCTION__, SWP_OFFSET(entry), SWP_TYPE(entry));
+	}
+	return brh.errno;
+}
+
+/*
+ * Reads into the buffer cache the slots in use around 'entry', since the
+ * pages of a region are usually swapped out (and needed again) together.
+ */
+static void swap_readahead(unsigned int entry)
+{
+	struct swap_info *si;
+	struct device *d;
+	struct blk_request brh, *br, *tmp;
+	unsigned int offset, start;
+	int n;
+
+	if(kstat.free_pages <= kstat.min_free_pages) {
+		return;
+	}
+	si = &swap_info[SWP_TYPE(entry)];
+	if(!(d = get_device(BLK_DEV, si->dev))) {
+		return;
+	}
+
+	memset_b(&brh, 0, sizeof(struct blk_request));
+	brh.flags = BRF_ASYNC;
+	tmp = NULL;
+	start = SWP_OFFSET(entry) & ~(SWAP_CLUSTER - 1);
+	for(offset = start; offset < start + SWAP_CLUSTER && offset < si->max; offset++) {
+		if(offset == SWP_OFFSET(entry) || !si->map[offset] || si->map[offset] == SWAP_MAP_BAD) {
+			continue;
+		}
+		for(n = 0; n < PAGE_SIZE / si->blksize; n++) {
+			if(!(br = (struct blk_request *)kmem_cache_alloc(blk_request_cache))) {
+				break;
+			}
+			memset_b(br, 0, sizeof(struct blk_request));
+			br->dev = si->dev;
+			br->block = swap_block(si, offset, n);
+			br->size = si->blksize;
+			br->device = d;
+			br->fn = d->fsop->read_block;
+			if(!brh.next_group) {
+				brh.next_group = br;
+			} else {
+				tmp->next_group = br;
+			}
+			tmp = br;
+		}
+	}
+	if(brh.next_group) {
+		gbread(d, &brh);
+	}
+}
+
+/* allocates a slot in the area with the highest priority */
+unsigned int get_swap_page(void)
+{
+	unsigned int flags, offset, n;
+	struct swap_info *si, *best;
+	int type;
+
+	SAVE_FLAGS(flags); CLI();
+	best = NULL;
+	for(type = 0; type < MAX_SWAPFILES; type++) {
+		si = &swap_info[type];
+		if(!(si->flags & SWP_WRITEOK) || si->inuse >= si->pages) {
+			continue;
+		}
+		if(!best || si->prio > best->prio) {
+			best = si;
+		}
+	}
+	if((si = best)) {
+		/* consecutive slots keep the pages of a region together */
+		offset = si->cluster_next;
+		for(n = 1; n < si->max; n++, offset++) {
+			if(offset >= si->max) {
+				offset = 1;
+			}
+			if(!si->map[offset]) {
+				si->map[offset] = 1;
+				si->inuse++;
+				si->cluster_next = offset + 1;
+				kstat.free_swap_pages--;
+				RESTORE_FLAGS(flags);
+				return SWP_ENTRY(si - swap_info, offset);
+			}
+		}
+	}
+	RESTORE_FLAGS(flags);
+	return 0;
+}
+
+void swap_free(unsigned int entry)
+{
+	unsigned int flags, offset;
+	struct swap_info *si;
+
+	if(!(si = get_swap_info(entry))) {
+		return;
+	}
+	offset = SWP_OFFSET(entry);
+
+	SAVE_FLAGS(flags); CLI();
+	if(!si->map[offset]) {
+		printk("WARNING: %s(): slot %d of the swap area %d is already free!\n", __FUNCTION__, offset, SWP_TYPE(entry));
+	} else if(si->map[offset] != SWAP_MAP_BAD) {
+		if(!--si->map[offset]) {
+			si->inuse--;
+			/* the slots of an area being disabled are no longer counted */
+			if(si->flags & SWP_WRITEOK) {
+				kstat.free_swap_pages++;
+			}
+#ifdef CONFIG_ZRAM
+			if(!si->blocks && MAJOR(si->dev) == ZRAM_MAJOR) {
+				zram_free_page(si->dev, offset);
+			}
+#endif /* CONFIG_ZRAM */
+		}
+	}
+	RESTORE_FLAGS(flags);
+}
+
+/* the entry has been copied to another page table (fork) */
+void swap_duplicate(unsigned int entry)
+{
+	unsigned int flags, offset;
+	struct swap_info *si;
+
+	if(!(si = get_swap_info(entry))) {
+		return;
+	}
+	offset = SWP_OFFSET(entry);
+
+	SAVE_FLAGS(flags); CLI();
+	if(si->map[offset] && si->map[offset] < SWAP_MAP_BAD - 1) {
+		si->map[offset]++;
+	}
+	RESTORE_FLAGS(flags);
+}
+
+/*
+ * Reads back the page at 'addr' of the process 'p', whose page table must
+ * not be shared. The page table is pinned while sleeping, and the page is
+ * only mapped if nobody has freed, shared or changed the entry meanwhile.
+ */
+static int do_swap_in(struct proc *p, unsigned int addr, int prot)
+{
+	unsigned int *pgdir, *pgtbl;
+	unsigned int pde, pte, entry, page;
+	struct page *tbl;
+	int errno;
+
+	pgdir = (unsigned int *)P2V(p->tss.cr3);
+	pde = GET_PGDIR(addr);
+	pte = GET_PGTBL(addr);
+	if(!(pgdir[pde] & PAGE_PRESENT)) {
+		return 0;
+	}
+	pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+	entry = pgtbl[pte];
+	if(!IS_SWP_ENTRY(entry)) {
+		return 0;
+	}
+	if(!get_swap_info(entry)) {
+		return -EFAULT;
+	}
+
+	tbl = &page_table[(pgdir[pde] & PAGE_MASK) >> PAGE_SHIFT];
+	tbl->count++;
+	if(!(page = kmalloc(PAGE_SIZE))) {
+		kfree((unsigned int)pgtbl);
+		return -ENOMEM;
+	}
+
+	swap_readahead(entry);
+	if(!(errno = read_swap_page(entry, (char *)page))) {
+		if(tbl->count == 2 && pgtbl[pte] == entry) {
+			pgtbl[pte] = V2P(page) | PAGE_PRESENT | PAGE_USER;
+			if(prot & PROT_WRITE) {
+				pgtbl[pte] |= PAGE_RW;
+			}
+			p->rss++;
+			kstat.swap_ins++;
+			swap_free(entry);
+			page = 0;
+		}
+	}
+	if(page) {
+		kfree(page);
+	}
+	kfree((unsigned int)pgtbl);
+	invalidate_tlb();
+	return errno;
+}
+
+/* called from the page fault handler when the entry of 'addr' is swapped */
+int swap_in(struct vma *vma, unsigned int addr)
+{
+	unsigned int *pgdir;
+	unsigned int pde;
+
+	pgdir = (unsigned int *)P2V(current->tss.cr3);
+	pde = GET_PGDIR(addr);
+	if(PGTBL_SHARED(pgdir[pde])) {
+		if(unshare_page_table(current, pde)) {
+			printk("%s(): not enough memory!\n", __FUNCTION__);
+			return 1;
+		}
+	}
+	if(do_swap_in(current, addr, vma->prot) < 0) {
+		return 1;
+	}
+	current->usage.ru_majflt++;
+	return 0;
+}
+
+/*
+ * Writes an anonymous page into a new slot. The page and its page table are
+ * pinned during the write, and the dirty bit of the entry tells if the page
+ * was modified meanwhile, in which case the slot is discarded.
+ */
+static int swap_out_page(struct proc *p, unsigned int *pgtbl, unsigned int pte)
+{
+	unsigned int entry, page;
+	struct page *pg, *tbl;
+	int freed;
+
+	if(!(entry = get_swap_page())) {
+		return 0;
+	}
+	page = pgtbl[pte] >> PAGE_SHIFT;
+	pg = &page_table[page];
+	tbl = &page_table[V2P((unsigned int)pgtbl) >> PAGE_SHIFT];
+
+	pgtbl[pte] &= ~PAGE_DIRTY;
+	pg->count++;
+	tbl->count++;
+	freed = 0;
+	if(!write_swap_page(entry, (char *)P2V((page << PAGE_SHIFT)))) {
+		if(tbl->count == 2 && pg->count == 2 && (pgtbl[pte] & (PAGE_MASK | PAGE_PRESENT | PAGE_DIRTY)) == ((page << PAGE_SHIFT) | PAGE_PRESENT)) {
+			pgtbl[pte] = entry;
+			p->rss--;
+			p->usage.ru_nswap++;
+			kstat.swap_outs++;
+			kfree(P2V((page << PAGE_SHIFT)));
+			freed = 1;
+		}
+	}
+	if(!freed) {
+		swap_free(entry);
+	}
+	kfree(P2V((page << PAGE_SHIFT)));
+	kfree((unsigned int)pgtbl);
+	return freed;
+}
+
+/*
+ * Scans the process from the clock hand on, returning when 'nr' pages are
+ * freed, when '*scan' reaches zero or after the first write (which sleeps).
+ */
+static int swap_out_proc(struct proc *p, int nr, int *scan)
+{
+	unsigned int *pgdir, *pgtbl;
+	unsigned int addr, pde, pte, page;
+	struct page *pg;
+	struct vma *vma;
+	int freed;
+
+	pgdir = (unsigned int *)P2V(p->tss.cr3);
+	freed = 0;
+	for(vma = p->vma_table; vma; vma = vma->next) {
+		if(vma->end <= swap_addr) {
+			continue;
+		}
+		/* shared and locked pages stay in memory */
+		if(vma->flags & (MAP_SHARED | MAP_LOCKED) || vma->object) {
+			continue;
+		}
+		addr = MAX(swap_addr, vma->start);
+		while(addr < vma->end) {
+			if(freed >= nr || *scan <= 0) {
+				return freed;
+			}
+			pde = GET_PGDIR(addr);
+			pte = GET_PGTBL(addr);
+			if(!(pgdir[pde] & PAGE_PRESENT) || PGTBL_SHARED(pgdir[pde])) {
+				addr = (pde + 1) << 22;
+				continue;
+			}
+			pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+			addr += PAGE_SIZE;
+			swap_addr = addr;
+			if(!(pgtbl[pte] & PAGE_PRESENT) || pgtbl[pte] & PAGE_NOALLOC) {
+				continue;
+			}
+			(*scan)--;
+
+			/* accessed since the last pass, it gets a second chance */
+			if(pgtbl[pte] & PAGE_ACCESSED) {
+				pgtbl[pte] &= ~PAGE_ACCESSED;
+				continue;
+			}
+			page = pgtbl[pte] >> PAGE_SHIFT;
+			pg = &page_table[page];
+			if(pg->flags & (PAGE_RESERVED | PAGE_LOCKED)) {
+				continue;
+			}
+
+			/* a page of the page cache will be found there again */
+			if(pg->inode) {
+				pgtbl[pte] = 0;
+				p->rss--;
+				kfree(P2V((page << PAGE_SHIFT)));
+				freed++;
+				continue;
+			}
+			if(pg->count == 1 && kstat.free_swap_pages) {
+				return freed + swap_out_page(p, pgtbl, pte);
+			}
+		}
+	}
+
+	/* move the clock hand to the next process */
+	swap_pid = p->pid + 1;
+	swap_addr = 0;
+	return freed;
+}
+
+/*
+ * A vfork() child uses the address space of its parent, whose vma_table is
+ * stale (and might have been freed) until the child gives it back. So the
+ * parent is skipped and its address space is scanned through the child.
+ */
+static int can_scan_proc(struct proc *p)
+{
+	struct proc *c;
+
+	if(p->state == PROC_ZOMBIE || p->flags & PF_KPROC || !p->vma_table) {
+		return 0;
+	}
+	FOR_EACH_PROCESS(c) {
+		if(c->flags & PF_VFORK && c->ppid == p) {
+			return 0;
+		}
+		c = c->next;
+	}
+	return 1;
+}
+
+/* the process with the lowest pid >= 'pid' whose pages can be reclaimed */
+static struct proc *next_swap_proc(__pid_t pid)
+{
+	struct proc *p, *found;
+
+	found = NULL;
+	FOR_EACH_PROCESS(p) {
+		if(p->pid >= pid && (!found || p->pid < found->pid)) {
+			if(can_scan_proc(p)) {
+				found = p;
+			}
+		}
+		p = p->next;
+	}
+	return found;
+}
+
+/* reclaims up to 'nr' pages mapped by the processes */
+int swap_out(int nr)
+{
+	struct proc *p;
+	int freed, scan, turns;
+
+	lock_resource(&swap_resource);
+	freed = turns = 0;
+	scan = kstat.total_mem_pages * 2;
+	while(freed < nr && scan > 0) {
+		if(!(p = next_swap_proc(swap_pid))) {
+			if(++turns > 1) {
+				break;
+			}
+			swap_pid = 0;
+			swap_addr = 0;
+			continue;
+		}
+		if(p->pid != swap_pid) {
+			swap_pid = p->pid;
+			swap_addr = 0;
+		}
+		freed += swap_out_proc(p, nr - freed, &scan);
+	}
+	unlock_resource(&swap_resource);
+
+	if(freed) {
+		wakeup(&get_free_page);
+	}
+	return freed;
+}
+
+static struct vma *find_proc_vma(struct proc *p, unsigned int addr)
+{
+	struct vma *vma;
+
+	for(vma = p->vma_table; vma; vma = vma->next) {
+		if(addr >= vma->start && addr < vma->end) {
+			return vma;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Brings back the pages of the process 'p' in the area 'type'. It returns
+ * 1 if the process has exited meanwhile.
+ */
+static int unuse_process(struct proc *p, int type)
+{
+	unsigned int *pgdir, *pgtbl;
+	unsigned int pde, pte, addr;
+	struct vma *vma;
+	__pid_t pid;
+	int errno;
+
+	pid = p->pid;
+	pgdir = (unsigned int *)P2V(p->tss.cr3);
+	for(pde = 0; pde < GET_PGDIR(PAGE_OFFSET); pde++) {
+		for(pte = 0; pte < PT_ENTRIES; pte++) {
+			if((pgdir[pde] & (PAGE_PRESENT | PAGE_USER)) != (PAGE_PRESENT | PAGE_USER)) {
+				break;
+			}
+			pgtbl = (unsigned int *)P2V((pgdir[pde] & PAGE_MASK));
+			if(!IS_SWP_ENTRY(pgtbl[pte]) || SWP_TYPE(pgtbl[pte]) != type) {
+				continue;
+			}
+			if(PGTBL_SHARED(pgdir[pde])) {
+				if(unshare_page_table(p, pde)) {
+					return -ENOMEM;
+				}
+				if(p->pid != pid || p->state == PROC_ZOMBIE) {
+					return 1;
+				}
+			}
+			addr = (pde << 22) | (pte << PAGE_SHIFT);
+			vma = find_proc_vma(p, addr);
+			if((errno = do_swap_in(p, addr, vma ? vma->prot : PROT_READ)) < 0) {
+				return errno;
+			}
+			if(p->pid != pid || p->state == PROC_ZOMBIE) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int try_to_unuse(int type)
+{
+	struct swap_info *si;
+	struct proc *p;
+	unsigned int inuse;
+	int errno;
+
+	si = &swap_info[type];
+	while(si->inuse) {
+		inuse = si->inuse;
+restart:
+		FOR_EACH_PROCESS(p) {
+			if(can_scan_proc(p)) {
+				if((errno = unuse_process(p, type)) < 0) {
+					return errno;
+				}
+				if(errno) {
+					goto restart;
+				}
+			}
+			p = p->next;
+		}
+		if(si->inuse == inuse) {
+			printk("WARNING: %s(): %d slots of the swap area %d are still in use.\n", __FUNCTION__, si->inuse, type);
+			return -EBUSY;
+		}
+		if(current->sigpending & ~current->sigblocked) {
+			return -EINTR;
+		}
+	}
+	return 0;
+}
+
+static int setup_swap_dev(struct swap_info *si, struct inode *i)
+{
+	struct device *d;
+	int errno;
+
+	if(get_superblock(i->rdev)) {
+		return -EBUSY;
+	}
+	if(!(d = get_device(BLK_DEV, i->rdev)) || !d->device_data) {
+		return -ENXIO;
+	}
+	if(!i->fsop || !i->fsop->open) {
+		return -EINVAL;
+	}
+	if((errno = i->fsop->open(i, NULL))) {
+		return errno;
+	}
+	si->dev = i->rdev;
+	si->blksize = PAGE_SIZE;
+	si->max = ((unsigned int *)d->device_data)[MINOR(si->dev)] / (PAGE_SIZE / 1024);
+
+	/* from now on its blocks are read and written by the swap only */
+	sync_buffers(si->dev);
+	invalidate_buffers(si->dev);
+	return 0;
+}
+
+/*
+ * The blocks of a swap file are looked up only once, it must have no holes.
+ * Its inode is marked so that nobody can truncate it or write on it.
+ */
+static int setup_swap_file(struct swap_info *si, struct inode *i)
+{
+	unsigned int n, nr;
+	int block;
+
+	if(!i->sb || !i->fsop || !(i->fsop->flags & FSOP_REQUIRES_DEV) || !i->fsop->bmap) {
+		return -EINVAL;
+	}
+	si->dev = i->dev;
+	si->blksize = i->sb->s_blocksize;
+	si->max = i->i_size / PAGE_SIZE;
+	if(!si->max) {
+		return -EINVAL;
+	}
+	i->state |= INODE_SWAPFILE;
+	nr = si->max * (PAGE_SIZE / si->blksize);
+	if(!(si->blocks = (__blk_t *)kmalloc(nr * sizeof(__blk_t)))) {
+		return -ENOMEM;
+	}
+	for(n = 0; n < nr; n++) {
+		if((block = bmap(i, n * si->blksize, FOR_READING)) <= 0) {
+			printk("WARNING: %s(): the swap file has holes.\n", __FUNCTION__);
+			return -EINVAL;
+		}
+		si->blocks[n] = block;
+	}
+	sync_inode_buffers(i);
+	return 0;
+}
+
+static int read_swap_header(struct swap_info *si, int type)
+{
+	union swap_header *hdr;
+	unsigned int n, last;
+	int errno;
+
+	if(!(hdr = (union swap_header *)kmalloc(PAGE_SIZE))) {
+		return -ENOMEM;
+	}
+	if((errno = read_swap_page(SWP_ENTRY(type, 0), (char *)hdr))) {
+		kfree((unsigned int)hdr);
+		return errno;
+	}
+	if(strncmp(hdr->magic.magic, "SWAPSPACE2", 10)) {
+		printk("WARNING: %s(): unable to find the swap-space signature.\n", __FUNCTION__);
+		kfree((unsigned int)hdr);
+		return -EINVAL;
+	}
+	if(hdr->info.version != 1 || hdr->info.nr_badpages > MAX_SWAP_BADPAGES) {
+		printk("WARNING: %s(): unsupported swap-space header.\n", __FUNCTION__);
+		kfree((unsigned int)hdr);
+		return -EINVAL;
+	}
+	last = hdr->info.last_page;
+	if(last && last < si->max - 1) {
+		si->max = last + 1;
+	}
+
+	if(!(si->map = (unsigned short int *)kmalloc(si->max * sizeof(unsigned short int)))) {
+		kfree((unsigned int)hdr);
+		return -ENOMEM;
+	}
+	memset_b(si->map, 0, si->max * sizeof(unsigned short int));
+	si->map[0] = SWAP_MAP_BAD;
+	for(n = 0; n < hdr->info.nr_badpages; n++) {
+		if(hdr->info.badpages[n] && hdr->info.badpages[n] < si->max) {
+			si->map[hdr->info.badpages[n]] = SWAP_MAP_BAD;
+		}
+	}
+	for(n = 1; n < si->max; n++) {
+		if(!si->map[n]) {
+			si->pages++;
+		}
+	}
+	kfree((unsigned int)hdr);
+	return si->pages ? 0 : -EINVAL;
+}
+
+/*
+ * Enables the swap area in 'i', which keeps the reference on success. The
+ * slot is only reserved while the area is set up, so kswapd doesn't wait
+ * for it if the memory needed here runs low.
+ */
+int swap_on(struct inode *i, const char *name, int swap_flags)
+{
+	struct swap_info *si;
+	int type, errno;
+
+	lock_resource(&swap_resource);
+	si = NULL;
+	for(type = 0; type < MAX_SWAPFILES; type++) {
+		if(swap_info[type].flags & SWP_USED) {
+			if(swap_info[type].inode == i) {
+				unlock_resource(&swap_resource);
+				return -EBUSY;
+			}
+		} else if(!si) {
+			si = &swap_info[type];
+		}
+	}
+	if(!si) {
+		unlock_resource(&swap_resource);
+		return -EPERM;
+	}
+	type = si - swap_info;
+	memset_b(si, 0, sizeof(struct swap_info));
+	si->flags = SWP_USED;
+	si->inode = i;
+	unlock_resource(&swap_resource);
+
+	if(S_ISBLK(i->i_mode)) {
+		errno = setup_swap_dev(si, i);
+	} else if(S_ISREG(i->i_mode)) {
+		errno = setup_swap_file(si, i);
+	} else {
+		errno = -EINVAL;
+	}
+	if(!errno && !(errno = read_swap_header(si, type))) {
+		si->cluster_next = 1;
+		if(swap_flags & SWAP_FLAG_PREFER) {
+			si->prio = swap_flags & SWAP_FLAG_PRIO_MASK;
+		} else {
+			si->prio = --least_prio;
+		}
+		strncpy(si->name, name, SWAP_NAME_LEN);
+		lock_resource(&swap_resource);
+		si->flags |= SWP_WRITEOK;
+		kstat.total_swap_pages += si->pages;
+		kstat.free_swap_pages += si->pages;
+		unlock_resource(&swap_resource);
+		return 0;
+	}
+
+	if(si->dev && S_ISBLK(i->i_mode) && i->fsop->close) {
+		i->fsop->close(i, NULL);
+	}
+	i->state &= ~INODE_SWAPFILE;
+	if(si->map) {
+		kfree((unsigned int)si->map);
+	}
+	if(si->blocks) {
+		kfree((unsigned int)si->blocks);
+	}
+	lock_resource(&swap_resource);
+	memset_b(si, 0, sizeof(struct swap_info));
+	unlock_resource(&swap_resource);
+	return errno;
+}
+
+/* disables the swap area in 'i' once all its pages are read back */
+int swap_off(struct inode *i)
+{
+	struct swap_info *si;
+	int type, errno;
+
+	lock_resource(&swap_resource);
+	for(type = 0; type < MAX_SWAPFILES; type++) {
+		if(swap_info[type].flags & SWP_USED && swap_info[type].inode == i) {
+			break;
+		}
+	}
+	if(type == MAX_SWAPFILES) {
+		unlock_resource(&swap_resource);
+		return -EINVAL;
+	}
+	si = &swap_info[type];
+	if(!(si->flags & SWP_WRITEOK)) {
+		unlock_resource(&swap_resource);
+		return -EBUSY;
+	}
+	si->flags &= ~SWP_WRITEOK;
+	kstat.total_swap_pages -= si->pages;
+	kstat.free_swap_pages -= si->pages - si->inuse;
+	unlock_resource(&swap_resource);
+
+	errno = try_to_unuse(type);
+
+	lock_resource(&swap_resource);
+	if(errno) {
+		si->flags |= SWP_WRITEOK;
+		kstat.total_swap_pages += si->pages;
+		kstat.free_swap_pages += si->pages - si->inuse;
+		unlock_resource(&swap_resource);
+		return errno;
+	}
+	kfree((unsigned int)si->map);
+	if(si->blocks) {
+		kfree((unsigned int)si->blocks);
+	}
+	if(S_ISBLK(i->i_mode)) {
+		if(i->fsop && i->fsop->close) {
+			i->fsop->close(i, NULL);
+		}
+		invalidate_buffers(si->dev);
+	}
+	i->state &= ~INODE_SWAPFILE;
+	iput(si->inode);
+	memset_b(si, 0, sizeof(struct swap_info));
+	unlock_resource(&swap_resource);
+	return 0;
+}
@@ -14,10 +14,12 @@
 #include <fiwix/serial.h>
 #include <fiwix/lp.h>
 #include <fiwix/ramdisk.h>
+#include <fiwix/zram.h>
 #include <fiwix/floppy.h>
 #include <fiwix/ata.h>
 #include <fiwix/buffer.h>
 #include <fiwix/mm.h>
+#include <fiwix/swap.h>
 #include <fiwix/fs.h>
 #include <fiwix/filesystems.h>
 #include <fiwix/pty.h>
@@ -38,6 +40,9 @@ int kswapd(void)
 
 	/* block devices */
 	ramdisk_init();
+#ifdef CONFIG_ZRAM
+	zram_init();
+#endif /* CONFIG_ZRAM */
 	floppy_init();
 	ata_init();
 
@@ -52,7 +57,14 @@ int kswapd(void)
 
 	for(;;) {
 		sleep(&kswapd, PROC_INTERRUPTIBLE);
-		if((kstat.pages_reclaimed = reclaim_buffers())) {
+		kstat.pages_reclaimed = bh_shrink();
+		kstat.pages_reclaimed += reclaim_buffers();
+
+		/* the caches were not enough, take pages from the processes */
+		if(kstat.free_pages <= kstat.min_free_pages) {
+			kstat.pages_reclaimed += swap_out(NR_SWAP_RECLAIM);
+		}
+		if(kstat.pages_reclaimed) {
 			continue;
 		}
 		wakeup(&get_free_page);
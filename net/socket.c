@@ -65,7 +65,7 @@ static int sock_alloc(struct socket **s)
 		printk("WARNING: %s(): sockfs filesystem is not registered!\n", __FUNCTION__);
 		return -EINVAL;
 	}
-	if(!(i = ialloc(&fs->mp->sb, S_IFSOCK))) {
+	if(!(i = ialloc(&fs->mp->sb, NULL, S_IFSOCK))) {
 		return -EINVAL;
 	}
 	if((fd = get_new_fd(i)) < 0) {
@@ -16,6 +16,7 @@
 #include <fiwix/fcntl.h>
 #include <fiwix/sched.h>
 #include <fiwix/sleep.h>
+#include <fiwix/poll.h>
 #include <fiwix/mm.h>
 #include <fiwix/string.h>
 #include <fiwix/stdio.h>
@@ -24,6 +25,7 @@
 struct unix_info *unix_socket_head;
 
 static struct resource packet_resource = { 0, 0 };
+static struct kmem_cache *packet_cache;
 
 static void add_unix_socket(struct unix_info *u)
 {
@@ -57,6 +59,14 @@ static void remove_unix_socket(struct unix_info *u)
 	}
 }
 
+/* wakes up the processes selecting the socket of 'u' */
+static void unix_wakeup(struct unix_info *u)
+{
+	if(u && u->socket) {
+		wakeup_queue(&u->socket->wq);
+	}
+}
+
 static struct unix_info *lookup_unix_socket(char *path, struct inode *i)
 {
 	struct unix_info *u;
@@ -114,7 +124,7 @@ void unix_free(struct socket *s)
 			u->peer->socket->state = SS_DISCONNECTING;
 		}
 		wakeup(u->peer);
-		wakeup(&do_select);
+		unix_wakeup(u->peer);
 	}
 	remove_unix_socket(u);
 	return;
@@ -196,6 +206,7 @@ int unix_connect(struct socket *sc, const struct sockaddr *addr, int addrlen)
 		return errno;
 	}
 	wakeup(up->socket);
+	wakeup_queue(&up->socket->wq);
 	sleep(sc, PROC_INTERRUPTIBLE);
 	return 0;
 }
@@ -220,7 +231,7 @@ int unix_accept(struct socket *sc, struct socket *nss)
 	sc->state = SS_CONNECTED;
 	nss->state = SS_CONNECTED;
 	wakeup(sc);
-	wakeup(&do_select);
+	wakeup_queue(&sc->wq);
 	return 0;
 }
 
@@ -320,12 +331,12 @@ int unix_sendto(struct socket *s, struct fd *f, const char *buffer, __size_t cou
 	iput(i);
 	free_name(tmp_name);
 
-	if(!(p = (struct packet *)kmalloc(sizeof(struct packet)))) {
+	if(!(p = (struct packet *)kmem_cache_alloc(packet_cache))) {
 		return -ENOMEM;
 	}
 	memset_b(p, 0, sizeof(struct packet));
 	if(!(p->data = (char *)kmalloc(count + 1))) {
-		kfree((unsigned int)p);
+		kmem_cache_free(packet_cache, p);
 		return -ENOMEM;
 	}
 	memset_b(p->data, 0, count + 1);
@@ -368,7 +379,7 @@ int unix_recvfrom(struct socket *s, struct fd *f, char *buffer, __size_t count,
 	if(!(flags & MSG_PEEK)) {
 		p = remove_packet_from_queue(&u->packet_queue);
 		kfree((unsigned int)p->data);
-		kfree((unsigned int)p);
+		kmem_cache_free(packet_cache, p);
 	}
 	unlock_resource(&packet_resource);
 
@@ -410,7 +421,7 @@ int unix_read(struct socket *s, struct fd *f, char *buffer, __size_t count)
 				u->writeoff = 0;
 			}
 			wakeup(u->peer);
-			wakeup(&do_select);
+			unix_wakeup(u->peer);
 		} else {
 			if(s->state != SS_CONNECTED) {
 				if(s->state == SS_DISCONNECTING) {
@@ -480,11 +491,11 @@ int unix_write(struct socket *s, struct fd *f, const char *buffer, __size_t coun
 				up->readoff = 0;
 			}
 			wakeup(u->peer);
-			wakeup(&do_select);
+			unix_wakeup(up);
 			continue;
 		}
 		wakeup(u->peer);
-		wakeup(&do_select);
+		unix_wakeup(up);
 		if(!(f->flags & O_NONBLOCK)) {
 			if(sleep(u, PROC_INTERRUPTIBLE)) {
 				return -EINTR;
@@ -500,6 +511,7 @@ int unix_select(struct socket *s, int flag)
 {
 	struct unix_info *u, *up;
 
+	select_wait(&s->wq);
 	if(s->flags & SO_ACCEPTCONN) {
 		if (flag == SEL_R && s->queue_len) {
 			return 1;
@@ -529,6 +541,11 @@ int unix_select(struct socket *s, int flag)
 				return 1;
 			}
 			break;
+		case SEL_HUP:
+			if(s->state != SS_CONNECTED) {
+				return 1;
+			}
+			break;
 	}
 	return 0;
 }
@@ -551,6 +568,7 @@ int unix_getsockopt(struct socket *s, int level, int optname, void *optval, sock
 int unix_init(void)
 {
 	unix_socket_head = NULL;
+	packet_cache = kmem_cache_create("packet", sizeof(struct packet), NULL);
 	return 0;
 }
 #endif /* CONFIG_NET */